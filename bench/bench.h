@@ -0,0 +1,80 @@
+/**
+ * @brief Shared pieces of the benchmark executable. Every case reports named metrics, the runner writes them out
+ * as JSON and can compare them against an earlier run so CI catches regressions
+ */
+#pragma once
+#include "atelier/atelier_base.h"
+#include "atelier/atelier_vk_completed.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace Atelier
+{
+
+struct BenchMetric {
+    std::string m_name;
+    std::string m_unit;
+    double m_value = 0.0;
+    bool m_higher_is_better = false;
+};
+
+/**
+ * @brief Handed to every case. The Vulkan members are only filled in when a device could be created, cases which
+ * need it are skipped otherwise
+ */
+struct BenchContext {
+    bool m_quick = false;  // A fraction of the iterations, for the CTest smoke run
+    bool m_failed = false;  // Set by cases which check their results and find them wrong
+    std::vector<BenchMetric> m_metrics;
+
+    VkCompletedState* m_vk = nullptr;
+    VkCompletedDevice* m_device = nullptr;
+    uint32_t m_graphics_family = 0;
+    VkQueue m_graphics_queue = VK_NULL_HANDLE;
+
+    void report(const char* name, const char* unit, double value, bool higher_is_better)
+    {
+        m_metrics.push_back({name, unit, value, higher_is_better});
+        Log::info("%-44s %14.3f %s", name, value, unit);
+    }
+
+    void fail(const char* what)
+    {
+        Log::error("%s", what);
+        m_failed = true;
+    }
+
+    uint32_t iterations(uint32_t full) const { return m_quick ? std::max(1u, full / 10) : full; }
+};
+
+struct BenchCase {
+    const char* m_name;
+    void (*m_run)(BenchContext& ctx);
+    bool m_needs_vulkan;
+};
+
+inline uint64_t bench_now_ns()
+{
+    using namespace std::chrono;
+    return uint64_t(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+// Nearest rank percentile in [0, 1], sorts the samples
+inline double bench_percentile(std::vector<double>& samples, double p)
+{
+    if (samples.empty()) return 0.0;
+    std::sort(samples.begin(), samples.end());
+    size_t index = size_t(p * double(samples.size() - 1) + 0.5);
+    return samples[std::min(index, samples.size() - 1)];
+}
+
+inline double bench_median(std::vector<double>& samples) { return bench_percentile(samples, 0.5); }
+
+// Each file appends its own cases
+void bench_core_cases(std::vector<BenchCase>& out);
+void bench_vk_cases(std::vector<BenchCase>& out);
+
+}  // namespace Atelier
@@ -0,0 +1,933 @@
+/**
+ * @brief Cases which only need the CPU
+ */
+#include "bench.h"
+#include "atelier/atelier_bvh.h"
+#include "atelier/atelier_frame_pacer.h"
+#include "atelier/atelier_frame_pipeline.h"
+#include "atelier/atelier_jobs.h"
+#include "atelier/atelier_mesh.h"
+#include "atelier/atelier_pixel.h"
+#include "atelier/atelier_scene.h"
+#include "atelier/atelier_vk_dynamic_resolution.h"
+#include "atelier/atelier_vk_reactor.h"
+#include "atelier/atelier_vk_shader.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <random>
+#include <thread>
+using namespace Atelier;
+
+static void bench_logger(BenchContext& ctx)
+{
+    // Formatting and the write itself, but not whatever terminal happens to be attached
+#ifdef _WIN32
+    FILE* sink = fopen("NUL", "wb");
+#else
+    FILE* sink = fopen("/dev/null", "wb");
+#endif
+    if (sink == nullptr) return;
+
+    Log::redirect(sink);
+    uint32_t calls = ctx.iterations(200000);
+    uint64_t start = bench_now_ns();
+    for (uint32_t i = 0; i < calls; i++) Log::info("frame %u took %.3f ms", i, 16.6);
+    uint64_t elapsed = bench_now_ns() - start;
+    Log::redirect(nullptr);
+    fclose(sink);
+
+    ctx.report("logger_info_ns_per_call", "ns", double(elapsed) / calls, false);
+}
+
+static void bench_hash(BenchContext& ctx)
+{
+    std::vector<uint8_t> data(size_t(64) << 20);
+    for (size_t i = 0; i < data.size(); i++) data[i] = uint8_t(i * 31);
+
+    // Volatile so the hashes can't be optimized out
+    std::vector<double> samples;
+    volatile uint64_t sink = 0;
+    for (uint32_t i = 0; i < ctx.iterations(20); i++) {
+        uint64_t start = bench_now_ns();
+        sink = sink ^ hash_bytes(data.data(), data.size());
+        samples.push_back(double(bench_now_ns() - start));
+    }
+    ctx.report("hash_bytes_gbps", "GB/s", double(data.size()) / bench_median(samples), true);
+}
+
+static void bench_jobs(BenchContext& ctx)
+{
+    JobSystem jobs;
+    jobs.init();
+
+    // Many tiny ranges, so this is mostly the cost of handing out work
+    std::vector<double> samples;
+    std::atomic<uint64_t> total{0};
+    for (uint32_t i = 0; i < ctx.iterations(50); i++) {
+        uint64_t start = bench_now_ns();
+        jobs.parallel_for(1 << 20, 256, [&](size_t begin, size_t end) {
+            uint64_t local = 0;
+            for (size_t j = begin; j < end; j++) local += j;
+            total.fetch_add(local, std::memory_order_relaxed);
+        });
+        samples.push_back(double(bench_now_ns() - start));
+    }
+    jobs.shutdown();
+    ctx.report("jobs_parallel_for_1m_us", "us", bench_median(samples) / 1000.0, false);
+}
+
+// Runs fn a few times and returns the best throughput, bytes counts both what is read and written per call
+template <class Fn>
+static double measure_gbps(BenchContext& ctx, size_t bytes, Fn fn)
+{
+    std::vector<double> samples;
+    for (uint32_t i = 0; i < ctx.iterations(10); i++) {
+        uint64_t start = bench_now_ns();
+        fn();
+        samples.push_back(double(bench_now_ns() - start));
+    }
+    return double(bytes) / bench_percentile(samples, 0.0);
+}
+
+static void bench_pixel(BenchContext& ctx)
+{
+    const size_t pixels = ctx.m_quick ? (size_t(1) << 18) : (size_t(1) << 22);
+    const uint32_t width = 2048;
+    const uint32_t height = uint32_t(pixels / width);
+    std::mt19937 rng(7);
+    std::vector<uint8_t> rgba(pixels * 4), rgb(pixels * 3);
+    std::vector<float> linear(pixels * 4);
+    for (auto& b : rgba) b = uint8_t(rng());
+    for (auto& b : rgb) b = uint8_t(rng());
+    for (auto& f : linear) f = std::uniform_real_distribution<float>(-0.1f, 1.1f)(rng);
+
+    const PixelKernels& reference = pixel_kernels(PixelIsa::k_scalar);
+    for (PixelIsa isa : {PixelIsa::k_scalar, PixelIsa::k_sse2, PixelIsa::k_avx2, PixelIsa::k_neon}) {
+        if (!pixel_isa_supported(isa)) continue;
+        const PixelKernels& k = pixel_kernels(isa);
+        std::string prefix = std::string("pixel_") + k.name + "_";
+        auto report = [&](const char* kernel, double gbps) {
+            ctx.report((prefix + kernel + "_gbps").c_str(), "GB/s", gbps, true);
+        };
+        auto check = [&](const char* kernel, const void* a, const void* b, size_t size) {
+            if (memcmp(a, b, size) != 0) ctx.fail((prefix + kernel + " doesn't match the scalar kernel").c_str());
+        };
+
+        std::vector<uint8_t> out8(pixels * 4), ref8(pixels * 4);
+        std::vector<float> out32(pixels * 4), ref32(pixels * 4);
+        std::vector<uint16_t> out16(pixels * 4), ref16(pixels * 4);
+
+        report("swizzle_rb", measure_gbps(ctx, pixels * 8, [&]() {
+                   k.swizzle_rb(out8.data(), rgba.data(), pixels);
+               }));
+        reference.swizzle_rb(ref8.data(), rgba.data(), pixels);
+        check("swizzle_rb", out8.data(), ref8.data(), pixels * 4);
+
+        report("rgb_to_rgba", measure_gbps(ctx, pixels * 7, [&]() {
+                   k.rgb_to_rgba(out8.data(), rgb.data(), pixels, 255);
+               }));
+        reference.rgb_to_rgba(ref8.data(), rgb.data(), pixels, 255);
+        check("rgb_to_rgba", out8.data(), ref8.data(), pixels * 4);
+
+        report("rgba_to_rgb", measure_gbps(ctx, pixels * 7, [&]() {
+                   k.rgba_to_rgb(out8.data(), rgba.data(), pixels);
+               }));
+        reference.rgba_to_rgb(ref8.data(), rgba.data(), pixels);
+        check("rgba_to_rgb", out8.data(), ref8.data(), pixels * 3);
+
+        report("premultiply", measure_gbps(ctx, pixels * 8, [&]() {
+                   k.premultiply(out8.data(), rgba.data(), pixels);
+               }));
+        reference.premultiply(ref8.data(), rgba.data(), pixels);
+        check("premultiply", out8.data(), ref8.data(), pixels * 4);
+
+        report("srgb_to_linear", measure_gbps(ctx, pixels * 20, [&]() {
+                   k.srgb_to_linear(out32.data(), rgba.data(), pixels);
+               }));
+        reference.srgb_to_linear(ref32.data(), rgba.data(), pixels);
+        check("srgb_to_linear", out32.data(), ref32.data(), pixels * 16);
+
+        report("linear_to_srgb", measure_gbps(ctx, pixels * 20, [&]() {
+                   k.linear_to_srgb(out8.data(), linear.data(), pixels);
+               }));
+        reference.linear_to_srgb(ref8.data(), linear.data(), pixels);
+        check("linear_to_srgb", out8.data(), ref8.data(), pixels * 4);
+
+        report("float_to_half", measure_gbps(ctx, pixels * 24, [&]() {
+                   k.float_to_half(out16.data(), linear.data(), pixels * 4);
+               }));
+        reference.float_to_half(ref16.data(), linear.data(), pixels * 4);
+        check("float_to_half", out16.data(), ref16.data(), pixels * 8);
+
+        report("half_to_float", measure_gbps(ctx, pixels * 24, [&]() {
+                   k.half_to_float(out32.data(), ref16.data(), pixels * 4);
+               }));
+        reference.half_to_float(ref32.data(), ref16.data(), pixels * 4);
+        check("half_to_float", out32.data(), ref32.data(), pixels * 16);
+
+        size_t stride = size_t(width) * 4;
+        report("downsample_2x2", measure_gbps(ctx, pixels * 5, [&]() {
+                   k.downsample_2x2(out8.data(), stride / 2, rgba.data(), stride, width, height);
+               }));
+        reference.downsample_2x2(ref8.data(), stride / 2, rgba.data(), stride, width, height);
+        check("downsample_2x2", out8.data(), ref8.data(), pixels);
+    }
+}
+
+// Burns roughly the given time on the calling thread, standing in for a frame's work
+static void simulate_work(uint64_t ns)
+{
+    uint64_t end = pacer_now_ns() + ns;
+    while (pacer_now_ns() < end) {
+    }
+}
+
+static void bench_frame_pacer(BenchContext& ctx)
+{
+    // A high target keeps the run short while still exposing the sleep's wake up slack
+    const double target_hz = 250.0;
+    const uint32_t frames = ctx.iterations(500);
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<uint64_t> work(500000, 1500000);
+
+    auto report = [&](const char* mode, const FramePacer::Stats& stats) {
+        std::string prefix = std::string("frame_pacer_") + mode;
+        ctx.report((prefix + "_stddev_ms").c_str(), "ms", stats.m_interval_stddev_ms, false);
+        double error = std::fabs(stats.m_interval_mean_ms - stats.m_target_ms);
+        ctx.report((prefix + "_mean_error_ms").c_str(), "ms", error, false);
+        ctx.report((prefix + "_p99_ms").c_str(), "ms", stats.m_interval_p99_ms, false);
+    };
+
+    // Everything on one thread, like the wWinMain loop
+    {
+        FramePacer pacer;
+        pacer.init(target_hz);
+        for (uint32_t i = 0; i < frames; i++) {
+            pacer.wait_for_frame();
+            simulate_work(work(rng));
+            pacer.end_cpu();
+        }
+        report("single", pacer.stats());
+        pacer.shutdown();
+    }
+
+    // A render thread picking up each frame after the pacing thread hands it over
+    {
+        FramePacer pacer;
+        pacer.init(target_hz);
+        std::mutex lock;
+        std::condition_variable wake;
+        uint32_t handed = 0;
+        bool done = false;
+        std::thread render([&]() {
+            uint32_t rendered = 0;
+            for (;;) {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [&]() { return done || handed > rendered; });
+                if (handed == rendered) return;
+                rendered++;
+                guard.unlock();
+                uint64_t start = pacer_now_ns();
+                simulate_work(400000);
+                pacer.report_render_cpu(pacer_now_ns() - start);
+            }
+        });
+        for (uint32_t i = 0; i < frames; i++) {
+            pacer.wait_for_frame();
+            simulate_work(work(rng) / 2);
+            pacer.end_cpu();
+            std::lock_guard<std::mutex> guard(lock);
+            handed++;
+            wake.notify_one();
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            done = true;
+            wake.notify_one();
+        }
+        render.join();
+        report("threaded", pacer.stats());
+        pacer.shutdown();
+    }
+}
+
+// What the update stage hands the renderer in the pipeline bench
+struct PipelineBenchFrame {
+    uint64_t m_frame = 0;
+    uint64_t m_start_ns = 0;  // When the update began, which is when input would have been sampled
+};
+
+static void bench_frame_pipeline(BenchContext& ctx)
+{
+    // Each stage sleeps rather than spins so that it holds its own resource the way the GPU does, even on machines
+    // with fewer cores than stages. The times wobble by half in either direction, like real frames
+    const uint64_t update_ns = 2000000, render_ns = 1500000, gpu_ns = 2500000;
+    const uint32_t frames = ctx.iterations(400);
+    auto occupy = [](std::mt19937& rng, uint64_t ns) {
+        std::uniform_int_distribution<uint64_t> wobble(ns / 2, ns + ns / 2);
+        std::this_thread::sleep_for(std::chrono::nanoseconds(wobble(rng)));
+    };
+
+    for (uint32_t depth = 1; depth <= FrameHandoff::k_max_depth; depth++) {
+        std::mt19937 update_rng(depth), render_rng(depth + 10), gpu_rng(depth + 20);
+        FramePipeline<PipelineBenchFrame> pipeline;
+        pipeline.init(depth, [&](PipelineBenchFrame& out, uint64_t frame) {
+            out.m_start_ns = bench_now_ns();
+            out.m_frame = frame;
+            occupy(update_rng, update_ns);
+        });
+
+        // The GPU is one more stage, fed by the render thread with two frames in flight
+        FrameHandoff gpu;
+        gpu.reset(2);
+        uint64_t gpu_start[FrameHandoff::k_max_depth] = {};
+        std::vector<double> latencies;
+        std::thread gpu_thread([&]() {
+            for (;;) {
+                int32_t slot = gpu.acquire_read();
+                if (slot < 0) return;
+                occupy(gpu_rng, gpu_ns);
+                latencies.push_back(double(bench_now_ns() - gpu_start[slot]));
+                gpu.release();
+            }
+        });
+
+        bool ordered = true;
+        uint64_t start = bench_now_ns();
+        for (uint32_t i = 0; i < frames; i++) {
+            const PipelineBenchFrame* frame = pipeline.begin_render();
+            ordered = ordered && frame != nullptr && frame->m_frame == i;
+            uint64_t frame_start = frame != nullptr ? frame->m_start_ns : 0;
+            occupy(render_rng, render_ns);
+            pipeline.end_render();
+            int32_t slot = gpu.acquire_write();
+            gpu_start[slot] = frame_start;
+            gpu.publish();
+        }
+        while (gpu.m_released.load(std::memory_order_acquire) < frames) std::this_thread::yield();
+        double elapsed_ms = double(bench_now_ns() - start) / 1e6;
+        gpu.close();
+        gpu_thread.join();
+        pipeline.shutdown();
+
+        std::string prefix = "frame_pipeline_depth" + std::to_string(depth);
+        ctx.report((prefix + "_ms_per_frame").c_str(), "ms", elapsed_ms / frames, false);
+        ctx.report((prefix + "_latency_ms").c_str(), "ms", bench_median(latencies) / 1e6, false);
+        ctx.report((prefix + "_latency_p99_ms").c_str(), "ms", bench_percentile(latencies, 0.99) / 1e6, false);
+        if (!ordered) ctx.fail("Frame pipeline handed snapshots to the renderer out of order");
+    }
+}
+
+static void bench_dynamic_resolution(BenchContext& ctx)
+{
+    // A GPU whose time goes with the pixel count, at 60hz with a load that jumps to twice what fits halfway
+    // through and drops back for the last quarter. Timestamps arrive two frames late, as they would in flight
+    const uint64_t interval_ns = 16666667;
+    const uint32_t frames = ctx.iterations(2000);
+    std::mt19937 rng(5);
+    std::normal_distribution<double> noise(1.0, 0.04);
+    ResolutionController controller;
+    controller.m_target_ns = interval_ns * 9 / 10;
+    uint64_t in_flight[2] = {};
+    uint32_t missed_fixed = 0, missed_scaled = 0, recovery_frames = 0;
+    bool recovering = false;
+    double scale_sum = 0.0;
+    for (uint32_t i = 0; i < frames; i++) {
+        double load = i >= frames / 2 && i < frames * 3 / 4 ? 2.0 : 0.7;
+        double full_ns = double(interval_ns) * load * noise(rng);
+        double scale = controller.m_scale;
+        uint64_t gpu_ns = uint64_t(full_ns * scale * scale);
+        missed_fixed += full_ns > double(interval_ns) ? 1 : 0;
+        missed_scaled += gpu_ns > interval_ns ? 1 : 0;
+        scale_sum += scale;
+        if (i == frames / 2) recovering = true;
+        if (recovering && gpu_ns <= interval_ns) recovering = false;
+        recovery_frames += recovering ? 1 : 0;
+        controller.update(in_flight[i % 2]);
+        in_flight[i % 2] = gpu_ns;
+    }
+    ctx.report("dynamic_resolution_missed_fixed", "frames", missed_fixed, false);
+    ctx.report("dynamic_resolution_missed_scaled", "frames", missed_scaled, false);
+    ctx.report("dynamic_resolution_recovery_frames", "frames", recovery_frames, false);
+    ctx.report("dynamic_resolution_mean_scale", "ratio", scale_sum / frames, true);
+    ctx.report("dynamic_resolution_changes", "changes", double(controller.m_changes), false);
+    if (missed_scaled >= missed_fixed) ctx.fail("Dynamic resolution didn't save any frames");
+}
+
+// Writes a scene of grid meshes as .gltf and .bin, with the triangles shuffled the way a careless exporter would
+static bool write_grid_scene(const char* gltf_path, const char* bin_name, uint32_t meshes, uint32_t grid)
+{
+    std::mt19937 rng(11);
+    std::vector<uint8_t> bin;
+    std::string json = "{\"asset\":{\"version\":\"2.0\"},\"buffers\":[{\"uri\":\"";
+    json += bin_name;
+    json += "\",\"byteLength\":BYTES}],\"bufferViews\":[";
+    std::string accessors, mesh_list;
+    auto append = [&bin](const void* data, size_t size) {
+        size_t offset = bin.size();
+        bin.insert(bin.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+        return offset;
+    };
+    for (uint32_t m = 0; m < meshes; m++) {
+        std::vector<float> positions, uvs;
+        for (uint32_t y = 0; y < grid; y++) {
+            for (uint32_t x = 0; x < grid; x++) {
+                float fx = float(x) / float(grid - 1), fy = float(y) / float(grid - 1);
+                positions.insert(positions.end(), {fx + float(m), 0.1f * std::sin(fx * 6.0f + fy * 4.0f), fy});
+                uvs.insert(uvs.end(), {fx, fy});
+            }
+        }
+        std::vector<std::array<uint32_t, 3>> triangles;
+        for (uint32_t y = 0; y + 1 < grid; y++) {
+            for (uint32_t x = 0; x + 1 < grid; x++) {
+                uint32_t i = y * grid + x;
+                triangles.push_back({i, i + grid, i + 1});
+                triangles.push_back({i + 1, i + grid, i + grid + 1});
+            }
+        }
+        std::shuffle(triangles.begin(), triangles.end(), rng);
+
+        uint32_t view = m * 3;
+        size_t position_offset = append(positions.data(), positions.size() * sizeof(float));
+        size_t uv_offset = append(uvs.data(), uvs.size() * sizeof(float));
+        size_t index_offset = append(triangles.data(), triangles.size() * sizeof(triangles[0]));
+        char text[512];
+        snprintf(text, sizeof(text),
+                 "%s{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu},{\"buffer\":0,\"byteOffset\":%zu,"
+                 "\"byteLength\":%zu},{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu}",
+                 m > 0 ? "," : "", position_offset, positions.size() * sizeof(float), uv_offset,
+                 uvs.size() * sizeof(float), index_offset, triangles.size() * sizeof(triangles[0]));
+        json += text;
+        snprintf(text, sizeof(text),
+                 "%s{\"bufferView\":%u,\"componentType\":5126,\"count\":%u,\"type\":\"VEC3\"},"
+                 "{\"bufferView\":%u,\"componentType\":5126,\"count\":%u,\"type\":\"VEC2\"},"
+                 "{\"bufferView\":%u,\"componentType\":5125,\"count\":%zu,\"type\":\"SCALAR\"}",
+                 m > 0 ? "," : "", view, grid * grid, view + 1, grid * grid, view + 2, triangles.size() * 3);
+        accessors += text;
+        snprintf(text, sizeof(text),
+                 "%s{\"name\":\"grid%u\",\"primitives\":[{\"attributes\":{\"POSITION\":%u,\"TEXCOORD_0\":%u},"
+                 "\"indices\":%u}]}",
+                 m > 0 ? "," : "", m, view, view + 1, view + 2);
+        mesh_list += text;
+    }
+    json += "],\"accessors\":[" + accessors + "],\"meshes\":[" + mesh_list + "]}";
+    json.replace(json.find("BYTES"), 5, std::to_string(bin.size()));
+
+    FILE* file = fopen(gltf_path, "wb");
+    if (file == nullptr) return false;
+    bool ok = fwrite(json.data(), 1, json.size(), file) == json.size();
+    fclose(file);
+    file = fopen(bin_name, "wb");
+    if (file == nullptr) return false;
+    ok = ok && fwrite(bin.data(), 1, bin.size(), file) == bin.size();
+    fclose(file);
+    return ok;
+}
+
+static void bench_mesh_import(BenchContext& ctx)
+{
+    const char* gltf_path = "bench_scene.gltf";
+    const char* bin_path = "bench_scene.bin";
+    const char* cooked_path = "bench_scene.amesh";
+    const uint32_t meshes = ctx.m_quick ? 8 : 64;
+    if (!write_grid_scene(gltf_path, bin_path, meshes, 128)) {
+        ctx.fail("Failed to write the test scene");
+        return;
+    }
+
+    // Parsing and decoding on one thread without optimizing, what loading the source asset at startup costs
+    GltfImporter raw;
+    raw.m_optimize = false;
+    uint64_t start = bench_now_ns();
+    bool imported = raw.import(gltf_path) == k_success;
+    double raw_ms = double(bench_now_ns() - start) / 1e6;
+
+    // The cook, with every primitive optimized across the workers
+    JobSystem jobs;
+    jobs.init();
+    GltfImporter cooked;
+    cooked.m_jobs = &jobs;
+    start = bench_now_ns();
+    imported = cooked.import(gltf_path) == k_success && imported;
+    double cook_ms = double(bench_now_ns() - start) / 1e6;
+    jobs.shutdown();
+    if (!imported || raw.m_meshes.size() != meshes || cooked.m_meshes.size() != meshes ||
+        CookedMeshFile::write(cooked_path, cooked.m_meshes) != k_success) {
+        ctx.fail("Failed to import and cook the test scene");
+        std::remove(gltf_path);
+        std::remove(bin_path);
+        return;
+    }
+
+    double raw_acmr = 0.0, cooked_acmr = 0.0;
+    for (uint32_t m = 0; m < meshes; m++) {
+        const auto& raw_indices = raw.m_meshes[m].m_indices;
+        const auto& cooked_indices = cooked.m_meshes[m].m_indices;
+        raw_acmr += average_cache_miss_ratio(raw_indices.data(), raw_indices.size());
+        cooked_acmr += average_cache_miss_ratio(cooked_indices.data(), cooked_indices.size());
+    }
+
+    // Loading the cooked file is mapping it and copying the geometry to where staging would be
+    std::vector<double> loads;
+    std::vector<uint8_t> staging;
+    uint64_t triangles = 0;
+    for (uint32_t i = 0; i < ctx.iterations(20); i++) {
+        start = bench_now_ns();
+        CookedMeshFile file;
+        if (file.open(cooked_path) != k_success) break;
+        size_t span = file.m_header->index_offset + file.m_header->index_bytes - file.m_header->vertex_offset;
+        staging.resize(span);
+        memcpy(staging.data(), file.vertices(), span);
+        triangles = file.m_header->index_bytes / sizeof(uint32_t) / 3;
+        loads.push_back(double(bench_now_ns() - start));
+    }
+
+    ctx.report("mesh_import_gltf_ms", "ms", raw_ms, false);
+    ctx.report("mesh_cook_parallel_ms", "ms", cook_ms, false);
+    ctx.report("mesh_cooked_load_ms", "ms", bench_median(loads) / 1e6, false);
+    ctx.report("mesh_acmr_raw", "ratio", raw_acmr / meshes, false);
+    ctx.report("mesh_acmr_optimized", "ratio", cooked_acmr / meshes, false);
+    if (loads.empty()) ctx.fail("Failed to open the cooked scene");
+    if (triangles != uint64_t(meshes) * 127 * 127 * 2) ctx.fail("The cooked scene lost triangles");
+    if (cooked_acmr >= raw_acmr) ctx.fail("Vertex cache optimization didn't improve the miss ratio");
+
+    std::remove(gltf_path);
+    std::remove(bin_path);
+    std::remove(cooked_path);
+}
+
+static void bench_shader_archive(BenchContext& ctx)
+{
+    // Stand ins for compiled shaders, the archive never looks past the bytes. The last one is a copy of the first
+    // under another name, which has to come back as the same blob
+    const char* archive_path = "bench_shaders.ashaders";
+    const std::vector<std::string> paths = {"bench_a.spv", "bench_b.spv", "bench_c.spv", "bench_a_copy.spv"};
+    const uint32_t words[] = {64, 1000, 333, 64};
+    std::vector<std::vector<uint32_t>> blobs(paths.size());
+    std::mt19937 rng(7);
+    bool written = true;
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (i == 3) {
+            blobs[i] = blobs[0];
+        } else {
+            blobs[i].resize(words[i]);
+            for (auto& w : blobs[i]) w = rng();
+            blobs[i][0] = 0x07230203;  // SPIR-V magic
+        }
+        FILE* file = fopen(paths[i].c_str(), "wb");
+        if (file == nullptr) {
+            written = false;
+            continue;
+        }
+        size_t bytes = blobs[i].size() * sizeof(uint32_t);
+        written = fwrite(blobs[i].data(), 1, bytes, file) == bytes && written;
+        fclose(file);
+    }
+
+    // The same path atelier_cook --shaders takes at build time
+    if (!written || ShaderArchive::pack_files(archive_path, paths) != k_success) {
+        ctx.fail("Failed to pack the test shaders");
+    } else {
+        std::vector<double> opens;
+        for (uint32_t i = 0; i < ctx.iterations(100); i++) {
+            uint64_t start = bench_now_ns();
+            ShaderArchive archive;
+            if (archive.open(archive_path) != k_success) break;
+            opens.push_back(double(bench_now_ns() - start));
+        }
+        ctx.report("shader_archive_open_us", "us", bench_median(opens) / 1e3, false);
+        if (opens.empty()) ctx.fail("Failed to open the packed shader archive");
+
+        ShaderArchive archive;
+        if (archive.open(archive_path) == k_success) {
+            bool matches = archive.m_header->entry_count == paths.size();
+            for (size_t i = 0; i < paths.size(); i++) {
+                size_t bytes = blobs[i].size() * sizeof(uint32_t);
+                const ShaderArchive::Entry* by_name = archive.find(paths[i].c_str());
+                const ShaderArchive::Entry* by_hash = archive.find(hash_bytes(blobs[i].data(), bytes));
+                matches = matches && by_name != nullptr && by_hash != nullptr &&
+                          by_name->offset == by_hash->offset && by_name->size == bytes &&
+                          memcmp(archive.code(*by_name), blobs[i].data(), bytes) == 0;
+            }
+            const ShaderArchive::Entry* original = archive.find("bench_a.spv");
+            const ShaderArchive::Entry* copy = archive.find("bench_a_copy.spv");
+            if (!matches) ctx.fail("Shaders read back from the archive don't match what was packed");
+            if (original == nullptr || copy == nullptr || original->offset != copy->offset) {
+                ctx.fail("Identical shaders weren't packed as one blob");
+            }
+            archive.close();
+        }
+    }
+
+    for (const auto& path : paths) std::remove(path.c_str());
+    std::remove(archive_path);
+}
+
+// What the hierarchy replaces: nodes as structs with child lists, walked recursively with scalar maths
+struct AosSceneNode {
+    float position[3];
+    float rotation[4];
+    float scale[3];
+    Mat4 world;
+    std::vector<uint32_t> children;
+};
+
+static void aos_update(std::vector<AosSceneNode>& nodes, uint32_t index, const Mat4* parent)
+{
+    AosSceneNode& node = nodes[index];
+    float x = node.rotation[0], y = node.rotation[1], z = node.rotation[2], w = node.rotation[3];
+    const float local[16] = {(1 - 2 * (y * y + z * z)) * node.scale[0], 2 * (x * y + w * z) * node.scale[0],
+                             2 * (x * z - w * y) * node.scale[0],       0,
+                             2 * (x * y - w * z) * node.scale[1],       (1 - 2 * (x * x + z * z)) * node.scale[1],
+                             2 * (y * z + w * x) * node.scale[1],       0,
+                             2 * (x * z + w * y) * node.scale[2],       2 * (y * z - w * x) * node.scale[2],
+                             (1 - 2 * (x * x + y * y)) * node.scale[2], 0,
+                             node.position[0],                          node.position[1],
+                             node.position[2],                          1};
+    for (uint32_t c = 0; c < 4; c++) {
+        for (uint32_t r = 0; r < 4; r++) {
+            if (parent == nullptr) {
+                node.world.m[c * 4 + r] = local[c * 4 + r];
+                continue;
+            }
+            float sum = 0.0f;
+            for (uint32_t k = 0; k < 4; k++) sum += parent->m[k * 4 + r] * local[c * 4 + k];
+            node.world.m[c * 4 + r] = sum;
+        }
+    }
+    for (uint32_t child : node.children) aos_update(nodes, child, &node.world);
+}
+
+static void bench_scene_update(BenchContext& ctx)
+{
+    // Five levels with a fan out of four, about 100k nodes for the full run
+    const uint32_t roots = ctx.m_quick ? 30 : 300;
+    SceneGraph scene;
+    std::vector<AosSceneNode> aos;
+    std::vector<uint32_t> aos_roots;
+    std::vector<uint32_t> level = {SceneGraph::k_none};
+    for (uint32_t depth = 0; depth < 5; depth++) {
+        std::vector<uint32_t> next;
+        uint32_t fan_out = depth == 0 ? roots : 4;
+        for (uint32_t parent : level) {
+            for (uint32_t c = 0; c < fan_out; c++) {
+                uint32_t id = scene.add(parent, uint32_t(aos.size()));
+                if (parent == SceneGraph::k_none) {
+                    aos_roots.push_back(id);
+                } else {
+                    aos[parent].children.push_back(id);
+                }
+                aos.push_back({});
+                next.push_back(id);
+            }
+        }
+        level.swap(next);
+    }
+    const uint32_t count = uint32_t(aos.size());
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    auto randomize = [&](uint32_t id) {
+        float position[3] = {unit(rng) * 10, unit(rng) * 10, unit(rng) * 10};
+        float rotation[4] = {unit(rng), unit(rng), unit(rng), unit(rng)};
+        float length = std::sqrt(rotation[0] * rotation[0] + rotation[1] * rotation[1] +
+                                 rotation[2] * rotation[2] + rotation[3] * rotation[3]) + 1e-6f;
+        for (float& r : rotation) r /= length;
+        float scale[3] = {1.0f + unit(rng) * 0.1f, 1.0f + unit(rng) * 0.1f, 1.0f + unit(rng) * 0.1f};
+        scene.set_local(id, position, rotation, scale);
+        memcpy(aos[id].position, position, sizeof(position));
+        memcpy(aos[id].rotation, rotation, sizeof(rotation));
+        memcpy(aos[id].scale, scale, sizeof(scale));
+    };
+    for (uint32_t id = 0; id < count; id++) randomize(id);
+
+    JobSystem jobs;
+    jobs.init();
+    std::vector<Mat4> instances(count);
+    InstanceTarget target;
+    target.m_data = instances.data();
+    target.m_capacity = count;
+
+    std::vector<double> aos_times, full_times, partial_times;
+    uint32_t partial_recomputed = 0;
+    for (uint32_t i = 0; i < ctx.iterations(20); i++) {
+        uint64_t start = bench_now_ns();
+        for (uint32_t root : aos_roots) aos_update(aos, root, nullptr);
+        aos_times.push_back(double(bench_now_ns() - start));
+
+        // Everything moved, which is the worst case
+        for (uint32_t id = 0; id < count; id++) scene.m_dirty[scene.m_slot[id]] = 1;
+        scene.m_any_dirty = true;
+        start = bench_now_ns();
+        scene.update(&jobs, &target);
+        full_times.push_back(double(bench_now_ns() - start));
+
+        // About one node in a hundred moved, with whatever hangs off it
+        for (uint32_t n = 0; n < count / 100; n++) randomize(rng() % count);
+        for (uint32_t root : aos_roots) aos_update(aos, root, nullptr);
+        start = bench_now_ns();
+        scene.update(&jobs, &target);
+        partial_times.push_back(double(bench_now_ns() - start));
+        partial_recomputed = scene.m_recomputed;
+    }
+    jobs.shutdown();
+
+    float worst = 0.0f;
+    for (uint32_t id = 0; id < count; id++) {
+        for (uint32_t k = 0; k < 16; k++) {
+            worst = std::max(worst, std::fabs(scene.world(id).m[k] - aos[id].world.m[k]));
+            worst = std::max(worst, std::fabs(instances[id].m[k] - aos[id].world.m[k]));
+        }
+    }
+
+    ctx.report("scene_nodes", "nodes", count, true);
+    ctx.report("scene_update_aos_ms", "ms", bench_median(aos_times) / 1e6, false);
+    ctx.report("scene_update_full_ms", "ms", bench_median(full_times) / 1e6, false);
+    ctx.report("scene_update_partial_ms", "ms", bench_median(partial_times) / 1e6, false);
+    ctx.report("scene_update_partial_recomputed", "nodes", partial_recomputed, false);
+    if (worst > 1e-3f) ctx.fail("Scene world matrices don't match the recursive update");
+}
+
+static void bench_bvh_cull(BenchContext& ctx)
+{
+    // Boxes of a metre or two scattered through a kilometre cube, which is denser than most scenes get
+    const uint32_t count = ctx.m_quick ? 100000 : 1000000;
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> place(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> size(0.25f, 1.0f);
+    std::vector<Aabb> boxes(count);
+    for (Aabb& box : boxes) {
+        for (uint32_t a = 0; a < 3; a++) {
+            float centre = place(rng), half = size(rng);
+            box.min[a] = centre - half;
+            box.max[a] = centre + half;
+        }
+    }
+
+    // A 90 degree frustum from the origin looking down +z, out to 400 metres
+    const float planes[6][4] = {{1, 0, 1, 0}, {-1, 0, 1, 0}, {0, 1, 1, 0},
+                                {0, -1, 1, 0}, {0, 0, 1, -0.1f}, {0, 0, -1, 400}};
+
+    Bvh bvh;
+    uint64_t start = bench_now_ns();
+    bvh.build(boxes.data(), count);
+    double build_ms = double(bench_now_ns() - start) / 1e6;
+    float built_cost = bvh.sah_cost();
+
+    // Testing every box on its own, what there is without the tree
+    std::vector<uint32_t> expected;
+    std::vector<double> brute_times;
+    for (uint32_t i = 0; i < ctx.iterations(10); i++) {
+        expected.clear();
+        start = bench_now_ns();
+        for (uint32_t o = 0; o < count; o++) {
+            bool outside = false;
+            for (uint32_t p = 0; p < 6 && !outside; p++) {
+                const float* plane = planes[p];
+                float distance = plane[3];
+                for (uint32_t a = 0; a < 3; a++) {
+                    distance += plane[a] * (plane[a] >= 0.0f ? boxes[o].max[a] : boxes[o].min[a]);
+                }
+                outside = distance < 0.0f;
+            }
+            if (!outside) expected.push_back(o);
+        }
+        brute_times.push_back(double(bench_now_ns() - start));
+    }
+
+    JobSystem jobs;
+    jobs.init();
+    std::vector<uint32_t> visible;
+    std::vector<double> serial_times, parallel_times;
+    for (uint32_t i = 0; i < ctx.iterations(20); i++) {
+        start = bench_now_ns();
+        bvh.cull(planes, visible);
+        serial_times.push_back(double(bench_now_ns() - start));
+        start = bench_now_ns();
+        bvh.cull(planes, visible, &jobs);
+        parallel_times.push_back(double(bench_now_ns() - start));
+    }
+    std::vector<uint32_t> sorted = visible;
+    std::sort(sorted.begin(), sorted.end());
+    bool matches = sorted == expected;
+
+    // One object in ten drifts a little, as in a typical frame
+    std::uniform_real_distribution<float> drift(-0.5f, 0.5f);
+    for (uint32_t o = 0; o < count; o += 10) {
+        for (uint32_t a = 0; a < 3; a++) {
+            float offset = drift(rng);
+            boxes[o].min[a] += offset;
+            boxes[o].max[a] += offset;
+        }
+        bvh.set_bounds(o, boxes[o]);
+    }
+    start = bench_now_ns();
+    bvh.refit();
+    double refit_ms = double(bench_now_ns() - start) / 1e6;
+    bvh.cull(planes, visible, &jobs);
+    jobs.shutdown();
+
+    size_t refit_expected = 0;
+    for (const Aabb& box : boxes) {
+        bool outside = false;
+        for (uint32_t p = 0; p < 6 && !outside; p++) {
+            float distance = planes[p][3];
+            for (uint32_t a = 0; a < 3; a++) {
+                distance += planes[p][a] * (planes[p][a] >= 0.0f ? box.max[a] : box.min[a]);
+            }
+            outside = distance < 0.0f;
+        }
+        refit_expected += outside ? 0 : 1;
+    }
+
+    ctx.report("bvh_build_ms", "ms", build_ms, false);
+    ctx.report("bvh_refit_ms", "ms", refit_ms, false);
+    ctx.report("bvh_refit_sah_growth", "ratio", bvh.sah_cost() / built_cost, false);
+    ctx.report("bvh_visible", "objects", double(expected.size()), true);
+    ctx.report("bvh_brute_objects_per_ms", "objects/ms", count / (bench_median(brute_times) / 1e6), true);
+    ctx.report("bvh_cull_objects_per_ms", "objects/ms", count / (bench_median(serial_times) / 1e6), true);
+    ctx.report("bvh_cull_parallel_objects_per_ms", "objects/ms", count / (bench_median(parallel_times) / 1e6),
+               true);
+    if (!matches) ctx.fail("BVH culling disagrees with testing every object");
+    if (visible.size() != refit_expected) ctx.fail("BVH culling disagrees with brute force after a refit");
+}
+
+// One load the way loading code would be written against the reactor, the work runs on a worker and the result is
+// picked up a frame later, with nothing blocking in between
+static uint64_t bench_async_work(uint32_t seed)
+{
+    uint64_t h = seed;
+    for (uint32_t i = 0; i < 2000; i++) h = h * 6364136223846793005ull + 1442695040888963407ull;
+    return h;
+}
+
+static Task<uint64_t> bench_async_parse(Reactor& reactor, JobSystem& jobs, uint32_t seed)
+{
+    uint64_t hash = co_await reactor.run(jobs, [seed]() { return bench_async_work(seed); });
+    co_await reactor.next_frame();
+    co_return hash;
+}
+
+static Task<void> bench_async_load(Reactor& reactor, JobSystem& jobs, uint32_t seed, uint64_t& total)
+{
+    total += co_await bench_async_parse(reactor, jobs, seed);
+}
+
+static Task<void> bench_async_read(Reactor& reactor, JobSystem& jobs, const char* path, size_t& bytes)
+{
+    FileRead read = co_await reactor.read_file(jobs, path);
+    if (read.m_result == k_success) bytes += read.m_file.m_size;
+}
+
+// Hands the task back through the public schedule from a thread of its own, the way a callback from outside the
+// job system would
+struct BenchThreadHop {
+    Reactor* m_reactor = nullptr;
+    std::thread* m_thread = nullptr;
+
+    bool await_ready() const { return false; }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        *m_thread = std::thread([reactor = m_reactor, handle]() { reactor->schedule(handle); });
+    }
+    void await_resume() const {}
+};
+
+static Task<void> bench_async_hop(Reactor& reactor, std::thread& thread, bool& resumed)
+{
+    BenchThreadHop hop;
+    hop.m_reactor = &reactor;
+    hop.m_thread = &thread;
+    co_await hop;
+    resumed = true;
+}
+
+static void bench_async_tasks(BenchContext& ctx)
+{
+    JobSystem jobs;
+    jobs.init();
+    Reactor reactor;
+    const uint32_t tasks = ctx.m_quick ? 1000 : 10000;
+    uint64_t expected = 0;
+    for (uint32_t i = 0; i < tasks; i++) expected += bench_async_work(i);
+
+    // Every task is in flight at once, the loop stands in for the frame loop polling the reactor
+    std::vector<double> samples;
+    uint64_t polls = 0;
+    bool matches = true;
+    for (uint32_t iteration = 0; iteration < ctx.iterations(10); iteration++) {
+        uint64_t total = 0;
+        uint64_t first_poll = reactor.m_polls;
+        uint64_t start = bench_now_ns();
+        for (uint32_t i = 0; i < tasks; i++) reactor.spawn(bench_async_load(reactor, jobs, i, total));
+        while (reactor.pending() != 0) {
+            reactor.poll();
+            std::this_thread::yield();
+        }
+        samples.push_back(double(bench_now_ns() - start));
+        polls = reactor.m_polls - first_poll;
+        matches = matches && total == expected;
+    }
+    double ms = bench_median(samples) / 1e6;
+    ctx.report("async_tasks_ms", "ms", ms, false);
+    ctx.report("async_tasks_us_per_task", "us", ms * 1000.0 / tasks, false);
+    ctx.report("async_tasks_polls", "polls", double(polls), false);
+    if (!matches) ctx.fail("Tasks finished with the wrong results");
+
+    // Only job hops count towards what shutdown waits for, scheduling from anywhere else must leave it alone
+    std::thread hop_thread;
+    bool resumed = false;
+    reactor.spawn(bench_async_hop(reactor, hop_thread, resumed));
+    hop_thread.join();
+    reactor.poll();
+    if (!resumed || reactor.m_jobs_in_flight.load() != 0) {
+        ctx.fail("Scheduling a task from outside a job changed the count of jobs in flight");
+    }
+
+    // Reads of the same file, mapped and paged in on the workers
+    const char* path = "bench_async.bin";
+    const size_t file_bytes = 4u << 20;
+    const uint32_t reads = 32;
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        ctx.fail("Failed to write the test file");
+    } else {
+        std::vector<uint8_t> bytes(file_bytes, 0x5a);
+        fwrite(bytes.data(), 1, bytes.size(), file);
+        fclose(file);
+        size_t read_bytes = 0;
+        uint64_t start = bench_now_ns();
+        for (uint32_t i = 0; i < reads; i++) reactor.spawn(bench_async_read(reactor, jobs, path, read_bytes));
+        while (reactor.pending() != 0) {
+            reactor.poll();
+            std::this_thread::yield();
+        }
+        ctx.report("async_file_reads_ms", "ms", double(bench_now_ns() - start) / 1e6, false);
+        if (read_bytes != file_bytes * reads) ctx.fail("File reads came back short");
+        std::remove(path);
+    }
+
+    reactor.shutdown();
+    jobs.shutdown();
+}
+
+void Atelier::bench_core_cases(std::vector<BenchCase>& out)
+{
+    out.push_back({"logger", bench_logger, false});
+    out.push_back({"hash", bench_hash, false});
+    out.push_back({"jobs", bench_jobs, false});
+    out.push_back({"pixel", bench_pixel, false});
+    out.push_back({"frame_pacer", bench_frame_pacer, false});
+    out.push_back({"frame_pipeline", bench_frame_pipeline, false});
+    out.push_back({"dynamic_resolution", bench_dynamic_resolution, false});
+    out.push_back({"mesh_import", bench_mesh_import, false});
+    out.push_back({"shader_archive", bench_shader_archive, false});
+    out.push_back({"scene_update", bench_scene_update, false});
+    out.push_back({"bvh_cull", bench_bvh_cull, false});
+    out.push_back({"async_tasks", bench_async_tasks, false});
+}
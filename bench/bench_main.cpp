@@ -0,0 +1,222 @@
+/**
+ * @brief Runs the benchmark cases, writes the metrics as JSON and optionally compares them against a baseline.
+ *
+ *   atelier_bench [--quick] [--filter text] [--out results.json] [--compare baseline.json] [--threshold 0.15]
+ *
+ * Returns non zero when a case reports wrong results or, in compare mode, when any metric got worse than the
+ * baseline by more than the threshold. When the selected Vulkan cases couldn't run for lack of a device it returns
+ * k_skipped instead, which CTest reports as a skip. With no GPU, point the Vulkan loader at a software driver such
+ * as lavapipe
+ */
+#include "bench.h"
+#include "atelier/atelier_vk_mutable.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+using namespace Atelier;
+
+static constexpr int k_skipped = 77;  // Matches SKIP_RETURN_CODE in bench/CMakeLists.txt
+
+static std::string json_escape(const std::string& text)
+{
+    std::string out;
+    for (char c : text) {
+        if (c == '"' || c == '\\') out.push_back('\\');
+        out.push_back(c);
+    }
+    return out;
+}
+
+static result write_json(const char* path, const std::vector<BenchMetric>& metrics)
+{
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) return -1;
+    fprintf(file, "{\n  \"version\": 1,\n  \"metrics\": [\n");
+    for (size_t i = 0; i < metrics.size(); i++) {
+        const auto& m = metrics[i];
+        fprintf(file, "    {\"name\": \"%s\", \"unit\": \"%s\", \"value\": %.17g, \"better\": \"%s\"}%s\n",
+                json_escape(m.m_name).c_str(), json_escape(m.m_unit).c_str(), m.m_value,
+                m.m_higher_is_better ? "higher" : "lower", i + 1 < metrics.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    return fclose(file) == 0 ? k_success : -2;
+}
+
+// Finds the string value of "key" at or after pos, we only ever read back files written by write_json
+static bool json_string(const std::string& text, size_t& pos, const char* key, std::string& out)
+{
+    std::string needle = std::string("\"") + key + "\": \"";
+    size_t start = text.find(needle, pos);
+    if (start == std::string::npos) return false;
+    start += needle.size();
+    out.clear();
+    size_t i = start;
+    for (; i < text.size() && text[i] != '"'; i++) {
+        if (text[i] == '\\' && i + 1 < text.size()) i++;
+        out.push_back(text[i]);
+    }
+    pos = i;
+    return true;
+}
+
+static bool json_number(const std::string& text, size_t& pos, const char* key, double& out)
+{
+    std::string needle = std::string("\"") + key + "\": ";
+    size_t start = text.find(needle, pos);
+    if (start == std::string::npos) return false;
+    char* end = nullptr;
+    out = strtod(text.c_str() + start + needle.size(), &end);
+    pos = size_t(end - text.c_str());
+    return true;
+}
+
+static result read_json(const char* path, std::vector<BenchMetric>& out)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) return -1;
+    std::string text;
+    char chunk[4096];
+    for (size_t n; (n = fread(chunk, 1, sizeof(chunk), file)) > 0;) text.append(chunk, n);
+    fclose(file);
+
+    size_t pos = text.find("\"metrics\"");
+    if (pos == std::string::npos) return -2;
+    BenchMetric metric;
+    std::string better;
+    while (json_string(text, pos, "name", metric.m_name)) {
+        if (!json_string(text, pos, "unit", metric.m_unit) || !json_number(text, pos, "value", metric.m_value) ||
+            !json_string(text, pos, "better", better)) {
+            return -3;
+        }
+        metric.m_higher_is_better = better == "higher";
+        out.push_back(metric);
+    }
+    return k_success;
+}
+
+// Returns how many metrics regressed past the threshold
+static uint32_t compare(const std::vector<BenchMetric>& baseline, const std::vector<BenchMetric>& current,
+                        double threshold)
+{
+    std::unordered_map<std::string, const BenchMetric*> lookup;
+    for (const auto& m : current) lookup[m.m_name] = &m;
+
+    uint32_t regressions = 0;
+    Log::info("%-44s %14s %14s %9s", "metric", "baseline", "current", "change");
+    for (const auto& base : baseline) {
+        auto it = lookup.find(base.m_name);
+        if (it == lookup.end()) {
+            Log::warn("%s is in the baseline but wasn't measured", base.m_name.c_str());
+            continue;
+        }
+        const BenchMetric& cur = *it->second;
+        if (base.m_value == 0.0) continue;
+
+        // Positive change is always worse, whichever way the metric points
+        double change = (cur.m_value - base.m_value) / base.m_value;
+        if (base.m_higher_is_better) change = -change;
+        bool regressed = change > threshold;
+        if (regressed) regressions++;
+        Log::info("%-44s %14.3f %14.3f %+8.1f%%%s", base.m_name.c_str(), base.m_value, cur.m_value, change * 100.0,
+                  regressed ? "  REGRESSED" : "");
+    }
+    return regressions;
+}
+
+// Creates the default state and picks the first device with a graphics queue
+static result init_vulkan(BenchContext& ctx, VkCompletedState& vk)
+{
+    if (vk.pre_surface_default_init() != k_success) return -1;
+    for (auto& device : vk.m_devices) {
+        for (auto& queue : device.m_queues) {
+            if ((queue.second.props.queueFlags & VK_QUEUE_GRAPHICS_BIT) == 0) continue;
+            ctx.m_vk = &vk;
+            ctx.m_device = &device;
+            ctx.m_graphics_family = queue.first;
+            ctx.m_graphics_queue = queue.second.m_handle[0];
+            Log::info("Benchmarking on %s", device.m_physical->m_device_properties.deviceName);
+            return k_success;
+        }
+    }
+    return -2;
+}
+
+int main(int argc, char** argv)
+{
+    Log::init();
+    BenchContext ctx;
+    const char* filter = nullptr;
+    const char* out_path = "atelier_bench.json";
+    const char* baseline_path = nullptr;
+    double threshold = 0.15;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--quick") {
+            ctx.m_quick = true;
+        } else if (arg == "--filter" && has_value) {
+            filter = argv[++i];
+        } else if (arg == "--out" && has_value) {
+            out_path = argv[++i];
+        } else if (arg == "--compare" && has_value) {
+            baseline_path = argv[++i];
+        } else if (arg == "--threshold" && has_value) {
+            threshold = atof(argv[++i]);
+        } else {
+            Log::error("Unknown argument %s", arg.c_str());
+            return 2;
+        }
+    }
+
+    // Read the baseline up front so a bad path fails before spending minutes measuring
+    std::vector<BenchMetric> baseline;
+    if (baseline_path != nullptr && read_json(baseline_path, baseline) != k_success) {
+        Log::error("Failed to read the baseline %s", baseline_path);
+        return 2;
+    }
+
+    std::vector<BenchCase> cases;
+    bench_core_cases(cases);
+    bench_vk_cases(cases);
+
+    VkCompletedState vk;
+    bool vulkan_tried = false;
+    uint32_t skipped = 0;
+    for (const auto& c : cases) {
+        if (filter != nullptr && strstr(c.m_name, filter) == nullptr) continue;
+        if (c.m_needs_vulkan && !vulkan_tried) {
+            vulkan_tried = true;
+            if (init_vulkan(ctx, vk) != k_success) Log::warn("No usable Vulkan device, skipping the Vulkan cases");
+        }
+        if (c.m_needs_vulkan && ctx.m_device == nullptr) {
+            skipped++;
+            continue;
+        }
+        c.m_run(ctx);
+    }
+    if (ctx.m_device != nullptr) vkDeviceWaitIdle(ctx.m_device->m_handle);
+    vk.shutdown();
+
+    if (write_json(out_path, ctx.m_metrics) != k_success) {
+        Log::error("Failed to write %s", out_path);
+        return 2;
+    }
+
+    int code = ctx.m_failed ? 1 : 0;
+    if (baseline_path != nullptr) {
+        uint32_t regressions = compare(baseline, ctx.m_metrics, threshold);
+        if (regressions > 0) {
+            Log::error("%u metrics regressed by more than %.0f%%", regressions, threshold * 100.0);
+            code = 1;
+        }
+    }
+
+    // A run missing its Vulkan cases measured only part of what was asked for, it mustn't count as a pass
+    if (code == 0 && skipped > 0) {
+        Log::warn("%u Vulkan cases couldn't run, reporting the run as skipped", skipped);
+        code = k_skipped;
+    }
+    return code;
+}
@@ -0,0 +1,1427 @@
+/**
+ * @brief Cases which need a Vulkan device. The ones driven by shaders read the SPIR-V from shaders/ in the
+ * working directory and are skipped when glslc wasn't around at build time
+ */
+#include "bench.h"
+#include "atelier/atelier_jobs.h"
+#include "atelier/atelier_vk_bundle.h"
+#include "atelier/atelier_vk_gpu_cull.h"
+#include "atelier/atelier_vk_memory.h"
+#include "atelier/atelier_vk_multi_gpu.h"
+#include "atelier/atelier_vk_mutable.h"
+#include "atelier/atelier_vk_pipeline.h"
+#include "atelier/atelier_vk_present.h"
+#include "atelier/atelier_vk_quad_batch.h"
+#include "atelier/atelier_vk_reactor.h"
+#include "atelier/atelier_vk_recorder.h"
+#include "atelier/atelier_vk_shader.h"
+#include "atelier/atelier_vk_submit.h"
+#include "atelier/atelier_vk_texture_stream.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <thread>
+using namespace Atelier;
+
+/**
+ * @brief One command buffer with a fence, recorded and waited on synchronously
+ */
+struct BenchCommands {
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkCommandPool m_pool = VK_NULL_HANDLE;
+    VkCommandBuffer m_cmd = VK_NULL_HANDLE;
+    VkFence m_fence = VK_NULL_HANDLE;
+
+    result init(BenchContext& ctx)
+    {
+        m_device = ctx.m_device->m_handle;
+        VkCommandPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+        pool_info.queueFamilyIndex = ctx.m_graphics_family;
+        if (vkCreateCommandPool(m_device, &pool_info, nullptr, &m_pool) != VK_SUCCESS) return -1;
+
+        VkCommandBufferAllocateInfo buffer_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        buffer_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        buffer_info.commandPool = m_pool;
+        buffer_info.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(m_device, &buffer_info, &m_cmd) != VK_SUCCESS) return -2;
+
+        VkFenceCreateInfo fence_info = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+        if (vkCreateFence(m_device, &fence_info, nullptr, &m_fence) != VK_SUCCESS) return -3;
+        return k_success;
+    }
+
+    void shutdown()
+    {
+        if (m_fence != VK_NULL_HANDLE) vkDestroyFence(m_device, m_fence, nullptr);
+        if (m_pool != VK_NULL_HANDLE) vkDestroyCommandPool(m_device, m_pool, nullptr);
+        m_fence = VK_NULL_HANDLE;
+        m_pool = VK_NULL_HANDLE;
+    }
+
+    VkCommandBuffer begin()
+    {
+        vkResetCommandPool(m_device, m_pool, 0);
+        VkCommandBufferBeginInfo begin_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(m_cmd, &begin_info);
+        return m_cmd;
+    }
+
+    void submit_and_wait(VkQueue queue)
+    {
+        vkEndCommandBuffer(m_cmd);
+        VkSubmitInfo submit = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        submit.pCommandBuffers = &m_cmd;
+        submit.commandBufferCount = 1;
+        vkQueueSubmit(queue, 1, &submit, m_fence);
+        vkWaitForFences(m_device, 1, &m_fence, VK_TRUE, (uint64_t)-1);
+        vkResetFences(m_device, 1, &m_fence);
+    }
+};
+
+// Single colour attachment pass which clears and ends up in final_layout
+static VkRenderPass create_clear_pass(VkDevice device, VkFormat format, VkImageLayout final_layout)
+{
+    VkAttachmentDescription attachment = {};
+    attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachment.finalLayout = final_layout;
+    attachment.format = format;
+    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkAttachmentReference ref = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkSubpassDescription subpass = {};
+    subpass.pColorAttachments = &ref;
+    subpass.colorAttachmentCount = 1;
+
+    VkRenderPassCreateInfo pass_info = {VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+    pass_info.pAttachments = &attachment;
+    pass_info.attachmentCount = 1;
+    pass_info.pSubpasses = &subpass;
+    pass_info.subpassCount = 1;
+    VkRenderPass pass = VK_NULL_HANDLE;
+    vkCreateRenderPass(device, &pass_info, nullptr, &pass);
+    return pass;
+}
+
+static VkFramebuffer create_framebuffer(VkDevice device, VkRenderPass pass, VkImageView view, VkExtent2D extent)
+{
+    VkFramebufferCreateInfo fb_info = {VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+    fb_info.renderPass = pass;
+    fb_info.pAttachments = &view;
+    fb_info.attachmentCount = 1;
+    fb_info.width = extent.width;
+    fb_info.height = extent.height;
+    fb_info.layers = 1;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    vkCreateFramebuffer(device, &fb_info, nullptr, &framebuffer);
+    return framebuffer;
+}
+
+/**
+ * @brief Offscreen RGBA8 colour target with a clearing render pass, for cases that don't need a swapchain
+ */
+struct BenchTarget {
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkExtent2D m_extent = {};
+    VkImage m_image = VK_NULL_HANDLE;
+    VkDeviceMemory m_memory = VK_NULL_HANDLE;
+    VkImageView m_view = VK_NULL_HANDLE;
+    VkRenderPass m_pass = VK_NULL_HANDLE;
+    VkFramebuffer m_framebuffer = VK_NULL_HANDLE;
+
+    result init(VkCompletedDevice& device, VkExtent2D extent)
+    {
+        m_device = device.m_handle;
+        m_extent = extent;
+        VkImageCreateInfo image_info = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+        image_info.extent = {extent.width, extent.height, 1};
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        if (vkCreateImage(m_device, &image_info, nullptr, &m_image) != VK_SUCCESS) return -1;
+
+        VkMemoryRequirements reqs = {};
+        vkGetImageMemoryRequirements(m_device, m_image, &reqs);
+        VkMemoryPropertyFlags local = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        int32_t type = device.m_physical->find_memory_type(reqs.memoryTypeBits, local);
+        if (type < 0) type = device.m_physical->find_memory_type(reqs.memoryTypeBits, 0);
+        VkMemoryAllocateInfo alloc = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+        alloc.allocationSize = reqs.size;
+        alloc.memoryTypeIndex = uint32_t(type);
+        if (type < 0 || vkAllocateMemory(m_device, &alloc, nullptr, &m_memory) != VK_SUCCESS) return -2;
+        vkBindImageMemory(m_device, m_image, m_memory, 0);
+
+        VkImageViewCreateInfo view_info = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+        view_info.image = m_image;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = image_info.format;
+        view_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        if (vkCreateImageView(m_device, &view_info, nullptr, &m_view) != VK_SUCCESS) return -3;
+
+        m_pass = create_clear_pass(m_device, image_info.format, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        m_framebuffer = create_framebuffer(m_device, m_pass, m_view, extent);
+        return m_pass != VK_NULL_HANDLE && m_framebuffer != VK_NULL_HANDLE ? k_success : -4;
+    }
+
+    void shutdown()
+    {
+        if (m_device == VK_NULL_HANDLE) return;
+        vkDestroyFramebuffer(m_device, m_framebuffer, nullptr);
+        vkDestroyRenderPass(m_device, m_pass, nullptr);
+        vkDestroyImageView(m_device, m_view, nullptr);
+        vkDestroyImage(m_device, m_image, nullptr);
+        vkFreeMemory(m_device, m_memory, nullptr);
+        *this = BenchTarget();
+    }
+
+    void begin_pass(VkCommandBuffer cmd)
+    {
+        VkClearValue clear = {};
+        VkRenderPassBeginInfo begin = {VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+        begin.renderPass = m_pass;
+        begin.framebuffer = m_framebuffer;
+        begin.renderArea.extent = m_extent;
+        begin.pClearValues = &clear;
+        begin.clearValueCount = 1;
+        vkCmdBeginRenderPass(cmd, &begin, VK_SUBPASS_CONTENTS_INLINE);
+    }
+
+    // Copies what the pass left into a host visible buffer of width * height * 4 bytes, recorded after the pass.
+    // The next pass starts from an undefined layout, so the image is left as a transfer source
+    void copy_to(VkCommandBuffer cmd, VkBuffer buffer)
+    {
+        VkImageMemoryBarrier barrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+        barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = m_image;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &barrier);
+
+        VkBufferImageCopy region = {};
+        region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.imageExtent = {m_extent.width, m_extent.height, 1};
+        vkCmdCopyImageToBuffer(cmd, m_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+        VkMemoryBarrier host = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        host.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        host.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &host, 0,
+                             nullptr, 0, nullptr);
+    }
+};
+
+/**
+ * @brief The quad shaders with a layout matching VkQuadBatcher, shared by the pipeline cases
+ */
+struct BenchQuadLayout {
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkShaderRegistry m_shaders;
+    VkShaderModule m_vertex = VK_NULL_HANDLE;
+    VkShaderModule m_fragment = VK_NULL_HANDLE;
+    uint64_t m_vertex_hash = 0;
+    uint64_t m_fragment_hash = 0;
+    VkDescriptorSetLayout m_set_layout = VK_NULL_HANDLE;
+    VkDescriptorPool m_pool = VK_NULL_HANDLE;
+    VkDescriptorSet m_set = VK_NULL_HANDLE;
+    VkPipelineLayout m_layout = VK_NULL_HANDLE;
+
+    result init(VkCompletedDevice& device)
+    {
+        m_device = device.m_handle;
+        m_shaders.init(device);
+        if (m_shaders.acquire_file("shaders/quad.vert.spv", m_vertex, &m_vertex_hash) != k_success ||
+            m_shaders.acquire_file("shaders/quad.frag.spv", m_fragment, &m_fragment_hash) != k_success) {
+            return -1;
+        }
+
+        VkDescriptorSetLayoutBinding binding = {};
+        binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        binding.descriptorCount = 1;
+        binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        VkDescriptorSetLayoutCreateInfo set_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+        set_info.pBindings = &binding;
+        set_info.bindingCount = 1;
+        if (vkCreateDescriptorSetLayout(m_device, &set_info, nullptr, &m_set_layout) != VK_SUCCESS) return -2;
+
+        // The set is never written, recording only needs a valid handle and nothing here is executed
+        VkDescriptorPoolSize pool_size = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1};
+        VkDescriptorPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+        pool_info.maxSets = 1;
+        pool_info.pPoolSizes = &pool_size;
+        pool_info.poolSizeCount = 1;
+        if (vkCreateDescriptorPool(m_device, &pool_info, nullptr, &m_pool) != VK_SUCCESS) return -3;
+        VkDescriptorSetAllocateInfo alloc = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+        alloc.descriptorPool = m_pool;
+        alloc.pSetLayouts = &m_set_layout;
+        alloc.descriptorSetCount = 1;
+        if (vkAllocateDescriptorSets(m_device, &alloc, &m_set) != VK_SUCCESS) return -4;
+
+        VkPushConstantRange push = {VK_SHADER_STAGE_VERTEX_BIT, 0, 16};
+        VkPipelineLayoutCreateInfo layout_info = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+        layout_info.pSetLayouts = &m_set_layout;
+        layout_info.setLayoutCount = 1;
+        layout_info.pPushConstantRanges = &push;
+        layout_info.pushConstantRangeCount = 1;
+        if (vkCreatePipelineLayout(m_device, &layout_info, nullptr, &m_layout) != VK_SUCCESS) return -5;
+        return k_success;
+    }
+
+    void shutdown()
+    {
+        if (m_device == VK_NULL_HANDLE) return;
+        if (m_layout != VK_NULL_HANDLE) vkDestroyPipelineLayout(m_device, m_layout, nullptr);
+        if (m_pool != VK_NULL_HANDLE) vkDestroyDescriptorPool(m_device, m_pool, nullptr);
+        if (m_set_layout != VK_NULL_HANDLE) vkDestroyDescriptorSetLayout(m_device, m_set_layout, nullptr);
+        m_shaders.shutdown();
+        m_device = VK_NULL_HANDLE;
+    }
+
+    void fill(VkMutableGraphicsPipelineCreateInfo& info, VkRenderPass pass)
+    {
+        VkMutableGraphicsPipelineCreateInfo::create_default(info, m_layout, pass);
+        VkQuadBatcher::fill_pipeline_info(info);
+        info.stages.push_back({VK_SHADER_STAGE_VERTEX_BIT, m_vertex, m_vertex_hash, "main"});
+        info.stages.push_back({VK_SHADER_STAGE_FRAGMENT_BIT, m_fragment, m_fragment_hash, "main"});
+    }
+};
+
+/**
+ * @brief A few descriptor sets pointing at a small cleared texture, so that draws with the quad layout can run on
+ * the GPU rather than only be recorded
+ */
+struct BenchMaterials {
+    static constexpr uint32_t k_count = 8;
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkImage m_image = VK_NULL_HANDLE;
+    VkDeviceMemory m_memory = VK_NULL_HANDLE;
+    VkImageView m_view = VK_NULL_HANDLE;
+    VkSampler m_sampler = VK_NULL_HANDLE;
+    VkDescriptorPool m_pool = VK_NULL_HANDLE;
+    VkDescriptorSet m_sets[k_count] = {};
+
+    result init(BenchContext& ctx, BenchCommands& commands, VkDescriptorSetLayout set_layout)
+    {
+        VkCompletedDevice& device = *ctx.m_device;
+        m_device = device.m_handle;
+        VkImageCreateInfo image_info = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+        image_info.extent = {4, 4, 1};
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        if (vkCreateImage(m_device, &image_info, nullptr, &m_image) != VK_SUCCESS) return -1;
+        VkMemoryRequirements reqs = {};
+        vkGetImageMemoryRequirements(m_device, m_image, &reqs);
+        int32_t type = device.m_physical->find_memory_type(reqs.memoryTypeBits, 0);
+        VkMemoryAllocateInfo alloc = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+        alloc.allocationSize = reqs.size;
+        alloc.memoryTypeIndex = uint32_t(type);
+        if (type < 0 || vkAllocateMemory(m_device, &alloc, nullptr, &m_memory) != VK_SUCCESS) return -2;
+        vkBindImageMemory(m_device, m_image, m_memory, 0);
+
+        VkImageViewCreateInfo view_info = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+        view_info.image = m_image;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = image_info.format;
+        view_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        if (vkCreateImageView(m_device, &view_info, nullptr, &m_view) != VK_SUCCESS) return -3;
+        VkSamplerCreateInfo sampler_info = {VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+        if (vkCreateSampler(m_device, &sampler_info, nullptr, &m_sampler) != VK_SUCCESS) return -4;
+
+        // Cleared to white and left ready for sampling
+        VkCommandBuffer cmd = commands.begin();
+        VkImageMemoryBarrier barrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = m_image;
+        barrier.subresourceRange = view_info.subresourceRange;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
+                             0, nullptr, 1, &barrier);
+        VkClearColorValue white = {{1.0f, 1.0f, 1.0f, 1.0f}};
+        vkCmdClearColorImage(cmd, m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &white, 1,
+                             &view_info.subresourceRange);
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0,
+                             nullptr, 0, nullptr, 1, &barrier);
+        commands.submit_and_wait(ctx.m_graphics_queue);
+
+        VkDescriptorPoolSize pool_size = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, k_count};
+        VkDescriptorPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+        pool_info.maxSets = k_count;
+        pool_info.pPoolSizes = &pool_size;
+        pool_info.poolSizeCount = 1;
+        if (vkCreateDescriptorPool(m_device, &pool_info, nullptr, &m_pool) != VK_SUCCESS) return -5;
+        VkDescriptorSetLayout layouts[k_count];
+        for (VkDescriptorSetLayout& layout : layouts) layout = set_layout;
+        VkDescriptorSetAllocateInfo set_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+        set_info.descriptorPool = m_pool;
+        set_info.pSetLayouts = layouts;
+        set_info.descriptorSetCount = k_count;
+        if (vkAllocateDescriptorSets(m_device, &set_info, m_sets) != VK_SUCCESS) return -6;
+        VkDescriptorImageInfo image = {m_sampler, m_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        for (VkDescriptorSet set : m_sets) {
+            VkWriteDescriptorSet write = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+            write.dstSet = set;
+            write.descriptorCount = 1;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            write.pImageInfo = &image;
+            vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+        }
+        return k_success;
+    }
+
+    void shutdown()
+    {
+        if (m_device == VK_NULL_HANDLE) return;
+        if (m_pool != VK_NULL_HANDLE) vkDestroyDescriptorPool(m_device, m_pool, nullptr);
+        if (m_sampler != VK_NULL_HANDLE) vkDestroySampler(m_device, m_sampler, nullptr);
+        if (m_view != VK_NULL_HANDLE) vkDestroyImageView(m_device, m_view, nullptr);
+        if (m_image != VK_NULL_HANDLE) vkDestroyImage(m_device, m_image, nullptr);
+        if (m_memory != VK_NULL_HANDLE) vkFreeMemory(m_device, m_memory, nullptr);
+        *this = BenchMaterials();
+    }
+};
+
+static void bench_pre_surface_init(BenchContext& ctx)
+{
+    // Instance and device creation from scratch each time, this is what startup pays before the window shows
+    std::vector<double> samples;
+    for (uint32_t i = 0; i < ctx.iterations(10); i++) {
+        VkCompletedState vk;
+        uint64_t start = bench_now_ns();
+        result res = vk.pre_surface_default_init();
+        samples.push_back(double(bench_now_ns() - start));
+        vk.shutdown();
+        if (res != k_success) {
+            ctx.fail("pre_surface_default_init failed");
+            return;
+        }
+    }
+    ctx.report("pre_surface_default_init_ms", "ms", bench_median(samples) / 1e6, false);
+}
+
+static void bench_command_recording(BenchContext& ctx)
+{
+    BenchCommands commands;
+    BenchTarget target;
+    VkCompletedBuffer buffer;
+    if (commands.init(ctx) != k_success || target.init(*ctx.m_device, {256, 256}) != k_success ||
+        buffer.init(*ctx.m_device, 1 << 16, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                    0) != k_success) {
+        ctx.fail("Failed to set up command recording");
+        target.shutdown();
+        commands.shutdown();
+        return;
+    }
+
+    // A mix of transfer, barrier and pass commands, recorded but never submitted
+    const uint32_t commands_per_buffer = 8192;
+    VkBufferMemoryBarrier barrier = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buffer.m_handle;
+    barrier.size = VK_WHOLE_SIZE;
+    std::vector<double> samples;
+    for (uint32_t i = 0; i < ctx.iterations(50); i++) {
+        uint64_t start = bench_now_ns();
+        VkCommandBuffer cmd = commands.begin();
+        for (uint32_t c = 0; c < commands_per_buffer; c += 4) {
+            vkCmdFillBuffer(cmd, buffer.m_handle, (c % 256) * 256, 256, c);
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                                 nullptr, 1, &barrier, 0, nullptr);
+            target.begin_pass(cmd);
+            vkCmdEndRenderPass(cmd);
+        }
+        vkEndCommandBuffer(cmd);
+        samples.push_back(double(bench_now_ns() - start));
+    }
+    ctx.report("cmd_record_mcommands_per_sec", "M/s", commands_per_buffer / bench_median(samples) * 1e3, true);
+
+    buffer.shutdown();
+    target.shutdown();
+    commands.shutdown();
+}
+
+static void bench_command_bundle(BenchContext& ctx)
+{
+    BenchCommands commands;
+    BenchTarget target;
+    if (commands.init(ctx) != k_success || target.init(*ctx.m_device, {256, 256}) != k_success) {
+        ctx.fail("Failed to set up the bundle target");
+        target.shutdown();
+        commands.shutdown();
+        return;
+    }
+
+    // A static pass with lots of small state changes, like a UI drawn from a fixed layout
+    const uint32_t rects = 2048;
+    auto record_static = [&target, rects](VkCommandBuffer cmd, uint32_t) {
+        target.begin_pass(cmd);
+        for (uint32_t r = 0; r < rects; r++) {
+            VkRect2D scissor = {{int32_t(r % 16) * 16, int32_t(r / 16 % 16) * 16}, {16, 16}};
+            vkCmdSetScissor(cmd, 0, 1, &scissor);
+        }
+        vkCmdEndRenderPass(cmd);
+    };
+
+    // Recorded every frame into the frame's own buffer, the way the main loop used to
+    std::vector<double> recorded;
+    for (uint32_t i = 0; i < ctx.iterations(100); i++) {
+        uint64_t start = bench_now_ns();
+        VkCommandBuffer cmd = commands.begin();
+        record_static(cmd, 0);
+        commands.submit_and_wait(ctx.m_graphics_queue);
+        recorded.push_back(double(bench_now_ns() - start));
+    }
+
+    // Replayed from three slots like a triple buffered swapchain, with the frame's own buffer left empty
+    VkCommandBundle bundle;
+    bundle.init(*ctx.m_device, ctx.m_graphics_family, 3, record_static);
+    std::vector<double> replayed;
+    uint64_t serial = 0;
+    for (uint32_t i = 0; i < ctx.iterations(100); i++) {
+        uint64_t start = bench_now_ns();
+        serial++;
+        VkCommandBuffer cmds[2] = {bundle.acquire(i % 3, serial, serial - 1), commands.begin()};
+        vkEndCommandBuffer(cmds[1]);
+        VkSubmitInfo submit = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        submit.pCommandBuffers = cmds;
+        submit.commandBufferCount = 2;
+        vkQueueSubmit(ctx.m_graphics_queue, 1, &submit, commands.m_fence);
+        vkWaitForFences(ctx.m_device->m_handle, 1, &commands.m_fence, VK_TRUE, (uint64_t)-1);
+        vkResetFences(ctx.m_device->m_handle, 1, &commands.m_fence);
+        replayed.push_back(double(bench_now_ns() - start));
+    }
+    ctx.report("bundle_rerecord_frame_us", "us", bench_median(recorded) / 1e3, false);
+    ctx.report("bundle_replay_frame_us", "us", bench_median(replayed) / 1e3, false);
+    if (bundle.m_recordings != 3) ctx.fail("A clean bundle was recorded again");
+
+    bundle.shutdown();
+    target.shutdown();
+    commands.shutdown();
+}
+
+static void bench_submit_batching(BenchContext& ctx)
+{
+    BenchCommands commands;
+    if (commands.init(ctx) != k_success) {
+        ctx.fail("Failed to set up the submit command buffer");
+        commands.shutdown();
+        return;
+    }
+
+    // One empty buffer submitted over and over, so the cost measured is the submit itself
+    VkCommandBufferBeginInfo begin_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+    vkBeginCommandBuffer(commands.m_cmd, &begin_info);
+    vkEndCommandBuffer(commands.m_cmd);
+
+    // Several threads each submitting small pieces of work, like jobs finishing uploads and compute
+    const uint32_t producers = 4;
+    const uint32_t per_producer = ctx.iterations(5000);
+    const double total = double(producers * per_producer);
+    auto run_producers = [producers](const std::function<void()>& fn) {
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < producers; t++) threads.emplace_back(fn);
+        for (auto& thread : threads) thread.join();
+    };
+
+    // Every thread taking the queue lock for its own vkQueueSubmit
+    std::mutex queue_lock;
+    uint64_t start = bench_now_ns();
+    run_producers([&]() {
+        VkSubmitInfo submit = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        submit.pCommandBuffers = &commands.m_cmd;
+        submit.commandBufferCount = 1;
+        for (uint32_t i = 0; i < per_producer; i++) {
+            std::lock_guard<std::mutex> lock(queue_lock);
+            vkQueueSubmit(ctx.m_graphics_queue, 1, &submit, VK_NULL_HANDLE);
+        }
+    });
+    vkQueueWaitIdle(ctx.m_graphics_queue);
+    double direct_ns = double(bench_now_ns() - start);
+
+    // The same descriptors pushed to the submission thread
+    VkSubmitQueue submitter;
+    if (submitter.init(*ctx.m_device, ctx.m_graphics_queue) != k_success) {
+        ctx.fail("Failed to start the submission thread");
+        commands.shutdown();
+        return;
+    }
+    start = bench_now_ns();
+    run_producers([&]() {
+        VkSubmitQueue::Submit submit;
+        submit.add_cmd(commands.m_cmd);
+        for (uint32_t i = 0; i < per_producer; i++) submitter.push(submit);
+    });
+    submitter.shutdown();
+    double batched_ns = double(bench_now_ns() - start);
+
+    ctx.report("submit_direct_per_sec", "submits/s", total / (direct_ns / 1e9), true);
+    ctx.report("submit_batched_per_sec", "submits/s", total / (batched_ns / 1e9), true);
+    double per_call = double(submitter.m_submits) / double(std::max<uint64_t>(submitter.m_calls, 1));
+    ctx.report("submit_batched_per_call", "submits", per_call, true);
+    if (submitter.m_submits != producers * per_producer) ctx.fail("The submission thread dropped descriptors");
+    if (submitter.m_last_error.load() != VK_SUCCESS) ctx.fail("A batched submit failed");
+
+    commands.shutdown();
+}
+
+static void bench_headless_frames(BenchContext& ctx)
+{
+    // The same acquire, clear, submit and present loop as the application, but with no window behind it
+    VkCompletedState& vk = *ctx.m_vk;
+    VkCompletedDevice& device = *ctx.m_device;
+    auto& surface = vk.m_headless_surfaces.emplace_back();
+    if (surface.init_headless(*device.m_parent) != k_success) {
+        Log::warn("VK_EXT_headless_surface isn't available, skipping the frame loop");
+        vk.m_headless_surfaces.pop_back();
+        return;
+    }
+    auto swap_info = VkCompletedSwapchain::CreateInfo();
+    auto& swap = device.m_swaps.emplace_back();
+    if (swap_info.create_default(device, surface, {1280, 720}) != k_success ||
+        swap.init_from_create_info(swap_info) != k_success) {
+        ctx.fail("Failed to create a headless swapchain");
+        return;
+    }
+    VkQueue present_queue = device.m_queues[swap.m_info.m_selected_queue_indicies[0]].m_handle[0];
+    VkDevice dev = device.m_handle;
+
+    BenchCommands commands;
+    commands.init(ctx);
+    VkSemaphore acquired = VK_NULL_HANDLE, rendered = VK_NULL_HANDLE;
+    VkSemaphoreCreateInfo semaphore_info = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    vkCreateSemaphore(dev, &semaphore_info, nullptr, &acquired);
+    vkCreateSemaphore(dev, &semaphore_info, nullptr, &rendered);
+    VkRenderPass pass = create_clear_pass(dev, swap.m_info.m_info.imageFormat, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    std::vector<VkFramebuffer> framebuffers(swap.m_length);
+    for (uint32_t i = 0; i < swap.m_length; i++) {
+        framebuffers[i] = create_framebuffer(dev, pass, swap.m_view_handles[i], swap.m_info.m_info.imageExtent);
+    }
+
+    uint32_t frames = ctx.iterations(600);
+    uint64_t start = bench_now_ns();
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        uint32_t index = 0;
+        vkAcquireNextImageKHR(dev, swap.m_handle, (uint64_t)-1, acquired, VK_NULL_HANDLE, &index);
+        VkCommandBuffer cmd = commands.begin();
+        VkClearValue clear = {};
+        clear.color.float32[0] = float(frame % 256) / 255.0f;
+        VkRenderPassBeginInfo begin = {VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+        begin.renderPass = pass;
+        begin.framebuffer = framebuffers[index];
+        begin.renderArea.extent = swap.m_info.m_info.imageExtent;
+        begin.pClearValues = &clear;
+        begin.clearValueCount = 1;
+        vkCmdBeginRenderPass(cmd, &begin, VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdEndRenderPass(cmd);
+        vkEndCommandBuffer(cmd);
+
+        VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        VkSubmitInfo submit = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        submit.pCommandBuffers = &cmd;
+        submit.commandBufferCount = 1;
+        submit.pWaitSemaphores = &acquired;
+        submit.waitSemaphoreCount = 1;
+        submit.pWaitDstStageMask = &wait_stage;
+        submit.pSignalSemaphores = &rendered;
+        submit.signalSemaphoreCount = 1;
+        vkQueueSubmit(ctx.m_graphics_queue, 1, &submit, commands.m_fence);
+
+        VkPresentInfoKHR present = {VK_STRUCTURE_TYPE_PRESENT_INFO_KHR};
+        present.pSwapchains = &swap.m_handle;
+        present.swapchainCount = 1;
+        present.pImageIndices = &index;
+        present.pWaitSemaphores = &rendered;
+        present.waitSemaphoreCount = 1;
+        vkQueuePresentKHR(present_queue, &present);
+
+        // One frame in flight like the application, the pool is reset on the next begin
+        vkWaitForFences(dev, 1, &commands.m_fence, VK_TRUE, (uint64_t)-1);
+        vkResetFences(dev, 1, &commands.m_fence);
+    }
+    double seconds = double(bench_now_ns() - start) / 1e9;
+    ctx.report("headless_frames_per_sec", "fps", frames / seconds, true);
+
+    vkDeviceWaitIdle(dev);
+    for (VkFramebuffer fb : framebuffers) vkDestroyFramebuffer(dev, fb, nullptr);
+    vkDestroyRenderPass(dev, pass, nullptr);
+    vkDestroySemaphore(dev, acquired, nullptr);
+    vkDestroySemaphore(dev, rendered, nullptr);
+    commands.shutdown();
+}
+
+static void bench_multi_present(BenchContext& ctx)
+{
+    // Several windows drawn as one frame, a window should cost its clear rather than another submit and present
+    const uint32_t window_count = 4;
+    VkCompletedState& vk = *ctx.m_vk;
+    VkCompletedDevice& device = *ctx.m_device;
+    VkDevice dev = device.m_handle;
+    vk.m_headless_surfaces.reserve(vk.m_headless_surfaces.size() + window_count);
+    device.m_swaps.reserve(device.m_swaps.size() + window_count);
+
+    VkMultiPresenter presenter;
+    if (presenter.init(device, ctx.m_graphics_family, ctx.m_graphics_queue, ctx.m_graphics_queue) != k_success) {
+        ctx.fail("Failed to create the presenter");
+        return;
+    }
+    VkRenderPass pass = VK_NULL_HANDLE;
+    std::vector<std::vector<VkFramebuffer>> framebuffers;
+    for (uint32_t i = 0; i < window_count; i++) {
+        auto& surface = vk.m_headless_surfaces.emplace_back();
+        if (surface.init_headless(*device.m_parent) != k_success) {
+            vk.m_headless_surfaces.pop_back();
+            break;
+        }
+        auto swap_info = VkCompletedSwapchain::CreateInfo();
+        auto& swap = device.m_swaps.emplace_back();
+        if (swap_info.create_default(device, surface, {640, 360}) != k_success ||
+            swap.init_from_create_info(swap_info) != k_success || presenter.add_target(swap) < 0) {
+            ctx.fail("Failed to create a headless swapchain");
+            break;
+        }
+        if (pass == VK_NULL_HANDLE) {
+            pass = create_clear_pass(dev, swap.m_info.m_info.imageFormat, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+        }
+        auto& views = framebuffers.emplace_back(swap.m_length);
+        for (uint32_t j = 0; j < swap.m_length; j++) {
+            views[j] = create_framebuffer(dev, pass, swap.m_view_handles[j], swap.m_info.m_info.imageExtent);
+        }
+    }
+
+    if (framebuffers.size() == window_count) {
+        uint32_t frames = ctx.iterations(300);
+        uint64_t start = bench_now_ns();
+        for (uint32_t frame = 0; frame < frames; frame++) {
+            if (presenter.begin_frame() != k_success) break;
+            for (uint32_t t = 0; t < window_count; t++) {
+                if (!presenter.is_active(t)) continue;
+                VkCommandBuffer cmd = presenter.command_buffer(t);
+                VkClearValue clear = {};
+                clear.color.float32[t % 3] = float(frame % 256) / 255.0f;
+                VkRenderPassBeginInfo begin = {VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+                begin.renderPass = pass;
+                begin.framebuffer = framebuffers[t][presenter.image_index(t)];
+                begin.renderArea.extent = presenter.m_targets[t].m_swap->m_info.m_info.imageExtent;
+                begin.pClearValues = &clear;
+                begin.clearValueCount = 1;
+                vkCmdBeginRenderPass(cmd, &begin, VK_SUBPASS_CONTENTS_INLINE);
+                vkCmdEndRenderPass(cmd);
+            }
+            if (presenter.end_frame() != k_success) {
+                ctx.fail("Multi swapchain present failed");
+                break;
+            }
+        }
+        double seconds = double(bench_now_ns() - start) / 1e9;
+        ctx.report("multi_present_4x_frames_per_sec", "fps", frames / seconds, true);
+
+        // Four clears are next to nothing, so a GPU time anywhere near a 60Hz refresh means the clock started
+        // before the FIFO wait for an image
+        double gpu_ms = double(presenter.gpu_time_ns()) / 1e6;
+        ctx.report("multi_present_4x_gpu_ms", "ms", gpu_ms, false);
+        if (gpu_ms > 1000.0 / 60.0 / 4.0) ctx.fail("Idle frames report GPU time that includes the wait for vsync");
+    } else if (framebuffers.empty()) {
+        Log::warn("VK_EXT_headless_surface isn't available, skipping the multi window loop");
+    }
+
+    presenter.shutdown();
+    for (auto& views : framebuffers) {
+        for (VkFramebuffer fb : views) vkDestroyFramebuffer(dev, fb, nullptr);
+    }
+    if (pass != VK_NULL_HANDLE) vkDestroyRenderPass(dev, pass, nullptr);
+}
+
+static void bench_pipeline_streaming(BenchContext& ctx)
+{
+    BenchTarget target;
+    BenchQuadLayout quad;
+    if (target.init(*ctx.m_device, {256, 256}) != k_success || quad.init(*ctx.m_device) != k_success) {
+        Log::warn("Quad shaders aren't built, skipping pipeline streaming");
+        quad.shutdown();
+        target.shutdown();
+        return;
+    }
+
+    // Distinct create states, so every request is a real compile. No cache file so the driver can't shortcut
+    JobSystem jobs;
+    jobs.init();
+    VkPipelineManager manager;
+    manager.init(*ctx.m_device, jobs);
+    uint32_t count = ctx.iterations(128);
+    std::vector<double> request_ns;
+    std::vector<VkPipelineManager::Handle> handles;
+    VkMutableGraphicsPipelineCreateInfo info;
+    quad.fill(info, target.m_pass);
+    uint64_t start = bench_now_ns();
+    for (uint32_t i = 0; i < count; i++) {
+        info.rasterization.depthBiasConstantFactor = float(i);
+        uint64_t request_start = bench_now_ns();
+        handles.push_back(manager.request(info));
+        request_ns.push_back(double(bench_now_ns() - request_start));
+    }
+    while (manager.pending() > 0) std::this_thread::yield();
+    double total_ms = double(bench_now_ns() - start) / 1e6;
+
+    for (auto handle : handles) {
+        if (manager.state(handle) != VkPipelineManager::State::k_ready) ctx.fail("A streamed pipeline failed");
+    }
+    ctx.report("pipeline_request_p50_ns", "ns", bench_percentile(request_ns, 0.5), false);
+    ctx.report("pipeline_request_p99_ns", "ns", bench_percentile(request_ns, 0.99), false);
+    ctx.report("pipeline_compile_all_ms", "ms", total_ms, false);
+
+    manager.shutdown();
+    jobs.shutdown();
+    quad.shutdown();
+    target.shutdown();
+}
+
+// The features shaders/quad.frag declares, each is the constant_id of its specialization constant
+enum class QuadFeature : uint32_t { k_alpha_test = 0, k_distance_field, k_grayscale };
+constexpr uint32_t k_quad_features =
+  k_feature_mask<QuadFeature::k_alpha_test, QuadFeature::k_distance_field, QuadFeature::k_grayscale>;
+
+static void bench_pipeline_variants(BenchContext& ctx)
+{
+    BenchTarget target;
+    BenchQuadLayout quad;
+    if (target.init(*ctx.m_device, {256, 256}) != k_success || quad.init(*ctx.m_device) != k_success) {
+        Log::warn("Quad shaders aren't built, skipping pipeline variants");
+        quad.shutdown();
+        target.shutdown();
+        return;
+    }
+
+    // First use of a variant specializes and requests it, every use after that is a table lookup
+    JobSystem jobs;
+    jobs.init();
+    VkPipelineManager manager;
+    manager.init(*ctx.m_device, jobs);
+    VkMutableGraphicsPipelineCreateInfo info;
+    quad.fill(info, target.m_pass);
+    using Variants = VkPipelineVariants<k_quad_features>;
+    Variants variants;
+    variants.init(manager, info);
+
+    uint64_t start = bench_now_ns();
+    variants.request_all();
+    double first_us = double(bench_now_ns() - start) / 1e3 / double(Variants::k_count);
+    while (manager.pending() > 0) std::this_thread::yield();
+    double compile_ms = double(bench_now_ns() - start) / 1e6;
+
+    uint32_t lookups = ctx.iterations(1000000);
+    uint64_t sink = 0;
+    start = bench_now_ns();
+    for (uint32_t i = 0; i < lookups; i++) sink += (uint64_t)variants.get(i * 2654435761u);
+    double lookup_ns = double(bench_now_ns() - start) / double(lookups);
+
+    for (uint32_t mask = 0; mask < Variants::k_count; mask++) {
+        if (manager.state(variants.m_variants[mask]) != VkPipelineManager::State::k_ready) {
+            ctx.fail("A pipeline variant failed");
+        }
+    }
+    if (variants.m_requested != Variants::k_count || manager.m_slots.size() != Variants::k_count || sink == 0) {
+        ctx.fail("Pipeline variants weren't built exactly once each");
+    }
+    ctx.report("pipeline_variant_first_use_us", "us", first_us, false);
+    ctx.report("pipeline_variant_lookup_ns", "ns", lookup_ns, false);
+    ctx.report("pipeline_variant_compile_all_ms", "ms", compile_ms, false);
+
+    variants.shutdown();
+    manager.shutdown();
+    jobs.shutdown();
+    quad.shutdown();
+    target.shutdown();
+}
+
+static void bench_quad_batch(BenchContext& ctx)
+{
+    BenchCommands commands;
+    BenchTarget target;
+    BenchQuadLayout quad;
+    VkQuadBatcher batcher;
+    VkPipeline pipelines[4] = {};
+    const uint32_t quads_per_frame = 100000;
+    bool ready = commands.init(ctx) == k_success && target.init(*ctx.m_device, {1024, 1024}) == k_success &&
+                 quad.init(*ctx.m_device) == k_success &&
+                 batcher.init(*ctx.m_device, 2, quads_per_frame) == k_success;
+    for (uint32_t i = 0; i < 4 && ready; i++) {
+        VkMutableGraphicsPipelineCreateInfo info;
+        quad.fill(info, target.m_pass);
+        info.rasterization.depthBiasConstantFactor = float(i);
+        ready = info.create_pipeline(pipelines[i], ctx.m_device->m_handle) == k_success;
+    }
+
+    if (ready) {
+        // Quads arrive in runs of the same pipeline, like sprites grouped by layer
+        std::mt19937 rng(3);
+        std::vector<QuadInstance> quads(quads_per_frame);
+        for (auto& q : quads) {
+            q = {float(rng() % 1024), float(rng() % 1024), 16, 16, 0, 0, 1, 1, 0xffffffffu, 0};
+        }
+        std::vector<double> samples;
+        for (uint32_t frame = 0; frame < ctx.iterations(30); frame++) {
+            uint64_t start = bench_now_ns();
+            batcher.begin_frame(frame % 2);
+            for (uint32_t i = 0; i < quads_per_frame; i++) {
+                batcher.submit(pipelines[(i / 64) % 4], quad.m_set, quads[i]);
+            }
+            VkCommandBuffer cmd = commands.begin();
+            target.begin_pass(cmd);
+            batcher.record(cmd, quad.m_layout, 0, target.m_extent);
+            vkCmdEndRenderPass(cmd);
+            vkEndCommandBuffer(cmd);
+            samples.push_back(double(bench_now_ns() - start));
+        }
+        ctx.report("quad_batch_mquads_per_sec", "M/s", quads_per_frame / bench_median(samples) * 1e3, true);
+    } else {
+        Log::warn("Quad shaders aren't built, skipping the quad batcher");
+    }
+
+    for (VkPipeline pipeline : pipelines) {
+        if (pipeline != VK_NULL_HANDLE) vkDestroyPipeline(ctx.m_device->m_handle, pipeline, nullptr);
+    }
+    batcher.shutdown();
+    quad.shutdown();
+    target.shutdown();
+    commands.shutdown();
+}
+
+static void bench_state_recorder(BenchContext& ctx)
+{
+    BenchCommands commands;
+    BenchTarget target;
+    BenchQuadLayout quad;
+    BenchMaterials materials;
+    VkCompletedBuffer instances;
+    VkCompletedBuffer pixels;
+    VkPipeline pipelines[4] = {};
+    const uint32_t draws = ctx.m_quick ? 2000 : 20000;
+    const VkMemoryPropertyFlags host = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    bool ready = commands.init(ctx) == k_success && target.init(*ctx.m_device, {1024, 1024}) == k_success &&
+                 quad.init(*ctx.m_device) == k_success &&
+                 materials.init(ctx, commands, quad.m_set_layout) == k_success &&
+                 instances.init(*ctx.m_device, draws * sizeof(QuadInstance), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                host) == k_success &&
+                 pixels.init(*ctx.m_device, 1024 * 1024 * 4, VK_BUFFER_USAGE_TRANSFER_DST_BIT, host) == k_success;
+    for (uint32_t i = 0; i < 4 && ready; i++) {
+        VkMutableGraphicsPipelineCreateInfo info;
+        quad.fill(info, target.m_pass);
+        info.rasterization.depthBiasConstantFactor = float(i);
+        ready = info.create_pipeline(pipelines[i], ctx.m_device->m_handle) == k_success;
+    }
+    if (!ready) {
+        Log::warn("Quad shaders aren't built, skipping the state recorder");
+    } else {
+        // Every draw is one quad with a random pipeline and material, recorded the way a naive scene walk would,
+        // setting all of its state whether or not the last draw already had it. Each quad has a cell of a grid to
+        // itself, placed at random, so sorting can't change which one ends up on top and every path has to draw
+        // the same image
+        std::mt19937 rng(9);
+        uint32_t columns = 1;
+        while (columns * columns < draws) columns++;
+        const uint32_t cell = 1024 / columns;
+        std::vector<uint32_t> cells(columns * columns);
+        for (uint32_t i = 0; i < cells.size(); i++) cells[i] = i;
+        std::shuffle(cells.begin(), cells.end(), rng);
+        auto* quads = static_cast<QuadInstance*>(instances.m_mapped);
+        std::vector<VkDrawList::Draw> scene(draws);
+        for (uint32_t i = 0; i < draws; i++) {
+            float x = float(cells[i] % columns * cell), y = float(cells[i] / columns * cell);
+            quads[i] = {x, y, float(cell), float(cell), 0, 0, 1, 1, 0xffffffffu, 0};
+            uint32_t pipeline = rng() % 4, material = rng() % BenchMaterials::k_count;
+            VkDrawList::Draw& draw = scene[i];
+            draw.m_key = VkDrawList::sort_key(pipeline, material, float(rng() % 1000) / 1000.0f);
+            draw.m_pipeline = pipelines[pipeline];
+            draw.m_layout = quad.m_layout;
+            draw.m_material = materials.m_sets[material];
+            draw.m_vertex_buffer = instances.m_handle;
+            draw.m_count = 6;
+            draw.m_first_instance = i;
+        }
+        float transform[4] = {2.0f / 1024.0f, 2.0f / 1024.0f, -1.0f, -1.0f};
+        VkViewport viewport = {0.0f, 0.0f, 1024.0f, 1024.0f, 0.0f, 1.0f};
+        VkRect2D scissor = {{0, 0}, target.m_extent};
+        VkDeviceSize zero = 0;
+
+        // Two timestamps around the pass, when the queue can write them
+        VkCompletedDevice& device = *ctx.m_device;
+        const VkDeviceDispatch& api = device.m_dispatch;
+        VkQueryPool timestamps = VK_NULL_HANDLE;
+        auto family = device.m_queues.find(ctx.m_graphics_family);
+        double period = device.m_physical->m_device_properties.limits.timestampPeriod;
+        if (family != device.m_queues.end() && family->second.props.timestampValidBits > 0 && period > 0.0) {
+            VkQueryPoolCreateInfo query_info = {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+            query_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            query_info.queryCount = 2;
+            vkCreateQueryPool(device.m_handle, &query_info, nullptr, &timestamps);
+        }
+
+        // Raw, through the recorder in scene order, and through the recorder sorted by key. The last frame of each
+        // is read back and has to match the raw one
+        VkStateRecorder recorder;
+        VkDrawList list;
+        const char* names[3] = {"raw", "filtered", "sorted"};
+        const uint32_t frames = ctx.iterations(30);
+        std::vector<uint8_t> raw_image(1024 * 1024 * 4);
+        for (uint32_t mode = 0; mode < 3; mode++) {
+            std::vector<double> record_samples, gpu_samples;
+            uint64_t emitted = 0, filtered = 0, recorded_draws = 0;
+            for (uint32_t frame = 0; frame < frames; frame++) {
+                recorder.m_counters = VkStateRecorder::Counters();
+                uint64_t start = bench_now_ns();
+                VkCommandBuffer cmd = commands.begin();
+                if (timestamps != VK_NULL_HANDLE) {
+                    api.vkCmdResetQueryPool(cmd, timestamps, 0, 2);
+                    api.vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamps, 0);
+                }
+                target.begin_pass(cmd);
+                recorder.begin(api, cmd);
+                if (mode == 0) {
+                    for (const VkDrawList::Draw& draw : scene) {
+                        api.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.m_pipeline);
+                        api.vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, quad.m_layout, 0, 1,
+                                                    &draw.m_material, 0, nullptr);
+                        api.vkCmdBindVertexBuffers(cmd, 0, 1, &draw.m_vertex_buffer, &zero);
+                        api.vkCmdPushConstants(cmd, quad.m_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, 16, transform);
+                        api.vkCmdSetViewport(cmd, 0, 1, &viewport);
+                        api.vkCmdSetScissor(cmd, 0, 1, &scissor);
+                        api.vkCmdDraw(cmd, 6, 1, 0, draw.m_first_instance);
+                    }
+                } else if (mode == 1) {
+                    for (const VkDrawList::Draw& draw : scene) {
+                        recorder.bind_pipeline(draw.m_pipeline);
+                        recorder.bind_descriptor_set(quad.m_layout, 0, draw.m_material);
+                        recorder.bind_vertex_buffers(0, 1, &draw.m_vertex_buffer, &zero);
+                        recorder.push_constants(quad.m_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, 16, transform);
+                        recorder.set_viewport(viewport);
+                        recorder.set_scissor(scissor);
+                        recorder.draw(6, 1, 0, draw.m_first_instance);
+                    }
+                } else {
+                    recorder.push_constants(quad.m_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, 16, transform);
+                    recorder.set_viewport(viewport);
+                    recorder.set_scissor(scissor);
+                    list.m_draws.assign(scene.begin(), scene.end());
+                    list.flush(recorder);
+                }
+                api.vkCmdEndRenderPass(cmd);
+                if (timestamps != VK_NULL_HANDLE) {
+                    api.vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamps, 1);
+                }
+                if (frame == frames - 1) target.copy_to(cmd, pixels.m_handle);
+                api.vkEndCommandBuffer(cmd);
+                record_samples.push_back(double(bench_now_ns() - start));
+                emitted = recorder.m_counters.m_emitted;
+                filtered = recorder.m_counters.m_filtered;
+                recorded_draws = recorder.m_counters.m_draws;
+
+                commands.submit_and_wait(ctx.m_graphics_queue);
+                uint64_t stamps[2] = {};
+                if (timestamps != VK_NULL_HANDLE &&
+                    api.vkGetQueryPoolResults(device.m_handle, timestamps, 0, 2, sizeof(stamps), stamps,
+                                              sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+                    gpu_samples.push_back(double(stamps[1] - stamps[0]) * period);
+                }
+            }
+            std::string prefix = std::string("state_recorder_") + names[mode];
+            ctx.report((prefix + "_record_ms").c_str(), "ms", bench_median(record_samples) / 1e6, false);
+            if (!gpu_samples.empty()) {
+                ctx.report((prefix + "_gpu_ms").c_str(), "ms", bench_median(gpu_samples) / 1e6, false);
+            }
+            if (mode != 0) {
+                ctx.report((prefix + "_binds_emitted").c_str(), "calls", double(emitted), false);
+                ctx.report((prefix + "_binds_filtered").c_str(), "calls", double(filtered), true);
+
+                // Scene order sets six pieces of state per draw. The sorted list sets the shared three once and
+                // binds a pipeline, material and vertex buffer per draw
+                uint64_t calls = mode == 1 ? 6ull * draws : 3 + 3ull * draws;
+                if (emitted + filtered != calls || recorded_draws != draws) {
+                    Log::error("Emitted %llu and filtered %llu of %llu state calls over %llu draws",
+                               (unsigned long long)emitted, (unsigned long long)filtered,
+                               (unsigned long long)calls, (unsigned long long)recorded_draws);
+                    ctx.fail((prefix + " lost or added state calls").c_str());
+                }
+            }
+            const uint8_t* image = static_cast<const uint8_t*>(pixels.m_mapped);
+            if (mode == 0) {
+                std::memcpy(raw_image.data(), image, raw_image.size());
+            } else if (std::memcmp(raw_image.data(), image, raw_image.size()) != 0) {
+                ctx.fail((prefix + " drew a different image to the raw path").c_str());
+            }
+        }
+        if (timestamps != VK_NULL_HANDLE) vkDestroyQueryPool(device.m_handle, timestamps, nullptr);
+    }
+
+    for (VkPipeline pipeline : pipelines) {
+        if (pipeline != VK_NULL_HANDLE) vkDestroyPipeline(ctx.m_device->m_handle, pipeline, nullptr);
+    }
+    instances.shutdown();
+    pixels.shutdown();
+    materials.shutdown();
+    quad.shutdown();
+    target.shutdown();
+    commands.shutdown();
+}
+
+static void bench_gpu_cull(BenchContext& ctx)
+{
+    const uint32_t objects = 100000;
+    BenchCommands commands;
+    VkShaderRegistry shaders;
+    VkGpuCuller culler;
+    shaders.init(*ctx.m_device);
+    if (commands.init(ctx) != k_success || culler.init(*ctx.m_device, shaders, objects) != k_success) {
+        Log::warn("Cull shader isn't built, skipping GPU culling");
+        culler.shutdown();
+        shaders.shutdown();
+        commands.shutdown();
+        return;
+    }
+
+    // Objects scattered in a cube around the camera, roughly half of them in view. Each has its own instance when
+    // the device can start indirect draws at one
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    for (uint32_t i = 0; i < objects; i++) {
+        VkDrawIndexedIndirectCommand draw = {36, 1, 0, 0, culler.m_first_instance ? i : 0};
+        culler.set_object(i, {position(rng), position(rng), position(rng), 1.0f}, draw);
+    }
+    culler.set_object_count(objects);
+    const float planes[6][4] = {{1, 0, 0, 100}, {-1, 0, 0, 100}, {0, 1, 0, 100},
+                                {0, -1, 0, 100}, {0, 0, 1, 0},   {0, 0, -1, 100}};
+
+    std::vector<double> samples;
+    for (uint32_t i = 0; i < ctx.iterations(50); i++) {
+        uint64_t start = bench_now_ns();
+        culler.record_cull(commands.begin(), planes);
+        commands.submit_and_wait(ctx.m_graphics_queue);
+        samples.push_back(double(bench_now_ns() - start));
+    }
+    ctx.report("gpu_cull_100k_ms", "ms", bench_median(samples) / 1e6, false);
+
+    culler.shutdown();
+    shaders.shutdown();
+    commands.shutdown();
+}
+
+static void bench_multi_gpu(BenchContext& ctx)
+{
+    // The graphics queue belongs to a submitter as it does in the application, so a primary worker on that queue
+    // has to go through it
+    VkSubmitQueue submitter;
+    VkMultiGpuScheduler scheduler;
+    if (submitter.init(*ctx.m_device, ctx.m_graphics_queue) != k_success) {
+        ctx.fail("Failed to start the submission thread");
+        return;
+    }
+    scheduler.m_submitter = &submitter;
+    if (scheduler.init(*ctx.m_vk, *ctx.m_device) != k_success) {
+        ctx.fail("Failed to create the offscreen scheduler");
+        submitter.shutdown();
+        return;
+    }
+
+    // Every worker fills a buffer and the primary has to see the same bytes, whichever way they travelled
+    const VkDeviceSize size = 16u << 20;
+    const uint32_t pattern = 0x41544c52u;
+    auto fill = [&](VkCommandBuffer cmd, VkBuffer result) { vkCmdFillBuffer(cmd, result, 0, size, pattern); };
+    for (uint32_t w = 0; w < scheduler.m_workers.size(); w++) {
+        std::vector<double> samples;
+        for (uint32_t i = 0; i < ctx.iterations(20); i++) {
+            uint64_t start = bench_now_ns();
+            auto handle = scheduler.submit_to(w, size, fill);
+            if (handle == VkMultiGpuScheduler::k_invalid || scheduler.wait(handle) != k_success) {
+                ctx.fail("Offscreen work failed to run");
+                break;
+            }
+            samples.push_back(double(bench_now_ns() - start));
+
+            const uint32_t* data = (const uint32_t*)scheduler.result_data(handle);
+            for (VkDeviceSize j = 0; data != nullptr && j < size / 4; j += 4099) {
+                if (data[j] != pattern) {
+                    ctx.fail("Offscreen result arrived corrupted on the primary device");
+                    break;
+                }
+            }
+            scheduler.release(handle);
+        }
+        if (samples.empty()) continue;
+        std::string name = "multi_gpu_worker" + std::to_string(w) + "_16mb_ms";
+        ctx.report(name.c_str(), "ms", bench_median(samples) / 1e6, false);
+    }
+
+    // Lots of small jobs left to the scheduler, spread over whatever devices exist
+    VkMultiGpuScheduler::Requirements req;
+    req.m_queue_flags = 0;
+    std::vector<VkMultiGpuScheduler::Handle> handles;
+    uint32_t jobs = ctx.iterations(256);
+    uint64_t start = bench_now_ns();
+    for (uint32_t i = 0; i < jobs; i++) {
+        handles.push_back(scheduler.submit(req, 64u << 10, [&](VkCommandBuffer cmd, VkBuffer result) {
+            vkCmdFillBuffer(cmd, result, 0, 64u << 10, i);
+        }));
+        scheduler.poll();
+    }
+    for (auto handle : handles) {
+        if (handle == VkMultiGpuScheduler::k_invalid) continue;
+        scheduler.wait(handle);
+        scheduler.release(handle);
+    }
+    ctx.report("multi_gpu_jobs_per_sec", "jobs/s", jobs / (double(bench_now_ns() - start) / 1e9), true);
+
+    scheduler.shutdown();
+    submitter.shutdown();
+    if (submitter.error() != k_success) ctx.fail("Offscreen work pushed to the submission thread failed");
+}
+
+static void bench_texture_stream(BenchContext& ctx)
+{
+    // 1024x1024 RGBA8 textures with a full chain, about 5.3MB each, written next to the working directory
+    const uint32_t count = 16, size = 1024;
+    std::vector<std::string> paths;
+    for (uint32_t t = 0; t < count; t++) {
+        std::vector<std::vector<uint8_t>> levels;
+        for (uint32_t s = size; s > 0; s /= 2) levels.emplace_back(size_t(s) * s * 4, uint8_t(t));
+        paths.push_back("bench_stream_" + std::to_string(t) + ".ktx2");
+        if (Ktx2File::write(paths.back().c_str(), VK_FORMAT_R8G8B8A8_UNORM, size, size, levels) != k_success) {
+            ctx.fail("Failed to write the streaming test textures");
+            for (const auto& path : paths) std::remove(path.c_str());
+            return;
+        }
+    }
+
+    // The transfer queue is only used when the bench device created one, otherwise uploads share graphics
+    uint32_t family = VkTextureStreamer::select_transfer_family(*ctx.m_device, ctx.m_graphics_family);
+    VkQueue queue = ctx.m_graphics_queue;
+    if (family != ctx.m_graphics_family) queue = ctx.m_device->m_queues[family].m_handle[0];
+    VkMemoryTelemetry memory;
+    memory.init(*ctx.m_device);
+    VkTextureStreamer streamer;
+    streamer.m_budget_limit = 24ull << 20;
+    if (streamer.init(*ctx.m_device, family, queue, ctx.m_graphics_family, 2, 16ull << 20) != k_success) {
+        ctx.fail("Failed to create the texture streamer");
+        memory.shutdown();
+        for (const auto& path : paths) std::remove(path.c_str());
+        return;
+    }
+
+    uint64_t start = bench_now_ns();
+    std::vector<VkTextureStreamer::Handle> handles;
+    for (const auto& path : paths) handles.push_back(streamer.load(path.c_str()));
+    streamer.flush();
+    ctx.report("texture_stream_tail_load_ms", "ms", double(bench_now_ns() - start) / 1e6, false);
+
+    // A camera sweeping past the textures, a few at full size at a time and the rest far away
+    uint64_t uploaded = streamer.m_uploaded_bytes;
+    VkDeviceSize peak = 0;
+    start = bench_now_ns();
+    for (uint32_t frame = 0; frame < ctx.iterations(240); frame++) {
+        for (uint32_t t = 0; t < count; t++) {
+            uint32_t distance = (t + count - frame / 15 % count) % count;
+            streamer.request(handles[t], distance < 3 ? float(size) : 32.0f);
+        }
+        memory.poll();
+        streamer.update();
+        streamer.flush();
+        peak = std::max(peak, streamer.m_resident_bytes);
+    }
+    double seconds = double(bench_now_ns() - start) / 1e9;
+    ctx.report("texture_stream_mb_per_sec", "MB/s", double(streamer.m_uploaded_bytes - uploaded) / 1e6 / seconds,
+               true);
+    ctx.report("texture_stream_evictions", "count", double(streamer.m_evictions), false);
+    if (peak > streamer.m_budget) ctx.fail("Resident textures went over the budget");
+    VkDeviceSize tracked_peak = memory.m_heaps.empty() ? 0 : memory.m_heaps[streamer.m_heap].m_tracked_high_water;
+    ctx.report("texture_stream_tracked_peak_mb", "MB", double(tracked_peak) / (1024.0 * 1024.0), false);
+
+    streamer.shutdown();
+    memory.shutdown();
+    for (const auto& path : paths) std::remove(path.c_str());
+}
+
+// Each of the reactor's waits driven from a task, the results land in the slots the bench checks afterwards
+static Task<void> bench_await_fence(Reactor& reactor, VkCompletedDevice& device, VkFence fence, result& out)
+{
+    out = co_await reactor.fence(device, fence);
+}
+
+static Task<void> bench_await_timeline(Reactor& reactor, VkCompletedDevice& device, VkSemaphore semaphore,
+                                       uint64_t value, result& out)
+{
+    out = co_await reactor.timeline(device, semaphore, value);
+}
+
+static Task<void> bench_await_job(Reactor& reactor, JobSystem& jobs, uint32_t seed, uint32_t& out)
+{
+    out = co_await reactor.run(jobs, [seed]() { return seed * 2654435761u; });
+}
+
+static Task<void> bench_await_upload(VkAsyncUploader& uploader, VkBuffer buffer, VkDeviceSize offset,
+                                     std::vector<uint32_t> words, uint32_t& uploaded)
+{
+    if (co_await uploader.upload(buffer, offset, words.data(), words.size() * sizeof(uint32_t)) == k_success) {
+        uploaded++;
+    }
+}
+
+static void bench_reactor_awaits(BenchContext& ctx)
+{
+    VkCompletedDevice& device = *ctx.m_device;
+    VkDevice dev = device.m_handle;
+    JobSystem jobs;
+    jobs.init();
+    Reactor reactor;
+
+    // Polled the way the frame loop would, with a bound so a wait that never finishes fails rather than hangs
+    auto drain = [&reactor]() {
+        uint64_t start = bench_now_ns();
+        while (reactor.pending() != 0 && bench_now_ns() - start < 5000000000ull) {
+            reactor.poll();
+            std::this_thread::yield();
+        }
+        return reactor.pending() == 0;
+    };
+    auto signal = [&](VkFence fence, VkSemaphore semaphore, uint64_t value) {
+        VkTimelineSemaphoreSubmitInfo values = {VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+        values.pSignalSemaphoreValues = &value;
+        values.signalSemaphoreValueCount = 1;
+        VkSubmitInfo submit = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        if (semaphore != VK_NULL_HANDLE) {
+            submit.pNext = &values;
+            submit.pSignalSemaphores = &semaphore;
+            submit.signalSemaphoreCount = 1;
+        }
+        return vkQueueSubmit(ctx.m_graphics_queue, 1, &submit, fence);
+    };
+
+    // A fence the task is already parked on by the time it's submitted
+    VkFenceCreateInfo fence_info = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    VkFence fence = VK_NULL_HANDLE;
+    result fence_result = -1;
+    if (vkCreateFence(dev, &fence_info, nullptr, &fence) != VK_SUCCESS) {
+        ctx.fail("Failed to create a fence");
+    } else {
+        reactor.spawn(bench_await_fence(reactor, device, fence, fence_result));
+        if (signal(fence, VK_NULL_HANDLE, 0) != VK_SUCCESS || !drain() || fence_result != k_success) {
+            ctx.fail("A task awaiting a fence wasn't resumed with success");
+        }
+        vkDestroyFence(dev, fence, nullptr);
+    }
+
+    // Timelines, several tasks on one semaphore resuming as the counter passes their values
+    if (device.m_dispatch.vkGetSemaphoreCounterValueKHR) {
+        VkSemaphoreTypeCreateInfo type_info = {VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+        type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        VkSemaphoreCreateInfo semaphore_info = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+        semaphore_info.pNext = &type_info;
+        VkSemaphore timeline = VK_NULL_HANDLE;
+        if (vkCreateSemaphore(dev, &semaphore_info, nullptr, &timeline) != VK_SUCCESS) {
+            ctx.fail("Failed to create a timeline semaphore");
+        } else {
+            result values[3] = {};
+            for (uint32_t i = 0; i < 3; i++) {
+                values[i] = -1;
+                reactor.spawn(bench_await_timeline(reactor, device, timeline, i + 1, values[i]));
+            }
+            bool ok = signal(VK_NULL_HANDLE, timeline, 2) == VK_SUCCESS;
+            for (uint32_t i = 0; ok && i < 10 && values[1] != k_success; i++) reactor.poll();
+            if (values[2] == k_success) ctx.fail("A timeline wait resumed before its value was reached");
+            ok = ok && signal(VK_NULL_HANDLE, timeline, 3) == VK_SUCCESS && drain();
+            if (!ok || values[0] != k_success || values[1] != k_success || values[2] != k_success) {
+                ctx.fail("Tasks awaiting a timeline weren't all resumed with success");
+            }
+            vkQueueWaitIdle(ctx.m_graphics_queue);
+            vkDestroySemaphore(dev, timeline, nullptr);
+        }
+    } else {
+        Log::warn("Timeline semaphores aren't enabled, skipping the timeline awaits");
+    }
+
+    // Jobs hop to a worker and back
+    std::vector<uint32_t> hashed(64, 0);
+    for (uint32_t i = 0; i < hashed.size(); i++) reactor.spawn(bench_await_job(reactor, jobs, i, hashed[i]));
+    bool hashed_ok = drain();
+    for (uint32_t i = 0; i < hashed.size(); i++) hashed_ok = hashed_ok && hashed[i] == i * 2654435761u;
+    if (!hashed_ok) ctx.fail("Tasks awaiting jobs came back with the wrong results");
+
+    // Small uploads batched into one submit, read back once every task has been resumed
+    const uint32_t uploads = ctx.iterations(1000);
+    const uint32_t words = 64;
+    VkCompletedBuffer target;
+    VkAsyncUploader uploader;
+    if (target.init(device, VkDeviceSize(uploads) * words * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != k_success ||
+        uploader.init(device, reactor, ctx.m_graphics_family, ctx.m_graphics_queue) != k_success) {
+        ctx.fail("Failed to create the async uploader");
+    } else {
+        uint32_t uploaded = 0;
+        uint64_t start = bench_now_ns();
+        for (uint32_t i = 0; i < uploads; i++) {
+            std::vector<uint32_t> data(words, i);
+            VkDeviceSize offset = VkDeviceSize(i) * words * sizeof(uint32_t);
+            reactor.spawn(bench_await_upload(uploader, target.m_handle, offset, std::move(data), uploaded));
+        }
+        bool flushed = uploader.flush() == k_success;
+        bool drained = drain();
+        ctx.report("reactor_uploads_ms", "ms", double(bench_now_ns() - start) / 1e6, false);
+        ctx.report("reactor_upload_submits", "submits", double(uploader.m_submits), false);
+
+        const uint32_t* mapped = static_cast<const uint32_t*>(target.m_mapped);
+        bool matches = flushed && drained && uploaded == uploads && mapped != nullptr;
+        for (uint32_t i = 0; matches && i < uploads; i++) matches = mapped[i * words + words - 1] == i;
+        if (!matches) ctx.fail("Async uploads didn't all land in the buffer");
+    }
+
+    vkQueueWaitIdle(ctx.m_graphics_queue);
+    uploader.shutdown();
+    target.shutdown();
+    reactor.shutdown();
+    jobs.shutdown();
+}
+
+void Atelier::bench_vk_cases(std::vector<BenchCase>& out)
+{
+    out.push_back({"pre_surface_init", bench_pre_surface_init, true});
+    out.push_back({"command_recording", bench_command_recording, true});
+    out.push_back({"command_bundle", bench_command_bundle, true});
+    out.push_back({"submit_batching", bench_submit_batching, true});
+    out.push_back({"headless_frames", bench_headless_frames, true});
+    out.push_back({"multi_present", bench_multi_present, true});
+    out.push_back({"pipeline_streaming", bench_pipeline_streaming, true});
+    out.push_back({"pipeline_variants", bench_pipeline_variants, true});
+    out.push_back({"quad_batch", bench_quad_batch, true});
+    out.push_back({"state_recorder", bench_state_recorder, true});
+    out.push_back({"gpu_cull", bench_gpu_cull, true});
+    out.push_back({"multi_gpu", bench_multi_gpu, true});
+    out.push_back({"texture_stream", bench_texture_stream, true});
+    out.push_back({"reactor_awaits", bench_reactor_awaits, true});
+}
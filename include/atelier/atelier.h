@@ -1,9 +1,30 @@
 #pragma once
 #include "atelier_base.h"
+#include "atelier_bvh.h"
+#include "atelier_frame_loop.h"
+#include "atelier_frame_pacer.h"
+#include "atelier_frame_pipeline.h"
+#include "atelier_input.h"
+#include "atelier_jobs.h"
+#include "atelier_mesh.h"
+#include "atelier_scene.h"
+#include "atelier_task.h"
+#include "atelier_vk_bundle.h"
+#include "atelier_vk_capture.h"
 #include "atelier_vk_completed.h"
+#include "atelier_vk_dispatch.h"
+#include "atelier_vk_dynamic_resolution.h"
+#include "atelier_vk_memory.h"
 #include "atelier_vk_mutable.h"
+#include "atelier_vk_overlay.h"
+#include "atelier_vk_present.h"
+#include "atelier_vk_reactor.h"
+#include "atelier_vk_recorder.h"
+#include "atelier_vk_submit.h"
+#include "atelier_vk_texture_stream.h"
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#include <algorithm>
 #include <mutex>
 #include <optional>
 #include <thread>
@@ -29,9 +50,15 @@ struct Window {
     // Make a sub window which doesn't
     static result create_sub_window(Window* out, HINSTANCE instance_handle);
 
+    // Marks the start of a frame in the input, call before draining the messages for the frame
+    void begin_input_frame();
+
     bool should_continue = true;
     HINSTANCE instance_handle = nullptr;
     HWND window_handle = nullptr;
+    InputState input;                   // Built from the window's messages, main window only
+    InputRecorder* recorder = nullptr;  // Gets a copy of every event when set
+    uint32_t input_frame = 0;
 };
 
 struct StateSingleton {
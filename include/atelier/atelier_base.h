@@ -2,6 +2,10 @@
  * @brief Basic functionality like a logger and stuff
  */
 #pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 
 namespace Atelier
 {
@@ -15,9 +19,47 @@ static constexpr result k_success = 0;
 struct Log {
     static void init();
     static void shutdown();
+
+    // Sends every message to the file instead of stdout, null goes back to stdout
+    static void redirect(FILE* output);
+
     static void unformatted(const char* const msg);
     static void info(const char* const msg, ...);
     static void warn(const char* const msg, ...);
     static void error(const char* const msg, ...);
 };
+
+// Finalizer from murmur3, spreads the bits of a 64 bit word so that it can be used as a hash
+inline uint64_t hash_mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+// Folds a value into an existing hash, order dependent
+inline uint64_t hash_combine(uint64_t seed, uint64_t value)
+{
+    return hash_mix(seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2)));
+}
+
+// Hashes a blob of bytes 8 at a time. Not cryptographic, but good enough to content address shaders and states
+inline uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 0)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint64_t h = hash_mix(seed ^ (size * 0x9e3779b97f4a7c15ull));
+    for (; size >= 8; size -= 8, p += 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        h = hash_combine(h, word);
+    }
+
+    // Pack the remaining tail bytes into one last word
+    uint64_t tail = 0;
+    for (size_t i = 0; i < size; i++) tail |= uint64_t(p[i]) << (8 * i);
+    return hash_combine(h, tail);
+}
 }  // namespace Atelier
@@ -0,0 +1,86 @@
+/**
+ * @brief Bounding volume hierarchy for deciding what to draw on the CPU. Nodes have four children with their
+ * bounds stored lane by lane, so one SIMD test against the frustum covers a whole node. Objects are reordered at
+ * build time so every subtree is one contiguous range, which lets a subtree entirely inside the frustum be
+ * emitted without testing anything under it
+ */
+#pragma once
+#include "atelier_base.h"
+
+#include <vector>
+
+namespace Atelier
+{
+
+struct JobSystem;
+
+struct Aabb {
+    float min[3];
+    float max[3];
+};
+
+struct Bvh {
+    static constexpr uint32_t k_none = ~0u;
+    static constexpr uint32_t k_leaf_size = 8;  // Objects below which a child stops being split
+    static constexpr uint32_t k_bins = 16;      // SAH candidates per split
+
+    struct alignas(16) Node {
+        float m_min_x[4], m_min_y[4], m_min_z[4];
+        float m_max_x[4], m_max_y[4], m_max_z[4];
+        uint32_t m_child[4];  // Node index of inner children
+        uint32_t m_first[4];  // First slot of the child's subtree
+        uint32_t m_count[4];  // Objects in the child's subtree
+        uint32_t m_parent;
+        uint8_t m_lanes;      // Children in use, always the first ones
+        uint8_t m_leaf_mask;  // Children whose objects are tested directly
+    };
+
+    Bvh() = default;
+    std::vector<Node> m_nodes;  // Parents always come before their children
+
+    // Object bounds by slot, in subtree order
+    std::vector<float> m_min_x, m_min_y, m_min_z;
+    std::vector<float> m_max_x, m_max_y, m_max_z;
+    std::vector<uint32_t> m_object;  // Object in each slot
+
+    // Per object
+    std::vector<uint32_t> m_slot_of;
+    std::vector<uint32_t> m_leaf_of;  // Node holding the object
+
+    std::vector<uint8_t> m_node_dirty;
+    bool m_refit_pending = false;
+
+    // Reused between culls so that a frame doesn't allocate
+    std::vector<uint32_t> m_tasks;
+    std::vector<std::vector<uint32_t>> m_task_visible;
+
+    // Counters from the last cull
+    uint32_t m_visible = 0;
+    uint64_t m_nodes_tested = 0;
+    uint64_t m_objects_tested = 0;
+
+    // Builds the tree over count objects from scratch, splitting by the surface area heuristic
+    void build(const Aabb* bounds, uint32_t count);
+
+    // Moves one object. The tree isn't correct for it until the next refit()
+    void set_bounds(uint32_t object, const Aabb& bounds);
+
+    // Grows and shrinks the nodes above everything moved since the last refit, keeping the same structure. Cheap,
+    // but the tree gets looser the further objects travel from where they were built, so rebuild now and then
+    void refit();
+
+    // Collects every object whose bounds touch the frustum into visible, splitting the tree across the jobs when
+    // given. Planes are ax + by + cz + d >= 0 inside, as made by VkGpuCuller::extract_frustum()
+    void cull(const float planes[6][4], std::vector<uint32_t>& visible, JobSystem* jobs = nullptr);
+
+    // Sum of node surface areas weighted by the objects under them, lower is a tighter tree
+    float sah_cost() const;
+
+    uint32_t object_count() const { return uint32_t(m_object.size()); }
+
+    // Runs one traversal from a task, appending what's visible
+    void cull_task(uint32_t task, const float planes[6][4], std::vector<uint32_t>& visible, uint64_t& nodes,
+                   uint64_t& objects) const;
+};
+
+}  // namespace Atelier
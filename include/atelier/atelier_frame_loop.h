@@ -0,0 +1,94 @@
+/**
+ * @brief The application's frame, kept out of the platform entry point so the windowed application and the replay
+ * tool draw exactly the same thing. The caller owns the windows and their swapchains and pumps the input, the loop
+ * records every window into one submit and one present, paces it and keeps the HUD's stats
+ */
+#pragma once
+#include "atelier_base.h"
+#include "atelier_frame_pacer.h"
+#include "atelier_input.h"
+#include "atelier_jobs.h"
+#include "atelier_vk_bundle.h"
+#include "atelier_vk_capture.h"
+#include "atelier_vk_completed.h"
+#include "atelier_vk_dynamic_resolution.h"
+#include "atelier_vk_memory.h"
+#include "atelier_vk_overlay.h"
+#include "atelier_vk_present.h"
+#include "atelier_vk_shader.h"
+#include "atelier_vk_submit.h"
+
+#include <deque>
+#include <vector>
+
+namespace Atelier
+{
+
+struct FrameLoop {
+    struct Config {
+        double m_target_fps = 60.0;  // Zero runs uncapped
+        bool m_capture = false;      // Reads the main window back every frame and encodes it into captures/
+        bool m_dynamic_resolution = true;
+    };
+
+    /**
+     * @brief Everything one window needs to be drawn into. The first viewport is the main window
+     */
+    struct Viewport {
+        VkCompletedSwapchain* m_swap = nullptr;  // Null while detached
+        VkRenderPass m_render_pass = VK_NULL_HANDLE;
+        VkRenderPass m_overlay_pass = VK_NULL_HANDLE;  // Draws over what the background left, main window only
+        std::vector<VkFramebuffer> m_framebuffers;
+        uint32_t m_target = 0;
+        VkCommandBundle m_background;      // The clear, recorded once per swapchain image
+        uint64_t m_background_key = 0;     // Everything but the render scale
+        VkDynamicResolution m_resolution;  // Main window only, scales the background's pass
+        bool m_scaled = false;
+    };
+
+    FrameLoop() = default;
+    Config m_config;
+    VkCompletedDevice* m_device = nullptr;
+    uint32_t m_family = 0;
+    VkQueue m_queue = VK_NULL_HANDLE;
+    VkMemoryTelemetry m_memory;
+    VkMultiPresenter m_presenter;
+    VkSubmitQueue m_submitter;
+    JobSystem m_jobs;
+    VkFrameCapture m_capture;
+    VkGpuScopes m_scopes;
+    PerfHud m_hud;
+    VkShaderRegistry m_shaders;
+    VkOverlay m_overlay;
+    FramePacer m_pacer;
+    std::deque<Viewport> m_viewports;  // The background recorders hold on to their viewport's address
+    bool m_capturing = false;
+    bool m_overlay_enabled = false;
+
+    // Carried from one frame to the next for the HUD
+    uint64_t m_last_frame_start = 0;
+    uint64_t m_last_gpu_sample = 0;
+    uint64_t m_pacing_delta_ns = 0;
+    uint64_t m_last_calls = 0;
+
+    // One swapchain per window, main window first. The swapchains are referenced by address until they're
+    // detached, and the graphics queue belongs to the submission thread once this returns
+    result init(VkCompletedDevice& device, uint32_t queue_family, VkQueue gfx_queue, VkQueue present_queue,
+                const std::vector<VkCompletedSwapchain*>& swaps, const Config& config);
+
+    // Logs the frame's stats and destroys everything but the swapchains, which can be destroyed afterwards
+    void shutdown();
+
+    // Sleeps until the latest moment the frame can start, sample the input straight after
+    uint64_t wait_for_frame() { return m_pacer.wait_for_frame(); }
+
+    // Records, submits and presents every attached window. The input is the main window's, which drives the HUD
+    result frame(const InputState& input);
+
+    // A resized window's swapchain is detached before it's rebuilt and attached again afterwards. Detaching waits
+    // for the device to go idle
+    result attach(uint32_t viewport, VkCompletedSwapchain& swap);
+    void detach(uint32_t viewport);
+};
+
+}  // namespace Atelier
@@ -0,0 +1,96 @@
+/**
+ * @brief Paces frames to a target interval by sleeping instead of spinning or blocking in present. The CPU and GPU
+ * cost of a frame is predicted from recent history, and the wait ends as late as possible while still leaving
+ * room for that cost before the frame's deadline. Input sampled straight after the wait is as fresh as it can be
+ */
+#pragma once
+#include "atelier_base.h"
+
+#include <mutex>
+
+namespace Atelier
+{
+
+// Monotonic nanoseconds on the same clock the pacer sleeps against
+uint64_t pacer_now_ns();
+
+/**
+ * @brief Running mean and variance over recent samples, weighted towards the newest
+ */
+struct FramePredictor {
+    double m_mean = 0.0;
+    double m_variance = 0.0;
+    bool m_primed = false;
+
+    void add(double sample);
+
+    // Mean plus two standard deviations, so most frames fit inside the prediction
+    double predict() const;
+};
+
+/**
+ * @brief Single threaded, call wait_for_frame then end_cpu around the frame's work and feed in GPU times when the
+ * timestamps come back. With a render thread the pacing thread still calls wait_for_frame and end_cpu around its
+ * own work, and the render thread adds its share through report_render_cpu. The report functions and stats can be
+ * called from any thread
+ */
+struct FramePacer {
+    static constexpr uint32_t k_history = 128;
+
+    struct Stats {
+        double m_target_ms = 0.0;
+        double m_interval_mean_ms = 0.0;
+        double m_interval_variance_ms2 = 0.0;
+        double m_interval_stddev_ms = 0.0;
+        double m_interval_p99_ms = 0.0;
+        double m_cpu_predicted_ms = 0.0;
+        double m_render_predicted_ms = 0.0;
+        double m_gpu_predicted_ms = 0.0;
+        double m_sleep_mean_ms = 0.0;
+        uint64_t m_frames = 0;
+        uint64_t m_missed = 0;  // Frames which started too late to make their deadline
+    };
+
+    FramePacer() = default;
+    uint64_t m_interval_ns = 0;     // Zero leaves the frame rate uncapped and only measures
+    uint64_t m_spin_ns = 200000;    // The end of every wait spins, which covers the timer's wake up slack
+    uint64_t m_margin_ns = 500000;  // Extra room left in front of the deadline on top of the prediction
+    uint64_t m_deadline = 0;
+    uint64_t m_frame_start = 0;
+    uint64_t m_frames = 0;
+    uint64_t m_missed = 0;
+    void* m_timer = nullptr;  // High resolution waitable timer on Windows
+
+    mutable std::mutex m_lock;  // Covers everything below, which the render thread reports into
+    FramePredictor m_cpu;
+    FramePredictor m_render;
+    FramePredictor m_gpu;
+    float m_intervals_ms[k_history] = {};
+    float m_sleeps_ms[k_history] = {};
+    uint32_t m_history_count = 0;
+
+    // A target of zero hz leaves the frame rate uncapped
+    result init(double target_hz);
+    void shutdown();
+    void set_target_hz(double target_hz);
+
+    // Sleeps until the latest moment this frame can start and still make its deadline, then returns that time.
+    // Sample input straight after this
+    uint64_t wait_for_frame();
+
+    // Sleeps until the given pacer_now_ns time on the same timer and spin as the frame wait
+    void wait_until(uint64_t wake_ns) const;
+
+    // The pacing thread's work for the frame is done, usually straight after submit
+    void end_cpu();
+
+    // Time the render thread spent on the frame, when it's split off from the pacing thread
+    void report_render_cpu(uint64_t render_ns);
+
+    // GPU time of a finished frame
+    void report_gpu(uint64_t gpu_ns);
+
+    Stats stats() const;
+};
+
+}  // namespace Atelier
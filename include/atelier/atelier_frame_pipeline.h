@@ -0,0 +1,129 @@
+/**
+ * @brief Splits a frame into an update stage and a render stage on their own threads, so the update for frame N+1
+ * runs while frame N is being recorded and frame N-1 is still on the GPU. The stages only share frame snapshots,
+ * which the update writes once and the render only reads, and hand them over through a pair of counters rather
+ * than a lock. The depth is how many snapshots can be in the pipe at once, each one adds a frame of latency
+ */
+#pragma once
+#include "atelier_base.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace Atelier
+{
+
+/**
+ * @brief Single producer, single consumer ring of slot indices. Frame N always lives in slot N % depth, so the
+ * only thing crossing threads is how many frames have been published and how many released. A side only parks
+ * on the condition variable after spinning for a while, the lock is never touched while the pipe keeps moving
+ */
+struct FrameHandoff {
+    static constexpr uint32_t k_max_depth = 3;
+    static constexpr uint32_t k_spins = 2048;  // Polls before a waiting side goes to sleep
+
+    FrameHandoff() = default;
+    uint32_t m_depth = 2;
+    alignas(64) std::atomic<uint64_t> m_published{0};  // Frames the producer has finished writing
+    alignas(64) std::atomic<uint64_t> m_released{0};   // Frames the consumer has finished reading
+    alignas(64) uint64_t m_write_frame = 0;            // Only touched by the producer
+    alignas(64) uint64_t m_read_frame = 0;             // Only touched by the consumer
+    std::atomic<uint32_t> m_sleepers{0};
+    std::atomic<bool> m_closed{false};
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+
+    // Depth is clamped to [1, k_max_depth]. Not thread safe, call it before either side starts
+    void reset(uint32_t depth);
+
+    // Blocks until the next frame's slot has been released by the consumer, negative once closed
+    int32_t acquire_write();
+    void publish();
+
+    // Blocks until the next frame has been published, negative once closed and drained
+    int32_t acquire_read();
+    void release();
+
+    // Wakes both sides, the consumer still gets whatever was published before this
+    void close();
+
+    // The frame the producer or consumer will move on to next
+    uint64_t write_frame() const { return m_write_frame; }
+    uint64_t read_frame() const { return m_read_frame; }
+
+    // Spins then sleeps until ready() is true, returns false when closed first
+    template <typename Ready>
+    bool wait(Ready ready);
+    void notify();
+};
+
+/**
+ * @brief The update thread and the snapshots it fills. The update callback gets the slot to write and the frame
+ * number, anything it needs from the previous frame has to live outside the snapshot because the slot it gets
+ * is the oldest one. The render side calls begin_render and end_render around each frame on its own thread
+ */
+template <typename Snapshot>
+struct FramePipeline {
+    using UpdateFunc = std::function<void(Snapshot& out, uint64_t frame)>;
+
+    FramePipeline() = default;
+    FrameHandoff m_handoff;
+    Snapshot m_snapshots[FrameHandoff::k_max_depth];
+    UpdateFunc m_update;
+    std::thread m_thread;
+
+    // Starts updating straight away, up to depth frames ahead of the renderer
+    result init(uint32_t depth, UpdateFunc update)
+    {
+        if (!update) return -1;
+        m_handoff.reset(depth);
+        m_update = std::move(update);
+        m_thread = std::thread([this]() {
+            for (;;) {
+                int32_t slot = m_handoff.acquire_write();
+                if (slot < 0) return;
+                m_update(m_snapshots[slot], m_handoff.write_frame());
+                m_handoff.publish();
+            }
+        });
+        return k_success;
+    }
+
+    // Stops the update thread after the frame it's on, snapshots which were never rendered are dropped
+    void shutdown()
+    {
+        m_handoff.close();
+        if (m_thread.joinable()) m_thread.join();
+    }
+
+    // The oldest unrendered snapshot, null once shut down. It stays valid and unchanged until end_render
+    const Snapshot* begin_render()
+    {
+        int32_t slot = m_handoff.acquire_read();
+        return slot < 0 ? nullptr : &m_snapshots[slot];
+    }
+
+    // Hands the snapshot back so the update thread can reuse its slot
+    void end_render() { m_handoff.release(); }
+
+    uint32_t depth() const { return m_handoff.m_depth; }
+};
+
+template <typename Ready>
+bool FrameHandoff::wait(Ready ready)
+{
+    for (uint32_t i = 0; i < k_spins; i++) {
+        if (ready()) return true;
+        if (m_closed.load(std::memory_order_acquire)) return false;
+    }
+    std::unique_lock<std::mutex> guard(m_lock);
+    m_sleepers.fetch_add(1, std::memory_order_seq_cst);
+    m_wake.wait(guard, [&]() { return ready() || m_closed.load(std::memory_order_acquire); });
+    m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+    return ready();
+}
+
+}  // namespace Atelier
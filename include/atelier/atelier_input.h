@@ -0,0 +1,121 @@
+/**
+ * @brief Window and input events in a form that can be recorded and played back. The window procedure turns its
+ * messages into InputEvents, the frame loop reads the InputState they build up, and a recording is just the events
+ * in the order they were delivered with a marker at the start of every frame. Replaying applies the same events
+ * before the same frames, so two builds see identical input however fast either of them runs
+ */
+#pragma once
+#include "atelier_base.h"
+#include "atelier_frame_pacer.h"
+#include "atelier_io.h"
+
+#include <vector>
+
+namespace Atelier
+{
+
+enum class InputEventType : uint32_t {
+    k_frame = 0,     // Start of a frame, every event after it up to the next one belongs to that frame
+    k_resize,        // m_x by m_y client area, zero when minimized
+    k_mouse_move,    // m_x, m_y in client pixels
+    k_mouse_button,  // m_code is 0 left, 1 right, 2 middle
+    k_wheel,         // m_y in multiples of 120 per notch
+    k_key,           // m_code is the virtual key
+    k_char,          // m_code is the UTF-16 unit
+    k_focus,
+    k_close,
+};
+
+struct InputEvent {
+    uint64_t m_time_ns = 0;  // From the start of the recording, or the clock when live
+    InputEventType m_type = InputEventType::k_frame;
+    uint32_t m_code = 0;
+    int32_t m_x = 0;
+    int32_t m_y = 0;
+    uint32_t m_down = 0;   // Buttons, keys and focus
+    uint32_t m_frame = 0;  // Frame it was delivered in
+};
+static_assert(sizeof(InputEvent) == 32, "InputEvent is written to recordings as is");
+
+/**
+ * @brief What the frame loop reads, built up from events whether they came from the window or a recording
+ */
+struct InputState {
+    InputState() = default;
+    uint32_t m_frame = 0;
+    uint64_t m_time_ns = 0;
+    uint64_t m_delta_ns = 0;  // Since the previous frame started, zero for the first
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    int32_t m_mouse_x = 0;
+    int32_t m_mouse_y = 0;
+    uint32_t m_buttons = 0;  // Bit per button
+    int32_t m_wheel = 0;     // This frame's scrolling, cleared by the next frame
+    bool m_focused = true;
+    bool m_resized = false;  // The size changed this frame
+    bool m_close = false;
+    bool m_keys[256] = {};
+    std::vector<uint32_t> m_chars;  // Typed this frame
+
+    void apply(const InputEvent& event);
+
+    bool key_down(uint32_t key) const { return key < 256 && m_keys[key]; }
+    bool button_down(uint32_t button) const { return (m_buttons >> button) & 1; }
+};
+
+/**
+ * @brief Keeps every event in memory and writes them out at the end, a long session is a few megabytes
+ */
+struct InputRecorder {
+    static constexpr uint32_t k_magic = 0x504E4941;  // "AINP" read little endian
+    static constexpr uint32_t k_version = 1;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t event_size;
+        uint32_t frame_count;
+        uint64_t event_count;
+        uint64_t duration_ns;
+    };
+
+    InputRecorder() = default;
+    std::vector<InputEvent> m_events;
+    uint64_t m_start_ns = 0;
+    uint32_t m_frames = 0;
+    bool m_recording = false;
+
+    // Starts the clock and records the window's current size, so a replay starts from the same extent
+    void begin(uint32_t width, uint32_t height);
+
+    // Rebases the event's time on the start of the recording and stores it
+    void record(InputEvent event);
+
+    result write(const char* path) const;
+};
+
+/**
+ * @brief Plays a recording back one frame at a time. Paced replays wait until each frame's recorded start, fast
+ * ones hand out frames as quickly as they're asked for
+ */
+struct InputReplay {
+    InputReplay() = default;
+    MappedFile m_file;
+    const InputRecorder::Header* m_header = nullptr;
+    const InputEvent* m_events = nullptr;
+    uint64_t m_next = 0;
+    bool m_paced = true;
+    uint64_t m_start_ns = 0;              // Clock time the first frame was handed out
+    const FramePacer* m_pacer = nullptr;  // Paced frames wait on its timer, a default one without it
+
+    // Maps the recording and checks it holds what the header says
+    result open(const char* path);
+    void close();
+
+    // Applies the events up to and including the next frame's, false once there are no frames left
+    bool next_frame(InputState& state);
+
+    uint32_t frame_count() const { return m_header != nullptr ? m_header->frame_count : 0; }
+};
+
+}  // namespace Atelier
@@ -0,0 +1,43 @@
+/**
+ * @brief File access helpers. Anything which is read in bulk at startup (shaders, textures, meshes) should come
+ * through a mapped file so that we don't pay for an extra copy into a heap buffer
+ */
+#pragma once
+#include "atelier_base.h"
+
+namespace Atelier
+{
+
+/**
+ * @brief Read only view of a whole file mapped into the address space. The OS pages the content in on first
+ * touch, so opening a large file is cheap and the bytes can be handed straight to Vulkan or copied into staging
+ */
+struct MappedFile {
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+
+    // Platform handles, a file and mapping handle on win32 or just the descriptor on posix
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+
+    // Maps the entire file at the path, an empty file is a successful mapping with no data
+    result open(const char* path);
+
+    // Unmaps the view and releases the handles, safe to call on a file that isn't open
+    void close();
+
+    bool is_open() const { return m_file != nullptr; }
+};
+
+// Writes 8 bit RGBA pixels as a PNG. The deflate stream uses stored blocks only, so encoding runs at about memcpy
+// speed at the cost of file size, which is the right trade for capturing every frame
+result write_png(const char* path, const uint8_t* rgba, uint32_t width, uint32_t height, size_t row_stride);
+
+}  // namespace Atelier
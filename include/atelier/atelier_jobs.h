@@ -0,0 +1,53 @@
+/**
+ * @brief A small pool of worker threads. Anything which shouldn't run on the render thread (pipeline compiles,
+ * encoding, IO) gets pushed in here. It's a single locked queue, which is fine for the handful of coarse jobs we
+ * throw at it, parallel_for is there for when the work should be split evenly across every core
+ */
+#pragma once
+#include "atelier_base.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Atelier
+{
+
+struct JobSystem {
+    using Job = std::function<void()>;
+
+    JobSystem() = default;
+    std::vector<std::thread> m_workers;
+    std::deque<Job> m_queue;
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    uint32_t m_active = 0;
+    bool m_stopping = false;
+
+    // Starts the workers, zero picks one less than the number of hardware threads so the caller keeps a core
+    result init(uint32_t worker_count = 0);
+
+    // Finishes everything that is already queued and then joins the workers
+    void shutdown();
+
+    // Queues a job to be run on any of the workers
+    void push(Job job);
+
+    // Blocks until the queue is empty and no worker is running a job
+    void wait_idle();
+
+    // Splits [0, count) into grain sized ranges and runs them across the workers and the calling thread. Returns
+    // once every range has finished, so it's safe to call from inside a job
+    void parallel_for(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& fn);
+
+    uint32_t worker_count() const { return static_cast<uint32_t>(m_workers.size()); }
+
+    // The loop every worker thread runs
+    void worker_main();
+};
+
+}  // namespace Atelier
@@ -0,0 +1,143 @@
+/**
+ * @brief Geometry import. glTF files are parsed once, with every primitive decoded and optimized in parallel, and
+ * cooked into a flat file of offsets which is mapped at runtime and copied straight into staging. Loading a cooked
+ * scene costs the I/O and one memcpy, nothing is parsed or fixed up
+ */
+#pragma once
+#include "atelier_base.h"
+#include "atelier_io.h"
+#include "atelier_vk_completed.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Atelier
+{
+
+struct JobSystem;
+
+// The one vertex layout everything is cooked into
+struct MeshVertex {
+    float m_position[3];
+    float m_normal[3];
+    float m_uv[2];
+};
+static_assert(sizeof(MeshVertex) == 32, "Cooked vertices are copied as is, the layout can't have padding");
+
+/**
+ * @brief One triangle list with its own vertices, what a glTF primitive imports as
+ */
+struct ImportedMesh {
+    std::string m_name;
+    std::vector<MeshVertex> m_vertices;
+    std::vector<uint32_t> m_indices;
+    float m_min[3] = {0.0f, 0.0f, 0.0f};
+    float m_max[3] = {0.0f, 0.0f, 0.0f};
+};
+
+// Reorders triangles so neighbouring ones share vertices, using Forsyth's scoring against a simulated LRU cache
+void optimize_vertex_cache(uint32_t* indices, size_t index_count, uint32_t vertex_count);
+
+// Reorders vertices into the order the indices first use them, so fetches walk memory forwards
+void optimize_vertex_fetch(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices);
+
+// Average vertex shader invocations per triangle with a FIFO cache of the given size, 0.5 is ideal and 3 is worst
+double average_cache_miss_ratio(const uint32_t* indices, size_t index_count, uint32_t cache_size = 16);
+
+/**
+ * @brief Loads .gltf files with their .bin buffers or data URIs, and binary .glb files. Only triangle list
+ * primitives are imported, missing normals are generated and missing texture coordinates are zero
+ */
+struct GltfImporter {
+    GltfImporter() = default;
+    JobSystem* m_jobs = nullptr;  // Primitives are decoded across the workers when set
+    bool m_optimize = true;       // Run the vertex cache and fetch optimizations on every primitive
+    std::vector<ImportedMesh> m_meshes;
+
+    // Timings of the last import, for the cook tool and benchmarks
+    double m_parse_ms = 0.0;
+    double m_decode_ms = 0.0;
+
+    // Replaces m_meshes with every primitive of every mesh in the file
+    result import(const char* path);
+};
+
+/**
+ * @brief The cooked mesh file. It's laid out as
+ *      Header
+ *      Mesh[mesh_count]
+ *      String table
+ *      Vertices, every mesh back to back
+ *      Indices, every mesh back to back and relative to the mesh's first vertex
+ *
+ * Vertices and indices sit next to each other so the whole geometry is a single range of the file
+ */
+struct CookedMeshFile {
+    static constexpr uint32_t k_magic = 0x48534D41;  // "AMSH" read little endian
+    static constexpr uint32_t k_version = 1;
+    static constexpr uint32_t k_data_alignment = 16;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t mesh_count;
+        uint32_t vertex_stride;
+        uint64_t vertex_offset;
+        uint64_t vertex_bytes;
+        uint64_t index_offset;
+        uint64_t index_bytes;
+        uint64_t string_table_offset;
+        uint32_t string_table_size;
+        uint32_t reserved;
+    };
+
+    struct Mesh {
+        uint32_t first_vertex;
+        uint32_t vertex_count;
+        uint32_t first_index;
+        uint32_t index_count;
+        float min[3];
+        float max[3];
+        uint32_t name_offset;
+        uint32_t reserved;
+    };
+
+    CookedMeshFile() = default;
+    MappedFile m_file;
+    const Header* m_header = nullptr;
+    const Mesh* m_meshes = nullptr;
+    const char* m_strings = nullptr;
+    std::unordered_map<std::string, uint32_t> m_name_lookup;
+
+    // Maps the file and validates every range, and that every index stays inside its mesh. The vertices aren't
+    // touched
+    result open(const char* path);
+    void close();
+
+    uint32_t mesh_count() const { return m_header != nullptr ? m_header->mesh_count : 0; }
+    const char* name(const Mesh& mesh) const { return m_strings + mesh.name_offset; }
+
+    // Finds a mesh by the name it was cooked with, null when not present
+    const Mesh* find(const char* name) const;
+
+    // Pointers to the geometry inside the mapping
+    const MeshVertex* vertices() const
+    {
+        return reinterpret_cast<const MeshVertex*>(m_file.m_data + m_header->vertex_offset);
+    }
+    const uint32_t* indices() const
+    {
+        return reinterpret_cast<const uint32_t*>(m_file.m_data + m_header->index_offset);
+    }
+
+    // Copies the vertices and indices into new device local buffers through a staging buffer, or directly when
+    // the buffers are host visible. Blocks until the copy is done
+    result upload(VkCompletedDevice& device, uint32_t queue_family, VkQueue queue, VkCompletedBuffer& vertices,
+                  VkCompletedBuffer& indices) const;
+
+    // Cooks the meshes into a new file
+    static result write(const char* path, const std::vector<ImportedMesh>& meshes);
+};
+
+}  // namespace Atelier
@@ -0,0 +1,56 @@
+/**
+ * @brief Pixel format conversion. Every kernel exists as a scalar reference plus SSE2, AVX2 and NEON versions
+ * where they help, and the best set for the running CPU is picked once at startup. All 8 bit four channel kernels
+ * treat the channels as RGBA, the byte order only matters to swizzle_rb. Results match the scalar set exactly
+ * apart from NaN payloads in the half conversions
+ */
+#pragma once
+#include "atelier_base.h"
+
+namespace Atelier
+{
+
+enum class PixelIsa : uint32_t { k_scalar, k_sse2, k_avx2, k_neon };
+
+struct PixelKernels {
+    const char* name;
+    PixelIsa isa;
+
+    // Swaps the first and third channel of four channel 8 bit pixels, RGBA <-> BGRA. dst may equal src
+    void (*swizzle_rb)(uint8_t* dst, const uint8_t* src, size_t pixel_count);
+
+    // Expands three channel pixels to four, filling in a constant alpha
+    void (*rgb_to_rgba)(uint8_t* dst, const uint8_t* src, size_t pixel_count, uint8_t alpha);
+
+    // Drops the fourth channel
+    void (*rgba_to_rgb)(uint8_t* dst, const uint8_t* src, size_t pixel_count);
+
+    // Decodes sRGB encoded RGBA8 to linear RGBA32F, alpha is already linear and is only normalized
+    void (*srgb_to_linear)(float* dst, const uint8_t* src, size_t pixel_count);
+
+    // Encodes linear RGBA32F to sRGB RGBA8, clamping to [0, 1]. Within one step of the exact rounding
+    void (*linear_to_srgb)(uint8_t* dst, const float* src, size_t pixel_count);
+
+    // Multiplies the colour channels of RGBA8 by alpha with correct rounding. dst may equal src
+    void (*premultiply)(uint8_t* dst, const uint8_t* src, size_t pixel_count);
+
+    // IEEE half conversions, round to nearest even on the way down
+    void (*float_to_half)(uint16_t* dst, const float* src, size_t count);
+    void (*half_to_float)(float* dst, const uint16_t* src, size_t count);
+
+    // 2x2 box filter of RGBA8 into the next mip level, the result is max(1, width / 2) by max(1, height / 2)
+    void (*downsample_2x2)(uint8_t* dst, size_t dst_stride, const uint8_t* src, size_t src_stride, uint32_t width,
+                           uint32_t height);
+};
+
+// Whether the kernels for the ISA were compiled in and the CPU can run them
+bool pixel_isa_supported(PixelIsa isa);
+
+// The fastest kernel set for this CPU, chosen on first use
+const PixelKernels& pixel_kernels();
+
+// A specific kernel set, the scalar set is the reference the others are checked against. Falls back to the
+// scalar kernels when the ISA isn't supported
+const PixelKernels& pixel_kernels(PixelIsa isa);
+
+}  // namespace Atelier
@@ -0,0 +1,123 @@
+/**
+ * @brief Transform hierarchy. Every component of a node lives in its own array, and nodes are kept sorted by depth
+ * so each level of the tree is one contiguous range with every parent ahead of its children. An update walks the
+ * levels in order with each level split across the job system, only recomputes nodes under something that moved,
+ * and writes world matrices straight into the mapped instance buffer the renderer reads
+ */
+#pragma once
+#include "atelier_base.h"
+#include "atelier_vk_completed.h"
+
+#include <atomic>
+#include <vector>
+
+namespace Atelier
+{
+
+struct JobSystem;
+
+// Column major, so columns are contiguous and the translation is in m[12..14]
+struct alignas(16) Mat4 {
+    float m[16];
+};
+
+/**
+ * @brief Somewhere for world matrices to go, indexed by each node's instance. Usually a persistently mapped
+ * buffer with one of these per frame in flight
+ */
+struct InstanceTarget {
+    Mat4* m_data = nullptr;
+    uint32_t m_capacity = 0;
+    uint64_t m_written = 0;  // Scene serial it was last brought up to date at, zero before the first update
+};
+
+struct SceneGraph {
+    static constexpr uint32_t k_none = ~0u;
+    static constexpr uint32_t k_chunk = 256;  // Nodes handed to a worker at a time
+
+    SceneGraph() = default;
+
+    // Per slot, slots are reordered whenever the hierarchy changes so ids are what callers hold on to
+    std::vector<float> m_position_x, m_position_y, m_position_z;
+    std::vector<float> m_rotation_x, m_rotation_y, m_rotation_z, m_rotation_w;
+    std::vector<float> m_scale_x, m_scale_y, m_scale_z;
+    std::vector<Mat4> m_world;
+    std::vector<uint32_t> m_parent;    // Slot of the parent, k_none for roots
+    std::vector<uint32_t> m_instance;  // Where the world matrix is written in the target, k_none for none
+    std::vector<uint64_t> m_changed;   // Serial of the update which last changed the world matrix
+    std::vector<uint8_t> m_dirty;      // The local transform changed since the last update
+    std::vector<uint32_t> m_id;        // Id of the node in each slot
+    std::vector<uint32_t> m_levels;    // First slot of every depth, plus the end
+
+    // Per id
+    std::vector<uint32_t> m_slot;  // k_none once the node is removed
+    std::vector<uint32_t> m_id_parent;
+    std::vector<uint32_t> m_depth;
+    std::vector<uint32_t> m_free_ids;
+
+    uint64_t m_serial = 0;       // Of the last update
+    uint64_t m_last_change = 0;  // Newest serial anything changed at
+    bool m_any_dirty = false;
+    bool m_layout_dirty = false;
+
+    // Counters from the last update
+    uint32_t m_recomputed = 0;
+    uint32_t m_written = 0;
+    std::atomic<uint32_t> m_recomputed_count{0};  // Summed by the workers while an update runs
+    std::atomic<uint32_t> m_written_count{0};
+
+    // Adds a node with an identity transform under the parent, or as a root. Returns its id
+    uint32_t add(uint32_t parent = k_none, uint32_t instance = k_none);
+
+    // Removes the node and everything under it
+    void remove(uint32_t id);
+
+    // Setting anything on a node which doesn't exist is logged and ignored
+    void set_local(uint32_t id, const float position[3], const float rotation[4], const float scale[3]);
+    void set_position(uint32_t id, const float position[3]);
+    void set_instance(uint32_t id, uint32_t instance);
+
+    bool is_alive(uint32_t id) const { return id < m_slot.size() && m_slot[id] != k_none; }
+    uint32_t node_count() const { return uint32_t(m_id.size()); }
+    uint32_t depth_count() const { return m_levels.empty() ? 0 : uint32_t(m_levels.size() - 1); }
+
+    // World matrix as of the last update
+    const Mat4& world(uint32_t id) const { return m_world[m_slot[id]]; }
+
+    // Recomputes every world matrix under a changed node, level by level across the jobs when given. When there
+    // is a target, every instance whose world changed since the target was last written is copied into it
+    void update(JobSystem* jobs = nullptr, InstanceTarget* target = nullptr);
+
+    // Reorders the slots by depth with siblings together, runs inside update() after the hierarchy changes
+    void rebuild_levels();
+
+    // Recomputes and writes out the slots in [begin, end), which must all be on the same level
+    void update_range(uint32_t begin, uint32_t end, InstanceTarget* target);
+};
+
+/**
+ * @brief One host visible buffer of world matrices per frame in flight, preferring device local memory so the
+ * renderer reads them without a copy. Each frame's buffer only receives what changed since it was last used
+ */
+struct VkInstanceBuffers {
+    static constexpr uint32_t k_max_frames = 4;
+
+    VkInstanceBuffers() = default;
+    VkCompletedBuffer m_buffers[k_max_frames];
+    InstanceTarget m_targets[k_max_frames];
+    uint32_t m_frames = 0;
+    uint32_t m_capacity = 0;
+
+    result init(VkCompletedDevice& device, uint32_t capacity, uint32_t frames);
+    void shutdown();
+
+    // The target to update for the frame, the frame's fence must have been waited on
+    InstanceTarget* target(uint32_t frame) { return &m_targets[frame]; }
+
+    // Makes the frame's writes visible to the device, does nothing for coherent memory
+    void flush(uint32_t frame) const { m_buffers[frame].flush(0, m_buffers[frame].m_size); }
+
+    VkBuffer buffer(uint32_t frame) const { return m_buffers[frame].m_handle; }
+};
+
+}  // namespace Atelier
@@ -0,0 +1,113 @@
+/**
+ * @brief Coroutine tasks. A Task starts suspended and only runs once it's awaited or handed to a Reactor, so a
+ * load can be written top to bottom with co_await at every point it would otherwise block on a fence or a file.
+ * The Task owns the coroutine's frame, awaiting it runs it to the end and moves the result out
+ */
+#pragma once
+#include "atelier_base.h"
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace Atelier
+{
+
+template <typename T>
+struct Task;
+
+// Jumps straight back into whoever awaited the task, a task nobody awaited stays suspended at its end
+struct TaskFinal {
+    bool await_ready() const noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) const noexcept
+    {
+        std::coroutine_handle<> next = handle.promise().m_continuation;
+        return next ? next : std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+};
+
+struct TaskPromiseBase {
+    std::coroutine_handle<> m_continuation;
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    TaskFinal final_suspend() const noexcept { return {}; }
+
+    // Nothing in the engine throws, so an exception getting this far is a bug
+    void unhandled_exception() const noexcept { std::terminate(); }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+    std::optional<T> m_value;
+
+    Task<T> get_return_object();
+    template <typename U>
+    void return_value(U&& value)
+    {
+        m_value.emplace(std::forward<U>(value));
+    }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+    Task<void> get_return_object();
+    void return_void() const {}
+};
+
+template <typename T = void>
+struct Task {
+    using promise_type = TaskPromise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Task() = default;
+    explicit Task(Handle handle) : m_handle(handle) {}
+    ~Task()
+    {
+        if (m_handle) m_handle.destroy();
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, {})) {}
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other) {
+            if (m_handle) m_handle.destroy();
+            m_handle = std::exchange(other.m_handle, {});
+        }
+        return *this;
+    }
+
+    Handle m_handle;
+
+    bool valid() const { return bool(m_handle); }
+    bool done() const { return !m_handle || m_handle.done(); }
+
+    // Awaiting starts the task on the awaiting thread, and the awaiting coroutine carries on from the task's end
+    bool await_ready() const noexcept { return m_handle.done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) const noexcept
+    {
+        m_handle.promise().m_continuation = awaiting;
+        return m_handle;
+    }
+    T await_resume() const
+    {
+        if constexpr (!std::is_void_v<T>) return std::move(*m_handle.promise().m_value);
+    }
+};
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object()
+{
+    return Task<T>(Task<T>::Handle::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object()
+{
+    return Task<void>(Task<void>::Handle::from_promise(*this));
+}
+
+}  // namespace Atelier
@@ -0,0 +1,69 @@
+/**
+ * @brief Command bundles. Work which comes out the same every frame, like a background or static UI pass, is
+ * recorded once for each swapchain image and the same command buffer is submitted again until something it
+ * depends on changes. Changes are found by comparing a key the caller builds from whatever the recording used
+ */
+#pragma once
+#include "atelier_base.h"
+#include "atelier_vk_completed.h"
+
+#include <functional>
+#include <vector>
+
+namespace Atelier
+{
+
+struct VkCommandBundle {
+    // Records the work for one slot, usually a swapchain image index. Must not begin or end the command buffer
+    typedef std::function<void(VkCommandBuffer cmd, uint32_t slot)> Recorder;
+
+    struct Slot {
+        VkCommandBuffer m_cmd = VK_NULL_HANDLE;
+        uint64_t m_generation = 0;  // Generation it was recorded at, zero before the first recording
+        uint64_t m_serial = 0;      // Newest submit it went into
+    };
+
+    // Buffers replaced while the GPU could still be reading them, free again once their serial completes
+    struct Retired {
+        VkCommandBuffer m_cmd = VK_NULL_HANDLE;
+        uint64_t m_serial = 0;
+    };
+
+    VkCommandBundle() = default;
+    VkCompletedDevice* m_parent = nullptr;
+    VkCommandPool m_pool = VK_NULL_HANDLE;
+    Recorder m_recorder;
+    uint64_t m_generation = 1;
+    uint64_t m_key = 0;
+    std::vector<Slot> m_slots;
+    std::vector<Retired> m_retired;
+    std::vector<VkCommandBuffer> m_free;
+
+    // Counters for the HUD and benchmarks
+    uint64_t m_recordings = 0;
+    uint64_t m_replays = 0;
+
+    // One slot per swapchain image, every slot starts dirty
+    result init(VkCompletedDevice& device, uint32_t queue_family, uint32_t slots, Recorder recorder);
+
+    // The device must be idle
+    void shutdown();
+
+    // Marks every slot dirty, they're re-recorded the next time they're acquired
+    void invalidate() { m_generation++; }
+
+    // Invalidates when the key differs from the last one, cheap enough to call every frame
+    void set_key(uint64_t key);
+
+    // Changes the number of slots after the swapchain was recreated, and invalidates
+    void resize(uint32_t slots);
+
+    bool dirty(uint32_t slot) const { return m_slots[slot].m_generation != m_generation; }
+
+    // Returns the slot's command buffer for the submit with the given serial, recording it first when dirty.
+    // Buffers still in flight are retired rather than re-recorded, completed is the newest finished serial. Null
+    // when a buffer couldn't be allocated
+    VkCommandBuffer acquire(uint32_t slot, uint64_t serial, uint64_t completed);
+};
+
+}  // namespace Atelier
@@ -0,0 +1,68 @@
+/**
+ * @brief Frame capture without stalling. Each captured frame is copied into its own slot of a host visible ring
+ * inside the frame's command buffer, the slot is only looked at again once the frame is known to be finished, and
+ * the pixels are encoded to disk on the job system. When the ring is full frames are dropped, never waited for
+ */
+#pragma once
+#include "atelier_base.h"
+#include "atelier_jobs.h"
+#include "atelier_vk_completed.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace Atelier
+{
+
+struct VkFrameCapture {
+    enum class Encoding : uint32_t { k_raw, k_png };
+    enum class SlotState : uint32_t { k_free, k_recorded, k_encoding };
+
+    struct Slot {
+        VkCompletedBuffer m_buffer;
+        std::atomic<SlotState> m_state{SlotState::k_free};
+        uint64_t m_serial = 0;        // Submission serial of the frame that copied into this slot
+        uint64_t m_frame_number = 0;  // Sequential number of the capture, used for the file name
+        VkExtent2D m_extent = {};
+        VkFormat m_format = VK_FORMAT_UNDEFINED;
+    };
+
+    VkFrameCapture() = default;
+    VkCompletedDevice* m_parent = nullptr;
+    JobSystem* m_jobs = nullptr;
+    std::unique_ptr<Slot[]> m_slots;
+    uint32_t m_slot_count = 0;
+    uint32_t m_next_slot = 0;
+    VkDeviceSize m_slot_size = 0;
+    std::string m_directory;
+    Encoding m_encoding = Encoding::k_png;
+    uint64_t m_next_frame_number = 0;
+    std::atomic<uint32_t> m_dropped{0};
+    std::atomic<uint32_t> m_written{0};
+    std::atomic<uint32_t> m_encoding_in_flight{0};
+
+    // Creates slot_count readback buffers each big enough for an image of format and max_extent. A few more slots
+    // than frames in flight gives the encoders room to fall behind for a moment without dropping frames. Fails for
+    // formats of unknown texel size, and for PNG anything other than 8 bit RGBA or BGRA
+    result init(VkCompletedDevice& device, JobSystem& jobs, VkFormat format, VkExtent2D max_extent,
+                uint32_t slot_count, const char* directory, Encoding encoding = Encoding::k_png);
+
+    // Waits for any encodes in flight and frees the ring
+    void shutdown();
+
+    // Records the copy of a colour image into a free slot, transitioning it from and back to the given layout.
+    // Must be outside of a render pass. Returns false when every slot was busy, or the image doesn't fit a slot or
+    // can't be encoded, and the frame was dropped
+    bool record(VkCommandBuffer cmd, VkImage image, VkFormat format, VkExtent2D extent, VkImageLayout layout,
+                uint64_t serial);
+
+    // Hands every slot whose frame the GPU has completed to a worker for encoding. completed_serial is the
+    // newest serial whose submission is known to be finished, for example after waiting on its fence
+    void poll(uint64_t completed_serial);
+
+    // Encodes one slot to disk and frees it, runs on a worker
+    void encode(Slot& slot);
+};
+
+}  // namespace Atelier
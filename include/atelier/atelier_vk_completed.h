@@ -4,6 +4,7 @@
  */
 #pragma once
 #include "atelier_base.h"
+#include "atelier_vk_dispatch.h"
 #include "vulkan/vulkan_core.h"
 
 #include <string>
@@ -20,6 +21,7 @@ struct VkCompletedState {
     std::vector<struct VkCompletedInstance> m_instances;
     std::vector<struct VkCompletedDevice> m_devices;
     std::vector<struct VkCompletedWin32Surface> m_surfaces;
+    std::vector<struct VkCompletedHeadlessSurface> m_headless_surfaces;
 
     // Shuts down everything in the completed vulkan state
     result shutdown();
@@ -35,12 +37,16 @@ struct VkCompletedInstance {
     std::vector<struct VkCompletedPhysicalDevice> m_physical_devices;
     std::vector<std::string> m_enabled_extensions;
     std::vector<std::string> m_enabled_layers;
+    VkInstanceDispatch m_dispatch;
 
     // Shuts down this instance and all of the child vulkan objects inside the passed VkCompletedState
     void shutdown(VkCompletedState& vk);
 
     // Attempts to only initialize the instance put none of the child vulkan devices
     result init_from_mutable_instance(const struct VkMutableInstanceCreateInfo& info);
+
+    // Was the extension enabled when this instance was created
+    bool has_extension(const char* name) const;
 };
 
 struct VkCompletedPhysicalDevice {
@@ -48,6 +54,7 @@ struct VkCompletedPhysicalDevice {
     VkPhysicalDevice m_handle = VK_NULL_HANDLE;
     VkCompletedInstance* m_parent = nullptr;
     VkPhysicalDeviceProperties m_device_properties = {};
+    VkPhysicalDeviceMemoryProperties m_memory_properties = {};
 
     // Tries to shut down all of the logical devices and the resets the resources contained as a child
     void shutdown(VkCompletedState& vk);
@@ -57,6 +64,10 @@ struct VkCompletedPhysicalDevice {
 
     // Attempts to initialize the physical device, but not the logical device
     result init_from_mutable_device(const struct VkMutableDeviceCreateInfo& info);
+
+    // Finds a memory type allowed by the type bits which has all of the required properties. Returns negative when
+    // nothing matches
+    int32_t find_memory_type(uint32_t type_bits, VkMemoryPropertyFlags required) const;
 };
 
 struct VkCompletedDevice {
@@ -65,14 +76,20 @@ struct VkCompletedDevice {
     VkCompletedPhysicalDevice* m_physical = nullptr;
 
     std::vector<std::string> m_enabled_extensions;
+    VkPhysicalDeviceFeatures m_enabled_features = {};
     std::unordered_map<uint32_t, struct VkCompletedQueue> m_queues;
     std::vector<struct VkCompletedSwapchain> m_swaps;
+    struct VkMemoryTelemetry* m_memory = nullptr;  // Told about every allocation when attached
+    VkDeviceDispatch m_dispatch;                   // Hot entry points, straight into the driver
 
     // Shuts down all of the child vulkan objects in order
     void shutdown(VkCompletedState& vk);
 
     // Attempts to initialize the logical device from the provided info
     result init_from_mutable_device(const struct VkMutableDeviceCreateInfo& info);
+
+    // Was the extension enabled when this device was created
+    bool has_extension(const char* name) const;
 };
 
 /**
@@ -97,7 +114,7 @@ struct VkCompletedQueue {
  * @brief Base surface which is only used as an interface to other structs
  */
 struct VkCompletedSurface {
-    enum class Type : uint32_t { k_unknown, k_win32 };
+    enum class Type : uint32_t { k_unknown, k_win32, k_headless };
 
     VkCompletedSurface() = default;
     VkSurfaceKHR m_handle = VK_NULL_HANDLE;
@@ -120,6 +137,47 @@ struct VkCompletedWin32Surface : VkCompletedSurface {
                                    void* win32_window_handle);
 };
 
+/**
+ * @brief A surface with no window behind it from VK_EXT_headless_surface. Presents go nowhere, which is what we
+ * want for benchmarks and CI machines running a software driver
+ */
+struct VkCompletedHeadlessSurface : VkCompletedSurface {
+    VkCompletedHeadlessSurface() = default;
+
+    void shutdown(VkCompletedState& vk);
+
+    // Fails when the instance wasn't created with VK_EXT_headless_surface
+    result init_headless(struct VkCompletedInstance& inst);
+};
+
+/**
+ * @brief A buffer bound to its own allocation. Host visible buffers stay mapped for their whole lifetime, we never
+ * map and unmap per frame
+ */
+struct VkCompletedBuffer {
+    VkCompletedBuffer() = default;
+    VkBuffer m_handle = VK_NULL_HANDLE;
+    VkDeviceMemory m_memory = VK_NULL_HANDLE;
+    VkCompletedDevice* m_parent = nullptr;
+    VkDeviceSize m_size = 0;
+    VkMemoryPropertyFlags m_memory_flags = 0;
+    uint32_t m_memory_type = 0;
+    VkDeviceSize m_allocation_size = 0;
+    void* m_mapped = nullptr;
+
+    // Creates the buffer in a memory type with all the required flags, trying required | preferred first
+    result init(VkCompletedDevice& device, VkDeviceSize size, VkBufferUsageFlags usage,
+                VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0);
+
+    void shutdown();
+
+    // Makes host writes in the range visible to the device, does nothing for coherent memory
+    void flush(VkDeviceSize offset, VkDeviceSize size) const;
+
+    // Makes device writes in the range visible to the host, does nothing for coherent memory
+    void invalidate(VkDeviceSize offset, VkDeviceSize size) const;
+};
+
 struct VkCompletedSwapchain {
     struct CreateInfo {
         CreateInfo() = default;
@@ -132,6 +190,10 @@ struct VkCompletedSwapchain {
         std::vector<uint32_t> m_selected_queue_indicies;
         VkSurfaceCapabilitiesKHR m_surface_caps = {};  // Technically derived from surface but needs device handle
 
+        // Surfaces which don't dictate their size (headless ones for instance) get the fallback extent clamped to
+        // what the surface allows
+        result create_default(VkCompletedDevice& device, VkCompletedSurface& surf,
+                              VkExtent2D fallback_extent = {1280, 720});
         result create_default_from_win32(VkCompletedDevice& device, VkCompletedWin32Surface& surf);
     };
 
@@ -0,0 +1,160 @@
+/**
+ * @brief Per instance and per device tables of Vulkan entry points. The exported functions from the loader are
+ * trampolines which look up the real dispatch table on every call, the pointers here come straight from
+ * vkGetDeviceProcAddr so hot calls land in the driver directly. The lists below are X-macros, an entry point is
+ * added to a table by adding it to a list.
+ *
+ * Building with ATELIER_VK_INSTRUMENT defined swaps every device entry for a wrapper which counts its calls and
+ * records how long each one took into a histogram, so the overhead we pay the driver can be seen per frame
+ */
+#pragma once
+#include "atelier_base.h"
+#include "vulkan/vulkan_core.h"
+
+#ifdef ATELIER_VK_INSTRUMENT
+#include <atomic>
+#include <memory>
+#include <utility>
+#endif
+
+namespace Atelier
+{
+
+// Used per frame or whenever something is recreated, everything else goes through the loader as before
+#define ATELIER_VK_INSTANCE_FUNCTIONS(X)                                                                          \
+    X(vkGetPhysicalDeviceSurfaceSupportKHR)                                                                       \
+    X(vkGetPhysicalDeviceSurfaceCapabilitiesKHR)                                                                  \
+    X(vkGetPhysicalDeviceSurfaceFormatsKHR)                                                                       \
+    X(vkGetPhysicalDeviceSurfacePresentModesKHR)
+
+// Extension entry points are left null when the device doesn't have them
+#define ATELIER_VK_DEVICE_FUNCTIONS(X)                                                                            \
+    X(vkAcquireNextImageKHR)                                                                                      \
+    X(vkQueuePresentKHR)                                                                                          \
+    X(vkQueueSubmit)                                                                                              \
+    X(vkQueueSubmit2KHR)                                                                                          \
+    X(vkQueueWaitIdle)                                                                                            \
+    X(vkDeviceWaitIdle)                                                                                           \
+    X(vkWaitForFences)                                                                                            \
+    X(vkResetFences)                                                                                              \
+    X(vkGetFenceStatus)                                                                                           \
+    X(vkGetSemaphoreCounterValueKHR)                                                                              \
+    X(vkResetCommandPool)                                                                                         \
+    X(vkResetCommandBuffer)                                                                                       \
+    X(vkBeginCommandBuffer)                                                                                       \
+    X(vkEndCommandBuffer)                                                                                         \
+    X(vkGetQueryPoolResults)                                                                                      \
+    X(vkFlushMappedMemoryRanges)                                                                                  \
+    X(vkInvalidateMappedMemoryRanges)                                                                             \
+    X(vkCmdBeginRenderPass)                                                                                       \
+    X(vkCmdEndRenderPass)                                                                                         \
+    X(vkCmdBindPipeline)                                                                                          \
+    X(vkCmdBindDescriptorSets)                                                                                    \
+    X(vkCmdBindVertexBuffers)                                                                                     \
+    X(vkCmdBindIndexBuffer)                                                                                       \
+    X(vkCmdPushConstants)                                                                                         \
+    X(vkCmdSetViewport)                                                                                           \
+    X(vkCmdSetScissor)                                                                                            \
+    X(vkCmdDraw)                                                                                                  \
+    X(vkCmdDrawIndexed)                                                                                           \
+    X(vkCmdDrawIndexedIndirect)                                                                                   \
+    X(vkCmdDrawIndexedIndirectCountKHR)                                                                           \
+    X(vkCmdDispatch)                                                                                              \
+    X(vkCmdPipelineBarrier)                                                                                       \
+    X(vkCmdCopyBuffer)                                                                                            \
+    X(vkCmdCopyBufferToImage)                                                                                     \
+    X(vkCmdCopyImageToBuffer)                                                                                     \
+    X(vkCmdBlitImage)                                                                                             \
+    X(vkCmdFillBuffer)                                                                                            \
+    X(vkCmdResetQueryPool)                                                                                        \
+    X(vkCmdWriteTimestamp)
+
+struct VkInstanceDispatch {
+#define ATELIER_VK_ENTRY(name) PFN_##name name = nullptr;
+    ATELIER_VK_INSTANCE_FUNCTIONS(ATELIER_VK_ENTRY)
+#undef ATELIER_VK_ENTRY
+
+    // Fills every entry through vkGetInstanceProcAddr, fails if a core entry point is missing
+    result load(VkInstance instance);
+};
+
+#ifdef ATELIER_VK_INSTRUMENT
+/**
+ * @brief Calls and time spent in one entry point. Latencies go into power of two buckets from 64ns up, which is
+ * enough to tell a call that returned straight away from one which waited on the driver
+ */
+struct VkCallStats {
+    static constexpr uint32_t k_buckets = 16;
+
+    struct Snapshot {
+        uint64_t m_calls = 0;
+        uint64_t m_total_ns = 0;
+        uint64_t m_histogram[k_buckets] = {};
+
+        // Upper edge of the bucket holding the given fraction of the calls
+        uint64_t percentile_ns(double fraction) const;
+    };
+
+    const char* m_name = nullptr;
+    std::atomic<uint64_t> m_calls{0};
+    std::atomic<uint64_t> m_total_ns{0};
+    std::atomic<uint64_t> m_histogram[k_buckets] = {};
+    Snapshot m_frame;  // The last finished frame
+    Snapshot m_run;    // Every finished frame added together
+
+    void record(uint64_t ns);
+
+    // Moves what was recorded since the last call into m_frame and m_run
+    void end_frame();
+};
+
+uint64_t vk_dispatch_now_ns();
+
+// Stands in for a function pointer, timing every call made through it
+template <typename Pfn>
+struct VkTimedEntry {
+    Pfn m_fn = nullptr;
+    VkCallStats* m_stats = nullptr;
+
+    template <typename... Args>
+    auto operator()(Args&&... args) const -> decltype(std::declval<Pfn>()(std::forward<Args>(args)...))
+    {
+        struct Timer {
+            VkCallStats* m_stats;
+            uint64_t m_start;
+            ~Timer() { m_stats->record(vk_dispatch_now_ns() - m_start); }
+        } timer = {m_stats, vk_dispatch_now_ns()};
+        return m_fn(std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const { return m_fn != nullptr; }
+};
+#endif
+
+struct VkDeviceDispatch {
+#ifdef ATELIER_VK_INSTRUMENT
+#define ATELIER_VK_ENTRY(name) VkTimedEntry<PFN_##name> name;
+#else
+#define ATELIER_VK_ENTRY(name) PFN_##name name = nullptr;
+#endif
+    ATELIER_VK_DEVICE_FUNCTIONS(ATELIER_VK_ENTRY)
+#undef ATELIER_VK_ENTRY
+
+#ifdef ATELIER_VK_INSTRUMENT
+    // One per entry point in list order, on the heap so the wrappers can point into it when the device moves
+    std::unique_ptr<VkCallStats[]> m_stats;
+    uint32_t m_stats_count = 0;
+    uint64_t m_frames = 0;
+#endif
+
+    // Fills every entry through vkGetDeviceProcAddr, fails if a core entry point is missing
+    result load(PFN_vkGetDeviceProcAddr get_device_proc_addr, VkDevice device);
+
+    // Closes the per frame stats when instrumented, otherwise does nothing
+    void end_frame();
+
+    // Logs the entry points which took the most time, does nothing unless instrumented
+    void log_stats(uint32_t top) const;
+};
+
+}  // namespace Atelier
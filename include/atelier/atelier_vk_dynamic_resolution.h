@@ -0,0 +1,84 @@
+/**
+ * @brief Dynamic resolution. The scene is rendered into an offscreen target at a fraction of the swapchain's
+ * extent and blitted up to fill the swapchain image, so a heavy frame costs sharpness instead of a missed present.
+ * The target is created once at the largest extent it can be asked for, a new scale only changes the render area
+ */
+#pragma once
+#include "atelier_base.h"
+#include "atelier_frame_pacer.h"
+#include "atelier_vk_completed.h"
+
+namespace Atelier
+{
+
+/**
+ * @brief Picks the render scale from GPU frame times. GPU time is taken to grow with the pixel count, so the next
+ * scale is the one which would have brought the predicted time back under the target. It drops quickly and
+ * climbs slowly, and ignores the frames still in flight after every change since they were rendered at the old
+ * scale
+ */
+struct ResolutionController {
+    ResolutionController() = default;
+    uint64_t m_target_ns = 0;  // GPU time to hold, zero keeps the maximum scale
+    float m_min_scale = 0.5f;  // Of the output extent, along each axis
+    float m_max_scale = 1.0f;
+    float m_raise_below = 0.8f;  // Fraction of the target the prediction has to be under before scaling up
+    float m_max_drop = 0.15f;    // Largest change in one step
+    float m_max_raise = 0.05f;
+    float m_granularity = 1.0f / 64.0f;  // Scales are rounded to this, so tiny corrections don't churn
+    uint32_t m_settle_frames = 3;        // Samples skipped after a change, at least the frames in flight
+    uint32_t m_min_samples = 4;          // Samples at a scale before it can be changed again
+
+    float m_scale = 1.0f;
+    FramePredictor m_gpu;  // Only holds samples taken at the current scale
+    uint32_t m_settle = 0;
+    uint32_t m_samples = 0;
+    uint64_t m_changes = 0;
+
+    // Feeds the GPU time of a finished frame, returns true when the scale changed
+    bool update(uint64_t gpu_ns);
+
+    // The region of an output of this size the scene should render into, never smaller than one pixel
+    VkExtent2D render_extent(VkExtent2D output) const;
+};
+
+/**
+ * @brief The offscreen target and the render pass which draws into it. Begin and end the pass around the scene,
+ * then upscale into the swapchain image. The pass leaves the target ready to be read by the blit and waits for the
+ * previous blit before writing again, so one target covers every frame in flight
+ */
+struct VkDynamicResolution {
+    VkDynamicResolution() = default;
+    VkCompletedDevice* m_parent = nullptr;
+    VkFormat m_format = VK_FORMAT_UNDEFINED;
+    VkExtent2D m_max_extent = {};
+    VkImage m_image = VK_NULL_HANDLE;
+    VkDeviceMemory m_memory = VK_NULL_HANDLE;
+    VkImageView m_view = VK_NULL_HANDLE;
+    VkRenderPass m_render_pass = VK_NULL_HANDLE;
+    VkFramebuffer m_framebuffer = VK_NULL_HANDLE;
+    VkFilter m_filter = VK_FILTER_LINEAR;  // Nearest when the format can't be filtered
+    uint32_t m_memory_type = 0;
+    VkDeviceSize m_bytes = 0;
+    ResolutionController m_controller;
+
+    // Creates the target at the largest output it will be used for, which must allow blitting in the format. The
+    // swapchain images have to allow being a transfer destination
+    result init(VkCompletedDevice& device, VkFormat format, VkExtent2D max_extent);
+
+    // The device must be idle
+    void shutdown();
+
+    // The extent the scene is rendered at this frame, for an output of the given size
+    VkExtent2D render_extent(VkExtent2D output) const;
+
+    // Begins the offscreen pass cleared to the colour, with the viewport and scissor covering the render extent
+    void begin(VkCommandBuffer cmd, VkExtent2D output, const VkClearValue& clear) const;
+    void end(VkCommandBuffer cmd) const;
+
+    // Stretches the rendered region over the whole of the output image, which is left in the final layout. The
+    // output's earlier contents are discarded, and the stage waiting on its acquire must be colour output
+    void upscale(VkCommandBuffer cmd, VkImage output, VkExtent2D extent, VkImageLayout final_layout) const;
+};
+
+}  // namespace Atelier
@@ -0,0 +1,76 @@
+/**
+ * @brief GPU driven drawing. The bounds and draw arguments of every object live in storage buffers, a compute
+ * pass frustum culls them and compacts the survivors into an indirect buffer, and one indirect draw consumes the
+ * result. The CPU records the same handful of commands no matter how many objects are in the scene
+ */
+#pragma once
+#include "atelier_base.h"
+#include "atelier_vk_completed.h"
+#include "atelier_vk_shader.h"
+
+namespace Atelier
+{
+
+// Bounding sphere of one object in world space
+struct ObjectBounds {
+    float x, y, z;
+    float radius;
+};
+
+struct VkGpuCuller {
+    // Matches the push constant block in shaders/cull.comp
+    struct PushConstants {
+        float planes[6][4];
+        uint32_t object_count;
+        uint32_t compact;
+    };
+
+    VkGpuCuller() = default;
+    VkCompletedDevice* m_parent = nullptr;
+    VkShaderRegistry* m_shaders = nullptr;
+    uint64_t m_shader_hash = 0;
+    uint32_t m_max_objects = 0;
+    uint32_t m_object_count = 0;
+
+    // Inputs are written by the CPU through the persistent mapping, outputs only ever touched by the GPU
+    VkCompletedBuffer m_bounds;
+    VkCompletedBuffer m_draws;
+    VkCompletedBuffer m_visible;
+    VkCompletedBuffer m_count;
+
+    VkDescriptorSetLayout m_set_layout = VK_NULL_HANDLE;
+    VkDescriptorPool m_pool = VK_NULL_HANDLE;
+    VkDescriptorSet m_set = VK_NULL_HANDLE;
+    VkPipelineLayout m_layout = VK_NULL_HANDLE;
+    VkPipeline m_pipeline = VK_NULL_HANDLE;
+
+    // VK_KHR_draw_indirect_count is enabled, without it we fall back to zeroing
+    bool m_draw_indirect_count = false;
+
+    // drawIndirectFirstInstance is enabled, without it every draw's firstInstance has to be zero
+    bool m_first_instance = false;
+
+    // Creates the buffers for max_objects and the cull pipeline from the compiled shaders/cull.comp
+    result init(VkCompletedDevice& device, VkShaderRegistry& shaders, uint32_t max_objects,
+                const char* cull_spirv_path = "shaders/cull.comp.spv");
+    void shutdown();
+
+    // Writes one object's bounds and draw arguments straight into the mapped input buffers. Fails for a nonzero
+    // firstInstance when the device can't take one from an indirect draw, check m_first_instance
+    result set_object(uint32_t index, const ObjectBounds& bounds, const VkDrawIndexedIndirectCommand& draw);
+
+    // Number of objects, starting at index zero, which are considered by the cull
+    void set_object_count(uint32_t count) { m_object_count = count < m_max_objects ? count : m_max_objects; }
+
+    // Records the cull dispatch, must be outside of a render pass. Planes are ax + by + cz + d >= 0 inside
+    void record_cull(VkCommandBuffer cmd, const float planes[6][4]);
+
+    // Records the indirect draw of whatever survived the cull. Must be inside a render pass with the index
+    // buffer, pipeline and descriptors for the objects already bound
+    void record_draw(VkCommandBuffer cmd);
+
+    // Pulls the six frustum planes out of a column major view projection matrix with a 0..1 depth range
+    static void extract_frustum(const float view_proj[16], float planes[6][4]);
+};
+
+}  // namespace Atelier
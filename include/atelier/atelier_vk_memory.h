@@ -0,0 +1,94 @@
+/**
+ * @brief Device memory telemetry. Per heap usage and budget are polled once a frame through VK_EXT_memory_budget,
+ * and every allocation the library makes is tracked as well, which stands in for the driver's usage when the
+ * extension is missing. Subsystems holding memory they can give back subscribe to pressure callbacks and shed it
+ * before the driver has to start paging
+ */
+#pragma once
+#include "atelier_base.h"
+#include "atelier_vk_completed.h"
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+namespace Atelier
+{
+
+struct VkMemoryTelemetry {
+    enum class Pressure : uint32_t {
+        k_none,
+        k_moderate,  // Over the moderate fraction of the budget, caches should trim
+        k_critical,  // Over the critical fraction, anything that can be dropped should be
+    };
+
+    struct Heap {
+        VkDeviceSize m_size = 0;
+        VkDeviceSize m_budget = 0;      // From the driver, or the heap size scaled by the fallback fraction
+        VkDeviceSize m_usage = 0;       // From the driver, or the tracked bytes without the extension
+        VkDeviceSize m_tracked = 0;     // Allocated through the library
+        VkDeviceSize m_high_water = 0;  // Highest usage seen since the last reset
+        VkDeviceSize m_tracked_high_water = 0;
+        uint32_t m_allocations = 0;
+        bool m_device_local = false;
+        Pressure m_pressure = Pressure::k_none;
+    };
+
+    // Called for every heap under pressure each poll, with the bytes it would take to fall below the moderate
+    // threshold. Runs on the thread calling poll()
+    typedef std::function<void(uint32_t heap, Pressure pressure, VkDeviceSize excess)> Callback;
+
+    struct Subscriber {
+        uint32_t m_id = 0;
+        Callback m_callback;
+    };
+
+    VkMemoryTelemetry() = default;
+    VkCompletedDevice* m_parent = nullptr;
+    bool m_has_budget = false;
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR m_get_props2 = nullptr;  // From the device's own instance
+    float m_moderate = 0.85f;  // Fractions of the budget where pressure starts
+    float m_critical = 0.95f;
+    float m_fallback_fraction = 0.8f;  // Of the heap size, taken as the budget without the extension
+    uint64_t m_polls = 0;
+    uint64_t m_pressure_events = 0;  // Callbacks fired, summed over subscribers
+    std::vector<Heap> m_heaps;
+    std::vector<Subscriber> m_subscribers;
+    uint32_t m_next_id = 1;
+
+    // Written from any thread that allocates, folded into m_heaps by poll()
+    std::atomic<VkDeviceSize> m_tracked[VK_MAX_MEMORY_HEAPS] = {};
+    std::atomic<uint32_t> m_allocation_count[VK_MAX_MEMORY_HEAPS] = {};
+
+    // Attaches to the device so its allocations are tracked, and takes a first sample
+    result init(VkCompletedDevice& device);
+
+    // Detaches from the device, must happen before the device is destroyed
+    void shutdown();
+
+    // Samples every heap, updates the high-water marks and fires callbacks. Call once a frame
+    void poll();
+
+    // Returns the id to unsubscribe with
+    uint32_t subscribe(Callback callback);
+    void unsubscribe(uint32_t id);
+
+    // Forgets the high-water marks, usually after a loading screen
+    void reset_high_water();
+
+    // Bytes left before the heap reaches its budget
+    VkDeviceSize available(uint32_t heap) const
+    {
+        return m_heaps[heap].m_budget > m_heaps[heap].m_usage ? m_heaps[heap].m_budget - m_heaps[heap].m_usage : 0;
+    }
+
+    // Records an allocation or free in the heap behind the memory type. Safe to call from any thread
+    void track_allocate(uint32_t memory_type, VkDeviceSize bytes);
+    void track_free(uint32_t memory_type, VkDeviceSize bytes);
+
+    // Record into the device's telemetry when it has one, so allocation sites don't have to check
+    static void on_allocate(const VkCompletedDevice& device, uint32_t memory_type, VkDeviceSize bytes);
+    static void on_free(const VkCompletedDevice& device, uint32_t memory_type, VkDeviceSize bytes);
+};
+
+}  // namespace Atelier
@@ -0,0 +1,176 @@
+/**
+ * @brief Runs offscreen work on whichever logical devices suit it best. Every device in the VkCompletedState gets
+ * a worker with a capability score, work goes to the best scoring device that isn't already busy, and the results
+ * come back to the primary device through shared memory when the two devices allow it, or a host copy when not
+ */
+#pragma once
+#include "atelier_base.h"
+#include "atelier_vk_completed.h"
+
+#include <functional>
+#include <vector>
+
+namespace Atelier
+{
+
+/**
+ * @brief How a result gets from the device which made it to the device which uses it. The best mode both devices
+ * support is chosen once per worker
+ */
+enum class VkShareMode : uint32_t {
+    k_same_device,  // Work runs on the consumer itself, nothing to share
+    k_opaque,       // Exported device memory and semaphore, needs the same driver and device UUIDs on both sides
+    k_host_memory,  // One pinned host allocation imported into both devices with VK_EXT_external_memory_host
+    k_host_copy,    // The producer writes a readback buffer and the CPU copies it into a consumer upload buffer
+};
+
+const char* share_mode_name(VkShareMode mode);
+
+/**
+ * @brief What a device offers to offscreen work, queried once so the scheduler can score it without Vulkan calls
+ */
+struct VkDeviceCapabilities {
+    VkCompletedDevice* m_device = nullptr;
+    VkPhysicalDeviceType m_type = VK_PHYSICAL_DEVICE_TYPE_OTHER;
+    VkDeviceSize m_device_local_bytes = 0;
+    uint32_t m_family = 0;  // Family the worker submits to
+    VkQueueFlags m_family_flags = 0;
+    bool m_async_family = false;  // The family has no graphics, so it runs beside the primary's rendering
+    bool m_has_ids = false;
+    uint8_t m_device_uuid[VK_UUID_SIZE] = {};
+    uint8_t m_driver_uuid[VK_UUID_SIZE] = {};
+    bool m_opaque_memory = false;
+    bool m_opaque_semaphore = false;
+    bool m_host_import = false;
+    VkDeviceSize m_host_import_alignment = 0;
+
+    // Fills everything in from the device and its physical device. Prefers a family without graphics for the
+    // primary device, and a family with everything for the rest as nothing else is using them
+    static VkDeviceCapabilities query(VkCompletedDevice& device, bool primary);
+};
+
+struct VkMultiGpuScheduler {
+    typedef uint32_t Handle;
+    static constexpr Handle k_invalid = 0xffffffffu;
+
+    // Records the work into the command buffer, the results have to end up in the buffer which has storage and
+    // transfer dst usage. It's called from the thread calling submit
+    typedef std::function<void(VkCommandBuffer cmd, VkBuffer result)> RecordFunc;
+
+    /**
+     * @brief What a piece of work needs from the device running it
+     */
+    struct Requirements {
+        VkQueueFlags m_queue_flags = VK_QUEUE_COMPUTE_BIT;
+        VkDeviceSize m_min_device_memory = 0;
+        bool m_allow_primary = true;  // False to only ever run on a secondary device
+        bool m_allow_cpu = true;      // Software devices like lavapipe count as a device too
+        bool m_gpu_wait = false;      // Signal a semaphore the consumer waits on, only with k_opaque sharing
+    };
+
+    struct Worker {
+        VkDeviceCapabilities m_caps;
+        VkShareMode m_share = VkShareMode::k_host_copy;
+        VkQueue m_queue = VK_NULL_HANDLE;
+        struct VkSubmitQueue* m_submitter = nullptr;  // Owns the queue when set, jobs are pushed to it
+        VkCommandPool m_pool = VK_NULL_HANDLE;
+        uint32_t m_pending = 0;
+        uint64_t m_completed = 0;  // Jobs finished over the worker's lifetime
+    };
+
+    enum class State : uint32_t { k_free, k_running, k_ready };
+
+    // Type and size of a result slot's memory, so the device's telemetry can be told when it's freed
+    struct Allocation {
+        uint32_t m_type = 0;
+        VkDeviceSize m_bytes = 0;
+    };
+
+    /**
+     * @brief One piece of work and the result slot it writes to. Slots are kept after release and picked up again
+     * by later work on the same worker which fits in them
+     */
+    struct Job {
+        uint32_t m_worker = 0;
+        State m_state = State::k_free;
+        VkDeviceSize m_capacity = 0;
+        VkDeviceSize m_size = 0;
+        VkCommandBuffer m_cmd = VK_NULL_HANDLE;
+        VkFence m_fence = VK_NULL_HANDLE;
+        uint64_t m_ticket = 0;  // Of the push, when the worker's queue belongs to a submitter
+
+        // Buffers on the producer and consumer side, the same buffer when the work ran on the consumer
+        VkBuffer m_producer_buffer = VK_NULL_HANDLE;
+        VkDeviceMemory m_producer_memory = VK_NULL_HANDLE;
+        Allocation m_producer_allocation;
+        void* m_producer_mapped = nullptr;
+        bool m_producer_coherent = true;
+        VkBuffer m_consumer_buffer = VK_NULL_HANDLE;
+        VkDeviceMemory m_consumer_memory = VK_NULL_HANDLE;
+        Allocation m_consumer_allocation;
+        void* m_consumer_mapped = nullptr;
+        bool m_consumer_coherent = true;
+        void* m_host = nullptr;  // Pinned allocation for k_host_memory
+
+        VkSemaphore m_producer_semaphore = VK_NULL_HANDLE;
+        VkSemaphore m_consumer_semaphore = VK_NULL_HANDLE;
+        bool m_signalled = false;  // Submitted with the semaphore, which the consumer still has to wait on
+    };
+
+    VkMultiGpuScheduler() = default;
+    VkCompletedDevice* m_primary = nullptr;
+    VkDeviceCapabilities m_primary_caps;
+    struct VkSubmitQueue* m_submitter = nullptr;  // Set before init when a submitter owns a primary queue
+    std::vector<Worker> m_workers;
+    std::vector<Job> m_jobs;
+
+    // Creates a worker for every device in the state. Results are always delivered to the primary device. When the
+    // primary worker lands on the submitter's queue it takes another queue of the family, or pushes to the
+    // submitter when the family only has the one
+    result init(VkCompletedState& vk, VkCompletedDevice& primary);
+
+    // Waits for all work and destroys every slot, the devices are left alone
+    void shutdown();
+
+    // Score of the worker for the requirements, negative when it can't run them at all. Doesn't include load
+    float score(uint32_t worker, const Requirements& req) const;
+
+    // Workers which can run the requirements, best first
+    std::vector<uint32_t> rank(const Requirements& req) const;
+
+    // Picks the best worker for the requirements, spreading work by how many jobs each worker still has in flight
+    Handle submit(const Requirements& req, VkDeviceSize result_size, const RecordFunc& record);
+
+    // Submits to a specific worker, returns k_invalid on failure
+    Handle submit_to(uint32_t worker, VkDeviceSize result_size, const RecordFunc& record, bool gpu_wait = false);
+
+    // Checks fences and finishes host copies for work that completed, call once a frame
+    void poll();
+
+    // Blocks until the job is ready
+    result wait(Handle handle);
+
+    bool ready(Handle handle) const { return m_jobs[handle].m_state == State::k_ready; }
+    VkShareMode share_mode(Handle handle) const { return m_workers[m_jobs[handle].m_worker].m_share; }
+
+    // Buffer on the primary device holding the result, with transfer src usage. Valid to read once ready, or
+    // straight after submit when waiting on the job's semaphore
+    VkBuffer result_buffer(Handle handle) const { return m_jobs[handle].m_consumer_buffer; }
+
+    // Host pointer to the result once ready, nullptr when the result only lives in device memory
+    const void* result_data(Handle handle) const;
+
+    // Semaphore the primary device must wait on exactly once before using the result, only for jobs submitted
+    // with gpu_wait and k_opaque sharing, otherwise VK_NULL_HANDLE
+    VkSemaphore take_wait_semaphore(Handle handle);
+
+    // Records what the primary device needs before it touches the result buffer. Acquires the buffer from the
+    // external queue family into the command buffer's family for k_opaque, otherwise a plain memory barrier
+    void record_acquire(Handle handle, VkCommandBuffer cmd, uint32_t cmd_family, VkPipelineStageFlags dst_stage,
+                        VkAccessFlags dst_access) const;
+
+    // Hands the slot back for reuse, the job must be ready
+    void release(Handle handle);
+};
+
+}  // namespace Atelier
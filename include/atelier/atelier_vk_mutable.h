@@ -7,7 +7,9 @@
 #include "atelier_base.h"
 #include "vulkan/vulkan_core.h"
 
+#include <cstring>
 #include <string>
+#include <type_traits>
 #include <vector>
 namespace Atelier
 {
@@ -57,9 +59,84 @@ struct VkMutableDeviceCreateInfo {
     std::vector<VkQueueFamilyProperties> queue_props;
     std::vector<VkDeviceQueueCreateInfo> queue_infos;
     std::vector<float> queue_priorities;
+    VkPhysicalDeviceFeatures supported_features = {};
+    VkPhysicalDeviceFeatures enabled_features = {};
 
     static result create_default(VkMutableDeviceCreateInfo& dev, VkInstance instance, VkPhysicalDevice physical);
     result create_device(VkDevice& Device, const VkAllocationCallbacks* alloc = nullptr) const;
 };
 
+/**
+ * @brief STL backed version of VkGraphicsPipelineCreateInfo. Besides being editable, this owns all of its arrays
+ * so it can be copied onto a worker thread and compiled there while the caller carries on
+ */
+struct VkMutableGraphicsPipelineCreateInfo {
+    struct Stage {
+        VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+        VkShaderModule module = VK_NULL_HANDLE;
+        uint64_t shader_hash = 0;  // Content hash from the shader registry, used in place of the module handle
+        std::string entry = "main";
+        std::vector<VkSpecializationMapEntry> constants = {};  // Offsets into constant_data
+        std::vector<uint8_t> constant_data = {};
+
+        // Sets the specialization constant with the id, replacing it when it's already set, even with a value of
+        // another size. A module without a constant of that id ignores it
+        template <typename T>
+        void specialize(uint32_t id, const T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>, "Specialization constants are copied as bytes");
+            for (size_t i = 0; i < constants.size(); i++) {
+                VkSpecializationMapEntry& c = constants[i];
+                if (c.constantID != id) continue;
+                if (c.size == sizeof(T)) {
+                    memcpy(constant_data.data() + c.offset, &value, sizeof(T));
+                    return;
+                }
+
+                // Take the old bytes out so the data stays packed, the constants after them move down
+                auto first = constant_data.begin() + c.offset;
+                constant_data.erase(first, first + c.size);
+                for (auto& other : constants) {
+                    if (other.offset > c.offset) other.offset -= uint32_t(c.size);
+                }
+                constants.erase(constants.begin() + i);
+                break;
+            }
+            uint32_t offset = uint32_t(constant_data.size());
+            constants.push_back({id, offset, sizeof(T)});
+            constant_data.resize(offset + sizeof(T));
+            memcpy(constant_data.data() + offset, &value, sizeof(T));
+        }
+    };
+
+    VkMutableGraphicsPipelineCreateInfo() = default;
+    std::vector<Stage> stages;
+    std::vector<VkVertexInputBindingDescription> vertex_bindings;
+    std::vector<VkVertexInputAttributeDescription> vertex_attributes;
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+    VkPipelineRasterizationStateCreateInfo rasterization = {};
+    VkPipelineMultisampleStateCreateInfo multisample = {};
+    VkPipelineDepthStencilStateCreateInfo depth_stencil = {};
+    std::vector<VkPipelineColorBlendAttachmentState> blend_attachments;
+    std::vector<VkDynamicState> dynamic_states;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VkRenderPass render_pass = VK_NULL_HANDLE;
+    uint32_t subpass = 0;
+
+    // Triangle lists, no culling, no depth, one opaque colour attachment and a dynamic viewport and scissor
+    static result create_default(VkMutableGraphicsPipelineCreateInfo& info, VkPipelineLayout layout,
+                                 VkRenderPass render_pass);
+
+    // Hash of the full create state. Shaders contribute their content hash and specialization constants, so
+    // identical pipelines built from different module handles still collide and variants of one shader don't
+    uint64_t hash() const;
+
+    // Whether the other info describes the same pipeline, comparing everything the hash covers. Caches keyed on
+    // the hash check this on a hit
+    bool same_state(const VkMutableGraphicsPipelineCreateInfo& other) const;
+
+    result create_pipeline(VkPipeline& pipeline, VkDevice device, VkPipelineCache cache = VK_NULL_HANDLE,
+                           const VkAllocationCallbacks* alloc = nullptr) const;
+};
+
 }  // namespace Atelier
@@ -0,0 +1,164 @@
+/**
+ * @brief Dear ImGui drawn straight into an existing render pass, with a performance HUD on top of it. The ImGui
+ * renderer and the HUD window are only built when external/imgui is checked out, which defines ATELIER_IMGUI.
+ * The GPU scope timer and the HUD's statistics don't need ImGui and are always available
+ */
+#pragma once
+#include "atelier_base.h"
+#include "atelier_vk_completed.h"
+#include "atelier_vk_memory.h"
+#include "atelier_vk_mutable.h"
+#include "atelier_vk_shader.h"
+
+#include <vector>
+
+struct ImDrawData;
+
+namespace Atelier
+{
+
+/**
+ * @brief GPU timestamps around named parts of a frame. Each frame in flight has its own queries, and a frame's
+ * results are read back when its slot comes round again, after the presenter has waited on that slot's fence
+ */
+struct VkGpuScopes {
+    static constexpr uint32_t k_max_scopes = 32;  // Per frame
+    static constexpr uint32_t k_max_frames_in_flight = 4;
+
+    struct Result {
+        const char* m_name = nullptr;
+        double m_ms = 0.0;
+    };
+
+    VkGpuScopes() = default;
+    VkCompletedDevice* m_parent = nullptr;
+    VkQueryPool m_pool = VK_NULL_HANDLE;
+    double m_period = 0.0;
+    uint32_t m_frames_in_flight = 0;
+    uint32_t m_frame = 0;
+    std::vector<const char*> m_names[k_max_frames_in_flight];  // Scopes opened in each frame slot
+    std::vector<Result> m_results;                             // The newest finished frame
+
+    // Does nothing and returns success when the family can't write timestamps, every scope is then skipped
+    result init(VkCompletedDevice& device, uint32_t graphics_family, uint32_t frames_in_flight);
+    void shutdown();
+
+    // Reads back what the slot measured last time round and resets its queries. The slot's fence must have been
+    // waited on, and the command buffer must be the first of the frame and outside of a render pass
+    void begin_frame(VkCommandBuffer cmd, uint32_t frame_index);
+
+    // Names must outlive the results, string literals are the intended use. Returns the scope to end
+    uint32_t begin(VkCommandBuffer cmd, const char* name);
+    void end(VkCommandBuffer cmd, uint32_t scope);
+};
+
+/**
+ * @brief Everything the HUD shows, gathered from the presenter, pacer and device each frame. Filled in without
+ * ImGui so it can be logged or read back in headless runs too
+ */
+struct PerfHud {
+    static constexpr uint32_t k_history = 240;
+
+    struct Heap {
+        VkDeviceSize m_size = 0;
+        VkDeviceSize m_usage = 0;       // What the library allocated without VK_EXT_memory_budget
+        VkDeviceSize m_budget = 0;      // A share of the heap size without VK_EXT_memory_budget
+        VkDeviceSize m_high_water = 0;
+        bool m_device_local = false;
+        bool m_pressure = false;
+    };
+
+    struct Queue {
+        uint32_t m_submits = 0;         // Per frame
+        uint32_t m_presents = 0;        // Swapchains presented per frame
+        uint64_t m_frames_pending = 0;  // Submitted frames the GPU hasn't finished yet
+        uint32_t m_overlay_draws = 0;
+        uint32_t m_overlay_vertices = 0;
+        uint32_t m_overlay_dropped = 0;  // Draw lists which didn't fit in the ring
+    };
+
+    PerfHud() = default;
+    float m_cpu_ms[k_history] = {};
+    float m_gpu_ms[k_history] = {};
+    uint32_t m_cursor = 0;
+    uint64_t m_frames = 0;
+    uint64_t m_missed = 0;
+    double m_stddev_ms = 0.0;
+    double m_p99_ms = 0.0;
+    float m_render_scale = 1.0f;  // Dynamic resolution scale of the main window, along each axis
+    bool m_has_budget = false;
+    std::vector<Heap> m_heaps;
+    std::vector<VkGpuScopes::Result> m_scopes;
+    Queue m_queue;
+
+    // Appends a frame to the graphs, gpu_ms is zero when no GPU time is known
+    void add_frame(double cpu_ms, double gpu_ms);
+
+    // Copies the heaps from the telemetry's last poll
+    void sample_memory(const VkMemoryTelemetry& memory);
+
+    // Builds the HUD window, must be called between ImGui::NewFrame and ImGui::Render
+    void draw() const;
+};
+
+/**
+ * @brief Records ImGui draw data into a render pass. Vertices and indices go into one persistently mapped ring
+ * with a fixed region per frame in flight, so nothing is allocated or mapped while running. Draw lists which don't
+ * fit into the region are dropped whole and counted
+ */
+struct VkOverlay {
+    VkOverlay() = default;
+    VkCompletedDevice* m_parent = nullptr;
+    VkShaderRegistry* m_shaders = nullptr;
+    uint64_t m_vertex_hash = 0;
+    uint64_t m_fragment_hash = 0;
+    bool m_owns_context = false;
+
+    // Each frame's region holds max_vertices vertices followed by max_indices indices
+    VkCompletedBuffer m_ring;
+    uint32_t m_frames_in_flight = 0;
+    uint32_t m_max_vertices = 0;
+    uint32_t m_max_indices = 0;
+    VkDeviceSize m_region_size = 0;
+    VkDeviceSize m_index_offset = 0;
+
+    VkImage m_font_image = VK_NULL_HANDLE;
+    VkDeviceMemory m_font_memory = VK_NULL_HANDLE;
+    uint32_t m_font_memory_type = 0;
+    VkDeviceSize m_font_bytes = 0;  // Tracked in the device's memory telemetry, zero until bound
+    VkImageView m_font_view = VK_NULL_HANDLE;
+    VkSampler m_sampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_set_layout = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptor_pool = VK_NULL_HANDLE;
+    VkDescriptorSet m_font_set = VK_NULL_HANDLE;
+    VkPipelineLayout m_layout = VK_NULL_HANDLE;
+    VkPipeline m_pipeline = VK_NULL_HANDLE;
+
+    // Stats of the last recorded frame
+    uint32_t m_last_draws = 0;
+    uint32_t m_last_vertices = 0;
+    uint32_t m_last_dropped = 0;
+    bool m_dropping = false;  // Lists were dropped last frame, the warning waits for a recovery before repeating
+
+    // Creates the ImGui context when there isn't one, uploads the font atlas through the queue and builds the
+    // pipeline for the render pass. The shaders are shaders/overlay.vert and shaders/quad.frag
+    result init(VkCompletedDevice& device, VkShaderRegistry& shaders, uint32_t graphics_family, VkQueue queue,
+                VkRenderPass render_pass, uint32_t frames_in_flight, uint32_t max_vertices = 1u << 17,
+                uint32_t max_indices = 1u << 18, const char* vertex_spirv_path = "shaders/overlay.vert.spv",
+                const char* fragment_spirv_path = "shaders/quad.frag.spv");
+
+    // The device must be idle
+    void shutdown();
+
+    // Sets the display size and time step then starts an ImGui frame
+    void new_frame(VkExtent2D extent, float delta_seconds);
+
+    // Copies the draw data into the frame's region of the ring and records the draws. Must be called inside the
+    // render pass the overlay was created for, and the region must be free on the GPU
+    void record(VkCommandBuffer cmd, uint32_t frame_index, const ImDrawData* data);
+
+    // Binds the pipeline, buffers and viewport, again after a draw callback asks for it
+    void setup_render_state(VkCommandBuffer cmd, const ImDrawData* data, VkDeviceSize region);
+};
+
+}  // namespace Atelier
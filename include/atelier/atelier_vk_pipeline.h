@@ -0,0 +1,179 @@
+/**
+ * @brief Pipeline creation off the render thread. The render thread only ever asks for a pipeline and gets a
+ * handle back straight away, the driver compile happens on the job system and the result is published with an
+ * atomic store, so a draw either has the pipeline or it doesn't and never waits for it
+ */
+#pragma once
+#include "atelier_base.h"
+#include "atelier_jobs.h"
+#include "atelier_vk_completed.h"
+#include "atelier_vk_mutable.h"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace Atelier
+{
+
+struct VkPipelineManager {
+    enum class State : uint32_t { k_pending, k_ready, k_failed };
+
+    // Slots live in a deque so their addresses stay put while more are appended, handles point straight at them.
+    // The slot keeps the create state it was requested with, the compile job reads it and lookups compare it
+    struct Slot {
+        std::atomic<VkPipeline> m_handle{VK_NULL_HANDLE};
+        std::atomic<State> m_state{State::k_pending};
+        uint64_t m_hash = 0;
+        VkMutableGraphicsPipelineCreateInfo m_info;
+    };
+
+    struct Handle {
+        const Slot* m_slot = nullptr;
+        bool valid() const { return m_slot != nullptr; }
+    };
+
+    VkPipelineManager() = default;
+    VkCompletedDevice* m_parent = nullptr;
+    JobSystem* m_jobs = nullptr;
+    VkPipelineCache m_cache = VK_NULL_HANDLE;
+    std::string m_cache_path;
+    std::deque<Slot> m_slots;
+    std::unordered_multimap<uint64_t, Slot*> m_lookup;
+    std::mutex m_lock;
+    std::atomic<uint32_t> m_in_flight{0};
+
+    // Creates the shared pipeline cache, seeding it from the file at cache_path when the file was written by the
+    // same driver and device. Compiles are pushed onto the given job system
+    result init(VkCompletedDevice& device, JobSystem& jobs, const char* cache_path = nullptr);
+
+    // Waits for compiles in flight, writes the cache back out and destroys every pipeline
+    void shutdown();
+
+    // Returns immediately with a handle to the pipeline, queuing a compile if this create state is new. Anything
+    // referenced by the info (modules, layout, render pass) has to stay alive until the pipeline is ready
+    Handle request(const VkMutableGraphicsPipelineCreateInfo& info);
+
+    // The pipeline, or VK_NULL_HANDLE while it's still compiling. Never blocks
+    VkPipeline get(Handle handle) const
+    {
+        return handle.valid() ? handle.m_slot->m_handle.load(std::memory_order_acquire) : VK_NULL_HANDLE;
+    }
+
+    // Lets a draw use a simpler pipeline until the real one has been published
+    VkPipeline get_or(Handle handle, VkPipeline fallback) const
+    {
+        VkPipeline pipeline = get(handle);
+        return pipeline != VK_NULL_HANDLE ? pipeline : fallback;
+    }
+
+    State state(Handle handle) const
+    {
+        return handle.valid() ? handle.m_slot->m_state.load(std::memory_order_acquire) : State::k_failed;
+    }
+
+    // Number of compiles queued or running
+    uint32_t pending() const { return m_in_flight.load(std::memory_order_relaxed); }
+
+    // Serializes the pipeline cache to m_cache_path
+    result save_cache();
+};
+
+// Bit for each feature, the features being enumerators which hold their bit's index
+template <auto... Features>
+inline constexpr uint32_t k_feature_mask = ((1u << uint32_t(Features)) | ... | 0u);
+
+/**
+ * @brief Every permutation of a shader's features as its own pipeline. Each supported feature is a VkBool32
+ * specialization constant whose id is the first id plus the feature's bit, so the driver folds the branches on it
+ * away and one SPIR-V file serves every variant. A variant is requested from the manager the first time it's asked
+ * for, and the manager dedupes on the shader hashes and constants, so two sets asking for the same variant share
+ * one pipeline. Lookups aren't locked, keep each set to one thread
+ */
+template <uint32_t Supported>
+struct VkPipelineVariants {
+    static constexpr uint32_t k_supported = Supported;
+    static constexpr uint32_t k_count = 1u << std::popcount(Supported);
+    static_assert(std::popcount(Supported) <= 8, "More than 8 features is too many pipelines to build lazily");
+
+    VkPipelineVariants() = default;
+    VkPipelineManager* m_manager = nullptr;
+    VkMutableGraphicsPipelineCreateInfo m_base;  // Copied and specialized for every variant
+    uint32_t m_first_id = 0;
+    std::array<VkPipelineManager::Handle, k_count> m_variants = {};
+    uint32_t m_requested = 0;
+
+    // Anything the base info references has to outlive the pipelines, as with VkPipelineManager::request
+    result init(VkPipelineManager& manager, const VkMutableGraphicsPipelineCreateInfo& base, uint32_t first_id = 0)
+    {
+        if (manager.m_parent == nullptr || base.stages.empty()) return -1;
+        m_manager = &manager;
+        m_base = base;
+        m_first_id = first_id;
+        return k_success;
+    }
+
+    // Forgets the handles, the pipelines themselves belong to the manager. Call before the manager shuts down
+    void shutdown()
+    {
+        m_variants = {};
+        m_requested = 0;
+        m_manager = nullptr;
+    }
+
+    // Dense index of a variant, the supported bits of the mask packed together
+    static constexpr uint32_t index_of(uint32_t mask)
+    {
+        uint32_t index = 0;
+        uint32_t next = 0;
+        for (uint32_t bit = 0; bit < 32; bit++) {
+            if (((Supported >> bit) & 1) == 0) continue;
+            index |= ((mask >> bit) & 1) << next++;
+        }
+        return index;
+    }
+
+    // The variant with exactly the features in the mask, requesting it the first time. Unsupported bits are
+    // dropped, the template version refuses them at compile time
+    VkPipelineManager::Handle variant(uint32_t mask)
+    {
+        mask &= Supported;
+        VkPipelineManager::Handle& handle = m_variants[index_of(mask)];
+        if (!handle.valid() && m_manager != nullptr) {
+            VkMutableGraphicsPipelineCreateInfo info = m_base;
+            for (uint32_t bit = 0; bit < 32; bit++) {
+                if (((Supported >> bit) & 1) == 0) continue;
+                VkBool32 enabled = (mask >> bit) & 1;
+                for (auto& stage : info.stages) stage.specialize(m_first_id + bit, enabled);
+            }
+            handle = m_manager->request(info);
+            m_requested += handle.valid();
+        }
+        return handle;
+    }
+
+    template <uint32_t Mask>
+    VkPipelineManager::Handle variant()
+    {
+        static_assert((Mask & ~Supported) == 0, "The variant set doesn't support every feature in the mask");
+        return variant(Mask);
+    }
+
+    // The pipeline, or VK_NULL_HANDLE while the variant is still compiling
+    VkPipeline get(uint32_t mask) { return m_manager != nullptr ? m_manager->get(variant(mask)) : VK_NULL_HANDLE; }
+
+    // Requests every variant, for sets small enough to build them all while loading
+    void request_all()
+    {
+        for (uint32_t mask = Supported;; mask = (mask - 1) & Supported) {
+            variant(mask);
+            if (mask == 0) break;
+        }
+    }
+};
+
+}  // namespace Atelier
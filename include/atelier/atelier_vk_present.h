@@ -0,0 +1,117 @@
+/**
+ * @brief Renders any number of swapchains as one frame. Every target acquires its own image and gets its own
+ * command buffer, then all of the command buffers go to the queue in a single submit and every swapchain is
+ * presented by a single vkQueuePresentKHR. An extra window costs its GPU work, not another submit and present
+ */
+#pragma once
+#include "atelier_base.h"
+#include "atelier_vk_completed.h"
+
+#include <vector>
+
+namespace Atelier
+{
+
+struct VkMultiPresenter {
+    static constexpr uint32_t k_max_frames_in_flight = 4;
+
+    struct Target {
+        VkCompletedSwapchain* m_swap = nullptr;  // Must stay at the same address while it's a target
+        VkSemaphore m_acquired[k_max_frames_in_flight] = {};
+        VkCommandBuffer m_cmd[k_max_frames_in_flight] = {};
+        uint32_t m_image_index = 0;
+        bool m_active = false;  // Acquired an image this frame, false for minimized or lost surfaces
+        VkResult m_last_present = VK_SUCCESS;
+        std::vector<VkCommandBuffer> m_static;  // Pre-recorded, submitted ahead of m_cmd this frame only
+    };
+
+    // Everything one frame in flight needs, the fence covers the single submit of that frame
+    struct Frame {
+        VkCommandPool m_pool = VK_NULL_HANDLE;
+        VkCommandBuffer m_prologue = VK_NULL_HANDLE;  // Starts the timestamps ahead of every other buffer
+        VkFence m_fence = VK_NULL_HANDLE;
+        VkSemaphore m_rendered = VK_NULL_HANDLE;
+        uint64_t m_serial = 0;
+        uint64_t m_ticket = 0;  // Last descriptor pushed for the frame when it went through the submitter
+        bool m_pushed = false;
+        bool m_timed = false;   // Timestamps were written around this frame's command buffers
+    };
+
+    VkMultiPresenter() = default;
+    VkCompletedDevice* m_parent = nullptr;
+    VkQueue m_graphics_queue = VK_NULL_HANDLE;
+    VkQueue m_present_queue = VK_NULL_HANDLE;
+    uint32_t m_frames_in_flight = 0;
+    uint32_t m_frame = 0;
+    uint64_t m_serial = 0;  // Serial of the next submit, starts at 1
+    uint64_t m_completed_serial = 0;
+    Frame m_frames[k_max_frames_in_flight];
+    std::vector<Target> m_targets;
+
+    // When set the frame is pushed to the submission thread instead of submitted here, and presents on the same
+    // queue go through it as well. Set before the first frame
+    struct VkSubmitQueue* m_submitter = nullptr;
+    uint64_t m_submit_ticket = 0;  // Ticket of the last descriptor the frame pushed
+
+    // Two timestamps per frame in flight, left null when the queue family can't write them
+    VkQueryPool m_timestamps = VK_NULL_HANDLE;
+    double m_timestamp_period = 0.0;
+    uint64_t m_gpu_time_ns = 0;
+    uint64_t m_gpu_samples = 0;
+
+    // Scratch arrays for the submit and present, kept so a frame doesn't allocate
+    std::vector<VkCommandBuffer> m_submit_cmds;
+    std::vector<VkSemaphore> m_submit_waits;
+    std::vector<uint32_t> m_submit_ends;  // Where each target's buffers end in m_submit_cmds, one per wait
+    std::vector<VkPipelineStageFlags> m_submit_stages;
+    std::vector<VkSwapchainKHR> m_present_swaps;
+    std::vector<uint32_t> m_present_indices;
+    std::vector<VkResult> m_present_results;
+
+    // The graphics family has to be the one the queue came from, and the present queue has to be able to present
+    // to every swapchain added later
+    result init(VkCompletedDevice& device, uint32_t graphics_family, VkQueue graphics_queue, VkQueue present_queue,
+                uint32_t frames_in_flight = 2);
+
+    // Waits for the device to go idle and destroys everything, the swapchains themselves are left alone
+    void shutdown();
+
+    // Adds a swapchain to be acquired and presented every frame, returns the target index or negative on failure
+    int32_t add_target(VkCompletedSwapchain& swap);
+
+    // Stops presenting a target, indices of later targets shift down. Waits for the device to go idle
+    void remove_target(uint32_t index);
+
+    // Waits until this frame's resources are free, acquires an image from every target and begins their command
+    // buffers. Targets which couldn't acquire are inactive for the frame and must not be recorded into
+    result begin_frame();
+
+    // Ends the command buffers, submits them together and presents every active target at once
+    result end_frame();
+
+    // Pushes the frame's command buffers to the submitter as descriptors, split between targets when there are too
+    // many for one. Fails when a single target has more buffers than a descriptor holds
+    result push_frame(const Frame& frame);
+
+    // Submits a pre-recorded command buffer ahead of the target's own one, for this frame only. The buffer must
+    // allow simultaneous use since the same image can come round again before the last submit is known to be done
+    void submit_static(uint32_t target, VkCommandBuffer cmd) { m_targets[target].m_static.push_back(cmd); }
+
+    bool is_active(uint32_t target) const { return m_targets[target].m_active; }
+    uint32_t image_index(uint32_t target) const { return m_targets[target].m_image_index; }
+    VkCommandBuffer command_buffer(uint32_t target) const { return m_targets[target].m_cmd[m_frame]; }
+
+    // Serial of the frame being recorded, and the newest serial the GPU is known to have finished
+    uint64_t serial() const { return m_serial; }
+    uint64_t completed_serial() const { return m_completed_serial; }
+
+    // GPU time of the newest frame known to have finished, from the first window's image being available to the
+    // end of the last command buffer. Zero when timestamps aren't supported
+    uint64_t gpu_time_ns() const { return m_gpu_time_ns; }
+
+    // Bumped every time a finished frame's GPU time is read back, so callers can tell a new sample from the
+    // one they already used
+    uint64_t gpu_samples() const { return m_gpu_samples; }
+};
+
+}  // namespace Atelier
@@ -0,0 +1,99 @@
+/**
+ * @brief Immediate mode 2D quads. Quads are gathered per (pipeline, texture) pair on the CPU, then written in one
+ * sequential pass into a persistently mapped ring and drawn with a single instanced draw per pair
+ */
+#pragma once
+#include "atelier_base.h"
+#include "atelier_vk_completed.h"
+#include "atelier_vk_mutable.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace Atelier
+{
+
+/**
+ * @brief Per instance data for one quad. The vertex shader expands each instance into 6 vertices from
+ * gl_VertexIndex, so there is no corner vertex buffer at all
+ */
+struct QuadInstance {
+    float x, y;            // Top left corner in pixels
+    float width, height;   // Size in pixels
+    float u0, v0, u1, v1;  // Texture rectangle
+    uint32_t color;        // RGBA8, multiplied with the texture
+    float rotation;        // Radians around the centre of the quad
+};
+static_assert(sizeof(QuadInstance) == 40, "QuadInstance layout is shared with shaders/quad.vert");
+
+/**
+ * @brief Collects quads during a frame and records them as instanced draws. The pipelines used with this are
+ * expected to be built with fill_pipeline_info, to take the texture in the given descriptor set index, and to have
+ * a 16 byte vertex stage push constant at offset 0 which receives the pixel to clip space scale and offset
+ */
+struct VkQuadBatcher {
+    struct Batch {
+        VkPipeline m_pipeline = VK_NULL_HANDLE;
+        VkDescriptorSet m_texture = VK_NULL_HANDLE;
+        std::vector<QuadInstance> m_quads;
+        uint32_t m_idle_frames = 0;  // Frames in a row without any quads
+    };
+
+    // Batches idle for longer than this are dropped, the pairs drawn change as pipelines and textures come and go
+    static constexpr uint32_t k_max_idle_frames = 120;
+
+    VkQuadBatcher() = default;
+    VkCompletedDevice* m_parent = nullptr;
+    VkCompletedBuffer m_ring;
+    uint32_t m_frames_in_flight = 0;
+    uint32_t m_max_quads = 0;  // Per frame
+    uint32_t m_frame = 0;
+
+    // Batches are kept between frames so that their vectors don't need to grow again each frame. The lookup is by
+    // hash of the pair, so every hit still compares the handles
+    std::vector<Batch> m_batches;
+    std::vector<uint32_t> m_order;
+    std::unordered_multimap<uint64_t, uint32_t> m_lookup;
+    uint32_t m_last_batch = 0;
+    uint32_t m_quad_count = 0;
+    uint32_t m_dropped = 0;
+
+    // Stats of the last recorded frame
+    uint32_t m_last_draws = 0;
+    uint32_t m_last_quads = 0;
+
+    // Allocates a host visible ring holding max_quads_per_frame quads for each frame in flight
+    result init(VkCompletedDevice& device, uint32_t frames_in_flight, uint32_t max_quads_per_frame);
+    void shutdown();
+
+    // Sets up the instance vertex input and alpha blending for a quad pipeline
+    static void fill_pipeline_info(VkMutableGraphicsPipelineCreateInfo& info);
+
+    // Starts collecting quads for the given frame in flight, the ring region of that frame must be free on the
+    // GPU. Drops the batches which have been idle for too long
+    void begin_frame(uint32_t frame_index);
+
+    // Queues a quad, quads past the per frame capacity are dropped and counted
+    void submit(VkPipeline pipeline, VkDescriptorSet texture, const QuadInstance& quad)
+    {
+        if (m_batches.empty() || m_batches[m_last_batch].m_pipeline != pipeline ||
+            m_batches[m_last_batch].m_texture != texture) {
+            select_batch(pipeline, texture);
+        }
+        if (m_quad_count >= m_max_quads) {
+            m_dropped++;
+            return;
+        }
+        m_batches[m_last_batch].m_quads.push_back(quad);
+        m_quad_count++;
+    }
+
+    // Copies the batches into the ring sorted by pipeline then texture, and records one instanced draw for each.
+    // Must be called inside a render pass
+    void record(VkCommandBuffer cmd, VkPipelineLayout layout, uint32_t texture_set, VkExtent2D target);
+
+    // Finds or creates the batch for the pair and makes it the current one
+    void select_batch(VkPipeline pipeline, VkDescriptorSet texture);
+};
+
+}  // namespace Atelier
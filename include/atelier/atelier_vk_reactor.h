@@ -0,0 +1,227 @@
+/**
+ * @brief The reactor which resumes tasks. Anything a task waits on, a fence, a timeline value, a job on the worker
+ * threads or a file being read, parks the task here, and poll() resumes every task whose wait is over. Poll is
+ * called once a frame on the render thread, and every task only ever runs on that thread, so tasks never need to
+ * lock anything they share with the frame. A thousand loads in flight cost a thousand suspended frames and one
+ * status query per fence per frame, rather than a thousand blocked threads
+ */
+#pragma once
+#include "atelier_base.h"
+#include "atelier_io.h"
+#include "atelier_jobs.h"
+#include "atelier_task.h"
+#include "atelier_vk_completed.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Atelier
+{
+
+struct Reactor;
+
+// Resumes once the fence has signalled, to k_success or to a failure when the device was lost
+struct FenceAwait {
+    Reactor* m_reactor = nullptr;
+    VkCompletedDevice* m_device = nullptr;
+    VkFence m_fence = VK_NULL_HANDLE;
+    VkResult m_result = VK_NOT_READY;
+
+    bool await_ready();
+    void await_suspend(std::coroutine_handle<> handle);
+    result await_resume() const { return m_result == VK_SUCCESS ? k_success : -1; }
+};
+
+// Resumes once the timeline semaphore has reached the value. Needs VK_KHR_timeline_semaphore
+struct TimelineAwait {
+    Reactor* m_reactor = nullptr;
+    VkCompletedDevice* m_device = nullptr;
+    VkSemaphore m_semaphore = VK_NULL_HANDLE;
+    uint64_t m_value = 0;
+    VkResult m_result = VK_NOT_READY;
+
+    bool await_ready();
+    void await_suspend(std::coroutine_handle<> handle);
+    result await_resume() const { return m_result == VK_SUCCESS ? k_success : -1; }
+};
+
+// Resumes at the next poll, for work spread over frames
+struct FrameAwait {
+    Reactor* m_reactor = nullptr;
+
+    bool await_ready() const { return false; }
+    void await_suspend(std::coroutine_handle<> handle);
+    void await_resume() const {}
+};
+
+// Runs the function on a worker and resumes with what it returned at the first poll after it finished
+template <typename T>
+struct JobAwait {
+    Reactor* m_reactor = nullptr;
+    JobSystem* m_jobs = nullptr;
+    std::function<T()> m_fn;
+    std::optional<T> m_value;
+
+    bool await_ready() const { return false; }
+    void await_suspend(std::coroutine_handle<> handle);
+    T await_resume() { return std::move(*m_value); }
+};
+
+template <>
+struct JobAwait<void> {
+    Reactor* m_reactor = nullptr;
+    JobSystem* m_jobs = nullptr;
+    std::function<void()> m_fn;
+
+    bool await_ready() const { return false; }
+    void await_suspend(std::coroutine_handle<> handle);
+    void await_resume() const {}
+};
+
+// A file mapped and paged in on a worker, so touching its bytes afterwards doesn't stall the render thread
+struct FileRead {
+    result m_result = -1;
+    MappedFile m_file;
+};
+
+struct Reactor {
+    struct FenceWait {
+        FenceAwait* m_await;
+        std::coroutine_handle<> m_handle;
+    };
+
+    struct TimelineWait {
+        TimelineAwait* m_await;
+        std::coroutine_handle<> m_handle;
+    };
+
+    Reactor() = default;
+    std::vector<Task<void>> m_tasks;  // Spawned and not finished yet
+    std::vector<FenceWait> m_fences;
+    std::vector<TimelineWait> m_timelines;
+    std::vector<std::coroutine_handle<>> m_next_frame;
+    std::vector<std::coroutine_handle<>> m_resuming;
+    std::vector<std::pair<VkSemaphore, uint64_t>> m_counters;  // Each semaphore is only queried once a poll
+
+    // Finished jobs land here from the workers
+    std::mutex m_lock;
+    std::condition_variable m_jobs_done;  // Signalled under the lock when the last job in flight lands
+    std::vector<std::coroutine_handle<>> m_ready;
+    std::atomic<uint32_t> m_jobs_in_flight{0};
+
+    uint64_t m_polls = 0;
+    uint64_t m_resumed = 0;
+
+    // Starts the task straight away, it runs until its first wait and is then resumed by poll. The reactor owns
+    // it until it finishes
+    void spawn(Task<void> task);
+
+    // Resumes every task whose wait is over, then frees the ones which finished. Call once a frame on the thread
+    // which spawned them
+    void poll();
+
+    // Waits for the jobs still running and destroys every unfinished task. The device must be idle
+    void shutdown();
+
+    // Tasks spawned which haven't finished yet
+    size_t pending() const { return m_tasks.size(); }
+
+    // Queues a coroutine to be resumed by the next poll, safe from any thread
+    void schedule(std::coroutine_handle<> handle);
+
+    // Resumes every task waiting on the fence at the next poll with the error, for a fence whose submit failed and
+    // so will never signal
+    void fail_fence(VkFence fence, VkResult error);
+
+    FenceAwait fence(VkCompletedDevice& device, VkFence fence) { return {this, &device, fence}; }
+    TimelineAwait timeline(VkCompletedDevice& device, VkSemaphore semaphore, uint64_t value)
+    {
+        return {this, &device, semaphore, value};
+    }
+    FrameAwait next_frame() { return {this}; }
+
+    template <typename Fn>
+    JobAwait<std::invoke_result_t<Fn&>> run(JobSystem& jobs, Fn fn)
+    {
+        JobAwait<std::invoke_result_t<Fn&>> await;
+        await.m_reactor = this;
+        await.m_jobs = &jobs;
+        await.m_fn = std::move(fn);
+        return await;
+    }
+
+    // Maps the file on a worker and touches every page of it there
+    JobAwait<FileRead> read_file(JobSystem& jobs, const char* path);
+
+private:
+    template <typename T>
+    friend struct JobAwait;
+
+    // Schedules the task a job hop suspended and drops that job from the count shutdown waits on, only the job
+    // itself may call this and it's the last thing the job does
+    void finish_job(std::coroutine_handle<> handle);
+};
+
+template <typename T>
+void JobAwait<T>::await_suspend(std::coroutine_handle<> handle)
+{
+    // Once scheduled the task may be resumed and this awaiter gone, so that's the last thing the job does
+    m_reactor->m_jobs_in_flight.fetch_add(1, std::memory_order_relaxed);
+    m_jobs->push([this, handle]() {
+        m_value.emplace(m_fn());
+        m_reactor->finish_job(handle);
+    });
+}
+
+/**
+ * @brief Buffer uploads as tasks. Every upload in a frame is copied into the same staging buffer and recorded into
+ * one command buffer, which goes to the queue with a single fence at flush(). Each upload's task resumes when that
+ * fence signals, so thousands of small uploads cost one submit a frame
+ */
+struct VkAsyncUploader {
+    struct Batch {
+        VkCommandBuffer m_cmd = VK_NULL_HANDLE;
+        VkFence m_fence = VK_NULL_HANDLE;
+        VkCompletedBuffer m_staging;
+        VkDeviceSize m_used = 0;
+        uint32_t m_waiters = 0;  // Tasks which haven't been resumed from the fence yet
+        bool m_recording = false;
+        bool m_submitted = false;
+    };
+
+    VkAsyncUploader() = default;
+    VkCompletedDevice* m_parent = nullptr;
+    Reactor* m_reactor = nullptr;
+    VkQueue m_queue = VK_NULL_HANDLE;
+    struct VkSubmitQueue* m_submitter = nullptr;  // Owns the queue when set, batches are pushed to it
+    VkCommandPool m_pool = VK_NULL_HANDLE;
+    VkDeviceSize m_batch_bytes = 8ull << 20;  // Staging per batch, larger uploads get a batch of their own
+    std::deque<Batch> m_batches;              // Only grows, so pointers held by waiting tasks stay valid
+    Batch* m_open = nullptr;
+
+    uint64_t m_uploads = 0;
+    uint64_t m_submits = 0;
+    uint64_t m_uploaded_bytes = 0;
+
+    result init(VkCompletedDevice& device, Reactor& reactor, uint32_t family, VkQueue queue);
+
+    // The device must be idle
+    void shutdown();
+
+    // Copies the bytes into staging when the task starts, so they only have to live until it's spawned or
+    // awaited, and finishes once the copy into the buffer has completed. The buffer mustn't be in use meanwhile
+    Task<result> upload(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size);
+
+    // Submits everything recorded since the last flush, call once a frame before polling the reactor
+    result flush();
+
+    // A batch recording with room for the size, reusing one whose uploads have all been resumed
+    Batch* open_batch(VkDeviceSize size);
+};
+
+}  // namespace Atelier
@@ -0,0 +1,127 @@
+/**
+ * @brief Graphics command recording through a shadow of the bound state. Binds which would leave the command
+ * buffer's state as it already is are dropped before they reach the driver, and counted. Draws inside a pass can
+ * also be queued with a 64-bit sort key and emitted in key order, which puts draws sharing a pipeline and material
+ * next to each other so that most of their binds are the ones being dropped
+ */
+#pragma once
+#include "atelier_base.h"
+#include "atelier_vk_completed.h"
+
+#include <vector>
+
+namespace Atelier
+{
+
+struct VkStateRecorder {
+    static constexpr uint32_t k_max_sets = 4;
+    static constexpr uint32_t k_max_vertex_bindings = 4;
+    static constexpr uint32_t k_max_push_bytes = 128;  // The smallest maxPushConstantsSize allowed
+
+    struct Counters {
+        uint64_t m_emitted = 0;   // Binds and dynamic state which reached the command buffer
+        uint64_t m_filtered = 0;  // Ones dropped because nothing would have changed
+        uint64_t m_draws = 0;
+    };
+
+    VkStateRecorder() = default;
+    const VkDeviceDispatch* m_api = nullptr;
+    VkCommandBuffer m_cmd = VK_NULL_HANDLE;
+
+    // What the command buffer has bound, null handles and cleared flags are unknown and never filtered
+    VkPipeline m_pipeline = VK_NULL_HANDLE;
+    VkPipelineLayout m_layout = VK_NULL_HANDLE;  // Of the bound descriptor sets and push constants
+    VkDescriptorSet m_sets[k_max_sets] = {};
+    VkBuffer m_vertex_buffers[k_max_vertex_bindings] = {};
+    VkDeviceSize m_vertex_offsets[k_max_vertex_bindings] = {};
+    VkBuffer m_index_buffer = VK_NULL_HANDLE;
+    VkDeviceSize m_index_offset = 0;
+    VkIndexType m_index_type = VK_INDEX_TYPE_UINT16;
+    VkViewport m_viewport = {};
+    VkRect2D m_scissor = {};
+    bool m_has_viewport = false;
+    bool m_has_scissor = false;
+    uint8_t m_push[k_max_push_bytes] = {};
+    uint8_t m_push_known[k_max_push_bytes] = {};  // Bytes of m_push that were written under m_layout
+    Counters m_counters;
+
+    // Starts shadowing a command buffer which has nothing bound yet, the counters carry on
+    void begin(const VkDeviceDispatch& api, VkCommandBuffer cmd);
+
+    // Forgets everything bound, for when commands were recorded around the recorder or secondaries were executed
+    void invalidate();
+
+    void bind_pipeline(VkPipeline pipeline);
+
+    // Only the sets which differ from what's bound are emitted. Dynamic offsets aren't shadowed, so sets with them
+    // are always emitted
+    void bind_descriptor_sets(VkPipelineLayout layout, uint32_t first, uint32_t count, const VkDescriptorSet* sets,
+                              uint32_t dynamic_count = 0, const uint32_t* dynamic_offsets = nullptr);
+    void bind_descriptor_set(VkPipelineLayout layout, uint32_t index, VkDescriptorSet set)
+    {
+        bind_descriptor_sets(layout, index, 1, &set);
+    }
+
+    // Only the bindings which differ from what's bound are emitted
+    void bind_vertex_buffers(uint32_t first, uint32_t count, const VkBuffer* buffers, const VkDeviceSize* offsets);
+    void bind_index_buffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType type);
+
+    // Pipelines are taken to have dynamic viewport and scissor, as create_default sets up. A pipeline with them
+    // baked in overwrites the state when bound, so call invalidate() after binding one of those
+    void set_viewport(const VkViewport& viewport);
+    void set_scissor(const VkRect2D& scissor);
+    void push_constants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size,
+                        const void* data);
+
+    void draw(uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance);
+    void draw_indexed(uint32_t index_count, uint32_t instance_count, uint32_t first_index, int32_t vertex_offset,
+                      uint32_t first_instance);
+};
+
+/**
+ * @brief Draws gathered for one pass and emitted sorted by key. The key is built by sort_key from a pipeline and
+ * material index, small numbers the caller hands out, and a depth in [0, 1]. Opaque passes want the depth front to
+ * back as given, blended ones pass 1 - depth
+ */
+struct VkDrawList {
+    struct Draw {
+        uint64_t m_key = 0;
+        VkPipeline m_pipeline = VK_NULL_HANDLE;
+        VkPipelineLayout m_layout = VK_NULL_HANDLE;
+        VkDescriptorSet m_material = VK_NULL_HANDLE;  // Bound to the list's material set, skipped when null
+        VkBuffer m_vertex_buffer = VK_NULL_HANDLE;    // Bound to binding 0, skipped when null
+        VkDeviceSize m_vertex_offset = 0;
+        VkBuffer m_index_buffer = VK_NULL_HANDLE;  // Indexed when set
+        VkDeviceSize m_index_offset = 0;
+        VkIndexType m_index_type = VK_INDEX_TYPE_UINT32;
+        uint32_t m_count = 0;  // Vertices or indices
+        uint32_t m_instance_count = 1;
+        uint32_t m_first = 0;  // First vertex or index
+        int32_t m_base_vertex = 0;
+        uint32_t m_first_instance = 0;
+    };
+
+    struct Order {
+        uint64_t m_key;
+        uint32_t m_index;
+    };
+
+    VkDrawList() = default;
+    uint32_t m_material_set = 0;  // Descriptor set index materials are bound to
+    bool m_sort = true;           // Off emits in submission order, for comparing against
+    std::vector<Draw> m_draws;
+    std::vector<Order> m_order;  // Kept between flushes so a frame doesn't allocate
+
+    // 16 bits of pipeline, 24 of material and 24 of depth, most significant first
+    static uint64_t sort_key(uint32_t pipeline, uint32_t material, float depth);
+
+    void add(const Draw& draw) { m_draws.push_back(draw); }
+
+    // Records every draw through the recorder in key order, ties keep the order they were added in, then empties
+    // the list. Must be called inside the pass
+    void flush(VkStateRecorder& recorder);
+
+    size_t size() const { return m_draws.size(); }
+};
+
+}  // namespace Atelier
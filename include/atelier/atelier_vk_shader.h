@@ -0,0 +1,132 @@
+/**
+ * @brief Shader loading. SPIR-V is addressed by the hash of its content rather than by path, so two pipelines
+ * which happen to use the same binary share one VkShaderModule no matter where the bytes came from
+ */
+#pragma once
+#include "atelier_base.h"
+#include "atelier_io.h"
+#include "atelier_vk_completed.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Atelier
+{
+
+/**
+ * @brief A single file packing many SPIR-V blobs together with an index. Startup opens and maps one file instead
+ * of hundreds, and the blobs are handed to vkCreateShaderModule straight out of the mapping. The layout is
+ *
+ *   Header | Entry[entry_count] sorted by hash | string table | 16 byte aligned SPIR-V blobs
+ *
+ * Everything is stored as offsets so the mapping can be used in place
+ */
+struct ShaderArchive {
+    static constexpr uint32_t k_magic = 0x41534841;  // "AHSA" read little endian
+    static constexpr uint32_t k_version = 1;
+    static constexpr uint32_t k_blob_alignment = 16;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t entry_count;
+        uint32_t string_table_size;
+        uint64_t string_table_offset;
+    };
+
+    struct Entry {
+        uint64_t hash;
+        uint64_t offset;
+        uint32_t size;
+        uint32_t name_offset;
+    };
+
+    // A blob to be packed when writing a new archive
+    struct Source {
+        std::string name;
+        const uint32_t* code = nullptr;
+        size_t size = 0;  // In bytes
+    };
+
+    ShaderArchive() = default;
+    MappedFile m_file;
+    const Header* m_header = nullptr;
+    const Entry* m_entries = nullptr;
+    const char* m_strings = nullptr;
+    std::unordered_map<std::string, uint32_t> m_name_lookup;
+
+    // Maps the archive and validates the index, the blobs themselves aren't touched until they're requested
+    result open(const char* path);
+    void close();
+
+    // Binary searches the index for the blob with the given content hash, null when not present
+    const Entry* find(uint64_t hash) const;
+
+    // Finds a blob by the name it was packed with, null when not present
+    const Entry* find(const char* name) const;
+
+    // Pointer to the SPIR-V words inside the mapping
+    const uint32_t* code(const Entry& entry) const
+    {
+        return reinterpret_cast<const uint32_t*>(m_file.m_data + entry.offset);
+    }
+
+    // Packs the blobs into a new archive, identical blobs are only stored once
+    static result write(const char* path, const std::vector<Source>& sources);
+
+    // Convenience for build steps, maps each SPIR-V file and packs it under its file name
+    static result pack_files(const char* path, const std::vector<std::string>& spirv_paths);
+};
+
+/**
+ * @brief Deduplicates VkShaderModules for a single device by the content hash of the SPIR-V. Modules are
+ * reference counted so pipelines can release them once they're compiled. Safe to use from multiple threads
+ */
+struct VkShaderRegistry {
+    struct Module {
+        VkShaderModule m_handle = VK_NULL_HANDLE;
+        uint32_t m_refs = 0;
+        std::vector<uint32_t> m_code;  // Kept so a hash hit can be verified against the caller's words
+    };
+
+    enum class Lookup { hit, miss, collision };
+
+    VkShaderRegistry() = default;
+    VkCompletedDevice* m_parent = nullptr;
+    std::unordered_map<uint64_t, Module> m_modules;
+    std::vector<std::unique_ptr<ShaderArchive>> m_archives;
+    std::mutex m_lock;
+
+    result init(VkCompletedDevice& device);
+
+    // Destroys every module regardless of reference count and unmaps the archives
+    void shutdown();
+
+    // Mounts an archive so that its blobs can be acquired by name or hash
+    result mount_archive(const char* path);
+
+    // Gets the module for the SPIR-V in memory, creating it only when this content hasn't been seen before
+    result acquire(const uint32_t* code, size_t size, VkShaderModule& out, uint64_t* out_hash = nullptr);
+
+    // Maps a loose SPIR-V file and acquires its module
+    result acquire_file(const char* path, VkShaderModule& out, uint64_t* out_hash = nullptr);
+
+    // Acquires a module by the name it has in one of the mounted archives
+    result acquire_named(const char* name, VkShaderModule& out, uint64_t* out_hash = nullptr);
+
+    // Acquires by hash, either an already live module or a blob inside one of the mounted archives
+    result acquire_hash(uint64_t hash, VkShaderModule& out);
+
+    // Drops one reference, the module is destroyed when nothing is holding it anymore
+    void release(uint64_t hash);
+
+    // Looks up a live module and takes a reference, needs the lock to be held. When code is given the stored
+    // words are compared so that a hash collision is reported instead of handing back another shader
+    Lookup try_ref_locked(uint64_t hash, const uint32_t* code, size_t size, VkShaderModule& out);
+    result create_and_insert(uint64_t hash, const uint32_t* code, size_t size, VkShaderModule& out);
+};
+
+}  // namespace Atelier
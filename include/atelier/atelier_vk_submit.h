@@ -0,0 +1,119 @@
+/**
+ * @brief A submission thread per queue. Producers on any thread push submit descriptors into a lock-free ring, the
+ * thread drains whatever has built up and hands it to the driver as one vkQueueSubmit2 call, or vkQueueSubmit when
+ * synchronization2 isn't enabled. The thread is the only one submitting, and anything else that touches the queue
+ * (presents, waits) goes through with_queue(), so the queue's external synchronization lives here
+ */
+#pragma once
+#include "atelier_base.h"
+#include "atelier_vk_completed.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Atelier
+{
+
+struct VkSubmitQueue {
+    static constexpr uint32_t k_capacity = 256;  // Descriptors the ring holds, producers wait when it's full
+    static constexpr uint32_t k_max_batch = 64;  // Descriptors merged into one driver call
+
+    /**
+     * @brief One VkSubmitInfo2 worth of work. Fixed size so pushing never allocates. A non-zero value on a
+     * semaphore makes it a timeline wait or signal
+     */
+    struct Submit {
+        static constexpr uint32_t k_max_cmds = 16;
+        static constexpr uint32_t k_max_waits = 8;
+        static constexpr uint32_t k_max_signals = 4;
+
+        VkCommandBuffer m_cmds[k_max_cmds] = {};
+        uint32_t m_cmd_count = 0;
+        VkSemaphore m_waits[k_max_waits] = {};
+        VkPipelineStageFlags2 m_wait_stages[k_max_waits] = {};
+        uint64_t m_wait_values[k_max_waits] = {};
+        uint32_t m_wait_count = 0;
+        VkSemaphore m_signals[k_max_signals] = {};
+        uint64_t m_signal_values[k_max_signals] = {};
+        uint32_t m_signal_count = 0;
+        VkFence m_fence = VK_NULL_HANDLE;  // Ends the batch it lands in, so it covers everything before it too
+
+        // Builders, false when the descriptor is already full
+        bool add_cmd(VkCommandBuffer cmd);
+        bool add_wait(VkSemaphore semaphore, VkPipelineStageFlags2 stages, uint64_t value = 0);
+        bool add_signal(VkSemaphore semaphore, uint64_t value = 0);
+    };
+
+    // One slot of the ring, the sequence says whether it's free for the producer or ready for the consumer
+    struct Cell {
+        std::atomic<uint64_t> m_sequence{0};
+        Submit m_submit;
+    };
+
+    VkSubmitQueue() = default;
+    VkCompletedDevice* m_parent = nullptr;
+    VkQueue m_queue = VK_NULL_HANDLE;
+    bool m_submit2 = false;  // Otherwise batches fall back to vkQueueSubmit
+
+    Cell m_cells[k_capacity];
+    alignas(64) std::atomic<uint64_t> m_head{0};  // Next ticket handed to a producer
+    alignas(64) uint64_t m_tail = 0;              // Next cell the submission thread reads
+
+    // Tickets below this have been handed to the driver, whether or not the call succeeded
+    std::atomic<uint64_t> m_submitted{0};
+    std::atomic<VkResult> m_last_error{VK_SUCCESS};  // The first failed call, latched until the next init
+
+    // The submission thread only sleeps on this when the ring is empty
+    std::thread m_thread;
+    std::mutex m_lock;
+    std::mutex m_queue_lock;
+    std::condition_variable m_wake;
+    std::condition_variable m_progress;
+    std::atomic<bool> m_sleeping{false};
+    std::atomic<bool> m_stopping{false};
+
+    // Counters, only written by the submission thread
+    std::atomic<uint64_t> m_submits{0};
+    std::atomic<uint64_t> m_calls{0};
+
+    // Scratch arrays for building one call, only used by the submission thread
+    std::vector<VkSubmitInfo2> m_infos;
+    std::vector<VkSemaphoreSubmitInfo> m_semaphores;
+    std::vector<VkCommandBufferSubmitInfo> m_buffers;
+    std::vector<VkSubmitInfo> m_legacy_infos;
+    std::vector<VkTimelineSemaphoreSubmitInfo> m_legacy_timelines;
+    std::vector<VkPipelineStageFlags> m_legacy_stages;
+
+    // Takes over the queue, nothing else may submit to it directly until shutdown
+    result init(VkCompletedDevice& device, VkQueue queue);
+
+    // Submits everything already pushed, stops the thread and waits for the queue to go idle
+    void shutdown();
+
+    // Copies the descriptor into the ring and returns its ticket. Safe from any thread, only blocks when the ring
+    // is full
+    uint64_t push(const Submit& submit);
+
+    // Blocks until the ticket has been handed to the driver, so work that depends on the submit being on the queue
+    // (a present waiting on its semaphore) can follow it
+    void wait_submitted(uint64_t ticket);
+
+    // Fails once any call has failed. The fences in that call will never signal, so anything about to wait on a
+    // fence it pushed waits for the ticket and checks this first rather than blocking forever
+    result error() const { return m_last_error.load(std::memory_order_acquire) == VK_SUCCESS ? k_success : -1; }
+
+    // Runs the function with exclusive access to the queue, after everything pushed so far has been submitted
+    void with_queue(const std::function<void(VkQueue queue)>& fn);
+
+    // The loop the submission thread runs
+    void thread_main();
+
+    // Hands count descriptors starting at the tail to the driver, splitting the call after every fence
+    void submit_batch(uint32_t count);
+};
+
+}  // namespace Atelier
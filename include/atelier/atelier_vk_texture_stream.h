@@ -0,0 +1,249 @@
+/**
+ * @brief Texture streaming. KTX2 containers are mapped rather than read, every texture gets its small mip tail
+ * resident as soon as it's loaded, and the larger mips follow on demand from the screen space size each draw asks
+ * for. Residency is kept under a memory budget by evicting the least recently used detail first
+ */
+#pragma once
+#include "atelier_base.h"
+#include "atelier_io.h"
+#include "atelier_vk_completed.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Atelier
+{
+
+/**
+ * @brief A mapped KTX2 container. Only 2D textures without supercompression are accepted, which keeps every level
+ * a plain run of bytes that can be copied straight into staging. Level 0 is the largest
+ */
+struct Ktx2File {
+    static constexpr uint8_t k_identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    struct Header {
+        uint8_t identifier[12];
+        uint32_t vk_format;
+        uint32_t type_size;
+        uint32_t pixel_width;
+        uint32_t pixel_height;
+        uint32_t pixel_depth;
+        uint32_t layer_count;
+        uint32_t face_count;
+        uint32_t level_count;
+        uint32_t supercompression_scheme;
+        uint32_t dfd_offset;
+        uint32_t dfd_length;
+        uint32_t kvd_offset;
+        uint32_t kvd_length;
+        uint64_t sgd_offset;
+        uint64_t sgd_length;
+    };
+
+    struct Level {
+        uint64_t offset;
+        uint64_t length;
+        uint64_t uncompressed_length;
+    };
+
+    Ktx2File() = default;
+    MappedFile m_file;
+    VkFormat m_format = VK_FORMAT_UNDEFINED;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_levels = 0;
+    const Level* m_level_index = nullptr;  // Points into the mapping
+
+    // Maps the file and validates the header and level index against its size
+    result open(const char* path);
+    void close();
+
+    const uint8_t* level_data(uint32_t level) const { return m_file.m_data + m_level_index[level].offset; }
+    VkDeviceSize level_size(uint32_t level) const { return m_level_index[level].length; }
+    VkExtent3D level_extent(uint32_t level) const
+    {
+        return {std::max(1u, m_width >> level), std::max(1u, m_height >> level), 1};
+    }
+
+    // Writes an uncompressed container, levels are given largest first and must already be in the format
+    static result write(const char* path, VkFormat format, uint32_t width, uint32_t height,
+                        const std::vector<std::vector<uint8_t>>& levels);
+};
+
+struct VkTextureStreamer {
+    typedef uint32_t Handle;
+    static constexpr Handle k_invalid = 0xffffffffu;
+    static constexpr VkDeviceSize k_copy_alignment = 16;  // Covers the texel block size of every format
+
+    // One image holding a texture's levels from m_top_mip down to the smallest
+    struct Residency {
+        VkImage m_image = VK_NULL_HANDLE;
+        VkDeviceMemory m_memory = VK_NULL_HANDLE;
+        VkImageView m_view = VK_NULL_HANDLE;
+        VkDeviceSize m_bytes = 0;
+        uint32_t m_memory_type = 0;
+        uint32_t m_top_mip = 0;
+    };
+
+    /**
+     * @brief The tail is loaded first and lives until shutdown, detail is swapped out whenever the wanted mip
+     * changes and dropped altogether when evicted. The tail's levels are duplicated in the detail image, which
+     * costs a few kilobytes and means eviction never has to wait on a read
+     */
+    struct Texture {
+        Ktx2File m_file;
+        uint32_t m_tail_mip = 0;
+        Residency m_tail;
+        Residency m_detail;
+        bool m_tail_ready = false;
+        bool m_detail_ready = false;
+        bool m_loading = false;     // An upload for this texture is queued or in flight
+        uint32_t m_wanted_mip = 0;  // From the newest request
+        uint64_t m_last_used = 0;   // Frame of the newest request
+    };
+
+    // Moves from the render thread to the I/O thread and back again with the staging range filled in
+    struct Upload {
+        Handle m_texture = k_invalid;
+        const Ktx2File* m_file = nullptr;  // The I/O thread never touches the texture list itself
+        bool m_tail = false;
+        Residency m_target;
+        VkDeviceSize m_staging_size = 0;
+        VkDeviceSize m_staging_offset = 0;
+        uint64_t m_staging_end = 0;  // Ring position after this upload, freed when its batch finishes
+    };
+
+    // One submit to the transfer queue, covering every upload that was ready when it was recorded
+    struct Batch {
+        VkCommandBuffer m_cmd = VK_NULL_HANDLE;
+        VkFence m_fence = VK_NULL_HANDLE;
+        std::vector<Upload> m_uploads;
+        bool m_busy = false;
+    };
+
+    struct Retired {
+        Residency m_residency;
+        uint64_t m_frame = 0;  // Destroyed once this frame is reached
+    };
+
+    VkTextureStreamer() = default;
+    VkCompletedDevice* m_parent = nullptr;
+    VkQueue m_transfer_queue = VK_NULL_HANDLE;
+    struct VkSubmitQueue* m_submitter = nullptr;  // Owns the transfer queue when set, uploads are pushed to it
+    VkCommandPool m_pool = VK_NULL_HANDLE;
+    std::vector<uint32_t> m_families;  // Images are shared between these when transfer and graphics differ
+    uint32_t m_frames_in_flight = 0;
+    uint64_t m_frame = 0;
+    VkDeviceSize m_tail_bytes = 64 * 1024;  // Levels at or below this size make up the tail
+
+    // Budget, recomputed every update
+    uint32_t m_heap = 0;
+    float m_budget_fraction = 0.5f;   // Share of the device local heap textures may use
+    VkDeviceSize m_budget_limit = 0;  // Hard cap on top of the fraction, zero for none
+    VkDeviceSize m_budget = 0;
+    VkDeviceSize m_resident_bytes = 0;  // Including images still being uploaded
+    VkDeviceSize m_pending_bytes = 0;   // Detail queued for upload, kept under the staging size
+    VkDeviceSize m_retired_bytes = 0;   // Evicted but still allocated until the GPU is done with it
+    uint64_t m_evictions = 0;
+    uint64_t m_uploaded_bytes = 0;
+    uint32_t m_subscription = 0;    // To the device's memory telemetry, when it has some
+    uint64_t m_held_frame = ~0ull;  // No new detail is queued in this frame after critical pressure
+
+    // Textures only grow so handles and the I/O thread's pointers to them stay valid
+    std::deque<Texture> m_textures;
+    std::vector<Batch> m_batches;
+    std::vector<Retired> m_retired;
+    std::vector<Handle> m_candidates;
+    std::vector<VkImageMemoryBarrier> m_barriers;
+    std::vector<VkBufferImageCopy> m_regions;
+
+    // Staging ring filled by the I/O thread. Positions only ever increase, the offset is the position modulo size
+    VkCompletedBuffer m_staging;
+    uint64_t m_staging_write = 0;
+    uint64_t m_staging_read = 0;
+    uint64_t m_staging_failed = 0;  // End of the staging used by uploads whose submit failed
+
+    // Shared with the I/O thread, tails are always served before detail
+    std::thread m_io_thread;
+    std::mutex m_lock;
+    std::condition_variable m_io_wake;
+    std::deque<Upload> m_tail_requests;
+    std::deque<Upload> m_detail_requests;
+    std::vector<Upload> m_ready;
+    std::vector<Upload> m_ready_swap;
+    bool m_stopping = false;
+
+    // Uploads go to the transfer queue. Images are shared with the graphics family when it differs, so there are
+    // no ownership transfers. Old images are kept for frames_in_flight frames after they stop being current
+    result init(VkCompletedDevice& device, uint32_t transfer_family, VkQueue transfer_queue,
+                uint32_t graphics_family, uint32_t frames_in_flight, VkDeviceSize staging_bytes = 64ull << 20);
+
+    // Stops the I/O thread, waits for the transfer queue and destroys every texture
+    void shutdown();
+
+    // Picks a family with transfer and nothing else when the device has one, the graphics family otherwise
+    static uint32_t select_transfer_family(const VkCompletedDevice& device, uint32_t graphics_family);
+
+    // Maps the file and queues its mip tail. The texture can be drawn once ready() is true. Fails when the tail
+    // is larger than the staging ring
+    Handle load(const char* path);
+
+    // Asks for enough detail to cover the given size in pixels on screen this frame
+    void request(Handle handle, float screen_pixels);
+
+    // Polls finished uploads, retires old images, enforces the budget and queues new uploads. Call once a frame,
+    // after polling the memory telemetry and on the same thread
+    void update();
+
+    // Blocks until nothing is queued or in flight, mostly for tests and loading screens
+    void flush();
+
+    bool ready(Handle handle) const { return m_textures[handle].m_tail_ready; }
+
+    // View of the most detailed resident image, in shader read only layout. Changes as residency changes, so fetch
+    // it every frame rather than keeping it in a descriptor for good
+    VkImageView view(Handle handle) const
+    {
+        const Texture& t = m_textures[handle];
+        return t.m_detail_ready ? t.m_detail.m_view : t.m_tail.m_view;
+    }
+
+    // Most detailed mip currently resident, the tail's top when no detail is
+    uint32_t resident_mip(Handle handle) const
+    {
+        const Texture& t = m_textures[handle];
+        return t.m_detail_ready ? t.m_detail.m_top_mip : t.m_tail_mip;
+    }
+
+    // Bytes the levels from top_mip down take once copied, with the staging alignment
+    static VkDeviceSize upload_size(const Ktx2File& file, uint32_t top_mip);
+
+    // Creates the image and memory for levels from top_mip down and counts them against the budget
+    result create_residency(const Texture& texture, uint32_t top_mip, Residency& out);
+    void destroy_residency(Residency& residency);
+
+    // Recomputes m_budget from the heap size, and the device's memory telemetry when it has some
+    void refresh_budget();
+
+    // Drops the detail of the least recently used texture which doesn't need it this frame, false when there's
+    // none left
+    bool evict_one();
+
+    // Records and submits every upload the I/O thread has finished
+    void submit_ready();
+
+    // Publishes the uploads of every batch whose fence has signalled and frees their staging
+    void complete_batches();
+
+    // Destroys the targets of uploads which never reached the queue, and frees their staging once it's safe to
+    void fail_uploads(std::vector<Upload>& uploads);
+
+    // The loop the I/O thread runs
+    void io_main();
+};
+
+}  // namespace Atelier
@@ -0,0 +1,21 @@
+#version 450
+// ImGui vertices, see ImDrawVert. Shares shaders/quad.frag, which takes the same uv and colour outputs
+
+layout(location = 0) in vec2 in_pos;  // Display coordinates
+layout(location = 1) in vec2 in_uv;
+layout(location = 2) in vec4 in_color;
+
+layout(push_constant) uniform Transform {
+    vec2 scale;   // Display coordinates to clip space
+    vec2 offset;
+} pc;
+
+layout(location = 0) out vec2 out_uv;
+layout(location = 1) out vec4 out_color;
+
+void main()
+{
+    gl_Position = vec4(in_pos * pc.scale + pc.offset, 0.0, 1.0);
+    out_uv = in_uv;
+    out_color = in_color;
+}
@@ -0,0 +1,25 @@
+#version 450
+// Optional features are specialization constants, see VkPipelineVariants. Each one left off is folded away
+
+layout(constant_id = 0) const bool k_alpha_test = false;      // Cut out instead of blending, for foliage and such
+layout(constant_id = 1) const bool k_distance_field = false;  // The texture's alpha is a distance, for text
+layout(constant_id = 2) const bool k_grayscale = false;       // Drops the colour, for disabled widgets
+
+layout(set = 0, binding = 0) uniform sampler2D u_texture;
+
+layout(location = 0) in vec2 in_uv;
+layout(location = 1) in vec4 in_color;
+
+layout(location = 0) out vec4 out_color;
+
+void main()
+{
+    vec4 texel = texture(u_texture, in_uv);
+    if (k_distance_field) {
+        float width = fwidth(texel.a);
+        texel = vec4(1.0, 1.0, 1.0, smoothstep(0.5 - width, 0.5 + width, texel.a));
+    }
+    out_color = texel * in_color;
+    if (k_grayscale) out_color.rgb = vec3(dot(out_color.rgb, vec3(0.2126, 0.7152, 0.0722)));
+    if (k_alpha_test && out_color.a < 0.5) discard;
+}
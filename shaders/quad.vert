@@ -0,0 +1,31 @@
+#version 450
+// Expands one QuadInstance into two triangles, see atelier_vk_quad_batch.h for the instance layout
+
+layout(location = 0) in vec4 in_rect;  // xy top left in pixels, zw size in pixels
+layout(location = 1) in vec4 in_uv;    // xy top left uv, zw bottom right uv
+layout(location = 2) in vec4 in_color;
+layout(location = 3) in float in_rotation;
+
+layout(push_constant) uniform Transform {
+    vec2 scale;   // Pixels to clip space
+    vec2 offset;
+} pc;
+
+layout(location = 0) out vec2 out_uv;
+layout(location = 1) out vec4 out_color;
+
+const vec2 k_corners[6] = vec2[](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(0.0, 1.0),
+                                 vec2(0.0, 1.0), vec2(1.0, 0.0), vec2(1.0, 1.0));
+
+void main()
+{
+    vec2 corner = k_corners[gl_VertexIndex];
+    vec2 local = (corner - 0.5) * in_rect.zw;
+    float s = sin(in_rotation);
+    float c = cos(in_rotation);
+    vec2 pos = in_rect.xy + 0.5 * in_rect.zw + vec2(c * local.x - s * local.y, s * local.x + c * local.y);
+
+    gl_Position = vec4(pos * pc.scale + pc.offset, 0.0, 1.0);
+    out_uv = mix(in_uv.xy, in_uv.zw, corner);
+    out_color = in_color;
+}
@@ -0,0 +1,434 @@
+#include "atelier/atelier_bvh.h"
+#include "atelier/atelier_jobs.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define ATELIER_BVH_SSE
+#include <xmmintrin.h>
+#endif
+using namespace Atelier;
+
+static constexpr uint32_t k_leaves_only = 1u << 31;  // Task flag, only the node's own leaf children are culled
+
+static float half_area(const Aabb& box)
+{
+    float dx = box.max[0] - box.min[0], dy = box.max[1] - box.min[1], dz = box.max[2] - box.min[2];
+    return dx * dy + dy * dz + dz * dx;
+}
+
+static void grow(Aabb& box, const Aabb& other)
+{
+    for (uint32_t a = 0; a < 3; a++) {
+        box.min[a] = std::min(box.min[a], other.min[a]);
+        box.max[a] = std::max(box.max[a], other.max[a]);
+    }
+}
+
+static const Aabb k_empty_box = {{FLT_MAX, FLT_MAX, FLT_MAX}, {-FLT_MAX, -FLT_MAX, -FLT_MAX}};
+
+// Only lives for the duration of Bvh::build()
+struct BvhBuilder {
+    Bvh& m_bvh;
+    const Aabb* m_bounds;
+    std::vector<float> m_centroids[3];
+
+    uint32_t split(uint32_t first, uint32_t count);
+    uint32_t build_node(uint32_t first, uint32_t count, uint32_t parent);
+};
+
+// Partitions the range into two by the binned surface area heuristic, returns how many went left
+uint32_t BvhBuilder::split(uint32_t first, uint32_t count)
+{
+    uint32_t* order = m_bvh.m_object.data() + first;
+    float centroid_min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+    float centroid_max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (uint32_t i = 0; i < count; i++) {
+        for (uint32_t a = 0; a < 3; a++) {
+            centroid_min[a] = std::min(centroid_min[a], m_centroids[a][order[i]]);
+            centroid_max[a] = std::max(centroid_max[a], m_centroids[a][order[i]]);
+        }
+    }
+    uint32_t axis = 0;
+    for (uint32_t a = 1; a < 3; a++) {
+        if (centroid_max[a] - centroid_min[a] > centroid_max[axis] - centroid_min[axis]) axis = a;
+    }
+    const std::vector<float>& centroid = m_centroids[axis];
+    float extent = centroid_max[axis] - centroid_min[axis];
+
+    uint32_t best = Bvh::k_bins;
+    if (extent > 0.0f) {
+        const float scale = float(Bvh::k_bins) * 0.9999f / extent;
+        auto bin_of = [&](uint32_t object) { return uint32_t((centroid[object] - centroid_min[axis]) * scale); };
+        Aabb bins[Bvh::k_bins];
+        uint32_t counts[Bvh::k_bins] = {};
+        for (auto& bin : bins) bin = k_empty_box;
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t b = bin_of(order[i]);
+            counts[b]++;
+            grow(bins[b], m_bounds[order[i]]);
+        }
+
+        // Sweep from the right to get every suffix's cost, then from the left picking the cheapest cut
+        float right_cost[Bvh::k_bins] = {};
+        Aabb right = k_empty_box;
+        uint32_t right_count = 0;
+        for (uint32_t b = Bvh::k_bins - 1; b > 0; b--) {
+            grow(right, bins[b]);
+            right_count += counts[b];
+            right_cost[b] = right_count > 0 ? half_area(right) * float(right_count) : 0.0f;
+        }
+        Aabb left = k_empty_box;
+        uint32_t left_count = 0;
+        float best_cost = FLT_MAX;
+        for (uint32_t b = 0; b + 1 < Bvh::k_bins; b++) {
+            grow(left, bins[b]);
+            left_count += counts[b];
+            if (left_count == 0 || left_count == count) continue;
+            float cost = half_area(left) * float(left_count) + right_cost[b + 1];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best = b;
+            }
+        }
+        if (best < Bvh::k_bins) {
+            uint32_t* middle =
+              std::partition(order, order + count, [&](uint32_t object) { return bin_of(object) <= best; });
+            return uint32_t(middle - order);
+        }
+    }
+
+    // Everything shares a centroid, so halve the range to guarantee progress
+    uint32_t half = count / 2;
+    std::nth_element(order, order + half, order + count,
+                     [&](uint32_t a, uint32_t b) { return centroid[a] < centroid[b]; });
+    return half;
+}
+
+// Splits the range into up to four children, then recurses into the ones too big to be leaves
+uint32_t BvhBuilder::build_node(uint32_t first, uint32_t count, uint32_t parent)
+{
+    uint32_t index = uint32_t(m_bvh.m_nodes.size());
+    m_bvh.m_nodes.push_back({});
+
+    uint32_t firsts[4] = {first};
+    uint32_t counts[4] = {count};
+    uint32_t lanes = 1;
+    while (lanes < 4) {
+        uint32_t largest = 0;
+        for (uint32_t lane = 1; lane < lanes; lane++) {
+            if (counts[lane] > counts[largest]) largest = lane;
+        }
+        if (counts[largest] <= Bvh::k_leaf_size) break;
+        uint32_t left = split(firsts[largest], counts[largest]);
+        firsts[lanes] = firsts[largest] + left;
+        counts[lanes] = counts[largest] - left;
+        counts[largest] = left;
+        lanes++;
+    }
+
+    uint32_t children[4] = {Bvh::k_none, Bvh::k_none, Bvh::k_none, Bvh::k_none};
+    uint8_t leaf_mask = 0;
+    for (uint32_t lane = 0; lane < lanes; lane++) {
+        if (counts[lane] > Bvh::k_leaf_size) {
+            children[lane] = build_node(firsts[lane], counts[lane], index);
+            continue;
+        }
+        leaf_mask |= uint8_t(1u << lane);
+        for (uint32_t s = firsts[lane]; s < firsts[lane] + counts[lane]; s++) {
+            m_bvh.m_leaf_of[m_bvh.m_object[s]] = index;
+        }
+    }
+
+    // Bounds are left to the refit that follows the build
+    Bvh::Node& node = m_bvh.m_nodes[index];
+    for (uint32_t lane = 0; lane < 4; lane++) {
+        node.m_child[lane] = children[lane];
+        node.m_first[lane] = lane < lanes ? firsts[lane] : 0;
+        node.m_count[lane] = lane < lanes ? counts[lane] : 0;
+    }
+    node.m_parent = parent;
+    node.m_lanes = uint8_t(lanes);
+    node.m_leaf_mask = leaf_mask;
+    return index;
+}
+
+void Bvh::build(const Aabb* bounds, uint32_t count)
+{
+    m_nodes.clear();
+    m_object.resize(count);
+    m_slot_of.resize(count);
+    m_leaf_of.assign(count, k_none);
+    if (count == 0) {
+        m_node_dirty.clear();
+        m_refit_pending = false;
+        return;
+    }
+
+    BvhBuilder builder = {*this, bounds, {}};
+    for (uint32_t a = 0; a < 3; a++) {
+        std::vector<float>& centroids = builder.m_centroids[a];
+        centroids.resize(count);
+        for (uint32_t i = 0; i < count; i++) centroids[i] = (bounds[i].min[a] + bounds[i].max[a]) * 0.5f;
+    }
+    for (uint32_t i = 0; i < count; i++) m_object[i] = i;
+    m_nodes.reserve(size_t(count) / (k_leaf_size * 2) + 1);
+    builder.build_node(0, count, k_none);
+
+    // Object bounds go in subtree order, padded so a leaf can always be loaded four at a time
+    std::vector<float>* columns[6] = {&m_min_x, &m_min_y, &m_min_z, &m_max_x, &m_max_y, &m_max_z};
+    for (uint32_t c = 0; c < 6; c++) {
+        columns[c]->assign(size_t(count) + 3, 0.0f);
+        float* column = columns[c]->data();
+        for (uint32_t s = 0; s < count; s++) {
+            const Aabb& box = bounds[m_object[s]];
+            column[s] = c < 3 ? box.min[c] : box.max[c - 3];
+        }
+    }
+    for (uint32_t s = 0; s < count; s++) m_slot_of[m_object[s]] = s;
+
+    m_node_dirty.assign(m_nodes.size(), 1);
+    m_refit_pending = true;
+    refit();
+}
+
+void Bvh::set_bounds(uint32_t object, const Aabb& bounds)
+{
+    uint32_t slot = m_slot_of[object];
+    m_min_x[slot] = bounds.min[0];
+    m_min_y[slot] = bounds.min[1];
+    m_min_z[slot] = bounds.min[2];
+    m_max_x[slot] = bounds.max[0];
+    m_max_y[slot] = bounds.max[1];
+    m_max_z[slot] = bounds.max[2];
+    m_node_dirty[m_leaf_of[object]] = 1;
+    m_refit_pending = true;
+}
+
+static Aabb node_bounds(const Bvh::Node& node)
+{
+    Aabb box = k_empty_box;
+    for (uint32_t lane = 0; lane < node.m_lanes; lane++) {
+        grow(box, {{node.m_min_x[lane], node.m_min_y[lane], node.m_min_z[lane]},
+                   {node.m_max_x[lane], node.m_max_y[lane], node.m_max_z[lane]}});
+    }
+    return box;
+}
+
+void Bvh::refit()
+{
+    if (!m_refit_pending) return;
+
+    // Children always come after their parent, so walking backwards finishes every child before its parent
+    for (size_t n = m_nodes.size(); n-- > 0;) {
+        if (!m_node_dirty[n]) continue;
+        Node& node = m_nodes[n];
+        for (uint32_t lane = 0; lane < node.m_lanes; lane++) {
+            Aabb box = k_empty_box;
+            if (node.m_leaf_mask & (1u << lane)) {
+                for (uint32_t s = node.m_first[lane]; s < node.m_first[lane] + node.m_count[lane]; s++) {
+                    grow(box, {{m_min_x[s], m_min_y[s], m_min_z[s]}, {m_max_x[s], m_max_y[s], m_max_z[s]}});
+                }
+            } else {
+                box = node_bounds(m_nodes[node.m_child[lane]]);
+            }
+            node.m_min_x[lane] = box.min[0];
+            node.m_min_y[lane] = box.min[1];
+            node.m_min_z[lane] = box.min[2];
+            node.m_max_x[lane] = box.max[0];
+            node.m_max_y[lane] = box.max[1];
+            node.m_max_z[lane] = box.max[2];
+        }
+        m_node_dirty[n] = 0;
+        if (node.m_parent != k_none) m_node_dirty[node.m_parent] = 1;
+    }
+    m_refit_pending = false;
+}
+
+float Bvh::sah_cost() const
+{
+    if (m_nodes.empty()) return 0.0f;
+    float root_area = half_area(node_bounds(m_nodes[0]));
+    if (root_area <= 0.0f) return 0.0f;
+    double cost = 0.0;
+    for (const Node& node : m_nodes) {
+        for (uint32_t lane = 0; lane < node.m_lanes; lane++) {
+            Aabb box = {{node.m_min_x[lane], node.m_min_y[lane], node.m_min_z[lane]},
+                        {node.m_max_x[lane], node.m_max_y[lane], node.m_max_z[lane]}};
+            cost += double(half_area(box)) * node.m_count[lane];
+        }
+    }
+    return float(cost / root_area);
+}
+
+// Tests up to four boxes stored lane by lane. Returns a bit for every box touching the frustum, and when inside
+// isn't null a bit for every box entirely within it. Each plane is checked against the box corner furthest along
+// its normal to reject, and the nearest corner to accept
+static uint32_t test_boxes(const float* min_x, const float* min_y, const float* min_z, const float* max_x,
+                           const float* max_y, const float* max_z, uint32_t lanes, const float planes[6][4],
+                           uint32_t* inside)
+{
+    const uint32_t lane_mask = (1u << lanes) - 1;
+#ifdef ATELIER_BVH_SSE
+    __m128 bounds_min[3] = {_mm_loadu_ps(min_x), _mm_loadu_ps(min_y), _mm_loadu_ps(min_z)};
+    __m128 bounds_max[3] = {_mm_loadu_ps(max_x), _mm_loadu_ps(max_y), _mm_loadu_ps(max_z)};
+    const __m128 zero = _mm_setzero_ps();
+    __m128 outside_any = zero;
+    __m128 inside_all = _mm_cmpeq_ps(zero, zero);
+    for (uint32_t p = 0; p < 6; p++) {
+        const float* plane = planes[p];
+        __m128 far_distance = _mm_set1_ps(plane[3]);
+        __m128 near_distance = far_distance;
+        for (uint32_t a = 0; a < 3; a++) {
+            __m128 normal = _mm_set1_ps(plane[a]);
+            bool positive = plane[a] >= 0.0f;
+            __m128 far_corner = positive ? bounds_max[a] : bounds_min[a];
+            __m128 near_corner = positive ? bounds_min[a] : bounds_max[a];
+            far_distance = _mm_add_ps(far_distance, _mm_mul_ps(normal, far_corner));
+            near_distance = _mm_add_ps(near_distance, _mm_mul_ps(normal, near_corner));
+        }
+        outside_any = _mm_or_ps(outside_any, _mm_cmplt_ps(far_distance, zero));
+        inside_all = _mm_and_ps(inside_all, _mm_cmpge_ps(near_distance, zero));
+    }
+    uint32_t visible = ~uint32_t(_mm_movemask_ps(outside_any)) & lane_mask;
+    if (inside != nullptr) *inside = uint32_t(_mm_movemask_ps(inside_all)) & visible;
+    return visible;
+#else
+    const float* bounds_min[3] = {min_x, min_y, min_z};
+    const float* bounds_max[3] = {max_x, max_y, max_z};
+    uint32_t visible = 0, contained = 0;
+    for (uint32_t lane = 0; lane < lanes; lane++) {
+        bool outside_any = false, inside_all = true;
+        for (uint32_t p = 0; p < 6; p++) {
+            const float* plane = planes[p];
+            float far_distance = plane[3], near_distance = plane[3];
+            for (uint32_t a = 0; a < 3; a++) {
+                bool positive = plane[a] >= 0.0f;
+                far_distance += plane[a] * (positive ? bounds_max[a][lane] : bounds_min[a][lane]);
+                near_distance += plane[a] * (positive ? bounds_min[a][lane] : bounds_max[a][lane]);
+            }
+            outside_any = outside_any || far_distance < 0.0f;
+            inside_all = inside_all && near_distance >= 0.0f;
+        }
+        visible |= uint32_t(!outside_any) << lane;
+        contained |= uint32_t(!outside_any && inside_all) << lane;
+    }
+    if (inside != nullptr) *inside = contained;
+    return visible & lane_mask;
+#endif
+}
+
+void Bvh::cull_task(uint32_t task, const float planes[6][4], std::vector<uint32_t>& visible, uint64_t& nodes,
+                    uint64_t& objects) const
+{
+    const bool leaves_only = (task & k_leaves_only) != 0;
+    const uint32_t root = task & ~k_leaves_only;
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(root);
+    while (!stack.empty()) {
+        uint32_t index = stack.back();
+        stack.pop_back();
+        const Node& node = m_nodes[index];
+        uint32_t inside = 0;
+        uint32_t hit = test_boxes(node.m_min_x, node.m_min_y, node.m_min_z, node.m_max_x, node.m_max_y,
+                                  node.m_max_z, node.m_lanes, planes, &inside);
+        nodes++;
+        for (uint32_t lane = 0; lane < node.m_lanes; lane++) {
+            const uint32_t bit = 1u << lane;
+            const bool leaf = (node.m_leaf_mask & bit) != 0;
+            if (!(hit & bit) || (leaves_only && index == root && !leaf)) continue;
+            const uint32_t first = node.m_first[lane];
+            const uint32_t end = first + node.m_count[lane];
+
+            // Nothing under a contained child can be outside, so the whole subtree goes out as it is
+            if (inside & bit) {
+                visible.insert(visible.end(), m_object.begin() + first, m_object.begin() + end);
+                continue;
+            }
+            if (!leaf) {
+                stack.push_back(node.m_child[lane]);
+                continue;
+            }
+            for (uint32_t s = first; s < end; s += 4) {
+                uint32_t lanes = std::min(4u, end - s);
+                uint32_t mask = test_boxes(&m_min_x[s], &m_min_y[s], &m_min_z[s], &m_max_x[s], &m_max_y[s],
+                                           &m_max_z[s], lanes, planes, nullptr);
+                objects += lanes;
+                for (uint32_t i = 0; i < lanes; i++) {
+                    if (mask & (1u << i)) visible.push_back(m_object[s + i]);
+                }
+            }
+        }
+    }
+}
+
+void Bvh::cull(const float planes[6][4], std::vector<uint32_t>& visible, JobSystem* jobs)
+{
+    visible.clear();
+    m_visible = 0;
+    m_nodes_tested = 0;
+    m_objects_tested = 0;
+    if (m_nodes.empty()) return;
+    refit();
+
+    if (jobs == nullptr || jobs->worker_count() == 0) {
+        cull_task(0, planes, visible, m_nodes_tested, m_objects_tested);
+        m_visible = uint32_t(visible.size());
+        return;
+    }
+
+    // Open up the top of the tree until there are a few subtrees per thread. Leaf children of the nodes opened
+    // along the way are culled as tasks of their own, nothing above the subtrees is tested to reject early
+    const size_t wanted = size_t(jobs->worker_count() + 1) * 4;
+    std::vector<uint32_t> frontier = {0}, next;
+    m_tasks.clear();
+    while (frontier.size() + m_tasks.size() < wanted) {
+        next.clear();
+        bool opened = false;
+        for (uint32_t index : frontier) {
+            const Node& node = m_nodes[index];
+            uint32_t inner = ((1u << node.m_lanes) - 1) & ~uint32_t(node.m_leaf_mask);
+            if (inner == 0) {
+                next.push_back(index);
+                continue;
+            }
+            opened = true;
+            if (node.m_leaf_mask != 0) m_tasks.push_back(index | k_leaves_only);
+            for (uint32_t lane = 0; lane < node.m_lanes; lane++) {
+                if (inner & (1u << lane)) next.push_back(node.m_child[lane]);
+            }
+        }
+        frontier.swap(next);
+        if (!opened) break;
+    }
+    m_tasks.insert(m_tasks.end(), frontier.begin(), frontier.end());
+
+    if (m_task_visible.size() < m_tasks.size()) m_task_visible.resize(m_tasks.size());
+    std::atomic<uint64_t> nodes{0}, objects{0};
+    jobs->parallel_for(m_tasks.size(), 1, [&](size_t begin, size_t end) {
+        uint64_t task_nodes = 0, task_objects = 0;
+        for (size_t t = begin; t < end; t++) {
+            m_task_visible[t].clear();
+            cull_task(m_tasks[t], planes, m_task_visible[t], task_nodes, task_objects);
+        }
+        nodes.fetch_add(task_nodes, std::memory_order_relaxed);
+        objects.fetch_add(task_objects, std::memory_order_relaxed);
+    });
+
+    // Compacted in task order, so the same frustum always gives the same list
+    size_t total = 0;
+    for (size_t t = 0; t < m_tasks.size(); t++) total += m_task_visible[t].size();
+    visible.resize(total);
+    size_t offset = 0;
+    for (size_t t = 0; t < m_tasks.size(); t++) {
+        const auto& part = m_task_visible[t];
+        if (!part.empty()) memcpy(visible.data() + offset, part.data(), part.size() * sizeof(uint32_t));
+        offset += part.size();
+    }
+    m_visible = uint32_t(total);
+    m_nodes_tested = nodes.load();
+    m_objects_tested = objects.load();
+}
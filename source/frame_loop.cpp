@@ -0,0 +1,364 @@
+#include "atelier/atelier_frame_loop.h"
+#ifdef ATELIER_IMGUI
+#include "imgui.h"
+#endif
+
+#include <algorithm>
+
+namespace Atelier
+{
+
+// A single colour attachment which ends up ready to present. The overlay's pass keeps what's already there
+static VkRenderPass create_pass(VkDevice device, VkFormat format, bool load)
+{
+    VkAttachmentDescription attachment = {};
+    attachment.initialLayout = load ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_UNDEFINED;
+    attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    attachment.format = format;
+    attachment.loadOp = load ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkAttachmentReference ref = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkSubpassDescription desc = {};
+    desc.pColorAttachments = &ref;
+    desc.colorAttachmentCount = 1;
+
+    VkRenderPassCreateInfo pass_info = {VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+    pass_info.pAttachments = &attachment;
+    pass_info.attachmentCount = 1;
+    pass_info.pSubpasses = &desc;
+    pass_info.subpassCount = 1;
+    VkRenderPass pass = VK_NULL_HANDLE;
+    vkCreateRenderPass(device, &pass_info, nullptr, &pass);
+    return pass;
+}
+
+result FrameLoop::init(VkCompletedDevice& device, uint32_t queue_family, VkQueue gfx_queue, VkQueue present_queue,
+                       const std::vector<VkCompletedSwapchain*>& swaps, const Config& config)
+{
+    if (swaps.empty()) return -1;
+    m_config = config;
+    m_device = &device;
+    m_family = queue_family;
+    m_queue = gfx_queue;
+
+    // Attached before anything allocates so the fallback tracking sees every allocation
+    m_memory.init(device);
+
+    // Every window is acquired on its own, but they're all submitted together and presented by one call
+    if (m_presenter.init(device, queue_family, gfx_queue, present_queue) != k_success) {
+        Log::error("Failed to create the presenter");
+        m_memory.shutdown();
+        m_device = nullptr;
+        return -2;
+    }
+    m_viewports.resize(swaps.size());
+    for (uint32_t i = 0; i < swaps.size(); i++) attach(i, *swaps[i]);
+    const VkCompletedSwapchain& swap = *swaps[0];
+
+    // Workers for whatever the frame hands off, the capture encoders among them
+    m_jobs.init();
+
+    // The readback needs the swapchain to allow transfer source
+    m_capturing = config.m_capture;
+    if (m_capturing && (swap.m_info.m_info.imageUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) == 0) {
+        Log::warn("Swapchain images can't be read back on this surface, capture disabled");
+        m_capturing = false;
+    }
+    if (m_capturing && m_capture.init(device, m_jobs, swap.m_info.m_info.imageFormat,
+                                      swap.m_info.m_info.imageExtent, swap.m_length + 2,
+                                      "captures") != k_success) {
+        Log::warn("Failed to start frame capture");
+        m_capturing = false;
+    }
+
+    // GPU timings of the frame's passes and the HUD which shows them along with the rest of the frame's stats
+    m_scopes.init(device, queue_family, m_presenter.m_frames_in_flight);
+    m_hud.sample_memory(m_memory);
+    m_shaders.init(device);
+#ifdef ATELIER_IMGUI
+    VkRenderPass overlay_pass = m_viewports[0].m_overlay_pass;
+    m_overlay_enabled = overlay_pass != VK_NULL_HANDLE &&
+                        m_overlay.init(device, m_shaders, queue_family, gfx_queue, overlay_pass,
+                                       m_presenter.m_frames_in_flight) == k_success;
+    if (!m_overlay_enabled) Log::warn("Failed to create the overlay, the HUD is disabled");
+#endif
+
+    // From here on the graphics queue belongs to the submission thread, the overlay's font upload above was the
+    // last direct submit
+    if (m_submitter.init(device, gfx_queue) == k_success) {
+        m_presenter.m_submitter = &m_submitter;
+    } else {
+        Log::warn("Failed to start the submission thread, frames are submitted directly");
+    }
+    m_pacer.init(config.m_target_fps);
+
+    // The GPU gets most of the frame interval, the rest covers the present and the timestamps' own jitter. An
+    // uncapped frame rate has nothing to hold, so it stays at full resolution
+    auto& resolution = m_viewports[0].m_resolution.m_controller;
+    resolution.m_target_ns = m_pacer.m_interval_ns * 9 / 10;
+    resolution.m_settle_frames = m_presenter.m_frames_in_flight + 1;
+    return k_success;
+}
+
+void FrameLoop::shutdown()
+{
+    if (m_device == nullptr) return;
+    auto pacing = m_pacer.stats();
+    Log::info("Frame interval %.3f ms mean, %.3f ms stddev, %.3f ms p99 over %llu frames, %llu missed",
+              pacing.m_interval_mean_ms, pacing.m_interval_stddev_ms, pacing.m_interval_p99_ms,
+              (unsigned long long)pacing.m_frames, (unsigned long long)pacing.m_missed);
+    m_device->m_dispatch.log_stats(12);
+    m_pacer.shutdown();
+
+    // Flush out the last captures before the device goes away
+    m_submitter.shutdown();
+    m_presenter.m_submitter = nullptr;
+    vkDeviceWaitIdle(m_device->m_handle);
+    if (m_capturing) {
+        m_capture.poll(m_presenter.serial());
+        m_capture.shutdown();
+        Log::info("Captured %u frames, dropped %u", m_capture.m_written.load(), m_capture.m_dropped.load());
+    }
+    m_jobs.shutdown();
+#ifdef ATELIER_IMGUI
+    m_overlay.shutdown();
+#endif
+    m_shaders.shutdown();
+    m_scopes.shutdown();
+    for (uint32_t i = 0; i < m_viewports.size(); i++) detach(i);
+    m_presenter.shutdown();
+    for (auto& viewport : m_viewports) {
+        if (viewport.m_render_pass != VK_NULL_HANDLE) {
+            vkDestroyRenderPass(m_device->m_handle, viewport.m_render_pass, nullptr);
+        }
+        if (viewport.m_overlay_pass != VK_NULL_HANDLE) {
+            vkDestroyRenderPass(m_device->m_handle, viewport.m_overlay_pass, nullptr);
+        }
+    }
+    m_viewports.clear();
+    auto& heaps = m_memory.m_heaps;
+    for (uint32_t i = 0; i < heaps.size(); i++) {
+        Log::info("Heap %u peaked at %.1f MB of a %.1f MB budget", i,
+                  double(heaps[i].m_high_water) / (1024.0 * 1024.0),
+                  double(heaps[i].m_budget) / (1024.0 * 1024.0));
+    }
+    m_memory.shutdown();
+    m_device = nullptr;
+}
+
+result FrameLoop::attach(uint32_t index, VkCompletedSwapchain& swap)
+{
+    if (index >= m_viewports.size()) return -1;
+    detach(index);
+    Viewport& viewport = m_viewports[index];
+    const auto& info = swap.m_info;
+    const auto& present_families = info.m_supported_queue_indicies;
+    if (std::find(present_families.begin(), present_families.end(), m_family) == present_families.end()) {
+        Log::warn("A window can't be presented from the main queue, it won't be drawn");
+        return -2;
+    }
+    int32_t target = m_presenter.add_target(swap);
+    if (target < 0) return -3;
+    viewport.m_swap = &swap;
+    viewport.m_target = uint32_t(target);
+
+    // The passes only depend on the format, which a surface keeps, so they outlive the swapchains. The overlay's
+    // pipeline is built against its pass and carries on working after a resize
+    VkDevice dev = m_device->m_handle;
+    VkFormat format = info.m_info.imageFormat;
+    if (viewport.m_render_pass == VK_NULL_HANDLE) viewport.m_render_pass = create_pass(dev, format, false);
+#ifdef ATELIER_IMGUI
+    // The overlay pass only differs in what it does with the attachment, so the framebuffers work for both
+    if (index == 0 && viewport.m_overlay_pass == VK_NULL_HANDLE) {
+        viewport.m_overlay_pass = create_pass(dev, format, true);
+    }
+#endif
+
+    VkExtent2D extent = info.m_info.imageExtent;
+    viewport.m_framebuffers.resize(swap.m_length, VK_NULL_HANDLE);
+    VkFramebufferCreateInfo fb = {VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+    fb.width = extent.width;
+    fb.height = extent.height;
+    fb.renderPass = viewport.m_render_pass;
+    fb.layers = 1;
+    fb.attachmentCount = 1;
+    for (uint32_t i = 0; i < swap.m_length; i++) {
+        fb.pAttachments = &swap.m_view_handles[i];
+        vkCreateFramebuffer(dev, &fb, nullptr, &viewport.m_framebuffers[i]);
+    }
+
+    // The main window renders at a scale picked from its GPU time and is stretched back over the swapchain image.
+    // The target is made at the full extent, so changing the scale never allocates
+    bool blit_target = (info.m_info.imageUsage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) != 0;
+    if (index == 0 && m_config.m_dynamic_resolution && blit_target) {
+        viewport.m_scaled = viewport.m_resolution.init(*m_device, format, extent) == k_success;
+    }
+
+    // Nothing in the background changes from frame to frame, so only the framebuffers and the scale go into its
+    // key
+    VkClearValue clear_col = {1.0, 0.0, 0.0, 1.0};
+    if (index != 0) clear_col = {0.1f, 0.1f, 0.1f, 1.0f};  // Tool windows are darker
+    const VkDeviceDispatch& api = m_device->m_dispatch;
+    auto record_background = [&viewport, &api, clear_col, extent](VkCommandBuffer cmd, uint32_t image) {
+        if (viewport.m_scaled) {
+            viewport.m_resolution.begin(cmd, extent, clear_col);
+            viewport.m_resolution.end(cmd);
+            viewport.m_resolution.upscale(cmd, viewport.m_swap->m_image_handles[image], extent,
+                                          VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+            return;
+        }
+        VkRenderPassBeginInfo render_pass = {VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+        render_pass.pClearValues = &clear_col;
+        render_pass.clearValueCount = 1;
+        render_pass.renderArea.offset = {0, 0};
+        render_pass.renderArea.extent = extent;
+        render_pass.renderPass = viewport.m_render_pass;
+        render_pass.framebuffer = viewport.m_framebuffers[image];
+        api.vkCmdBeginRenderPass(cmd, &render_pass, VK_SUBPASS_CONTENTS_INLINE);
+        api.vkCmdEndRenderPass(cmd);
+    };
+    viewport.m_background.init(*m_device, m_family, swap.m_length, record_background);
+    uint64_t key = hash_combine((uint64_t)viewport.m_render_pass, extent.width);
+    key = hash_combine(key, extent.height);
+    for (VkFramebuffer framebuffer : viewport.m_framebuffers) key = hash_combine(key, (uint64_t)framebuffer);
+    viewport.m_background_key = key;
+    viewport.m_background.set_key(key);
+    return k_success;
+}
+
+void FrameLoop::detach(uint32_t index)
+{
+    if (index >= m_viewports.size() || m_viewports[index].m_swap == nullptr) return;
+    Viewport& viewport = m_viewports[index];
+
+    // The queue belongs to the submission thread, so the wait goes through it. Nothing is pushed until the next
+    // frame, which leaves the presenter's own idle wait with the queue to itself
+    if (m_presenter.m_submitter != nullptr) {
+        m_submitter.with_queue([this](VkQueue) { vkDeviceWaitIdle(m_device->m_handle); });
+    }
+    m_presenter.remove_target(viewport.m_target);
+    for (auto& other : m_viewports) {
+        if (other.m_swap != nullptr && other.m_target > viewport.m_target) other.m_target--;
+    }
+
+    viewport.m_background.shutdown();
+    viewport.m_resolution.shutdown();
+    for (VkFramebuffer fb : viewport.m_framebuffers) vkDestroyFramebuffer(m_device->m_handle, fb, nullptr);
+    viewport.m_framebuffers.clear();
+    viewport.m_scaled = false;
+    viewport.m_swap = nullptr;
+}
+
+result FrameLoop::frame(const InputState& input)
+{
+    // Waits for this frame's previous submit and acquires an image from every window
+    if (m_presenter.begin_frame() != k_success) return -1;
+    Viewport& main = m_viewports[0];
+
+#ifdef ATELIER_IMGUI
+    // The HUD is built before recording, it only needs stats from frames which already finished. It reads the
+    // window's input rather than asking the OS, so a recording drives it the same way. A wheel notch is 120
+    bool overlay = m_overlay_enabled && main.m_swap != nullptr;
+    if (overlay) {
+        ImGuiIO& io = ImGui::GetIO();
+        io.AddMousePosEvent(float(input.m_mouse_x), float(input.m_mouse_y));
+        io.AddMouseButtonEvent(0, input.button_down(0));
+        if (input.m_wheel != 0) io.AddMouseWheelEvent(0.0f, float(input.m_wheel) / 120.0f);
+        m_overlay.new_frame(main.m_swap->m_info.m_info.imageExtent, float(m_pacing_delta_ns) / 1e9f);
+        m_hud.draw();
+        ImGui::Render();
+    }
+#else
+    (void)input;
+#endif
+    bool scopes_started = false;
+
+    // Everything up to the completed serial is finished, so its captures can go to the encoders
+    if (m_capturing) m_capture.poll(m_presenter.completed_serial());
+
+    for (size_t i = 0; i < m_viewports.size(); i++) {
+        auto& viewport = m_viewports[i];
+        if (viewport.m_swap == nullptr || !m_presenter.is_active(viewport.m_target)) continue;
+        VkCommandBuffer buffer = m_presenter.command_buffer(viewport.m_target);
+        uint32_t swap_index = m_presenter.image_index(viewport.m_target);
+        VkExtent2D extent = viewport.m_swap->m_info.m_info.imageExtent;
+        if (!scopes_started) {
+            m_scopes.begin_frame(buffer, m_presenter.m_frame);
+            scopes_started = true;
+        }
+
+        // The background goes ahead of this frame's buffer, and is only re-recorded when its key changes
+        if (viewport.m_scaled) {
+            VkExtent2D scaled = viewport.m_resolution.render_extent(extent);
+            uint64_t key = hash_combine(viewport.m_background_key, scaled.width);
+            viewport.m_background.set_key(hash_combine(key, scaled.height));
+        }
+        VkCommandBuffer background = viewport.m_background.acquire(swap_index, m_presenter.serial(),
+                                                                   m_presenter.completed_serial());
+        if (background != VK_NULL_HANDLE) m_presenter.submit_static(viewport.m_target, background);
+#ifdef ATELIER_IMGUI
+        if (overlay && i == 0) {
+            const VkDeviceDispatch& api = m_device->m_dispatch;
+            VkRenderPassBeginInfo render_pass = {VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+            render_pass.renderArea.offset = {0, 0};
+            render_pass.renderArea.extent = extent;
+            render_pass.renderPass = viewport.m_overlay_pass;
+            render_pass.framebuffer = viewport.m_framebuffers[swap_index];
+            uint32_t overlay_scope = m_scopes.begin(buffer, "Overlay");
+            api.vkCmdBeginRenderPass(buffer, &render_pass, VK_SUBPASS_CONTENTS_INLINE);
+            m_overlay.record(buffer, m_presenter.m_frame, ImGui::GetDrawData());
+            api.vkCmdEndRenderPass(buffer);
+            m_scopes.end(buffer, overlay_scope);
+        }
+#endif
+
+        if (m_capturing && i == 0) {
+            m_capture.record(buffer, viewport.m_swap->m_image_handles[swap_index],
+                             viewport.m_swap->m_info.m_info.imageFormat, extent, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                             m_presenter.serial());
+        }
+    }
+
+    // One submit and one present for all of the windows
+    if (m_presenter.end_frame() != k_success) return -2;
+    m_device->m_dispatch.end_frame();
+    m_pacer.end_cpu();
+
+    // A GPU time only comes back once a frame in flight finishes, so each one is reported just the once
+    auto& resolution = main.m_resolution.m_controller;
+    if (m_presenter.gpu_samples() != m_last_gpu_sample) {
+        m_last_gpu_sample = m_presenter.gpu_samples();
+        m_pacer.report_gpu(m_presenter.gpu_time_ns());
+        if (main.m_scaled) resolution.update(m_presenter.gpu_time_ns());
+    }
+
+    // Everything the HUD shows next frame
+    uint64_t frame_start = m_pacer.m_frame_start;
+    m_pacing_delta_ns = m_last_frame_start != 0 ? frame_start - m_last_frame_start : 0;
+    m_last_frame_start = frame_start;
+    auto frame_stats = m_pacer.stats();
+    m_hud.add_frame(double(m_pacing_delta_ns) / 1e6, double(m_presenter.gpu_time_ns()) / 1e6);
+    m_hud.m_frames = frame_stats.m_frames;
+    m_hud.m_missed = frame_stats.m_missed;
+    m_hud.m_stddev_ms = frame_stats.m_interval_stddev_ms;
+    m_hud.m_p99_ms = frame_stats.m_interval_p99_ms;
+    m_hud.m_render_scale = main.m_scaled ? resolution.m_scale : 1.0f;
+    m_hud.m_scopes = m_scopes.m_results;
+    uint64_t calls = m_submitter.m_calls.load(std::memory_order_relaxed);
+    m_hud.m_queue.m_submits = m_presenter.m_submitter != nullptr ? uint32_t(calls - m_last_calls) : 1;
+    m_last_calls = calls;
+    m_hud.m_queue.m_presents = uint32_t(m_presenter.m_present_swaps.size());
+    m_hud.m_queue.m_frames_pending = m_presenter.serial() - m_presenter.completed_serial();
+#ifdef ATELIER_IMGUI
+    m_hud.m_queue.m_overlay_draws = m_overlay.m_last_draws;
+    m_hud.m_queue.m_overlay_vertices = m_overlay.m_last_vertices;
+    m_hud.m_queue.m_overlay_dropped = m_overlay.m_last_dropped;
+#endif
+    m_memory.poll();
+    m_hud.sample_memory(m_memory);
+    return k_success;
+}
+
+}  // namespace Atelier
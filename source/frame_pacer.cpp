@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <thread>
+#include "atelier/atelier_frame_pacer.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+using namespace Atelier;
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+uint64_t Atelier::pacer_now_ns()
+{
+#ifdef _WIN32
+    static const LONGLONG s_frequency = [] {
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        return f.QuadPart;
+    }();
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return uint64_t(now.QuadPart / s_frequency) * 1000000000ull +
+           uint64_t(now.QuadPart % s_frequency) * 1000000000ull / s_frequency;
+#else
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return uint64_t(now.tv_sec) * 1000000000ull + uint64_t(now.tv_nsec);
+#endif
+}
+
+// Sleeps most of the way with the OS timer then spins the rest, the timer alone can wake up a fraction of a
+// millisecond late
+static void sleep_until(uint64_t wake, uint64_t spin_ns, void* timer)
+{
+    uint64_t now = pacer_now_ns();
+    if (wake > now + spin_ns) {
+        uint64_t sleep_ns = wake - now - spin_ns;
+#ifdef _WIN32
+        if (timer != nullptr) {
+            LARGE_INTEGER due;
+            due.QuadPart = -LONGLONG(sleep_ns / 100);  // Relative, in 100ns units
+            if (SetWaitableTimer((HANDLE)timer, &due, 0, nullptr, nullptr, FALSE)) {
+                WaitForSingleObject((HANDLE)timer, INFINITE);
+            }
+        } else {
+            Sleep(DWORD(sleep_ns / 1000000));
+        }
+#elif defined(__linux__)
+        (void)timer;
+        (void)sleep_ns;
+        timespec target;
+        target.tv_sec = time_t((wake - spin_ns) / 1000000000ull);
+        target.tv_nsec = long((wake - spin_ns) % 1000000000ull);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target, nullptr) == EINTR) {
+        }
+#else
+        (void)timer;
+        timespec duration;
+        duration.tv_sec = time_t(sleep_ns / 1000000000ull);
+        duration.tv_nsec = long(sleep_ns % 1000000000ull);
+        nanosleep(&duration, nullptr);
+#endif
+    }
+    while (pacer_now_ns() < wake) std::this_thread::yield();
+}
+
+void FramePredictor::add(double sample)
+{
+    // Roughly the last 16 frames carry the weight, enough to follow a scene change within a quarter second
+    const double alpha = 1.0 / 16.0;
+    if (!m_primed) {
+        m_mean = sample;
+        m_variance = 0.0;
+        m_primed = true;
+        return;
+    }
+    double delta = sample - m_mean;
+    m_mean += alpha * delta;
+    m_variance = (1.0 - alpha) * (m_variance + alpha * delta * delta);
+}
+
+double FramePredictor::predict() const
+{
+    return m_primed ? m_mean + 2.0 * std::sqrt(m_variance) : 0.0;
+}
+
+result FramePacer::init(double target_hz)
+{
+    if (target_hz < 0.0) return -1;
+    set_target_hz(target_hz);
+#ifdef _WIN32
+    // High resolution timers only exist from Windows 10 1803, older ones get the regular timer
+    m_timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (m_timer == nullptr) m_timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+#endif
+    m_deadline = 0;
+    m_frame_start = 0;
+    m_frames = 0;
+    m_missed = 0;
+    return k_success;
+}
+
+void FramePacer::shutdown()
+{
+#ifdef _WIN32
+    if (m_timer != nullptr) CloseHandle((HANDLE)m_timer);
+#endif
+    m_timer = nullptr;
+}
+
+void FramePacer::set_target_hz(double target_hz)
+{
+    m_interval_ns = target_hz > 0.0 ? uint64_t(1e9 / target_hz) : 0;
+}
+
+uint64_t FramePacer::wait_for_frame()
+{
+    uint64_t lead = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        lead = uint64_t(m_cpu.predict() + m_render.predict() + m_gpu.predict()) + m_margin_ns;
+    }
+    uint64_t now = pacer_now_ns();
+    uint64_t wake = now;
+    if (m_interval_ns > 0) {
+        // A frame which costs more than the interval can only start as soon as possible
+        lead = std::min(lead, m_interval_ns);
+        m_deadline += m_interval_ns;
+        if (m_deadline < now + lead) {
+            if (m_frames > 0 && m_deadline < now) m_missed++;
+            m_deadline = now + lead;
+        }
+        wake = m_deadline - lead;
+        sleep_until(wake, m_spin_ns, m_timer);
+    }
+
+    uint64_t start = pacer_now_ns();
+    if (m_frames > 0) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        uint32_t slot = m_history_count++ % k_history;
+        m_intervals_ms[slot] = float(double(start - m_frame_start) / 1e6);
+        m_sleeps_ms[slot] = float(double(start - now) / 1e6);
+    }
+    m_frame_start = start;
+    m_frames++;
+    return start;
+}
+
+void FramePacer::wait_until(uint64_t wake_ns) const
+{
+    sleep_until(wake_ns, m_spin_ns, m_timer);
+}
+
+void FramePacer::end_cpu()
+{
+    uint64_t cpu_ns = pacer_now_ns() - m_frame_start;
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_cpu.add(double(cpu_ns));
+}
+
+void FramePacer::report_render_cpu(uint64_t render_ns)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_render.add(double(render_ns));
+}
+
+void FramePacer::report_gpu(uint64_t gpu_ns)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_gpu.add(double(gpu_ns));
+}
+
+FramePacer::Stats FramePacer::stats() const
+{
+    Stats out;
+    std::lock_guard<std::mutex> lock(m_lock);
+    out.m_target_ms = double(m_interval_ns) / 1e6;
+    out.m_cpu_predicted_ms = m_cpu.predict() / 1e6;
+    out.m_render_predicted_ms = m_render.predict() / 1e6;
+    out.m_gpu_predicted_ms = m_gpu.predict() / 1e6;
+    out.m_frames = m_frames;
+    out.m_missed = m_missed;
+
+    uint32_t count = std::min(m_history_count, k_history);
+    if (count == 0) return out;
+    double sum = 0.0, sleep_sum = 0.0;
+    for (uint32_t i = 0; i < count; i++) {
+        sum += m_intervals_ms[i];
+        sleep_sum += m_sleeps_ms[i];
+    }
+    out.m_interval_mean_ms = sum / count;
+    out.m_sleep_mean_ms = sleep_sum / count;
+    double squares = 0.0;
+    for (uint32_t i = 0; i < count; i++) {
+        double delta = m_intervals_ms[i] - out.m_interval_mean_ms;
+        squares += delta * delta;
+    }
+    out.m_interval_variance_ms2 = squares / count;
+    out.m_interval_stddev_ms = std::sqrt(out.m_interval_variance_ms2);
+
+    float sorted[k_history];
+    std::copy(m_intervals_ms, m_intervals_ms + count, sorted);
+    uint32_t p99 = std::min(count - 1, uint32_t(double(count) * 0.99));
+    std::nth_element(sorted, sorted + p99, sorted + count);
+    out.m_interval_p99_ms = sorted[p99];
+    return out;
+}
@@ -0,0 +1,65 @@
+#include "atelier/atelier_frame_pipeline.h"
+
+#include <algorithm>
+using namespace Atelier;
+
+void FrameHandoff::reset(uint32_t depth)
+{
+    m_depth = std::min(std::max(depth, 1u), k_max_depth);
+    m_published.store(0, std::memory_order_relaxed);
+    m_released.store(0, std::memory_order_relaxed);
+    m_write_frame = 0;
+    m_read_frame = 0;
+    m_closed.store(false, std::memory_order_relaxed);
+}
+
+int32_t FrameHandoff::acquire_write()
+{
+    // With a depth of one the update waits for the last frame to be rendered, which is the serial loop again
+    uint64_t frame = m_write_frame;
+    auto ready = [&]() { return frame < m_released.load(std::memory_order_acquire) + m_depth; };
+    if (!wait(ready)) return -1;
+    return int32_t(frame % m_depth);
+}
+
+void FrameHandoff::publish()
+{
+    m_write_frame++;
+    m_published.store(m_write_frame, std::memory_order_seq_cst);
+    notify();
+}
+
+int32_t FrameHandoff::acquire_read()
+{
+    uint64_t frame = m_read_frame;
+    auto ready = [&]() { return frame < m_published.load(std::memory_order_acquire); };
+    if (!wait(ready)) return -1;
+    return int32_t(frame % m_depth);
+}
+
+void FrameHandoff::release()
+{
+    m_read_frame++;
+    m_released.store(m_read_frame, std::memory_order_seq_cst);
+    notify();
+}
+
+void FrameHandoff::close()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_closed.store(true, std::memory_order_release);
+    }
+    m_wake.notify_all();
+}
+
+void FrameHandoff::notify()
+{
+    // A waiter registers itself before its last check of the counters, so either it sees the new value or we see
+    // it here. Taking the lock makes sure it's actually waiting before it's woken
+    if (m_sleepers.load(std::memory_order_seq_cst) == 0) return;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+    }
+    m_wake.notify_all();
+}
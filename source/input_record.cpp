@@ -0,0 +1,166 @@
+#include "atelier/atelier_input.h"
+#include "atelier/atelier_frame_pacer.h"
+
+#include <cstdio>
+using namespace Atelier;
+
+void InputState::apply(const InputEvent& event)
+{
+    switch (event.m_type) {
+        case InputEventType::k_frame:
+            m_delta_ns = event.m_frame > 0 && event.m_time_ns > m_time_ns ? event.m_time_ns - m_time_ns : 0;
+            m_frame = event.m_frame;
+            m_time_ns = event.m_time_ns;
+            m_wheel = 0;
+            m_resized = false;
+            m_chars.clear();
+            break;
+        case InputEventType::k_resize:
+            m_width = uint32_t(event.m_x);
+            m_height = uint32_t(event.m_y);
+            m_resized = true;
+            break;
+        case InputEventType::k_mouse_move:
+            m_mouse_x = event.m_x;
+            m_mouse_y = event.m_y;
+            break;
+        case InputEventType::k_mouse_button:
+            if (event.m_code < 32) {
+                m_buttons = event.m_down ? m_buttons | (1u << event.m_code) : m_buttons & ~(1u << event.m_code);
+            }
+            break;
+        case InputEventType::k_wheel:
+            m_wheel += event.m_y;
+            break;
+        case InputEventType::k_key:
+            if (event.m_code < 256) m_keys[event.m_code] = event.m_down != 0;
+            break;
+        case InputEventType::k_char:
+            m_chars.push_back(event.m_code);
+            break;
+        case InputEventType::k_focus:
+            // Releases aren't delivered to a window without focus, so nothing can be held across losing it
+            m_focused = event.m_down != 0;
+            if (!m_focused) {
+                m_buttons = 0;
+                for (bool& key : m_keys) key = false;
+            }
+            break;
+        case InputEventType::k_close:
+            m_close = true;
+            break;
+    }
+}
+
+void InputRecorder::begin(uint32_t width, uint32_t height)
+{
+    m_events.clear();
+    m_start_ns = pacer_now_ns();
+    m_frames = 0;
+    m_recording = true;
+    InputEvent resize;
+    resize.m_time_ns = m_start_ns;
+    resize.m_type = InputEventType::k_resize;
+    resize.m_x = int32_t(width);
+    resize.m_y = int32_t(height);
+    record(resize);
+}
+
+void InputRecorder::record(InputEvent event)
+{
+    if (!m_recording) return;
+    event.m_time_ns = event.m_time_ns > m_start_ns ? event.m_time_ns - m_start_ns : 0;
+    if (event.m_type == InputEventType::k_frame) {
+        event.m_frame = m_frames++;
+    } else {
+        event.m_frame = m_frames > 0 ? m_frames - 1 : 0;
+    }
+    m_events.push_back(event);
+}
+
+result InputRecorder::write(const char* path) const
+{
+    Header header = {};
+    header.magic = k_magic;
+    header.version = k_version;
+    header.event_size = sizeof(InputEvent);
+    header.frame_count = m_frames;
+    header.event_count = m_events.size();
+    header.duration_ns = m_events.empty() ? 0 : m_events.back().m_time_ns;
+
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        Log::error("Failed to open input recording for writing: %s", path);
+        return -1;
+    }
+    bool ok = fwrite(&header, sizeof(Header), 1, file) == 1;
+    ok = ok && fwrite(m_events.data(), sizeof(InputEvent), m_events.size(), file) == m_events.size();
+    fclose(file);
+    if (!ok) {
+        Log::error("Failed while writing input recording: %s", path);
+        return -2;
+    }
+    return k_success;
+}
+
+result InputReplay::open(const char* path)
+{
+    close();
+    if (m_file.open(path) != k_success) return -1;
+    if (m_file.m_size < sizeof(InputRecorder::Header)) {
+        Log::error("Input recording is too small to be valid: %s", path);
+        close();
+        return -2;
+    }
+    const auto* header = reinterpret_cast<const InputRecorder::Header*>(m_file.m_data);
+    if (header->magic != InputRecorder::k_magic || header->version != InputRecorder::k_version ||
+        header->event_size != sizeof(InputEvent)) {
+        Log::error("Input recording has an unknown magic, version or event layout: %s", path);
+        close();
+        return -3;
+    }
+    if (header->event_count > (m_file.m_size - sizeof(InputRecorder::Header)) / sizeof(InputEvent)) {
+        Log::error("Input recording is truncated: %s", path);
+        close();
+        return -4;
+    }
+    m_header = header;
+    m_events = reinterpret_cast<const InputEvent*>(m_file.m_data + sizeof(InputRecorder::Header));
+    return k_success;
+}
+
+void InputReplay::close()
+{
+    m_header = nullptr;
+    m_events = nullptr;
+    m_next = 0;
+    m_start_ns = 0;
+    m_file.close();
+}
+
+bool InputReplay::next_frame(InputState& state)
+{
+    if (m_header == nullptr) return false;
+    const uint64_t count = m_header->event_count;
+
+    // Only the starting size comes ahead of the first frame
+    while (m_next < count && m_events[m_next].m_type != InputEventType::k_frame) state.apply(m_events[m_next++]);
+    if (m_next >= count) return false;
+    const InputEvent& frame = m_events[m_next++];
+
+    // Paced frames start the same time after the first one as they did when recorded, a frame that's already late
+    // starts straight away
+    if (m_paced) {
+        uint64_t now = pacer_now_ns();
+        if (m_start_ns == 0) m_start_ns = now - frame.m_time_ns;
+        uint64_t target = m_start_ns + frame.m_time_ns;
+        if (now < target) {
+            static const FramePacer s_untimed;  // No timer of its own, the OS sleep and the same spin at the end
+            (m_pacer != nullptr ? m_pacer : &s_untimed)->wait_until(target);
+        }
+    }
+
+    state.apply(frame);
+    while (m_next < count && m_events[m_next].m_type != InputEventType::k_frame) state.apply(m_events[m_next++]);
+    return true;
+}
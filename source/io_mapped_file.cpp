@@ -0,0 +1,129 @@
+#include "atelier/atelier_io.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+using namespace Atelier;
+
+MappedFile::~MappedFile() { close(); }
+
+MappedFile::MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this == &other) return *this;
+    close();
+    std::swap(m_data, other.m_data);
+    std::swap(m_size, other.m_size);
+    std::swap(m_file, other.m_file);
+    std::swap(m_mapping, other.m_mapping);
+    return *this;
+}
+
+#ifdef _WIN32
+
+result MappedFile::open(const char* path)
+{
+    close();
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        Log::error("Failed to open file for mapping: %s", path);
+        return -1;
+    }
+
+    LARGE_INTEGER size = {};
+    if (!GetFileSizeEx(file, &size)) {
+        Log::error("Failed to get size of file: %s", path);
+        CloseHandle(file);
+        return -2;
+    }
+
+    // Windows refuses to make a mapping object of an empty file, so just keep the file handle around
+    m_file = file;
+    m_size = static_cast<size_t>(size.QuadPart);
+    if (m_size == 0) return k_success;
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        Log::error("Failed to create file mapping: %s", path);
+        close();
+        return -3;
+    }
+    m_mapping = mapping;
+
+    m_data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (m_data == nullptr) {
+        Log::error("Failed to map view of file: %s", path);
+        close();
+        return -4;
+    }
+    return k_success;
+}
+
+void MappedFile::close()
+{
+    if (m_data != nullptr) UnmapViewOfFile(m_data);
+    if (m_mapping != nullptr) CloseHandle((HANDLE)m_mapping);
+    if (m_file != nullptr) CloseHandle((HANDLE)m_file);
+    m_data = nullptr;
+    m_size = 0;
+    m_mapping = nullptr;
+    m_file = nullptr;
+}
+
+#else
+
+// On posix we store the descriptor offset by one in the file pointer, that way descriptor 0 isn't a null handle
+static int to_fd(void* handle) { return static_cast<int>(reinterpret_cast<intptr_t>(handle)) - 1; }
+static void* from_fd(int fd) { return reinterpret_cast<void*>(static_cast<intptr_t>(fd) + 1); }
+
+result MappedFile::open(const char* path)
+{
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        Log::error("Failed to open file for mapping: %s", path);
+        return -1;
+    }
+
+    struct stat st = {};
+    if (fstat(fd, &st) != 0) {
+        Log::error("Failed to get size of file: %s", path);
+        ::close(fd);
+        return -2;
+    }
+
+    m_file = from_fd(fd);
+    m_size = static_cast<size_t>(st.st_size);
+    if (m_size == 0) return k_success;
+
+    void* view = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED) {
+        Log::error("Failed to map view of file: %s", path);
+        close();
+        return -4;
+    }
+    m_data = static_cast<const uint8_t*>(view);
+    return k_success;
+}
+
+void MappedFile::close()
+{
+    if (m_data != nullptr) munmap(const_cast<uint8_t*>(m_data), m_size);
+    if (m_file != nullptr) ::close(to_fd(m_file));
+    m_data = nullptr;
+    m_size = 0;
+    m_mapping = nullptr;
+    m_file = nullptr;
+}
+
+#endif
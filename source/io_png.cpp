@@ -0,0 +1,122 @@
+#include "atelier/atelier_io.h"
+
+#include <cstdio>
+#include <vector>
+using namespace Atelier;
+
+static const uint32_t* crc_table()
+{
+    static const auto table = []() {
+        std::vector<uint32_t> t(256);
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+    return table.data();
+}
+
+static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size)
+{
+    const uint32_t* table = crc_table();
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void put_be32(std::vector<uint8_t>& out, uint32_t v)
+{
+    out.push_back(uint8_t(v >> 24));
+    out.push_back(uint8_t(v >> 16));
+    out.push_back(uint8_t(v >> 8));
+    out.push_back(uint8_t(v));
+}
+
+// Appends a chunk with its length and crc, the crc covers the type and the data
+static void put_chunk(std::vector<uint8_t>& out, const char type[4], const uint8_t* data, size_t size)
+{
+    put_be32(out, static_cast<uint32_t>(size));
+    size_t crc_start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    put_be32(out, crc32(0, out.data() + crc_start, size + 4));
+}
+
+result Atelier::write_png(const char* path, const uint8_t* rgba, uint32_t width, uint32_t height, size_t row_stride)
+{
+    if (rgba == nullptr || width == 0 || height == 0) return -1;
+
+    // Filtered scanlines are a zero filter byte followed by the row, the adler sum runs over exactly that
+    size_t row_bytes = size_t(width) * 4;
+    size_t raw_size = (row_bytes + 1) * height;
+    static constexpr size_t k_block = 65535;
+    size_t block_count = (raw_size + k_block - 1) / k_block;
+
+    std::vector<uint8_t> zlib;
+    zlib.reserve(2 + raw_size + block_count * 5 + 4);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+
+    // Emit stored blocks while walking the scanlines, the block boundaries don't care about row boundaries
+    uint32_t a = 1, b = 0;
+    size_t remaining = raw_size;
+    uint32_t row = 0;
+    size_t row_offset = 0;  // Position inside the current filtered row, 0 is the filter byte
+    while (remaining > 0) {
+        size_t len = remaining < k_block ? remaining : k_block;
+        remaining -= len;
+        zlib.push_back(remaining == 0 ? 1 : 0);
+        zlib.push_back(uint8_t(len));
+        zlib.push_back(uint8_t(len >> 8));
+        zlib.push_back(uint8_t(~len));
+        zlib.push_back(uint8_t(~len >> 8));
+
+        while (len > 0) {
+            if (row_offset == 0) {
+                zlib.push_back(0);
+                b = (b + a) % 65521;
+                row_offset = 1;
+                len--;
+                continue;
+            }
+            const uint8_t* src = rgba + size_t(row) * row_stride + (row_offset - 1);
+            size_t take = row_bytes - (row_offset - 1);
+            if (take > len) take = len;
+            zlib.insert(zlib.end(), src, src + take);
+            for (size_t i = 0; i < take; i++) {
+                a = (a + src[i]) % 65521;
+                b = (b + a) % 65521;
+            }
+            len -= take;
+            row_offset += take;
+            if (row_offset == row_bytes + 1) {
+                row_offset = 0;
+                row++;
+            }
+        }
+    }
+    put_be32(zlib, (b << 16) | a);
+
+    std::vector<uint8_t> png;
+    png.reserve(zlib.size() + 64);
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    png.insert(png.end(), signature, signature + 8);
+
+    uint8_t ihdr[13] = {uint8_t(width >> 24),  uint8_t(width >> 16),  uint8_t(width >> 8),  uint8_t(width),
+                        uint8_t(height >> 24), uint8_t(height >> 16), uint8_t(height >> 8), uint8_t(height),
+                        8, 6, 0, 0, 0};  // 8 bit depth, RGBA, deflate, no filter method, not interlaced
+    put_chunk(png, "IHDR", ihdr, sizeof(ihdr));
+    put_chunk(png, "IDAT", zlib.data(), zlib.size());
+    put_chunk(png, "IEND", nullptr, 0);
+
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        Log::error("Failed to open %s for writing", path);
+        return -2;
+    }
+    bool ok = fwrite(png.data(), 1, png.size(), file) == png.size();
+    fclose(file);
+    return ok ? k_success : -3;
+}
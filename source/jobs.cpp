@@ -0,0 +1,118 @@
+#include "atelier/atelier_jobs.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+using namespace Atelier;
+
+result JobSystem::init(uint32_t worker_count)
+{
+    if (!m_workers.empty()) return -1;
+    if (worker_count == 0) {
+        uint32_t hw = std::thread::hardware_concurrency();
+        worker_count = hw > 1 ? hw - 1 : 1;
+    }
+
+    m_stopping = false;
+    m_workers.reserve(worker_count);
+    for (uint32_t i = 0; i < worker_count; i++) {
+        m_workers.emplace_back([this]() { worker_main(); });
+    }
+    return k_success;
+}
+
+void JobSystem::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (auto& worker : m_workers) {
+        if (worker.joinable()) worker.join();
+    }
+    m_workers.clear();
+}
+
+void JobSystem::push(Job job)
+{
+    // Without any workers just run inline, this keeps single threaded setups working
+    if (m_workers.empty()) {
+        job();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_queue.push_back(std::move(job));
+    }
+    m_wake.notify_one();
+}
+
+void JobSystem::wait_idle()
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_idle.wait(lock, [this]() { return m_queue.empty() && m_active == 0; });
+}
+
+void JobSystem::worker_main()
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+    while (true) {
+        m_wake.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+
+        // When stopping we still drain the queue so nothing pushed before shutdown is lost
+        if (m_queue.empty()) return;
+
+        Job job = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_active++;
+        lock.unlock();
+
+        job();
+
+        lock.lock();
+        m_active--;
+        if (m_queue.empty() && m_active == 0) m_idle.notify_all();
+    }
+}
+
+void JobSystem::parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn)
+{
+    if (count == 0) return;
+    grain = std::max<size_t>(grain, 1);
+    size_t chunks = (count + grain - 1) / grain;
+    if (chunks == 1 || m_workers.empty()) {
+        fn(0, count);
+        return;
+    }
+
+    // Everyone, including this thread, pulls chunks from a shared counter until they run out. The state is
+    // shared so that helpers which start after we've returned find nothing left to do and exit immediately
+    struct Shared {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        std::mutex lock;
+        std::condition_variable finished;
+    };
+    auto shared = std::make_shared<Shared>();
+    auto run = [shared, count, grain, chunks, &fn]() {
+        size_t completed = 0;
+        for (size_t c = shared->next.fetch_add(1); c < chunks; c = shared->next.fetch_add(1)) {
+            fn(c * grain, std::min(count, (c + 1) * grain));
+            completed++;
+        }
+        if (completed == 0) return;
+        if (shared->done.fetch_add(completed) + completed == chunks) {
+            std::lock_guard<std::mutex> guard(shared->lock);
+            shared->finished.notify_all();
+        }
+    };
+
+    size_t helpers = std::min<size_t>(chunks - 1, m_workers.size());
+    for (size_t i = 0; i < helpers; i++) push(run);
+    run();
+
+    std::unique_lock<std::mutex> lock(shared->lock);
+    shared->finished.wait(lock, [&]() { return shared->done.load() == chunks; });
+}
@@ -1,14 +1,24 @@
 #include "atelier/atelier_base.h"
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
+#endif
 
-#include <varargs.h>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
 #include <string>
 
+// Where every message ends up, stdout unless redirected
+static FILE* s_output = nullptr;
+
 static std::string fmt_va(const char* const msg, va_list va_args)
 {
-    // How many chars we need
-    size_t required_size = vsnprintf(nullptr, 0, msg, va_args);
+    // How many chars we need. Counting consumes the list, so count on a copy
+    va_list count_args;
+    va_copy(count_args, va_args);
+    size_t required_size = vsnprintf(nullptr, 0, msg, count_args);
+    va_end(count_args);
 
     // vsn printf doesn't count null terminator!
     std::string out;
@@ -21,7 +31,7 @@ static std::string fmt_va(const char* const msg, va_list va_args)
 
 void Atelier::Log::init()
 {
-#ifndef NDEBUG
+#if defined(_WIN32) && !defined(NDEBUG)
     // Do we have a console attached in win32?
     if (!AttachConsole(ATTACH_PARENT_PROCESS)) {
         AllocConsole();
@@ -33,12 +43,14 @@ void Atelier::Log::init()
 
 void Atelier::Log::shutdown()
 {
-#ifndef NDEBUG
+#if defined(_WIN32) && !defined(NDEBUG)
     system("pause");
 #endif
 }
 
-void Atelier::Log::unformatted(const char* const msg) { printf("%s", msg); }
+void Atelier::Log::redirect(FILE* output) { s_output = output; }
+
+void Atelier::Log::unformatted(const char* const msg) { fputs(msg, s_output != nullptr ? s_output : stdout); }
 
 void Atelier::Log::info(const char* const msg, ...)
 {
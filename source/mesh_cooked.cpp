@@ -0,0 +1,242 @@
+#include "atelier/atelier_mesh.h"
+
+#include <algorithm>
+using namespace Atelier;
+
+// Whether the range lies inside a file of the given size, without adding anything that could overflow
+static bool range_in_file(uint64_t offset, uint64_t size, uint64_t file_size)
+{
+    return offset <= file_size && size <= file_size - offset;
+}
+
+result CookedMeshFile::open(const char* path)
+{
+    close();
+    if (m_file.open(path) != k_success) return -1;
+
+    // Nothing in the mapping is trusted until every range has been checked against the file size
+    if (m_file.m_size < sizeof(Header)) {
+        Log::error("Cooked mesh file is too small to be valid: %s", path);
+        close();
+        return -2;
+    }
+    const auto* header = reinterpret_cast<const Header*>(m_file.m_data);
+    if (header->magic != k_magic || header->version != k_version || header->vertex_stride != sizeof(MeshVertex)) {
+        Log::error("Cooked mesh file has an unknown magic, version or vertex layout: %s", path);
+        close();
+        return -3;
+    }
+    // Indices have to follow the vertices, the upload stages both as one range
+    const uint64_t size = m_file.m_size;
+    bool in_file = range_in_file(sizeof(Header), uint64_t(header->mesh_count) * sizeof(Mesh), size) &&
+                   range_in_file(header->string_table_offset, header->string_table_size, size) &&
+                   range_in_file(header->vertex_offset, header->vertex_bytes, size) &&
+                   range_in_file(header->index_offset, header->index_bytes, size);
+    bool ordered = header->index_offset >= header->vertex_offset &&
+                   header->index_offset - header->vertex_offset >= header->vertex_bytes;
+    bool aligned = header->vertex_offset % k_data_alignment == 0 && header->index_offset % k_data_alignment == 0;
+    uint64_t strings_end = header->string_table_offset + header->string_table_size;
+    bool terminated = header->string_table_size == 0 || (in_file && m_file.m_data[strings_end - 1] == '\0');
+    if (!in_file || !ordered || !aligned || !terminated) {
+        Log::error("Cooked mesh file is truncated: %s", path);
+        close();
+        return -4;
+    }
+
+    m_header = header;
+    m_meshes = reinterpret_cast<const Mesh*>(m_file.m_data + sizeof(Header));
+    m_strings = reinterpret_cast<const char*>(m_file.m_data + header->string_table_offset);
+    uint64_t vertex_count = header->vertex_bytes / sizeof(MeshVertex);
+    uint64_t index_count = header->index_bytes / sizeof(uint32_t);
+    m_name_lookup.reserve(header->mesh_count);
+    for (uint32_t i = 0; i < header->mesh_count; i++) {
+        const Mesh& mesh = m_meshes[i];
+        if (uint64_t(mesh.first_vertex) + mesh.vertex_count > vertex_count ||
+            uint64_t(mesh.first_index) + mesh.index_count > index_count ||
+            mesh.name_offset >= header->string_table_size) {
+            Log::error("Cooked mesh %u is out of bounds: %s", i, path);
+            close();
+            return -5;
+        }
+
+        // Indices are relative to the mesh's first vertex, one past its count would read another mesh's vertices
+        // or past the buffer on the GPU
+        const uint32_t* mesh_indices = indices() + mesh.first_index;
+        uint32_t highest = 0;
+        for (uint32_t j = 0; j < mesh.index_count; j++) highest = std::max(highest, mesh_indices[j]);
+        if (mesh.index_count > 0 && highest >= mesh.vertex_count) {
+            Log::error("Cooked mesh %u has index %u past its %u vertices: %s", i, highest, mesh.vertex_count,
+                       path);
+            close();
+            return -6;
+        }
+        m_name_lookup[std::string(m_strings + mesh.name_offset)] = i;
+    }
+    return k_success;
+}
+
+void CookedMeshFile::close()
+{
+    m_name_lookup.clear();
+    m_header = nullptr;
+    m_meshes = nullptr;
+    m_strings = nullptr;
+    m_file.close();
+}
+
+const CookedMeshFile::Mesh* CookedMeshFile::find(const char* name) const
+{
+    auto it = m_name_lookup.find(name);
+    return it == m_name_lookup.end() ? nullptr : &m_meshes[it->second];
+}
+
+static uint64_t align_up(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+result CookedMeshFile::write(const char* path, const std::vector<ImportedMesh>& meshes)
+{
+    // The table and string sizes decide where the geometry starts, so they're built first
+    std::vector<Mesh> table(meshes.size());
+    std::string strings;
+    uint64_t vertex_count = 0;
+    uint64_t index_count = 0;
+    for (size_t i = 0; i < meshes.size(); i++) {
+        Mesh& mesh = table[i];
+        mesh = {};
+        mesh.first_vertex = uint32_t(vertex_count);
+        mesh.vertex_count = uint32_t(meshes[i].m_vertices.size());
+        mesh.first_index = uint32_t(index_count);
+        mesh.index_count = uint32_t(meshes[i].m_indices.size());
+        memcpy(mesh.min, meshes[i].m_min, sizeof(mesh.min));
+        memcpy(mesh.max, meshes[i].m_max, sizeof(mesh.max));
+        mesh.name_offset = uint32_t(strings.size());
+        strings.append(meshes[i].m_name);
+        strings.push_back('\0');
+        vertex_count += mesh.vertex_count;
+        index_count += mesh.index_count;
+    }
+    if (vertex_count > UINT32_MAX || index_count > UINT32_MAX) {
+        Log::error("Too much geometry to cook into one file: %s", path);
+        return -1;
+    }
+
+    Header header = {};
+    header.magic = k_magic;
+    header.version = k_version;
+    header.mesh_count = uint32_t(meshes.size());
+    header.vertex_stride = sizeof(MeshVertex);
+    header.string_table_offset = sizeof(Header) + table.size() * sizeof(Mesh);
+    header.string_table_size = uint32_t(strings.size());
+    header.vertex_offset = align_up(header.string_table_offset + strings.size(), k_data_alignment);
+    header.vertex_bytes = vertex_count * sizeof(MeshVertex);
+    header.index_offset = align_up(header.vertex_offset + header.vertex_bytes, k_data_alignment);
+    header.index_bytes = index_count * sizeof(uint32_t);
+
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        Log::error("Failed to open cooked mesh file for writing: %s", path);
+        return -2;
+    }
+    static const uint8_t zeros[k_data_alignment] = {};
+    bool ok = fwrite(&header, sizeof(Header), 1, file) == 1;
+    ok = ok && fwrite(table.data(), sizeof(Mesh), table.size(), file) == table.size();
+    ok = ok && fwrite(strings.data(), 1, strings.size(), file) == strings.size();
+    size_t padding = size_t(header.vertex_offset - header.string_table_offset - strings.size());
+    ok = ok && fwrite(zeros, 1, padding, file) == padding;
+    for (const auto& mesh : meshes) {
+        ok = ok && fwrite(mesh.m_vertices.data(), sizeof(MeshVertex), mesh.m_vertices.size(), file) ==
+                     mesh.m_vertices.size();
+    }
+    padding = size_t(header.index_offset - header.vertex_offset - header.vertex_bytes);
+    ok = ok && fwrite(zeros, 1, padding, file) == padding;
+    for (const auto& mesh : meshes) {
+        ok = ok && fwrite(mesh.m_indices.data(), sizeof(uint32_t), mesh.m_indices.size(), file) ==
+                     mesh.m_indices.size();
+    }
+    fclose(file);
+
+    if (!ok) {
+        Log::error("Failed while writing cooked mesh file: %s", path);
+        return -3;
+    }
+    return k_success;
+}
+
+result CookedMeshFile::upload(VkCompletedDevice& device, uint32_t queue_family, VkQueue queue,
+                              VkCompletedBuffer& vertices, VkCompletedBuffer& indices) const
+{
+    if (m_header == nullptr || m_header->vertex_bytes == 0 || m_header->index_bytes == 0) return -1;
+    const VkMemoryPropertyFlags local = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    const VkBufferUsageFlags vertex_usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    const VkBufferUsageFlags index_usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    if (vertices.init(device, m_header->vertex_bytes, vertex_usage, local) != k_success ||
+        indices.init(device, m_header->index_bytes, index_usage, local) != k_success) {
+        vertices.shutdown();
+        return -2;
+    }
+
+    // Integrated GPUs often have device local memory the host can write, which needs no copy on the GPU at all
+    const uint8_t* geometry = m_file.m_data + m_header->vertex_offset;
+    if (vertices.m_mapped != nullptr && indices.m_mapped != nullptr) {
+        memcpy(vertices.m_mapped, geometry, m_header->vertex_bytes);
+        memcpy(indices.m_mapped, m_file.m_data + m_header->index_offset, m_header->index_bytes);
+        vertices.flush(0, vertices.m_size);
+        indices.flush(0, indices.m_size);
+        return k_success;
+    }
+
+    // Vertices and indices are one range in the file, so staging is a single memcpy from the mapping
+    VkDeviceSize span = m_header->index_offset + m_header->index_bytes - m_header->vertex_offset;
+    VkCompletedBuffer staging;
+    if (staging.init(device, span, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != k_success) {
+        vertices.shutdown();
+        indices.shutdown();
+        return -3;
+    }
+    memcpy(staging.m_mapped, geometry, span);
+
+    VkDevice dev = device.m_handle;
+    VkCommandPool pool = VK_NULL_HANDLE;
+    VkCommandBuffer cmd = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    VkCommandPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    pool_info.queueFamilyIndex = queue_family;
+    VkCommandBufferAllocateInfo buffer_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    buffer_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    buffer_info.commandBufferCount = 1;
+    VkFenceCreateInfo fence_info = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    bool ok = vkCreateCommandPool(dev, &pool_info, nullptr, &pool) == VK_SUCCESS;
+    buffer_info.commandPool = pool;
+    ok = ok && vkAllocateCommandBuffers(dev, &buffer_info, &cmd) == VK_SUCCESS;
+    ok = ok && vkCreateFence(dev, &fence_info, nullptr, &fence) == VK_SUCCESS;
+    if (ok) {
+        VkCommandBufferBeginInfo begin = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+        begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(cmd, &begin);
+        VkBufferCopy vertex_copy = {0, 0, m_header->vertex_bytes};
+        VkBufferCopy index_copy = {m_header->index_offset - m_header->vertex_offset, 0, m_header->index_bytes};
+        vkCmdCopyBuffer(cmd, staging.m_handle, vertices.m_handle, 1, &vertex_copy);
+        vkCmdCopyBuffer(cmd, staging.m_handle, indices.m_handle, 1, &index_copy);
+        vkEndCommandBuffer(cmd);
+
+        VkSubmitInfo submit = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        submit.commandBufferCount = 1;
+        submit.pCommandBuffers = &cmd;
+        ok = vkQueueSubmit(queue, 1, &submit, fence) == VK_SUCCESS &&
+             vkWaitForFences(dev, 1, &fence, VK_TRUE, UINT64_MAX) == VK_SUCCESS;
+    }
+    if (fence != VK_NULL_HANDLE) vkDestroyFence(dev, fence, nullptr);
+    if (pool != VK_NULL_HANDLE) vkDestroyCommandPool(dev, pool, nullptr);
+    staging.shutdown();
+    if (!ok) {
+        Log::error("Failed to upload cooked meshes");
+        vertices.shutdown();
+        indices.shutdown();
+        return -4;
+    }
+    return k_success;
+}
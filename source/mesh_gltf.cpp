@@ -0,0 +1,623 @@
+#include "atelier/atelier_frame_pacer.h"
+#include "atelier/atelier_jobs.h"
+#include "atelier/atelier_mesh.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+using namespace Atelier;
+
+/**
+ * @brief Just enough of a JSON document for glTF. Object members keep their file order, lookups are linear which
+ * is fine for the handful of keys a glTF object has
+ */
+struct GltfJson {
+    enum class Type : uint8_t { k_null, k_bool, k_number, k_string, k_array, k_object };
+    Type m_type = Type::k_null;
+    double m_number = 0.0;  // Also holds booleans as 0 or 1
+    std::string m_string;
+    std::vector<GltfJson> m_items;  // Array elements, or object values in the same order as m_keys
+    std::vector<std::string> m_keys;
+
+    const GltfJson* find(const char* key) const
+    {
+        if (m_type != Type::k_object) return nullptr;
+        for (size_t i = 0; i < m_keys.size(); i++) {
+            if (m_keys[i] == key) return &m_items[i];
+        }
+        return nullptr;
+    }
+
+    int64_t integer(const char* key, int64_t fallback) const
+    {
+        const GltfJson* value = find(key);
+        return value != nullptr && value->m_type == Type::k_number ? int64_t(value->m_number) : fallback;
+    }
+
+    // Elements of an array member, empty when it's missing or not an array
+    const std::vector<GltfJson>& array(const char* key) const
+    {
+        static const std::vector<GltfJson> empty;
+        const GltfJson* value = find(key);
+        return value != nullptr && value->m_type == Type::k_array ? value->m_items : empty;
+    }
+};
+
+struct GltfJsonParser {
+    static constexpr uint32_t k_max_depth = 64;
+    const char* m_cur = nullptr;
+    const char* m_end = nullptr;
+    uint32_t m_depth = 0;
+
+    void skip_space()
+    {
+        while (m_cur < m_end && (*m_cur == ' ' || *m_cur == '\t' || *m_cur == '\n' || *m_cur == '\r')) m_cur++;
+    }
+
+    bool literal(const char* word)
+    {
+        size_t length = strlen(word);
+        if (size_t(m_end - m_cur) < length || memcmp(m_cur, word, length) != 0) return false;
+        m_cur += length;
+        return true;
+    }
+
+    static void append_utf8(std::string& out, uint32_t code)
+    {
+        if (code < 0x80) {
+            out.push_back(char(code));
+        } else if (code < 0x800) {
+            out.push_back(char(0xC0 | (code >> 6)));
+            out.push_back(char(0x80 | (code & 0x3F)));
+        } else if (code < 0x10000) {
+            out.push_back(char(0xE0 | (code >> 12)));
+            out.push_back(char(0x80 | ((code >> 6) & 0x3F)));
+            out.push_back(char(0x80 | (code & 0x3F)));
+        } else {
+            out.push_back(char(0xF0 | (code >> 18)));
+            out.push_back(char(0x80 | ((code >> 12) & 0x3F)));
+            out.push_back(char(0x80 | ((code >> 6) & 0x3F)));
+            out.push_back(char(0x80 | (code & 0x3F)));
+        }
+    }
+
+    bool hex4(uint32_t& out)
+    {
+        if (m_end - m_cur < 4) return false;
+        out = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = *m_cur++;
+            uint32_t digit = 0;
+            if (c >= '0' && c <= '9') {
+                digit = uint32_t(c - '0');
+            } else if (c >= 'a' && c <= 'f') {
+                digit = uint32_t(c - 'a' + 10);
+            } else if (c >= 'A' && c <= 'F') {
+                digit = uint32_t(c - 'A' + 10);
+            } else {
+                return false;
+            }
+            out = out << 4 | digit;
+        }
+        return true;
+    }
+
+    bool parse_string(std::string& out)
+    {
+        if (m_cur >= m_end || *m_cur != '"') return false;
+        m_cur++;
+        out.clear();
+        while (m_cur < m_end && *m_cur != '"') {
+            char c = *m_cur++;
+            if (c != '\\') {
+                out.push_back(c);
+                continue;
+            }
+            if (m_cur >= m_end) return false;
+            char escape = *m_cur++;
+            switch (escape) {
+                case '"': out.push_back('"'); break;
+                case '\\': out.push_back('\\'); break;
+                case '/': out.push_back('/'); break;
+                case 'b': out.push_back('\b'); break;
+                case 'f': out.push_back('\f'); break;
+                case 'n': out.push_back('\n'); break;
+                case 'r': out.push_back('\r'); break;
+                case 't': out.push_back('\t'); break;
+                case 'u': {
+                    uint32_t code = 0;
+                    if (!hex4(code)) return false;
+
+                    // Characters outside the basic plane come as a surrogate pair
+                    if (code >= 0xD800 && code < 0xDC00) {
+                        uint32_t low = 0;
+                        if (!literal("\\u") || !hex4(low) || low < 0xDC00 || low >= 0xE000) return false;
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    append_utf8(out, code);
+                    break;
+                }
+                default: return false;
+            }
+        }
+        if (m_cur >= m_end) return false;
+        m_cur++;
+        return true;
+    }
+
+    bool parse_number(double& out)
+    {
+        // strtod wants a terminator, which a chunk inside a .glb doesn't have
+        char buffer[64];
+        size_t length = 0;
+        while (m_cur + length < m_end && length < sizeof(buffer) - 1 && m_cur[length] != '\0' &&
+               strchr("+-0123456789.eE", m_cur[length]) != nullptr) {
+            length++;
+        }
+        if (length == 0) return false;
+        memcpy(buffer, m_cur, length);
+        buffer[length] = '\0';
+        char* parsed_end = nullptr;
+        out = strtod(buffer, &parsed_end);
+        if (parsed_end != buffer + length) return false;
+        m_cur += length;
+        return true;
+    }
+
+    bool parse_value(GltfJson& out)
+    {
+        skip_space();
+        if (m_cur >= m_end) return false;
+        switch (*m_cur) {
+            case '{': return parse_object(out);
+            case '[': return parse_array(out);
+            case '"': out.m_type = GltfJson::Type::k_string; return parse_string(out.m_string);
+            case 't': out.m_type = GltfJson::Type::k_bool; out.m_number = 1.0; return literal("true");
+            case 'f': out.m_type = GltfJson::Type::k_bool; out.m_number = 0.0; return literal("false");
+            case 'n': out.m_type = GltfJson::Type::k_null; return literal("null");
+            default: out.m_type = GltfJson::Type::k_number; return parse_number(out.m_number);
+        }
+    }
+
+    bool parse_array(GltfJson& out)
+    {
+        if (++m_depth > k_max_depth) return false;
+        out.m_type = GltfJson::Type::k_array;
+        m_cur++;
+        skip_space();
+        if (m_cur < m_end && *m_cur == ']') {
+            m_cur++;
+            m_depth--;
+            return true;
+        }
+        for (;;) {
+            out.m_items.emplace_back();
+            if (!parse_value(out.m_items.back())) return false;
+            skip_space();
+            if (m_cur >= m_end) return false;
+            if (*m_cur++ == ']') break;
+            if (m_cur[-1] != ',') return false;
+        }
+        m_depth--;
+        return true;
+    }
+
+    bool parse_object(GltfJson& out)
+    {
+        if (++m_depth > k_max_depth) return false;
+        out.m_type = GltfJson::Type::k_object;
+        m_cur++;
+        skip_space();
+        if (m_cur < m_end && *m_cur == '}') {
+            m_cur++;
+            m_depth--;
+            return true;
+        }
+        for (;;) {
+            skip_space();
+            out.m_keys.emplace_back();
+            if (!parse_string(out.m_keys.back())) return false;
+            skip_space();
+            if (m_cur >= m_end || *m_cur++ != ':') return false;
+            out.m_items.emplace_back();
+            if (!parse_value(out.m_items.back())) return false;
+            skip_space();
+            if (m_cur >= m_end) return false;
+            if (*m_cur++ == '}') break;
+            if (m_cur[-1] != ',') return false;
+        }
+        m_depth--;
+        return true;
+    }
+};
+
+// Component types and element sizes from the glTF spec
+static constexpr uint32_t k_gltf_byte = 5120;
+static constexpr uint32_t k_gltf_unsigned_byte = 5121;
+static constexpr uint32_t k_gltf_short = 5122;
+static constexpr uint32_t k_gltf_unsigned_short = 5123;
+static constexpr uint32_t k_gltf_unsigned_int = 5125;
+static constexpr uint32_t k_gltf_float = 5126;
+static constexpr uint32_t k_gltf_triangles = 4;
+
+static uint32_t gltf_component_size(uint32_t type)
+{
+    switch (type) {
+        case k_gltf_byte:
+        case k_gltf_unsigned_byte: return 1;
+        case k_gltf_short:
+        case k_gltf_unsigned_short: return 2;
+        case k_gltf_unsigned_int:
+        case k_gltf_float: return 4;
+        default: return 0;
+    }
+}
+
+static uint32_t gltf_component_count(const std::string& type)
+{
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4") return 4;
+    return 0;
+}
+
+// An accessor resolved down to a pointer and stride, checked to lie inside its buffer
+struct GltfAccessor {
+    const uint8_t* m_data = nullptr;
+    size_t m_stride = 0;
+    uint32_t m_count = 0;
+    uint32_t m_component_type = 0;
+    uint32_t m_components = 0;
+    bool m_normalized = false;
+
+    float read(uint32_t element, uint32_t component) const
+    {
+        const uint8_t* p = m_data + element * m_stride;
+        switch (m_component_type) {
+            case k_gltf_float: {
+                float value;
+                memcpy(&value, p + component * 4, 4);
+                return value;
+            }
+            case k_gltf_unsigned_byte: {
+                float value = float(p[component]);
+                return m_normalized ? value / 255.0f : value;
+            }
+            case k_gltf_unsigned_short: {
+                uint16_t value;
+                memcpy(&value, p + component * 2, 2);
+                return m_normalized ? float(value) / 65535.0f : float(value);
+            }
+            case k_gltf_byte: {
+                float value = float(int8_t(p[component]));
+                return m_normalized ? std::max(value / 127.0f, -1.0f) : value;
+            }
+            case k_gltf_short: {
+                int16_t value;
+                memcpy(&value, p + component * 2, 2);
+                return m_normalized ? std::max(float(value) / 32767.0f, -1.0f) : float(value);
+            }
+            default: return 0.0f;
+        }
+    }
+
+    uint32_t read_index(uint32_t element) const
+    {
+        const uint8_t* p = m_data + element * m_stride;
+        switch (m_component_type) {
+            case k_gltf_unsigned_byte: return p[0];
+            case k_gltf_unsigned_short: {
+                uint16_t value;
+                memcpy(&value, p, 2);
+                return value;
+            }
+            case k_gltf_unsigned_int: {
+                uint32_t value;
+                memcpy(&value, p, 4);
+                return value;
+            }
+            default: return 0;
+        }
+    }
+};
+
+// Everything a primitive needs to be decoded on a worker without looking at the document again
+struct GltfPrimitive {
+    std::string m_name;
+    GltfAccessor m_positions;
+    GltfAccessor m_normals;
+    GltfAccessor m_uvs;
+    GltfAccessor m_indices;
+    bool m_has_normals = false;
+    bool m_has_uvs = false;
+    bool m_has_indices = false;
+};
+
+static bool gltf_base64_decode(const char* text, size_t length, std::vector<uint8_t>& out)
+{
+    static const std::array<int8_t, 256> table = []() {
+        std::array<int8_t, 256> values;
+        values.fill(-1);
+        const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (int i = 0; i < 64; i++) values[uint8_t(alphabet[i])] = int8_t(i);
+        return values;
+    }();
+    out.clear();
+    out.reserve(length / 4 * 3);
+    uint32_t bits = 0;
+    int32_t bit_count = 0;
+    for (size_t i = 0; i < length && text[i] != '='; i++) {
+        int8_t value = table[uint8_t(text[i])];
+        if (value < 0) return false;
+        bits = bits << 6 | uint32_t(value);
+        bit_count += 6;
+        if (bit_count >= 8) {
+            bit_count -= 8;
+            out.push_back(uint8_t(bits >> bit_count));
+        }
+    }
+    return true;
+}
+
+// Base pointer and size of every buffer in the document
+typedef std::vector<std::pair<const uint8_t*, size_t>> GltfBuffers;
+
+// Resolves an accessor index through its buffer view, false when anything points outside the data
+static bool gltf_resolve_accessor(const GltfJson& root, const GltfBuffers& buffers, int64_t index,
+                                  GltfAccessor& out)
+{
+    const auto& accessors = root.array("accessors");
+    const auto& views = root.array("bufferViews");
+    if (index < 0 || size_t(index) >= accessors.size()) return false;
+    const GltfJson& accessor = accessors[index];
+    if (accessor.find("sparse") != nullptr) {
+        Log::warn("Sparse glTF accessors aren't supported, accessor %lld is read as dense", (long long)index);
+    }
+    int64_t view_index = accessor.integer("bufferView", -1);
+    if (view_index < 0 || size_t(view_index) >= views.size()) return false;
+    const GltfJson& view = views[view_index];
+    int64_t buffer_index = view.integer("buffer", -1);
+    if (buffer_index < 0 || size_t(buffer_index) >= buffers.size()) return false;
+
+    // Sizes and offsets are read signed, so a negative one is caught here rather than wrapping into a huge one
+    int64_t count = accessor.integer("count", 0);
+    int64_t stride = view.integer("byteStride", 0);
+    int64_t offsets[3] = {view.integer("byteOffset", 0), view.integer("byteLength", 0),
+                          accessor.integer("byteOffset", 0)};
+    if (count < 0 || count > int64_t(UINT32_MAX) || stride < 0) return false;
+    for (int64_t value : offsets) {
+        if (value < 0) return false;
+    }
+
+    const GltfJson* type = accessor.find("type");
+    const GltfJson* normalized = accessor.find("normalized");
+    out.m_count = uint32_t(count);
+    out.m_component_type = uint32_t(accessor.integer("componentType", 0));
+    out.m_components = type != nullptr ? gltf_component_count(type->m_string) : 0;
+    out.m_normalized = normalized != nullptr && normalized->m_number != 0.0;
+    size_t element_size = size_t(gltf_component_size(out.m_component_type)) * out.m_components;
+    if (element_size == 0) return false;
+    out.m_stride = stride != 0 ? size_t(stride) : element_size;
+
+    // The last element has to end inside the view, and the view inside the buffer. Every check subtracts from
+    // the side known to be larger, so none of them can overflow
+    size_t buffer_size = buffers[buffer_index].second;
+    size_t view_offset = size_t(offsets[0]);
+    size_t view_length = size_t(offsets[1]);
+    size_t accessor_offset = size_t(offsets[2]);
+    if (view_offset > buffer_size || view_length > buffer_size - view_offset) return false;
+    if (out.m_count > 0) {
+        if (accessor_offset > view_length || element_size > view_length - accessor_offset) return false;
+        if (out.m_count - 1 > (view_length - accessor_offset - element_size) / out.m_stride) return false;
+    }
+    out.m_data = buffers[buffer_index].first + view_offset + accessor_offset;
+    return true;
+}
+
+// Decodes one primitive into the shared vertex layout, then optimizes it
+static void gltf_decode_primitive(const GltfPrimitive& primitive, bool optimize, ImportedMesh& out)
+{
+    out.m_name = primitive.m_name;
+    uint32_t vertex_count = primitive.m_positions.m_count;
+    out.m_vertices.resize(vertex_count);
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        MeshVertex& vertex = out.m_vertices[v];
+        for (uint32_t c = 0; c < 3; c++) {
+            vertex.m_position[c] = primitive.m_positions.read(v, c);
+            vertex.m_normal[c] = primitive.m_has_normals ? primitive.m_normals.read(v, c) : 0.0f;
+        }
+        for (uint32_t c = 0; c < 2; c++) vertex.m_uv[c] = primitive.m_has_uvs ? primitive.m_uvs.read(v, c) : 0.0f;
+    }
+
+    // Out of range indices would turn into reads past the vertex buffer on the GPU, so they're clamped here
+    if (primitive.m_has_indices) {
+        out.m_indices.resize(primitive.m_indices.m_count / 3 * 3);
+        for (uint32_t i = 0; i < out.m_indices.size(); i++) {
+            out.m_indices[i] = std::min(primitive.m_indices.read_index(i), vertex_count - 1);
+        }
+    } else {
+        out.m_indices.resize(vertex_count / 3 * 3);
+        for (uint32_t i = 0; i < out.m_indices.size(); i++) out.m_indices[i] = i;
+    }
+
+    // Area weighted face normals summed at each vertex
+    if (!primitive.m_has_normals) {
+        for (size_t i = 0; i + 2 < out.m_indices.size(); i += 3) {
+            MeshVertex* tri[3] = {&out.m_vertices[out.m_indices[i]], &out.m_vertices[out.m_indices[i + 1]],
+                                  &out.m_vertices[out.m_indices[i + 2]]};
+            float e1[3], e2[3];
+            for (uint32_t c = 0; c < 3; c++) {
+                e1[c] = tri[1]->m_position[c] - tri[0]->m_position[c];
+                e2[c] = tri[2]->m_position[c] - tri[0]->m_position[c];
+            }
+            float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2],
+                          e1[0] * e2[1] - e1[1] * e2[0]};
+            for (auto* vertex : tri) {
+                for (uint32_t c = 0; c < 3; c++) vertex->m_normal[c] += n[c];
+            }
+        }
+        for (auto& vertex : out.m_vertices) {
+            float* n = vertex.m_normal;
+            float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            float scale = length > 0.0f ? 1.0f / length : 0.0f;
+            for (uint32_t c = 0; c < 3; c++) n[c] *= scale;
+        }
+    }
+
+    if (optimize && !out.m_indices.empty()) {
+        optimize_vertex_cache(out.m_indices.data(), out.m_indices.size(), vertex_count);
+        optimize_vertex_fetch(out.m_vertices, out.m_indices);
+    }
+
+    for (uint32_t c = 0; c < 3; c++) {
+        out.m_min[c] = out.m_vertices.empty() ? 0.0f : out.m_vertices[0].m_position[c];
+        out.m_max[c] = out.m_min[c];
+    }
+    for (const auto& vertex : out.m_vertices) {
+        for (uint32_t c = 0; c < 3; c++) {
+            out.m_min[c] = std::min(out.m_min[c], vertex.m_position[c]);
+            out.m_max[c] = std::max(out.m_max[c], vertex.m_position[c]);
+        }
+    }
+}
+
+result GltfImporter::import(const char* path)
+{
+    m_meshes.clear();
+    uint64_t start = pacer_now_ns();
+    MappedFile file;
+    if (file.open(path) != k_success) return -1;
+
+    // A .glb is a small header followed by a JSON chunk and an optional binary chunk
+    const char* json = reinterpret_cast<const char*>(file.m_data);
+    size_t json_size = file.m_size;
+    const uint8_t* glb_data = nullptr;
+    size_t glb_size = 0;
+    uint32_t magic = 0;
+    if (file.m_size >= 12) memcpy(&magic, file.m_data, 4);
+    if (magic == 0x46546C67) {
+        uint32_t chunk_header[2];
+        size_t cursor = 12;
+        json_size = 0;
+        while (cursor + 8 <= file.m_size) {
+            memcpy(chunk_header, file.m_data + cursor, 8);
+            cursor += 8;
+            if (chunk_header[0] > file.m_size - cursor) break;
+            if (chunk_header[1] == 0x4E4F534A && json_size == 0) {
+                json = reinterpret_cast<const char*>(file.m_data + cursor);
+                json_size = chunk_header[0];
+            } else if (chunk_header[1] == 0x004E4942 && glb_data == nullptr) {
+                glb_data = file.m_data + cursor;
+                glb_size = chunk_header[0];
+            }
+            cursor += (size_t(chunk_header[0]) + 3) & ~size_t(3);
+        }
+        if (json_size == 0) {
+            Log::error("Binary glTF has no JSON chunk: %s", path);
+            return -2;
+        }
+    }
+
+    GltfJson root;
+    GltfJsonParser parser;
+    parser.m_cur = json;
+    parser.m_end = json + json_size;
+    if (!parser.parse_value(root) || root.m_type != GltfJson::Type::k_object) {
+        Log::error("Failed to parse the glTF JSON at byte %zu: %s", size_t(parser.m_cur - json), path);
+        return -3;
+    }
+
+    // External buffers are relative to the file, they stay mapped until every primitive is decoded
+    std::string directory = path;
+    size_t slash = directory.find_last_of("/\\");
+    directory = slash == std::string::npos ? std::string() : directory.substr(0, slash + 1);
+    const auto& buffer_list = root.array("buffers");
+    std::vector<MappedFile> mapped(buffer_list.size());
+    std::vector<std::vector<uint8_t>> embedded(buffer_list.size());
+    GltfBuffers buffers(buffer_list.size());
+    for (size_t i = 0; i < buffer_list.size(); i++) {
+        const GltfJson* uri = buffer_list[i].find("uri");
+        if (uri == nullptr) {
+            buffers[i] = {glb_data, glb_size};
+        } else if (uri->m_string.compare(0, 5, "data:") == 0) {
+            const std::string& text = uri->m_string;
+            size_t comma = text.find(',');
+            if (comma == std::string::npos ||
+                !gltf_base64_decode(text.c_str() + comma + 1, text.size() - comma - 1, embedded[i])) {
+                Log::error("glTF buffer %zu has a malformed data URI: %s", i, path);
+                return -4;
+            }
+            buffers[i] = {embedded[i].data(), embedded[i].size()};
+        } else {
+            std::string buffer_path = directory + uri->m_string;
+            if (mapped[i].open(buffer_path.c_str()) != k_success) {
+                Log::error("Failed to open glTF buffer %s", buffer_path.c_str());
+                return -5;
+            }
+            buffers[i] = {mapped[i].m_data, mapped[i].m_size};
+        }
+        if (buffers[i].first == nullptr && buffer_list[i].integer("byteLength", 0) > 0) {
+            Log::error("glTF buffer %zu has no data: %s", i, path);
+            return -6;
+        }
+    }
+
+    // Resolve every primitive up front so the workers only ever touch flat data
+    std::vector<GltfPrimitive> primitives;
+    const auto& meshes = root.array("meshes");
+    for (size_t m = 0; m < meshes.size(); m++) {
+        const GltfJson* name = meshes[m].find("name");
+        std::string mesh_name = name != nullptr ? name->m_string : "mesh" + std::to_string(m);
+        const auto& mesh_primitives = meshes[m].array("primitives");
+        for (size_t p = 0; p < mesh_primitives.size(); p++) {
+            const GltfJson& source = mesh_primitives[p];
+            if (source.integer("mode", k_gltf_triangles) != k_gltf_triangles) {
+                Log::warn("Skipping %s primitive %zu, only triangle lists are imported", mesh_name.c_str(), p);
+                continue;
+            }
+            const GltfJson* attributes = source.find("attributes");
+            GltfPrimitive primitive;
+            primitive.m_name = mesh_primitives.size() > 1 ? mesh_name + "/" + std::to_string(p) : mesh_name;
+            int64_t position = attributes != nullptr ? attributes->integer("POSITION", -1) : -1;
+            int64_t normal = attributes != nullptr ? attributes->integer("NORMAL", -1) : -1;
+            int64_t uv = attributes != nullptr ? attributes->integer("TEXCOORD_0", -1) : -1;
+            int64_t indices = source.integer("indices", -1);
+            bool valid = gltf_resolve_accessor(root, buffers, position, primitive.m_positions) &&
+                         primitive.m_positions.m_components == 3 && primitive.m_positions.m_count > 0;
+            primitive.m_has_normals = normal >= 0;
+            primitive.m_has_uvs = uv >= 0;
+            primitive.m_has_indices = indices >= 0;
+            valid = valid && (normal < 0 || (gltf_resolve_accessor(root, buffers, normal, primitive.m_normals) &&
+                                             primitive.m_normals.m_components == 3 &&
+                                             primitive.m_normals.m_count >= primitive.m_positions.m_count));
+            valid = valid && (uv < 0 || (gltf_resolve_accessor(root, buffers, uv, primitive.m_uvs) &&
+                                         primitive.m_uvs.m_components == 2 &&
+                                         primitive.m_uvs.m_count >= primitive.m_positions.m_count));
+            valid = valid && (indices < 0 || (gltf_resolve_accessor(root, buffers, indices, primitive.m_indices) &&
+                                              primitive.m_indices.m_components == 1));
+            if (!valid) {
+                Log::warn("Skipping %s primitive %zu, its accessors are missing or out of bounds",
+                          mesh_name.c_str(), p);
+                continue;
+            }
+            primitives.push_back(std::move(primitive));
+        }
+    }
+    uint64_t parsed = pacer_now_ns();
+    m_parse_ms = double(parsed - start) / 1e6;
+
+    // Primitives vary a lot in size, one per chunk lets the workers balance themselves
+    m_meshes.resize(primitives.size());
+    auto decode = [this, &primitives](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) gltf_decode_primitive(primitives[i], m_optimize, m_meshes[i]);
+    };
+    if (m_jobs != nullptr) {
+        m_jobs->parallel_for(primitives.size(), 1, decode);
+    } else {
+        decode(0, primitives.size());
+    }
+    m_decode_ms = double(pacer_now_ns() - parsed) / 1e6;
+    return k_success;
+}
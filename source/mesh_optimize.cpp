@@ -0,0 +1,173 @@
+#include "atelier/atelier_mesh.h"
+
+#include <algorithm>
+#include <cmath>
+using namespace Atelier;
+
+// Forsyth's tuning, the cache being modelled is larger than real hardware's so scores still hold on wider GPUs
+static constexpr uint32_t k_forsyth_cache_size = 32;
+static constexpr float k_forsyth_last_triangle_score = 0.75f;
+static constexpr float k_forsyth_cache_decay_power = 1.5f;
+static constexpr float k_forsyth_valence_scale = 2.0f;
+static constexpr float k_forsyth_valence_power = -0.5f;
+
+static constexpr uint32_t k_forsyth_max_valence = 64;
+
+// Scores by cache position and by triangles left are tabled, pow() in the inner loop dominates otherwise
+struct ForsythTables {
+    float m_cache[k_forsyth_cache_size + 1];  // The last entry is for vertices outside the cache
+    float m_valence[k_forsyth_max_valence];
+
+    ForsythTables()
+    {
+        for (uint32_t p = 0; p < k_forsyth_cache_size; p++) {
+            const float scale = 1.0f / float(k_forsyth_cache_size - 3);
+            m_cache[p] = p < 3 ? k_forsyth_last_triangle_score
+                               : std::pow(1.0f - float(p - 3) * scale, k_forsyth_cache_decay_power);
+        }
+        m_cache[k_forsyth_cache_size] = 0.0f;
+        m_valence[0] = 0.0f;
+        for (uint32_t v = 1; v < k_forsyth_max_valence; v++) {
+            m_valence[v] = k_forsyth_valence_scale * std::pow(float(v), k_forsyth_valence_power);
+        }
+    }
+};
+
+// Vertices still needed by few triangles score higher, so they get finished off rather than left stranded
+static float forsyth_vertex_score(const ForsythTables& tables, int32_t cache_position, uint32_t remaining)
+{
+    if (remaining == 0) return -1.0f;
+    float cache = tables.m_cache[cache_position >= 0 ? uint32_t(cache_position) : k_forsyth_cache_size];
+    return cache + tables.m_valence[std::min(remaining, k_forsyth_max_valence - 1)];
+}
+
+void Atelier::optimize_vertex_cache(uint32_t* indices, size_t index_count, uint32_t vertex_count)
+{
+    size_t triangle_count = index_count / 3;
+    if (triangle_count < 2 || vertex_count == 0) return;
+    static const ForsythTables tables;
+
+    // Triangles touching each vertex, the live ones are kept at the front of each vertex's range
+    std::vector<uint32_t> remaining(vertex_count, 0);
+    for (size_t i = 0; i < triangle_count * 3; i++) remaining[indices[i]]++;
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (uint32_t v = 0; v < vertex_count; v++) offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<uint32_t> adjacency(triangle_count * 3);
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < triangle_count * 3; i++) adjacency[fill[indices[i]]++] = uint32_t(i / 3);
+
+    std::vector<int32_t> cache_position(vertex_count, -1);
+    std::vector<float> vertex_score(vertex_count);
+    for (uint32_t v = 0; v < vertex_count; v++) vertex_score[v] = forsyth_vertex_score(tables, -1, remaining[v]);
+    std::vector<float> triangle_score(triangle_count);
+    std::vector<uint8_t> emitted(triangle_count, 0);
+    int64_t best = 0;
+    for (size_t t = 0; t < triangle_count; t++) {
+        const uint32_t* tri = indices + t * 3;
+        triangle_score[t] = vertex_score[tri[0]] + vertex_score[tri[1]] + vertex_score[tri[2]];
+        if (triangle_score[t] > triangle_score[best]) best = int64_t(t);
+    }
+
+    std::vector<uint32_t> output(triangle_count * 3);
+    uint32_t cache[k_forsyth_cache_size + 3];
+    uint32_t next[k_forsyth_cache_size + 3];
+    uint32_t cache_count = 0;
+    size_t scan = 0;
+    for (size_t emitted_count = 0; emitted_count < triangle_count; emitted_count++) {
+        // Nothing in the cache has work left, so start again from the first triangle not yet emitted
+        if (best < 0) {
+            while (emitted[scan]) scan++;
+            best = int64_t(scan);
+        }
+        const uint32_t* tri = indices + best * 3;
+        emitted[best] = 1;
+        memcpy(output.data() + emitted_count * 3, tri, 3 * sizeof(uint32_t));
+
+        for (uint32_t k = 0; k < 3; k++) {
+            uint32_t v = tri[k];
+            uint32_t* list = adjacency.data() + offsets[v];
+            for (uint32_t a = 0; a < remaining[v]; a++) {
+                if (list[a] != uint32_t(best)) continue;
+                list[a] = list[remaining[v] - 1];
+                remaining[v]--;
+                break;
+            }
+        }
+
+        // The triangle's vertices move to the front of the cache, everything else shuffles back
+        uint32_t count = 0;
+        for (uint32_t k = 0; k < 3; k++) {
+            bool seen = false;
+            for (uint32_t n = 0; n < count; n++) seen = seen || next[n] == tri[k];
+            if (!seen) next[count++] = tri[k];
+        }
+        for (uint32_t c = 0; c < cache_count; c++) {
+            uint32_t v = cache[c];
+            if (v != tri[0] && v != tri[1] && v != tri[2]) next[count++] = v;
+        }
+
+        // Rescore everything whose position moved, including the ones which just fell out
+        for (uint32_t n = 0; n < count; n++) {
+            uint32_t v = next[n];
+            cache_position[v] = n < k_forsyth_cache_size ? int32_t(n) : -1;
+            float score = forsyth_vertex_score(tables, cache_position[v], remaining[v]);
+            float delta = score - vertex_score[v];
+            vertex_score[v] = score;
+            const uint32_t* list = adjacency.data() + offsets[v];
+            for (uint32_t a = 0; a < remaining[v]; a++) triangle_score[list[a]] += delta;
+        }
+
+        // The next triangle is the best one touching the cache, anything else scores too low to be worth finding
+        best = -1;
+        float best_score = -1.0f;
+        cache_count = std::min(count, k_forsyth_cache_size);
+        for (uint32_t c = 0; c < cache_count; c++) {
+            uint32_t v = next[c];
+            cache[c] = v;
+            const uint32_t* list = adjacency.data() + offsets[v];
+            for (uint32_t a = 0; a < remaining[v]; a++) {
+                if (triangle_score[list[a]] <= best_score) continue;
+                best_score = triangle_score[list[a]];
+                best = int64_t(list[a]);
+            }
+        }
+    }
+
+    memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+void Atelier::optimize_vertex_fetch(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices)
+{
+    // Vertices nothing references are dropped along the way
+    std::vector<uint32_t> remap(vertices.size(), ~0u);
+    std::vector<MeshVertex> ordered;
+    ordered.reserve(vertices.size());
+    for (uint32_t& index : indices) {
+        if (remap[index] == ~0u) {
+            remap[index] = uint32_t(ordered.size());
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(ordered);
+}
+
+double Atelier::average_cache_miss_ratio(const uint32_t* indices, size_t index_count, uint32_t cache_size)
+{
+    size_t triangle_count = index_count / 3;
+    if (triangle_count == 0 || cache_size == 0) return 0.0;
+
+    // A FIFO rather than an LRU, which is closer to how post transform caches actually behave
+    std::vector<uint32_t> fifo(cache_size, ~0u);
+    uint32_t head = 0;
+    size_t misses = 0;
+    for (size_t i = 0; i < triangle_count * 3; i++) {
+        bool hit = false;
+        for (uint32_t c = 0; c < cache_size && !hit; c++) hit = fifo[c] == indices[i];
+        if (hit) continue;
+        fifo[head] = indices[i];
+        head = (head + 1) % cache_size;
+        misses++;
+    }
+    return double(misses) / double(triangle_count);
+}
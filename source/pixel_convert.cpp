@@ -0,0 +1,378 @@
+#include "pixel_kernels.h"
+
+#include <cmath>
+#include <vector>
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define ATELIER_PIXEL_NEON 1
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define ATELIER_PIXEL_X86 1
+#elif defined(__x86_64__) || defined(__i386__)
+#define ATELIER_PIXEL_X86 1
+#endif
+using namespace Atelier;
+
+// Scalar reference
+//
+
+const float* PixelScalar::srgb_decode_table()
+{
+    static const auto table = []() {
+        std::vector<float> t(256);
+        for (uint32_t i = 0; i < 256; i++) {
+            double c = i / 255.0;
+            t[i] = float(c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+        }
+        return t;
+    }();
+    return table.data();
+}
+
+const uint8_t* PixelScalar::srgb_encode_table()
+{
+    static const auto table = []() {
+        std::vector<uint8_t> t(k_encode_steps);
+        for (uint32_t i = 0; i < k_encode_steps; i++) {
+            double l = double(i) / (k_encode_steps - 1);
+            double s = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+            t[i] = uint8_t(s * 255.0 + 0.5);
+        }
+        return t;
+    }();
+    return table.data();
+}
+
+// Exact rounding of x / 255 for x in [0, 255 * 255]
+static inline uint8_t div255(uint32_t x)
+{
+    x += 128;
+    return uint8_t((x + (x >> 8)) >> 8);
+}
+
+static inline float clamp01(float v) { return v > 0.0f ? (v < 1.0f ? v : 1.0f) : 0.0f; }
+
+void PixelScalar::swizzle_rb(uint8_t* dst, const uint8_t* src, size_t pixel_count)
+{
+    for (size_t i = 0; i < pixel_count; i++, src += 4, dst += 4) {
+        uint8_t r = src[0], g = src[1], b = src[2], a = src[3];
+        dst[0] = b;
+        dst[1] = g;
+        dst[2] = r;
+        dst[3] = a;
+    }
+}
+
+void PixelScalar::rgb_to_rgba(uint8_t* dst, const uint8_t* src, size_t pixel_count, uint8_t alpha)
+{
+    for (size_t i = 0; i < pixel_count; i++, src += 3, dst += 4) {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+        dst[3] = alpha;
+    }
+}
+
+void PixelScalar::rgba_to_rgb(uint8_t* dst, const uint8_t* src, size_t pixel_count)
+{
+    for (size_t i = 0; i < pixel_count; i++, src += 4, dst += 3) {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+    }
+}
+
+void PixelScalar::srgb_to_linear(float* dst, const uint8_t* src, size_t pixel_count)
+{
+    const float* table = srgb_decode_table();
+    for (size_t i = 0; i < pixel_count; i++, src += 4, dst += 4) {
+        dst[0] = table[src[0]];
+        dst[1] = table[src[1]];
+        dst[2] = table[src[2]];
+        dst[3] = src[3] * (1.0f / 255.0f);
+    }
+}
+
+void PixelScalar::linear_to_srgb(uint8_t* dst, const float* src, size_t pixel_count)
+{
+    const uint8_t* table = srgb_encode_table();
+    const float scale = float(k_encode_steps - 1);
+    for (size_t i = 0; i < pixel_count; i++, src += 4, dst += 4) {
+        dst[0] = table[uint32_t(clamp01(src[0]) * scale + 0.5f)];
+        dst[1] = table[uint32_t(clamp01(src[1]) * scale + 0.5f)];
+        dst[2] = table[uint32_t(clamp01(src[2]) * scale + 0.5f)];
+        dst[3] = uint8_t(clamp01(src[3]) * 255.0f + 0.5f);
+    }
+}
+
+void PixelScalar::premultiply(uint8_t* dst, const uint8_t* src, size_t pixel_count)
+{
+    for (size_t i = 0; i < pixel_count; i++, src += 4, dst += 4) {
+        uint32_t a = src[3];
+        dst[0] = div255(src[0] * a);
+        dst[1] = div255(src[1] * a);
+        dst[2] = div255(src[2] * a);
+        dst[3] = uint8_t(a);
+    }
+}
+
+static inline uint32_t as_bits(float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, 4);
+    return u;
+}
+static inline float as_float(uint32_t u)
+{
+    float f;
+    memcpy(&f, &u, 4);
+    return f;
+}
+
+void PixelScalar::float_to_half(uint16_t* dst, const float* src, size_t count)
+{
+    // Round to nearest even through bias tricks rather than branching on every case, the SIMD versions mirror this
+    const uint32_t f32_infinity = 255u << 23;
+    const uint32_t f16_max = (127u + 16) << 23;
+    const uint32_t subnormal_magic = ((127u - 15) + (23 - 10) + 1) << 23;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t x = as_bits(src[i]);
+        uint32_t sign = x & 0x80000000u;
+        x ^= sign;
+
+        uint16_t out;
+        if (x >= f16_max) {
+            out = x > f32_infinity ? 0x7e00 : 0x7c00;
+        } else if (x < (113u << 23)) {
+            out = uint16_t(as_bits(as_float(x) + as_float(subnormal_magic)) - subnormal_magic);
+        } else {
+            uint32_t mantissa_odd = (x >> 13) & 1;
+            x += ((15u - 127u) << 23) + 0xfff + mantissa_odd;
+            out = uint16_t(x >> 13);
+        }
+        dst[i] = out | uint16_t(sign >> 16);
+    }
+}
+
+void PixelScalar::half_to_float(float* dst, const uint16_t* src, size_t count)
+{
+    // Rebias the exponent with a multiply, which also normalizes half subnormals for free
+    const float magic = as_float((254u - 15) << 23);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t exp_mantissa = src[i] & 0x7fffu;
+        uint32_t out = as_bits(as_float(exp_mantissa << 13) * magic);
+        if (exp_mantissa > 0x7bff) out |= 255u << 23;
+        out |= uint32_t(src[i] & 0x8000u) << 16;
+        dst[i] = as_float(out);
+    }
+}
+
+void PixelScalar::downsample_2x2(uint8_t* dst, size_t dst_stride, const uint8_t* src, size_t src_stride,
+                                 uint32_t width, uint32_t height)
+{
+    uint32_t out_w = width > 1 ? width / 2 : 1;
+    uint32_t out_h = height > 1 ? height / 2 : 1;
+    for (uint32_t y = 0; y < out_h; y++) {
+        // Single texel wide or tall sources just repeat the edge instead of reading outside
+        const uint8_t* row0 = src + size_t(2 * y) * src_stride;
+        const uint8_t* row1 = src + size_t(2 * y + 1 < height ? 2 * y + 1 : 2 * y) * src_stride;
+        uint8_t* out = dst + size_t(y) * dst_stride;
+        for (uint32_t x = 0; x < out_w; x++) {
+            uint32_t x0 = 2 * x * 4;
+            uint32_t x1 = (2 * x + 1 < width ? 2 * x + 1 : 2 * x) * 4;
+            for (uint32_t c = 0; c < 4; c++) {
+                out[x * 4 + c] = uint8_t((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+            }
+        }
+    }
+}
+
+static const PixelKernels s_scalar = {
+  "scalar",
+  PixelIsa::k_scalar,
+  PixelScalar::swizzle_rb,
+  PixelScalar::rgb_to_rgba,
+  PixelScalar::rgba_to_rgb,
+  PixelScalar::srgb_to_linear,
+  PixelScalar::linear_to_srgb,
+  PixelScalar::premultiply,
+  PixelScalar::float_to_half,
+  PixelScalar::half_to_float,
+  PixelScalar::downsample_2x2,
+};
+
+// NEON
+//
+
+#ifdef ATELIER_PIXEL_NEON
+
+static void neon_swizzle_rb(uint8_t* dst, const uint8_t* src, size_t pixel_count)
+{
+    size_t i = 0;
+    for (; i + 16 <= pixel_count; i += 16) {
+        uint8x16x4_t v = vld4q_u8(src + i * 4);
+        uint8x16_t r = v.val[0];
+        v.val[0] = v.val[2];
+        v.val[2] = r;
+        vst4q_u8(dst + i * 4, v);
+    }
+    PixelScalar::swizzle_rb(dst + i * 4, src + i * 4, pixel_count - i);
+}
+
+static void neon_rgb_to_rgba(uint8_t* dst, const uint8_t* src, size_t pixel_count, uint8_t alpha)
+{
+    size_t i = 0;
+    for (; i + 16 <= pixel_count; i += 16) {
+        uint8x16x3_t rgb = vld3q_u8(src + i * 3);
+        uint8x16x4_t rgba = {{rgb.val[0], rgb.val[1], rgb.val[2], vdupq_n_u8(alpha)}};
+        vst4q_u8(dst + i * 4, rgba);
+    }
+    PixelScalar::rgb_to_rgba(dst + i * 4, src + i * 3, pixel_count - i, alpha);
+}
+
+static void neon_rgba_to_rgb(uint8_t* dst, const uint8_t* src, size_t pixel_count)
+{
+    size_t i = 0;
+    for (; i + 16 <= pixel_count; i += 16) {
+        uint8x16x4_t rgba = vld4q_u8(src + i * 4);
+        uint8x16x3_t rgb = {{rgba.val[0], rgba.val[1], rgba.val[2]}};
+        vst3q_u8(dst + i * 3, rgb);
+    }
+    PixelScalar::rgba_to_rgb(dst + i * 3, src + i * 4, pixel_count - i);
+}
+
+// x / 255 with the same rounding as div255, done as (t + ((t + 128) >> 8) + 128) >> 8
+static inline uint8x8_t neon_mul_div255(uint8x8_t c, uint8x8_t a)
+{
+    uint16x8_t t = vmull_u8(c, a);
+    return vraddhn_u16(t, vrshrq_n_u16(t, 8));
+}
+
+static void neon_premultiply(uint8_t* dst, const uint8_t* src, size_t pixel_count)
+{
+    size_t i = 0;
+    for (; i + 8 <= pixel_count; i += 8) {
+        uint8x8x4_t v = vld4_u8(src + i * 4);
+        v.val[0] = neon_mul_div255(v.val[0], v.val[3]);
+        v.val[1] = neon_mul_div255(v.val[1], v.val[3]);
+        v.val[2] = neon_mul_div255(v.val[2], v.val[3]);
+        vst4_u8(dst + i * 4, v);
+    }
+    PixelScalar::premultiply(dst + i * 4, src + i * 4, pixel_count - i);
+}
+
+#ifdef __aarch64__
+static void neon_float_to_half(uint16_t* dst, const float* src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float16x4_t h = vcvt_f16_f32(vld1q_f32(src + i));
+        vst1_u16(dst + i, vreinterpret_u16_f16(h));
+    }
+    PixelScalar::float_to_half(dst + i, src + i, count - i);
+}
+
+static void neon_half_to_float(float* dst, const uint16_t* src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(dst + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + i))));
+    }
+    PixelScalar::half_to_float(dst + i, src + i, count - i);
+}
+#endif
+
+static const PixelKernels s_neon = {
+  "neon",
+  PixelIsa::k_neon,
+  neon_swizzle_rb,
+  neon_rgb_to_rgba,
+  neon_rgba_to_rgb,
+  PixelScalar::srgb_to_linear,
+  PixelScalar::linear_to_srgb,
+  neon_premultiply,
+#ifdef __aarch64__
+  neon_float_to_half,
+  neon_half_to_float,
+#else
+  PixelScalar::float_to_half,
+  PixelScalar::half_to_float,
+#endif
+  PixelScalar::downsample_2x2,
+};
+
+const PixelKernels* Atelier::pixel_kernels_neon() { return &s_neon; }
+#else
+const PixelKernels* Atelier::pixel_kernels_neon() { return nullptr; }
+#endif
+
+// Dispatch
+//
+
+#ifdef ATELIER_PIXEL_X86
+// AVX2 also needs the OS to save the upper halves of the registers, and we lean on F16C for the half conversions
+static bool cpu_has_avx2()
+{
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 1);
+    bool osxsave = (regs[2] & (1 << 27)) != 0;
+    bool f16c = (regs[2] & (1 << 29)) != 0;
+    if (!osxsave || !f16c || (_xgetbv(0) & 0x6) != 0x6) return false;
+    __cpuidex(regs, 7, 0);
+    return (regs[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c");
+#endif
+}
+#endif
+
+bool Atelier::pixel_isa_supported(PixelIsa isa)
+{
+    switch (isa) {
+        case PixelIsa::k_scalar:
+            return true;
+#ifdef ATELIER_PIXEL_X86
+        case PixelIsa::k_sse2:
+            return pixel_kernels_sse2() != nullptr;  // Baseline for every x86-64 CPU
+        case PixelIsa::k_avx2: {
+            static const bool avx2 = cpu_has_avx2();
+            return avx2 && pixel_kernels_avx2() != nullptr;
+        }
+#endif
+        case PixelIsa::k_neon:
+            return pixel_kernels_neon() != nullptr;
+        default:
+            return false;
+    }
+}
+
+const PixelKernels& Atelier::pixel_kernels(PixelIsa isa)
+{
+    if (!pixel_isa_supported(isa)) return s_scalar;
+    switch (isa) {
+        case PixelIsa::k_sse2:
+            return *pixel_kernels_sse2();
+        case PixelIsa::k_avx2:
+            return *pixel_kernels_avx2();
+        case PixelIsa::k_neon:
+            return *pixel_kernels_neon();
+        default:
+            return s_scalar;
+    }
+}
+
+const PixelKernels& Atelier::pixel_kernels()
+{
+    static const PixelKernels* best = []() {
+        for (PixelIsa isa : {PixelIsa::k_avx2, PixelIsa::k_neon, PixelIsa::k_sse2}) {
+            if (pixel_isa_supported(isa)) return &pixel_kernels(isa);
+        }
+        return &s_scalar;
+    }();
+    return *best;
+}
@@ -0,0 +1,200 @@
+#include "pixel_kernels.h"
+
+// Built with AVX2 and F16C enabled, nothing in here may run before pixel_isa_supported has checked the CPU
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#include <vector>
+using namespace Atelier;
+
+static void avx2_swizzle_rb(uint8_t* dst, const uint8_t* src, size_t pixel_count)
+{
+    const __m256i mask = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,  //
+                                          2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    size_t i = 0;
+    for (; i + 8 <= pixel_count; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), _mm256_shuffle_epi8(v, mask));
+    }
+    PixelScalar::swizzle_rb(dst + i * 4, src + i * 4, pixel_count - i);
+}
+
+static void avx2_rgb_to_rgba(uint8_t* dst, const uint8_t* src, size_t pixel_count, uint8_t alpha)
+{
+    const __m256i mask = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,  //
+                                          0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i alpha_bits = _mm256_set1_epi32(int32_t(uint32_t(alpha) << 24));
+    // Each half loads 16 bytes for 12 bytes of pixels, so stop while the over-read is still inside the source
+    size_t i = 0;
+    for (; i + 10 <= pixel_count; i += 8) {
+        const uint8_t* p = src + i * 3;
+        __m256i v = _mm256_inserti128_si256(
+          _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12)), 1);
+        v = _mm256_or_si256(_mm256_shuffle_epi8(v, mask), alpha_bits);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), v);
+    }
+    PixelScalar::rgb_to_rgba(dst + i * 4, src + i * 3, pixel_count - i, alpha);
+}
+
+static void avx2_rgba_to_rgb(uint8_t* dst, const uint8_t* src, size_t pixel_count)
+{
+    const __m256i mask = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,  //
+                                          0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    // Each half stores 16 bytes for 12 bytes of pixels, the next store overwrites the slack
+    size_t i = 0;
+    for (; i + 10 <= pixel_count; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+        v = _mm256_shuffle_epi8(v, mask);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 3), _mm256_castsi256_si128(v));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 3 + 12), _mm256_extracti128_si256(v, 1));
+    }
+    PixelScalar::rgba_to_rgb(dst + i * 3, src + i * 4, pixel_count - i);
+}
+
+static void avx2_srgb_to_linear(float* dst, const uint8_t* src, size_t pixel_count)
+{
+    const float* table = PixelScalar::srgb_decode_table();
+    const __m256 alpha_scale = _mm256_set1_ps(1.0f / 255.0f);
+    size_t i = 0;
+    for (; i + 2 <= pixel_count; i += 2) {
+        __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i * 4)));
+        __m256 colour = _mm256_i32gather_ps(table, index, 4);
+        __m256 alpha = _mm256_mul_ps(_mm256_cvtepi32_ps(index), alpha_scale);
+        _mm256_storeu_ps(dst + i * 4, _mm256_blend_ps(colour, alpha, 0x88));
+    }
+    PixelScalar::srgb_to_linear(dst + i * 4, src + i * 4, pixel_count - i);
+}
+
+// Gathers only load 32 bit elements, so widen the shared encode table once
+static const int32_t* avx2_encode_table()
+{
+    static const auto table = []() {
+        const uint8_t* narrow = PixelScalar::srgb_encode_table();
+        return std::vector<int32_t>(narrow, narrow + PixelScalar::k_encode_steps);
+    }();
+    return table.data();
+}
+
+static inline __m256i avx2_encode_2(const float* src, const int32_t* table)
+{
+    const float steps = PixelScalar::k_encode_steps - 1.0f;
+    const __m256 scale = _mm256_setr_ps(steps, steps, steps, 255.0f, steps, steps, steps, 255.0f);
+    __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src), _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+    __m256i index = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, scale), _mm256_set1_ps(0.5f)));
+    // The alpha lanes index within the table too, their gathered value is just replaced
+    return _mm256_blend_epi32(_mm256_i32gather_epi32(table, index, 4), index, 0x88);
+}
+
+static void avx2_linear_to_srgb(uint8_t* dst, const float* src, size_t pixel_count)
+{
+    const int32_t* table = avx2_encode_table();
+    size_t i = 0;
+    for (; i + 4 <= pixel_count; i += 4) {
+        __m256i a = avx2_encode_2(src + i * 4, table);
+        __m256i b = avx2_encode_2(src + i * 4 + 8, table);
+        // Packing is per 128 bit lane, so pixels come out as 0 2 1 3 until the permute
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xd8);
+        __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), bytes);
+    }
+    PixelScalar::linear_to_srgb(dst + i * 4, src + i * 4, pixel_count - i);
+}
+
+static inline __m256i avx2_premultiply_16(__m256i px)
+{
+    const __m256i colour_mask = _mm256_set_epi16(0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1);
+    const __m256i alpha_one = _mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0);
+    const __m256i bias = _mm256_set1_epi16(128);
+    __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(px, 0xff), 0xff);
+    alpha = _mm256_or_si256(_mm256_and_si256(alpha, colour_mask), alpha_one);
+    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(px, alpha), bias);
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+static void avx2_premultiply(uint8_t* dst, const uint8_t* src, size_t pixel_count)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= pixel_count; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+        __m256i lo = avx2_premultiply_16(_mm256_unpacklo_epi8(v, zero));
+        __m256i hi = avx2_premultiply_16(_mm256_unpackhi_epi8(v, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), _mm256_packus_epi16(lo, hi));
+    }
+    PixelScalar::premultiply(dst + i * 4, src + i * 4, pixel_count - i);
+}
+
+static void avx2_float_to_half(uint16_t* dst, const float* src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+    }
+    PixelScalar::float_to_half(dst + i, src + i, count - i);
+}
+
+static void avx2_half_to_float(float* dst, const uint16_t* src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+    }
+    PixelScalar::half_to_float(dst + i, src + i, count - i);
+}
+
+static void avx2_downsample_2x2(uint8_t* dst, size_t dst_stride, const uint8_t* src, size_t src_stride,
+                                uint32_t width, uint32_t height)
+{
+    // Same block structure as the SSE2 kernel, four output texels at a time
+    uint32_t out_w = width / 2;
+    uint32_t out_h = height / 2;
+    uint32_t simd_w = out_w & ~3u;
+    if (simd_w == 0 || out_h == 0) {
+        PixelScalar::downsample_2x2(dst, dst_stride, src, src_stride, width, height);
+        return;
+    }
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i round = _mm256_set1_epi16(2);
+    for (uint32_t y = 0; y < out_h; y++) {
+        const uint8_t* row0 = src + size_t(2 * y) * src_stride;
+        const uint8_t* row1 = row0 + src_stride;
+        uint8_t* out = dst + size_t(y) * dst_stride;
+        for (uint32_t x = 0; x < simd_w; x += 4) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + x * 8));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + x * 8));
+            __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero));
+            __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero));
+            lo = _mm256_add_epi16(lo, _mm256_srli_si256(lo, 8));
+            hi = _mm256_add_epi16(hi, _mm256_srli_si256(hi, 8));
+            __m256i sum = _mm256_srli_epi16(_mm256_add_epi16(_mm256_unpacklo_epi64(lo, hi), round), 2);
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(sum, sum), 0x08);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), _mm256_castsi256_si128(packed));
+        }
+        if (simd_w < out_w) {
+            PixelScalar::downsample_2x2(out + simd_w * 4, dst_stride, row0 + simd_w * 8, src_stride,
+                                        (out_w - simd_w) * 2, 2);
+        }
+    }
+}
+
+static const PixelKernels s_avx2 = {
+  "avx2",
+  PixelIsa::k_avx2,
+  avx2_swizzle_rb,
+  avx2_rgb_to_rgba,
+  avx2_rgba_to_rgb,
+  avx2_srgb_to_linear,
+  avx2_linear_to_srgb,
+  avx2_premultiply,
+  avx2_float_to_half,
+  avx2_half_to_float,
+  avx2_downsample_2x2,
+};
+
+const PixelKernels* Atelier::pixel_kernels_avx2() { return &s_avx2; }
+#else
+const Atelier::PixelKernels* Atelier::pixel_kernels_avx2() { return nullptr; }
+#endif
@@ -0,0 +1,193 @@
+#include "pixel_kernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#include <emmintrin.h>
+using namespace Atelier;
+
+static void sse2_swizzle_rb(uint8_t* dst, const uint8_t* src, size_t pixel_count)
+{
+    const __m128i ag_mask = _mm_set1_epi32(int32_t(0xff00ff00));
+    const __m128i rb_mask = _mm_set1_epi32(0x00ff00ff);
+    size_t i = 0;
+    for (; i + 4 <= pixel_count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+        __m128i rb = _mm_and_si128(v, rb_mask);
+        rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_or_si128(_mm_and_si128(v, ag_mask), rb));
+    }
+    PixelScalar::swizzle_rb(dst + i * 4, src + i * 4, pixel_count - i);
+}
+
+// Two pixels widened to 16 bits per channel, times alpha, divided by 255 with the scalar rounding
+static inline __m128i sse2_premultiply_16(__m128i px)
+{
+    const __m128i colour_mask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+    const __m128i alpha_one = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+    const __m128i bias = _mm_set1_epi16(128);
+    __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(px, 0xff), 0xff);
+    alpha = _mm_or_si128(_mm_and_si128(alpha, colour_mask), alpha_one);
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(px, alpha), bias);
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static void sse2_premultiply(uint8_t* dst, const uint8_t* src, size_t pixel_count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= pixel_count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+        __m128i lo = sse2_premultiply_16(_mm_unpacklo_epi8(v, zero));
+        __m128i hi = sse2_premultiply_16(_mm_unpackhi_epi8(v, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_packus_epi16(lo, hi));
+    }
+    PixelScalar::premultiply(dst + i * 4, src + i * 4, pixel_count - i);
+}
+
+static void sse2_linear_to_srgb(uint8_t* dst, const float* src, size_t pixel_count)
+{
+    // Quantization is vectorized, the table lookup can't be without a gather
+    const uint8_t* table = PixelScalar::srgb_encode_table();
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set_ps(255.0f, PixelScalar::k_encode_steps - 1.0f, PixelScalar::k_encode_steps - 1.0f,
+                                    PixelScalar::k_encode_steps - 1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    alignas(16) int32_t index[4];
+    for (size_t i = 0; i < pixel_count; i++, src += 4, dst += 4) {
+        // max with the value first maps NaN to zero like the scalar clamp
+        __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src), zero), one);
+        __m128i quantized = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half));
+        _mm_store_si128(reinterpret_cast<__m128i*>(index), quantized);
+        dst[0] = table[index[0]];
+        dst[1] = table[index[1]];
+        dst[2] = table[index[2]];
+        dst[3] = uint8_t(index[3]);
+    }
+}
+
+static inline __m128i sse2_float_to_half_4(__m128 f)
+{
+    const __m128i sign_mask = _mm_set1_epi32(int32_t(0x80000000u));
+    const __m128i f16_max = _mm_set1_epi32((127 + 16) << 23);
+    const __m128i min_normal = _mm_set1_epi32(113 << 23);
+    const __m128i subnormal_magic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+    const __m128i normal_bias = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+    const __m128i infinity = _mm_set1_epi32(0x7c00);
+    const __m128i nan_bit = _mm_set1_epi32(0x200);
+
+    __m128i bits = _mm_castps_si128(f);
+    __m128i sign = _mm_and_si128(bits, sign_mask);
+    __m128i abs = _mm_xor_si128(bits, sign);
+    __m128 abs_f = _mm_castsi128_ps(abs);
+
+    __m128i is_nan = _mm_castps_si128(_mm_cmpunord_ps(abs_f, abs_f));
+    __m128i is_regular = _mm_cmpgt_epi32(f16_max, abs);
+    __m128i is_subnormal = _mm_cmpgt_epi32(min_normal, abs);
+    __m128i inf_or_nan = _mm_or_si128(_mm_and_si128(is_nan, nan_bit), infinity);
+
+    __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(abs_f, _mm_castsi128_ps(subnormal_magic))),
+                                      subnormal_magic);
+    __m128i mantissa_odd = _mm_srai_epi32(_mm_slli_epi32(abs, 31 - 13), 31);
+    __m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(abs, normal_bias), mantissa_odd), 13);
+
+    __m128i finite = _mm_or_si128(_mm_and_si128(is_subnormal, subnormal), _mm_andnot_si128(is_subnormal, normal));
+    __m128i joined = _mm_or_si128(_mm_and_si128(is_regular, finite), _mm_andnot_si128(is_regular, inf_or_nan));
+    // The arithmetic shift leaves the sign extended so the signed saturating pack keeps the low 16 bits intact
+    return _mm_or_si128(joined, _mm_srai_epi32(sign, 16));
+}
+
+static void sse2_float_to_half(uint16_t* dst, const float* src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i lo = sse2_float_to_half_4(_mm_loadu_ps(src + i));
+        __m128i hi = sse2_float_to_half_4(_mm_loadu_ps(src + i + 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(lo, hi));
+    }
+    PixelScalar::float_to_half(dst + i, src + i, count - i);
+}
+
+static inline __m128 sse2_half_to_float_4(__m128i h)
+{
+    const __m128i exp_mantissa_mask = _mm_set1_epi32(0x7fff);
+    const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23));
+    const __m128i was_inf_nan = _mm_set1_epi32(0x7bff);
+    const __m128 inf_nan_exp = _mm_castsi128_ps(_mm_set1_epi32(255 << 23));
+
+    __m128i exp_mantissa = _mm_and_si128(h, exp_mantissa_mask);
+    __m128i sign = _mm_slli_epi32(_mm_xor_si128(h, exp_mantissa), 16);
+    __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(exp_mantissa, 13)), magic);
+    __m128 inf_nan = _mm_and_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(exp_mantissa, was_inf_nan)), inf_nan_exp);
+    return _mm_or_ps(scaled, _mm_or_ps(_mm_castsi128_ps(sign), inf_nan));
+}
+
+static void sse2_half_to_float(float* dst, const uint16_t* src, size_t count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_ps(dst + i, sse2_half_to_float_4(_mm_unpacklo_epi16(h, zero)));
+        _mm_storeu_ps(dst + i + 4, sse2_half_to_float_4(_mm_unpackhi_epi16(h, zero)));
+    }
+    PixelScalar::half_to_float(dst + i, src + i, count - i);
+}
+
+static void sse2_downsample_2x2(uint8_t* dst, size_t dst_stride, const uint8_t* src, size_t src_stride,
+                                uint32_t width, uint32_t height)
+{
+    // With both dimensions above one texel every output texel is a full 2x2 block, the 1 texel cases clamp and go
+    // through the scalar kernel
+    uint32_t out_w = width / 2;
+    uint32_t out_h = height / 2;
+    uint32_t simd_w = out_w & ~1u;
+    if (simd_w == 0 || out_h == 0) {
+        PixelScalar::downsample_2x2(dst, dst_stride, src, src_stride, width, height);
+        return;
+    }
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(2);
+    for (uint32_t y = 0; y < out_h; y++) {
+        const uint8_t* row0 = src + size_t(2 * y) * src_stride;
+        const uint8_t* row1 = row0 + src_stride;
+        uint8_t* out = dst + size_t(y) * dst_stride;
+        for (uint32_t x = 0; x < simd_w; x += 2) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+            lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+            hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+            __m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), round), 2);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x * 4), _mm_packus_epi16(sum, sum));
+        }
+    }
+
+    // Odd output width leaves one column
+    if (simd_w < out_w) {
+        for (uint32_t y = 0; y < out_h; y++) {
+            PixelScalar::downsample_2x2(dst + size_t(y) * dst_stride + simd_w * 4, dst_stride,
+                                        src + size_t(2 * y) * src_stride + simd_w * 8, src_stride, 2, 2);
+        }
+    }
+}
+
+static const PixelKernels s_sse2 = {
+  "sse2",
+  PixelIsa::k_sse2,
+  sse2_swizzle_rb,
+  PixelScalar::rgb_to_rgba,
+  PixelScalar::rgba_to_rgb,
+  PixelScalar::srgb_to_linear,
+  sse2_linear_to_srgb,
+  sse2_premultiply,
+  sse2_float_to_half,
+  sse2_half_to_float,
+  sse2_downsample_2x2,
+};
+
+const PixelKernels* Atelier::pixel_kernels_sse2() { return &s_sse2; }
+#else
+const Atelier::PixelKernels* Atelier::pixel_kernels_sse2() { return nullptr; }
+#endif
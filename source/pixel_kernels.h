@@ -0,0 +1,35 @@
+/**
+ * @brief Shared between the pixel conversion translation units. Each ISA lives in its own file so it can be
+ * compiled with its own instruction set flags, and the scalar kernels double as the tail handling for the others
+ */
+#pragma once
+#include "atelier/atelier_pixel.h"
+
+namespace Atelier
+{
+namespace PixelScalar
+{
+void swizzle_rb(uint8_t* dst, const uint8_t* src, size_t pixel_count);
+void rgb_to_rgba(uint8_t* dst, const uint8_t* src, size_t pixel_count, uint8_t alpha);
+void rgba_to_rgb(uint8_t* dst, const uint8_t* src, size_t pixel_count);
+void srgb_to_linear(float* dst, const uint8_t* src, size_t pixel_count);
+void linear_to_srgb(uint8_t* dst, const float* src, size_t pixel_count);
+void premultiply(uint8_t* dst, const uint8_t* src, size_t pixel_count);
+void float_to_half(uint16_t* dst, const float* src, size_t count);
+void half_to_float(float* dst, const uint16_t* src, size_t count);
+void downsample_2x2(uint8_t* dst, size_t dst_stride, const uint8_t* src, size_t src_stride, uint32_t width,
+                    uint32_t height);
+
+// Decode table from sRGB8 to linear float
+extern const float* srgb_decode_table();
+
+// Encode table from a linear value quantized to k_encode_steps to sRGB8
+static constexpr uint32_t k_encode_steps = 8192;
+extern const uint8_t* srgb_encode_table();
+}  // namespace PixelScalar
+
+// Null when the ISA wasn't compiled into this build
+const PixelKernels* pixel_kernels_sse2();
+const PixelKernels* pixel_kernels_avx2();
+const PixelKernels* pixel_kernels_neon();
+}  // namespace Atelier
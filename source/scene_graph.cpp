@@ -0,0 +1,383 @@
+#include "atelier/atelier_jobs.h"
+#include "atelier/atelier_scene.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define ATELIER_SCENE_SSE
+#include <xmmintrin.h>
+#endif
+using namespace Atelier;
+
+static const Mat4 k_identity = {{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1}};
+
+uint32_t SceneGraph::add(uint32_t parent, uint32_t instance)
+{
+    if (parent != k_none && !is_alive(parent)) {
+        Log::error("Scene node %u can't be a parent, it doesn't exist", parent);
+        return k_none;
+    }
+    uint32_t id = 0;
+    if (!m_free_ids.empty()) {
+        id = m_free_ids.back();
+        m_free_ids.pop_back();
+    } else {
+        id = uint32_t(m_slot.size());
+        m_slot.push_back(k_none);
+        m_id_parent.push_back(k_none);
+        m_depth.push_back(0);
+    }
+    m_id_parent[id] = parent;
+    m_depth[id] = parent == k_none ? 0 : m_depth[parent] + 1;
+
+    // New nodes go on the end, out of order until the next update sorts them into their level
+    m_slot[id] = uint32_t(m_id.size());
+    m_position_x.push_back(0.0f);
+    m_position_y.push_back(0.0f);
+    m_position_z.push_back(0.0f);
+    m_rotation_x.push_back(0.0f);
+    m_rotation_y.push_back(0.0f);
+    m_rotation_z.push_back(0.0f);
+    m_rotation_w.push_back(1.0f);
+    m_scale_x.push_back(1.0f);
+    m_scale_y.push_back(1.0f);
+    m_scale_z.push_back(1.0f);
+    m_world.push_back(k_identity);
+    m_parent.push_back(parent == k_none ? k_none : m_slot[parent]);
+    m_instance.push_back(instance);
+    m_changed.push_back(0);
+    m_dirty.push_back(1);
+    m_id.push_back(id);
+    m_layout_dirty = true;
+    m_any_dirty = true;
+    return id;
+}
+
+void SceneGraph::remove(uint32_t id)
+{
+    if (!is_alive(id)) return;
+
+    // A node goes with its subtree, found by walking up from every other node. Removal is rare enough that this
+    // beats keeping child lists up to date
+    std::vector<uint8_t> removed(m_slot.size(), 0);
+    removed[id] = 1;
+    for (uint32_t other = 0; other < m_slot.size(); other++) {
+        if (m_slot[other] == k_none) continue;
+        for (uint32_t up = m_id_parent[other]; up != k_none; up = m_id_parent[up]) {
+            if (!removed[up]) continue;
+            removed[other] = 1;
+            break;
+        }
+    }
+    for (uint32_t other = 0; other < m_slot.size(); other++) {
+        if (!removed[other]) continue;
+        m_slot[other] = k_none;
+        m_free_ids.push_back(other);
+    }
+    m_layout_dirty = true;
+}
+
+void SceneGraph::set_local(uint32_t id, const float position[3], const float rotation[4], const float scale[3])
+{
+    if (!is_alive(id)) {
+        Log::error("Scene node %u doesn't exist, can't set its transform", id);
+        return;
+    }
+    uint32_t slot = m_slot[id];
+    m_position_x[slot] = position[0];
+    m_position_y[slot] = position[1];
+    m_position_z[slot] = position[2];
+    m_rotation_x[slot] = rotation[0];
+    m_rotation_y[slot] = rotation[1];
+    m_rotation_z[slot] = rotation[2];
+    m_rotation_w[slot] = rotation[3];
+    m_scale_x[slot] = scale[0];
+    m_scale_y[slot] = scale[1];
+    m_scale_z[slot] = scale[2];
+    m_dirty[slot] = 1;
+    m_any_dirty = true;
+}
+
+void SceneGraph::set_position(uint32_t id, const float position[3])
+{
+    if (!is_alive(id)) {
+        Log::error("Scene node %u doesn't exist, can't set its position", id);
+        return;
+    }
+    uint32_t slot = m_slot[id];
+    m_position_x[slot] = position[0];
+    m_position_y[slot] = position[1];
+    m_position_z[slot] = position[2];
+    m_dirty[slot] = 1;
+    m_any_dirty = true;
+}
+
+void SceneGraph::set_instance(uint32_t id, uint32_t instance)
+{
+    if (!is_alive(id)) {
+        Log::error("Scene node %u doesn't exist, can't set its instance", id);
+        return;
+    }
+
+    // Forcing the node dirty gets the matrix written at its new place in every target
+    uint32_t slot = m_slot[id];
+    m_instance[slot] = instance;
+    m_dirty[slot] = 1;
+    m_any_dirty = true;
+}
+
+template <typename T>
+static void gather(std::vector<T>& values, const std::vector<uint32_t>& from)
+{
+    std::vector<T> ordered(from.size());
+    for (size_t i = 0; i < from.size(); i++) ordered[i] = values[from[i]];
+    values.swap(ordered);
+}
+
+void SceneGraph::rebuild_levels()
+{
+    // Bucket the live nodes by depth, keeping their current order so roots don't move around between rebuilds
+    std::vector<std::vector<uint32_t>> by_depth;
+    for (uint32_t slot = 0; slot < m_id.size(); slot++) {
+        uint32_t id = m_id[slot];
+        if (m_slot[id] != slot) continue;
+        if (m_depth[id] >= by_depth.size()) by_depth.resize(m_depth[id] + 1);
+        by_depth[m_depth[id]].push_back(id);
+    }
+
+    // Within a level, children of the same parent end up next to each other and in their parents' order, so a
+    // level reads the one above it roughly front to back
+    std::vector<uint32_t> new_slot(m_slot.size(), k_none);
+    std::vector<uint32_t> order;
+    order.reserve(m_id.size());
+    m_levels.assign(1, 0);
+    for (size_t depth = 0; depth < by_depth.size(); depth++) {
+        auto& level = by_depth[depth];
+        if (depth > 0) {
+            std::stable_sort(level.begin(), level.end(), [&](uint32_t a, uint32_t b) {
+                return new_slot[m_id_parent[a]] < new_slot[m_id_parent[b]];
+            });
+        }
+        for (uint32_t id : level) {
+            new_slot[id] = uint32_t(order.size());
+            order.push_back(id);
+        }
+        m_levels.push_back(uint32_t(order.size()));
+    }
+
+    std::vector<uint32_t> from(order.size());
+    for (size_t i = 0; i < order.size(); i++) from[i] = m_slot[order[i]];
+    gather(m_position_x, from);
+    gather(m_position_y, from);
+    gather(m_position_z, from);
+    gather(m_rotation_x, from);
+    gather(m_rotation_y, from);
+    gather(m_rotation_z, from);
+    gather(m_rotation_w, from);
+    gather(m_scale_x, from);
+    gather(m_scale_y, from);
+    gather(m_scale_z, from);
+    gather(m_world, from);
+    gather(m_instance, from);
+    gather(m_changed, from);
+    gather(m_dirty, from);
+    m_id = order;
+    m_parent.resize(order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        uint32_t parent = m_id_parent[order[i]];
+        m_parent[i] = parent == k_none ? k_none : new_slot[parent];
+        m_slot[order[i]] = uint32_t(i);
+    }
+    m_layout_dirty = false;
+}
+
+// Rotation and scale into the upper 3x3 of a column major matrix, translation into the last column
+static void local_matrix(const SceneGraph& scene, uint32_t slot, Mat4& out)
+{
+    float x = scene.m_rotation_x[slot], y = scene.m_rotation_y[slot], z = scene.m_rotation_z[slot];
+    float w = scene.m_rotation_w[slot];
+    float sx = scene.m_scale_x[slot], sy = scene.m_scale_y[slot], sz = scene.m_scale_z[slot];
+    float* m = out.m;
+    m[0] = (1.0f - 2.0f * (y * y + z * z)) * sx;
+    m[1] = 2.0f * (x * y + w * z) * sx;
+    m[2] = 2.0f * (x * z - w * y) * sx;
+    m[3] = 0.0f;
+    m[4] = 2.0f * (x * y - w * z) * sy;
+    m[5] = (1.0f - 2.0f * (x * x + z * z)) * sy;
+    m[6] = 2.0f * (y * z + w * x) * sy;
+    m[7] = 0.0f;
+    m[8] = 2.0f * (x * z + w * y) * sz;
+    m[9] = 2.0f * (y * z - w * x) * sz;
+    m[10] = (1.0f - 2.0f * (x * x + y * y)) * sz;
+    m[11] = 0.0f;
+    m[12] = scene.m_position_x[slot];
+    m[13] = scene.m_position_y[slot];
+    m[14] = scene.m_position_z[slot];
+    m[15] = 1.0f;
+}
+
+#ifdef ATELIER_SCENE_SSE
+// The same as local_matrix for four slots at once, one node per lane, then transposed out into four matrices
+static void local_matrices_x4(const SceneGraph& scene, uint32_t slot, Mat4 out[4])
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    __m128 x = _mm_loadu_ps(&scene.m_rotation_x[slot]);
+    __m128 y = _mm_loadu_ps(&scene.m_rotation_y[slot]);
+    __m128 z = _mm_loadu_ps(&scene.m_rotation_z[slot]);
+    __m128 w = _mm_loadu_ps(&scene.m_rotation_w[slot]);
+    __m128 sx = _mm_loadu_ps(&scene.m_scale_x[slot]);
+    __m128 sy = _mm_loadu_ps(&scene.m_scale_y[slot]);
+    __m128 sz = _mm_loadu_ps(&scene.m_scale_z[slot]);
+    __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+    __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+    __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+    __m128 columns[4][4];
+    columns[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+    columns[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+    columns[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+    columns[0][3] = _mm_setzero_ps();
+    columns[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+    columns[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+    columns[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+    columns[1][3] = _mm_setzero_ps();
+    columns[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+    columns[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+    columns[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+    columns[2][3] = _mm_setzero_ps();
+    columns[3][0] = _mm_loadu_ps(&scene.m_position_x[slot]);
+    columns[3][1] = _mm_loadu_ps(&scene.m_position_y[slot]);
+    columns[3][2] = _mm_loadu_ps(&scene.m_position_z[slot]);
+    columns[3][3] = one;
+    for (uint32_t c = 0; c < 4; c++) {
+        _MM_TRANSPOSE4_PS(columns[c][0], columns[c][1], columns[c][2], columns[c][3]);
+        for (uint32_t lane = 0; lane < 4; lane++) _mm_store_ps(out[lane].m + c * 4, columns[c][lane]);
+    }
+}
+
+// out = a * b, each column of the result is the columns of a weighted by one column of b
+static void multiply(const Mat4& a, const Mat4& b, Mat4& out)
+{
+    __m128 a0 = _mm_load_ps(a.m), a1 = _mm_load_ps(a.m + 4), a2 = _mm_load_ps(a.m + 8), a3 = _mm_load_ps(a.m + 12);
+    __m128 result[4];
+    for (uint32_t c = 0; c < 4; c++) {
+        __m128 column = _mm_load_ps(b.m + c * 4);
+        __m128 sum = _mm_mul_ps(a0, _mm_shuffle_ps(column, column, _MM_SHUFFLE(0, 0, 0, 0)));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_shuffle_ps(column, column, _MM_SHUFFLE(1, 1, 1, 1))));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_shuffle_ps(column, column, _MM_SHUFFLE(2, 2, 2, 2))));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_shuffle_ps(column, column, _MM_SHUFFLE(3, 3, 3, 3))));
+        result[c] = sum;
+    }
+    for (uint32_t c = 0; c < 4; c++) _mm_store_ps(out.m + c * 4, result[c]);
+}
+
+// Instance buffers are usually write combined, streaming stores skip reading the lines in first
+static void store_matrix(Mat4& dst, const Mat4& src)
+{
+    for (uint32_t c = 0; c < 4; c++) _mm_stream_ps(dst.m + c * 4, _mm_load_ps(src.m + c * 4));
+}
+#else
+static void local_matrices_x4(const SceneGraph& scene, uint32_t slot, Mat4 out[4])
+{
+    for (uint32_t lane = 0; lane < 4; lane++) local_matrix(scene, slot + lane, out[lane]);
+}
+
+static void multiply(const Mat4& a, const Mat4& b, Mat4& out)
+{
+    Mat4 result;
+    for (uint32_t c = 0; c < 4; c++) {
+        for (uint32_t r = 0; r < 4; r++) {
+            result.m[c * 4 + r] = a.m[r] * b.m[c * 4] + a.m[4 + r] * b.m[c * 4 + 1] + a.m[8 + r] * b.m[c * 4 + 2] +
+                                  a.m[12 + r] * b.m[c * 4 + 3];
+        }
+    }
+    out = result;
+}
+
+static void store_matrix(Mat4& dst, const Mat4& src) { dst = src; }
+#endif
+
+void SceneGraph::update_range(uint32_t begin, uint32_t end, InstanceTarget* target)
+{
+    const uint64_t serial = m_serial;
+    uint32_t recomputed = 0;
+    uint32_t written = 0;
+    Mat4 local[4];
+    for (uint32_t slot = begin; slot < end; slot += 4) {
+        uint32_t lanes = std::min(4u, end - slot);
+
+        // A node is recomputed when it moved itself, or when its parent was recomputed on the level above
+        uint32_t mask = 0;
+        for (uint32_t lane = 0; lane < lanes; lane++) {
+            uint32_t parent = m_parent[slot + lane];
+            bool moved = m_dirty[slot + lane] || (parent != k_none && m_changed[parent] == serial);
+            mask |= uint32_t(moved) << lane;
+        }
+        if (mask != 0) {
+            if (lanes == 4 && mask == 0xF) {
+                local_matrices_x4(*this, slot, local);
+            } else {
+                for (uint32_t lane = 0; lane < lanes; lane++) {
+                    if (mask & (1u << lane)) local_matrix(*this, slot + lane, local[lane]);
+                }
+            }
+            for (uint32_t lane = 0; lane < lanes; lane++) {
+                if (!(mask & (1u << lane))) continue;
+                uint32_t s = slot + lane;
+                if (m_parent[s] == k_none) {
+                    m_world[s] = local[lane];
+                } else {
+                    multiply(m_world[m_parent[s]], local[lane], m_world[s]);
+                }
+                m_changed[s] = serial;
+                m_dirty[s] = 0;
+                recomputed++;
+            }
+        }
+
+        // Anything that changed since this target was last written goes out, which covers frames in flight that
+        // missed earlier updates
+        if (target == nullptr) continue;
+        for (uint32_t lane = 0; lane < lanes; lane++) {
+            uint32_t s = slot + lane;
+            uint32_t instance = m_instance[s];
+            if (instance >= target->m_capacity || m_changed[s] <= target->m_written) continue;
+            store_matrix(target->m_data[instance], m_world[s]);
+            written++;
+        }
+    }
+    m_recomputed_count.fetch_add(recomputed, std::memory_order_relaxed);
+    m_written_count.fetch_add(written, std::memory_order_relaxed);
+}
+
+void SceneGraph::update(JobSystem* jobs, InstanceTarget* target)
+{
+    if (m_layout_dirty) rebuild_levels();
+    m_serial++;
+    m_recomputed_count.store(0);
+    m_written_count.store(0);
+    bool catch_up = target != nullptr && target->m_written < m_last_change;
+    if (m_any_dirty) m_last_change = m_serial;
+    if (m_any_dirty || catch_up) {
+        for (uint32_t level = 0; level + 1 < m_levels.size(); level++) {
+            uint32_t begin = m_levels[level];
+            uint32_t count = m_levels[level + 1] - begin;
+            auto run = [this, begin, target](size_t first, size_t last) {
+                update_range(begin + uint32_t(first), begin + uint32_t(last), target);
+            };
+            if (jobs != nullptr) {
+                jobs->parallel_for(count, k_chunk, run);
+            } else {
+                run(0, count);
+            }
+        }
+#ifdef ATELIER_SCENE_SSE
+        if (target != nullptr) _mm_sfence();
+#endif
+    }
+    m_any_dirty = false;
+    if (target != nullptr) target->m_written = m_serial;
+    m_recomputed = m_recomputed_count.load();
+    m_written = m_written_count.load();
+}
@@ -0,0 +1,186 @@
+#include "atelier/atelier_vk_shader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+using namespace Atelier;
+
+// Whether [offset, offset + size) lies inside the file, written so that it can't overflow
+static bool range_in_file(uint64_t offset, uint64_t size, size_t file_size)
+{
+    return offset <= file_size && size <= file_size - offset;
+}
+
+result ShaderArchive::open(const char* path)
+{
+    close();
+    if (m_file.open(path) != k_success) return -1;
+
+    // Validate the header and that the index is fully contained inside the file before trusting any offsets
+    if (m_file.m_size < sizeof(Header)) {
+        Log::error("Shader archive is too small to be valid: %s", path);
+        close();
+        return -2;
+    }
+    const auto* header = reinterpret_cast<const Header*>(m_file.m_data);
+    if (header->magic != k_magic || header->version != k_version) {
+        Log::error("Shader archive has an unknown magic or version: %s", path);
+        close();
+        return -3;
+    }
+    if (!range_in_file(sizeof(Header), uint64_t(header->entry_count) * sizeof(Entry), m_file.m_size) ||
+        !range_in_file(header->string_table_offset, header->string_table_size, m_file.m_size)) {
+        Log::error("Shader archive index is truncated: %s", path);
+        close();
+        return -4;
+    }
+
+    // Names are read straight out of the table, the last one must be terminated inside it
+    const auto* strings = reinterpret_cast<const char*>(m_file.m_data + header->string_table_offset);
+    if (header->string_table_size != 0 && strings[header->string_table_size - 1] != '\0') {
+        Log::error("Shader archive string table is not terminated: %s", path);
+        close();
+        return -4;
+    }
+
+    m_header = header;
+    m_entries = reinterpret_cast<const Entry*>(m_file.m_data + sizeof(Header));
+    m_strings = strings;
+
+    // Every blob must be inside the file and aligned so the words can be passed to vulkan without copying
+    m_name_lookup.reserve(header->entry_count);
+    for (uint32_t i = 0; i < header->entry_count; i++) {
+        const Entry& e = m_entries[i];
+        if (!range_in_file(e.offset, e.size, m_file.m_size) || (e.offset % sizeof(uint32_t)) != 0 ||
+            e.name_offset >= header->string_table_size) {
+            Log::error("Shader archive entry %u is out of bounds: %s", i, path);
+            close();
+            return -5;
+        }
+        m_name_lookup[std::string(m_strings + e.name_offset)] = i;
+    }
+
+    return k_success;
+}
+
+void ShaderArchive::close()
+{
+    m_name_lookup.clear();
+    m_header = nullptr;
+    m_entries = nullptr;
+    m_strings = nullptr;
+    m_file.close();
+}
+
+const ShaderArchive::Entry* ShaderArchive::find(uint64_t hash) const
+{
+    if (m_header == nullptr) return nullptr;
+    const Entry* end = m_entries + m_header->entry_count;
+    const Entry* it =
+      std::lower_bound(m_entries, end, hash, [](const Entry& e, uint64_t h) { return e.hash < h; });
+    return (it != end && it->hash == hash) ? it : nullptr;
+}
+
+const ShaderArchive::Entry* ShaderArchive::find(const char* name) const
+{
+    auto it = m_name_lookup.find(name);
+    return it == m_name_lookup.end() ? nullptr : &m_entries[it->second];
+}
+
+static size_t align_up(size_t value, size_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+result ShaderArchive::write(const char* path, const std::vector<Source>& sources)
+{
+    // Build the string table and the index in memory first, the blob offsets depend on the table size
+    std::vector<Entry> entries(sources.size());
+    std::string strings;
+    for (size_t i = 0; i < sources.size(); i++) {
+        entries[i].hash = hash_bytes(sources[i].code, sources[i].size);
+        entries[i].size = static_cast<uint32_t>(sources[i].size);
+        entries[i].name_offset = static_cast<uint32_t>(strings.size());
+        strings.append(sources[i].name);
+        strings.push_back('\0');
+    }
+
+    // Sort the index by hash, but keep track of which source each entry came from
+    std::vector<uint32_t> order(sources.size());
+    for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+    std::sort(order.begin(), order.end(),
+              [&](uint32_t a, uint32_t b) { return entries[a].hash < entries[b].hash; });
+
+    Header header = {};
+    header.magic = k_magic;
+    header.version = k_version;
+    header.entry_count = static_cast<uint32_t>(entries.size());
+    header.string_table_offset = sizeof(Header) + entries.size() * sizeof(Entry);
+    header.string_table_size = static_cast<uint32_t>(strings.size());
+
+    // Lay out the blobs, entries with the same content point at the one copy. Equal hashes sit next to each other
+    // in the order, but only share a blob when the bytes match as well
+    std::vector<uint32_t> unique_blobs;
+    size_t cursor = align_up(header.string_table_offset + strings.size(), k_blob_alignment);
+    for (size_t i = 0; i < order.size(); i++) {
+        Entry& e = entries[order[i]];
+        const Source& source = sources[order[i]];
+        const Entry* same = nullptr;
+        for (size_t j = i; j-- > 0 && entries[order[j]].hash == e.hash;) {
+            const Source& other = sources[order[j]];
+            if (other.size == source.size && memcmp(other.code, source.code, source.size) == 0) {
+                same = &entries[order[j]];
+                break;
+            }
+        }
+        if (same != nullptr) {
+            e.offset = same->offset;
+            continue;
+        }
+        e.offset = cursor;
+        cursor = align_up(cursor + e.size, k_blob_alignment);
+        unique_blobs.push_back(order[i]);
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        Log::error("Failed to open shader archive for writing: %s", path);
+        return -1;
+    }
+
+    bool ok = fwrite(&header, sizeof(Header), 1, file) == 1;
+    for (uint32_t i : order) ok = ok && fwrite(&entries[i], sizeof(Entry), 1, file) == 1;
+    ok = ok && fwrite(strings.data(), 1, strings.size(), file) == strings.size();
+
+    // Pad between blobs so every blob starts on the alignment boundary
+    static const uint8_t zeros[k_blob_alignment] = {};
+    size_t written = header.string_table_offset + strings.size();
+    for (uint32_t i : unique_blobs) {
+        const Entry& e = entries[i];
+        ok = ok && fwrite(zeros, 1, e.offset - written, file) == e.offset - written;
+        ok = ok && fwrite(sources[i].code, 1, e.size, file) == e.size;
+        written = e.offset + e.size;
+    }
+    fclose(file);
+
+    if (!ok) {
+        Log::error("Failed while writing shader archive: %s", path);
+        return -2;
+    }
+    return k_success;
+}
+
+result ShaderArchive::pack_files(const char* path, const std::vector<std::string>& spirv_paths)
+{
+    // Keep all of the inputs mapped until the archive has been written out
+    std::vector<MappedFile> files(spirv_paths.size());
+    std::vector<Source> sources(spirv_paths.size());
+    for (size_t i = 0; i < spirv_paths.size(); i++) {
+        if (files[i].open(spirv_paths[i].c_str()) != k_success) return -1;
+
+        const std::string& p = spirv_paths[i];
+        size_t slash = p.find_last_of("/\\");
+        sources[i].name = slash == std::string::npos ? p : p.substr(slash + 1);
+        sources[i].code = reinterpret_cast<const uint32_t*>(files[i].m_data);
+        sources[i].size = files[i].m_size;
+    }
+
+    return write(path, sources);
+}
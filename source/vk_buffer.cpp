@@ -0,0 +1,103 @@
+#include "atelier/atelier_vk_completed.h"
+#include "atelier/atelier_vk_memory.h"
+using namespace Atelier;
+
+result VkCompletedBuffer::init(VkCompletedDevice& device, VkDeviceSize size, VkBufferUsageFlags usage,
+                               VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred)
+{
+    if (device.m_handle == VK_NULL_HANDLE || size == 0) return -1;
+
+    VkBufferCreateInfo info = {VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    info.size = size;
+    info.usage = usage;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    if (vkCreateBuffer(device.m_handle, &info, nullptr, &buffer) != VK_SUCCESS) {
+        Log::error("Failed to create buffer of %llu bytes", (unsigned long long)size);
+        return -2;
+    }
+
+    // Try for the preferred flags on top of the required ones, otherwise settle for just the required
+    VkMemoryRequirements reqs = {};
+    vkGetBufferMemoryRequirements(device.m_handle, buffer, &reqs);
+    int32_t type = device.m_physical->find_memory_type(reqs.memoryTypeBits, required | preferred);
+    if (type < 0) type = device.m_physical->find_memory_type(reqs.memoryTypeBits, required);
+    if (type < 0) {
+        Log::error("No memory type is suitable for the buffer");
+        vkDestroyBuffer(device.m_handle, buffer, nullptr);
+        return -3;
+    }
+
+    VkMemoryAllocateInfo alloc = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    alloc.allocationSize = reqs.size;
+    alloc.memoryTypeIndex = type;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    if (vkAllocateMemory(device.m_handle, &alloc, nullptr, &memory) != VK_SUCCESS) {
+        Log::error("Failed to allocate %llu bytes for buffer", (unsigned long long)reqs.size);
+        vkDestroyBuffer(device.m_handle, buffer, nullptr);
+        return -4;
+    }
+    vkBindBufferMemory(device.m_handle, buffer, memory, 0);
+
+    m_memory_flags = device.m_physical->m_memory_properties.memoryTypes[type].propertyFlags;
+    if (m_memory_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        if (vkMapMemory(device.m_handle, memory, 0, VK_WHOLE_SIZE, 0, &m_mapped) != VK_SUCCESS) {
+            Log::error("Failed to persistently map buffer memory");
+            vkFreeMemory(device.m_handle, memory, nullptr);
+            vkDestroyBuffer(device.m_handle, buffer, nullptr);
+            return -5;
+        }
+    }
+
+    m_handle = buffer;
+    m_memory = memory;
+    m_parent = &device;
+    m_size = size;
+    m_memory_type = uint32_t(type);
+    m_allocation_size = reqs.size;
+    VkMemoryTelemetry::on_allocate(device, m_memory_type, m_allocation_size);
+    return k_success;
+}
+
+void VkCompletedBuffer::shutdown()
+{
+    if (m_parent == nullptr || m_parent->m_handle == VK_NULL_HANDLE) return;
+    if (m_mapped != nullptr) vkUnmapMemory(m_parent->m_handle, m_memory);
+    vkDestroyBuffer(m_parent->m_handle, m_handle, nullptr);
+    vkFreeMemory(m_parent->m_handle, m_memory, nullptr);
+    VkMemoryTelemetry::on_free(*m_parent, m_memory_type, m_allocation_size);
+    m_handle = VK_NULL_HANDLE;
+    m_memory = VK_NULL_HANDLE;
+    m_mapped = nullptr;
+    m_parent = nullptr;
+    m_size = 0;
+}
+
+// Non coherent ranges have to be expanded out to the atom size of the device
+static VkMappedMemoryRange atom_range(const VkCompletedBuffer& buffer, VkDeviceSize offset, VkDeviceSize size)
+{
+    VkDeviceSize atom = buffer.m_parent->m_physical->m_device_properties.limits.nonCoherentAtomSize;
+    if (atom == 0) atom = 1;
+    VkMappedMemoryRange range = {VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE};
+    range.memory = buffer.m_memory;
+    range.offset = offset / atom * atom;
+    VkDeviceSize end = (offset + size + atom - 1) / atom * atom;
+    range.size = end >= buffer.m_size ? VK_WHOLE_SIZE : end - range.offset;
+    return range;
+}
+
+void VkCompletedBuffer::flush(VkDeviceSize offset, VkDeviceSize size) const
+{
+    if (m_mapped == nullptr || (m_memory_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) return;
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    VkMappedMemoryRange range = atom_range(*this, offset, size);
+    api.vkFlushMappedMemoryRanges(m_parent->m_handle, 1, &range);
+}
+
+void VkCompletedBuffer::invalidate(VkDeviceSize offset, VkDeviceSize size) const
+{
+    if (m_mapped == nullptr || (m_memory_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) return;
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    VkMappedMemoryRange range = atom_range(*this, offset, size);
+    api.vkInvalidateMappedMemoryRanges(m_parent->m_handle, 1, &range);
+}
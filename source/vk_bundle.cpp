@@ -0,0 +1,101 @@
+#include "atelier/atelier_vk_bundle.h"
+using namespace Atelier;
+
+result VkCommandBundle::init(VkCompletedDevice& device, uint32_t queue_family, uint32_t slots, Recorder recorder)
+{
+    if (device.m_handle == VK_NULL_HANDLE || !recorder) return -1;
+    VkCommandPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex = queue_family;
+    if (vkCreateCommandPool(device.m_handle, &pool_info, nullptr, &m_pool) != VK_SUCCESS) {
+        Log::error("Failed to create the command pool for a bundle");
+        return -2;
+    }
+    m_parent = &device;
+    m_recorder = std::move(recorder);
+    m_generation = 1;
+    m_key = 0;
+    m_slots.assign(slots, Slot());
+    return k_success;
+}
+
+void VkCommandBundle::shutdown()
+{
+    if (m_parent == nullptr) return;
+    vkDestroyCommandPool(m_parent->m_handle, m_pool, nullptr);
+    m_pool = VK_NULL_HANDLE;
+    m_slots.clear();
+    m_retired.clear();
+    m_free.clear();
+    m_recorder = nullptr;
+    m_parent = nullptr;
+}
+
+void VkCommandBundle::set_key(uint64_t key)
+{
+    if (key == m_key) return;
+    m_key = key;
+    invalidate();
+}
+
+void VkCommandBundle::resize(uint32_t slots)
+{
+    // The dropped slots' buffers can still be in flight, so they go through the retired list like any other
+    for (uint32_t i = slots; i < m_slots.size(); i++) {
+        if (m_slots[i].m_cmd != VK_NULL_HANDLE) m_retired.push_back({m_slots[i].m_cmd, m_slots[i].m_serial});
+    }
+    m_slots.resize(slots);
+    invalidate();
+}
+
+VkCommandBuffer VkCommandBundle::acquire(uint32_t slot, uint64_t serial, uint64_t completed)
+{
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    Slot& s = m_slots[slot];
+    uint64_t previous = s.m_serial;
+    s.m_serial = serial;
+    if (s.m_generation == m_generation) {
+        m_replays++;
+        return s.m_cmd;
+    }
+
+    for (size_t i = 0; i < m_retired.size();) {
+        if (m_retired[i].m_serial > completed) {
+            i++;
+            continue;
+        }
+        m_free.push_back(m_retired[i].m_cmd);
+        m_retired[i] = m_retired.back();
+        m_retired.pop_back();
+    }
+
+    // A buffer the GPU may still be running can't be reset, so it's swapped for one that's done
+    if (s.m_cmd != VK_NULL_HANDLE && previous > completed) {
+        m_retired.push_back({s.m_cmd, previous});
+        s.m_cmd = VK_NULL_HANDLE;
+    }
+    if (s.m_cmd == VK_NULL_HANDLE && !m_free.empty()) {
+        s.m_cmd = m_free.back();
+        m_free.pop_back();
+    }
+    if (s.m_cmd == VK_NULL_HANDLE) {
+        VkCommandBufferAllocateInfo buffer_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        buffer_info.commandPool = m_pool;
+        buffer_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        buffer_info.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(m_parent->m_handle, &buffer_info, &s.m_cmd) != VK_SUCCESS) {
+            Log::error("Failed to allocate a bundle command buffer");
+            return VK_NULL_HANDLE;
+        }
+    }
+
+    // Simultaneous use because a swapchain image can be acquired again before its last frame's fence is seen
+    VkCommandBufferBeginInfo begin = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    begin.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+    api.vkBeginCommandBuffer(s.m_cmd, &begin);
+    m_recorder(s.m_cmd, slot);
+    api.vkEndCommandBuffer(s.m_cmd);
+    s.m_generation = m_generation;
+    m_recordings++;
+    return s.m_cmd;
+}
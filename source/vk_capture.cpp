@@ -0,0 +1,215 @@
+#include "atelier/atelier_io.h"
+#include "atelier/atelier_pixel.h"
+#include "atelier/atelier_vk_capture.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+#include <vector>
+using namespace Atelier;
+
+// Bytes per texel of the colour formats a swapchain or render target is likely to be in, 0 for anything else
+static uint32_t texel_size(VkFormat format)
+{
+    switch (format) {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+            return 4;
+        case VK_FORMAT_R16G16B16A16_UNORM:
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+            return 8;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+// Formats we know how to turn into RGBA8 for the PNG encoder
+static bool is_bgra8(VkFormat format)
+{
+    return format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+}
+static bool is_rgba8(VkFormat format)
+{
+    return format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB;
+}
+
+result VkFrameCapture::init(VkCompletedDevice& device, JobSystem& jobs, VkFormat format, VkExtent2D max_extent,
+                            uint32_t slot_count, const char* directory, Encoding encoding)
+{
+    if (slot_count == 0 || max_extent.width == 0 || max_extent.height == 0) return -1;
+    uint32_t texel = texel_size(format);
+    if (texel == 0) {
+        Log::error("Can't capture images of format %d", (int)format);
+        return -1;
+    }
+    if (encoding == Encoding::k_png && !is_bgra8(format) && !is_rgba8(format)) {
+        Log::error("Can't write PNG captures of format %d, only 8 bit RGBA and BGRA", (int)format);
+        return -1;
+    }
+
+    std::error_code err;
+    std::filesystem::create_directories(directory, err);
+    if (err) {
+        Log::error("Failed to create capture directory %s", directory);
+        return -2;
+    }
+
+    // Cached memory makes the reads on the encoder threads much cheaper, coherency is optional since we invalidate
+    m_slot_size = VkDeviceSize(max_extent.width) * max_extent.height * texel;
+    m_slots = std::make_unique<Slot[]>(slot_count);
+    m_slot_count = slot_count;
+    for (uint32_t i = 0; i < slot_count; i++) {
+        if (m_slots[i].m_buffer.init(device, m_slot_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                     VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != k_success) {
+            Log::error("Failed to create capture readback buffer %u", i);
+            shutdown();
+            return -3;
+        }
+    }
+
+    m_parent = &device;
+    m_jobs = &jobs;
+    m_directory = directory;
+    m_encoding = encoding;
+    return k_success;
+}
+
+void VkFrameCapture::shutdown()
+{
+    while (m_encoding_in_flight.load() != 0) std::this_thread::yield();
+    for (uint32_t i = 0; i < m_slot_count; i++) m_slots[i].m_buffer.shutdown();
+    m_slots.reset();
+    m_slot_count = 0;
+    m_parent = nullptr;
+    m_jobs = nullptr;
+}
+
+bool VkFrameCapture::record(VkCommandBuffer cmd, VkImage image, VkFormat format, VkExtent2D extent,
+                            VkImageLayout layout, uint64_t serial)
+{
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    VkDeviceSize texel = texel_size(format);
+    bool encodable = m_encoding != Encoding::k_png || is_bgra8(format) || is_rgba8(format);
+    if (texel == 0 || !encodable || VkDeviceSize(extent.width) * extent.height * texel > m_slot_size) {
+        m_dropped.fetch_add(1);
+        return false;
+    }
+
+    // Slots are handed out in order so a free one is almost always the next one, but encoders can finish out of
+    // order so look around the whole ring before giving up
+    Slot* slot = nullptr;
+    for (uint32_t i = 0; i < m_slot_count && slot == nullptr; i++) {
+        Slot& candidate = m_slots[(m_next_slot + i) % m_slot_count];
+        if (candidate.m_state.load(std::memory_order_acquire) == SlotState::k_free) slot = &candidate;
+    }
+    if (slot == nullptr) {
+        m_dropped.fetch_add(1);
+        return false;
+    }
+    m_next_slot = static_cast<uint32_t>((slot - m_slots.get()) + 1) % m_slot_count;
+
+    VkImageMemoryBarrier to_src = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+    to_src.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    to_src.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    to_src.oldLayout = layout;
+    to_src.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    to_src.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_src.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_src.image = image;
+    to_src.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    api.vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &to_src);
+
+    VkBufferImageCopy region = {};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {extent.width, extent.height, 1};
+    api.vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->m_buffer.m_handle, 1,
+                               &region);
+
+    // Put the image back for whoever was using it, and make the copy visible to the host once the fence passes
+    VkImageMemoryBarrier to_original = to_src;
+    to_original.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    to_original.dstAccessMask = 0;
+    to_original.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    to_original.newLayout = layout;
+    VkBufferMemoryBarrier to_host = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+    to_host.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    to_host.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    to_host.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_host.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_host.buffer = slot->m_buffer.m_handle;
+    to_host.size = VK_WHOLE_SIZE;
+    api.vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1,
+                             &to_host, 1, &to_original);
+
+    slot->m_serial = serial;
+    slot->m_frame_number = m_next_frame_number++;
+    slot->m_extent = extent;
+    slot->m_format = format;
+    slot->m_state.store(SlotState::k_recorded, std::memory_order_release);
+    return true;
+}
+
+void VkFrameCapture::poll(uint64_t completed_serial)
+{
+    for (uint32_t i = 0; i < m_slot_count; i++) {
+        Slot& slot = m_slots[i];
+        if (slot.m_state.load(std::memory_order_acquire) != SlotState::k_recorded) continue;
+        if (slot.m_serial > completed_serial) continue;
+
+        slot.m_state.store(SlotState::k_encoding, std::memory_order_release);
+        m_encoding_in_flight.fetch_add(1);
+        m_jobs->push([this, &slot]() {
+            encode(slot);
+            slot.m_state.store(SlotState::k_free, std::memory_order_release);
+            m_encoding_in_flight.fetch_sub(1);
+        });
+    }
+}
+
+void VkFrameCapture::encode(Slot& slot)
+{
+    const uint32_t width = slot.m_extent.width;
+    const uint32_t height = slot.m_extent.height;
+    const size_t size = size_t(width) * height * texel_size(slot.m_format);
+    slot.m_buffer.invalidate(0, size);
+    const auto* pixels = static_cast<const uint8_t*>(slot.m_buffer.m_mapped);
+
+    char path[512];
+    if (m_encoding == Encoding::k_raw) {
+        // Raw dumps keep the swapchain's own texel layout, the name carries everything needed to read them back
+        snprintf(path, sizeof(path), "%s/frame_%06llu_%ux%u_fmt%d.raw", m_directory.c_str(),
+                 (unsigned long long)slot.m_frame_number, width, height, (int)slot.m_format);
+        FILE* file = fopen(path, "wb");
+        bool ok = file != nullptr && fwrite(pixels, 1, size, file) == size;
+        if (file != nullptr) fclose(file);
+        if (!ok) {
+            Log::error("Failed to write capture %s", path);
+            return;
+        }
+        m_written.fetch_add(1);
+        return;
+    }
+
+    snprintf(path, sizeof(path), "%s/frame_%06llu.png", m_directory.c_str(),
+             (unsigned long long)slot.m_frame_number);
+    std::vector<uint8_t> rgba;
+    if (is_bgra8(slot.m_format)) {
+        rgba.resize(size);
+        pixel_kernels().swizzle_rb(rgba.data(), pixels, size / 4);
+        pixels = rgba.data();
+    }
+    if (write_png(path, pixels, width, height, size_t(width) * 4) != k_success) {
+        Log::error("Failed to write capture %s", path);
+        return;
+    }
+    m_written.fetch_add(1);
+}
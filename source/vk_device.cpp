@@ -9,6 +9,7 @@ result VkCompletedPhysicalDevice::init_from_instance(VkInstance instance, VkPhys
     (void)instance;
     m_handle = device;
     vkGetPhysicalDeviceProperties(device, &m_device_properties);
+    vkGetPhysicalDeviceMemoryProperties(device, &m_memory_properties);
     return k_success;
 }
 
@@ -16,9 +17,19 @@ result VkCompletedPhysicalDevice::init_from_mutable_device(const VkMutableDevice
 {
     m_handle = info.physical_device;
     m_device_properties = info.device_properties;
+    vkGetPhysicalDeviceMemoryProperties(info.physical_device, &m_memory_properties);
     return k_success;
 }
 
+int32_t VkCompletedPhysicalDevice::find_memory_type(uint32_t type_bits, VkMemoryPropertyFlags required) const
+{
+    for (uint32_t i = 0; i < m_memory_properties.memoryTypeCount; i++) {
+        if ((type_bits & (1u << i)) == 0) continue;
+        if ((m_memory_properties.memoryTypes[i].propertyFlags & required) == required) return i;
+    }
+    return -1;
+}
+
 result VkCompletedDevice::init_from_mutable_device(const VkMutableDeviceCreateInfo& info)
 {
     // Try and initialize the vulkan handle for a logical device, but not touching the original
@@ -28,6 +39,13 @@ result VkCompletedDevice::init_from_mutable_device(const VkMutableDeviceCreateIn
         return -1;
     }
 
+    // Hot calls skip the loader's trampolines by going through the table
+    if (m_dispatch.load(vkGetDeviceProcAddr, device) != k_success) {
+        Log::error("Failed to load the device entry points");
+        vkDestroyDevice(device, nullptr);
+        return -2;
+    }
+
     // We track the queues for each family as a group. The user can in theory create multiple queues targeting the
     // same family
     m_queues.reserve(info.queue_infos.size());
@@ -46,6 +64,7 @@ result VkCompletedDevice::init_from_mutable_device(const VkMutableDeviceCreateIn
 
     // Success attach the device handle and extensions
     m_handle = device;
+    m_enabled_features = info.enabled_features;
     m_enabled_extensions.reserve(info.ext_selected.size());
     for (const char* s : info.ext_selected) {
         m_enabled_extensions.push_back(std::string(s));
@@ -53,6 +72,14 @@ result VkCompletedDevice::init_from_mutable_device(const VkMutableDeviceCreateIn
     return k_success;
 }
 
+bool VkCompletedDevice::has_extension(const char* name) const
+{
+    for (const auto& ext : m_enabled_extensions) {
+        if (ext == name) return true;
+    }
+    return false;
+}
+
 void Atelier::VkCompletedPhysicalDevice::shutdown(VkCompletedState& vk)
 {
     // In most cleanup the logical devices are cleared up separately but just in
@@ -87,11 +114,44 @@ result VkMutableDeviceCreateInfo::create_device(VkDevice& device, const VkAlloca
     info.enabledExtensionCount = ext_selected.size();
     info.pQueueCreateInfos = queue_infos.data();
     info.queueCreateInfoCount = queue_infos.size();
+    info.pEnabledFeatures = &enabled_features;
+
+    // The features are required wherever their extensions are, so each one is switched on whenever its extension
+    // was selected
+    VkPhysicalDeviceSynchronization2Features sync2 = {};
+    sync2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
+    sync2.synchronization2 = VK_TRUE;
+    VkPhysicalDeviceTimelineSemaphoreFeatures timeline = {};
+    timeline.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timeline.timelineSemaphore = VK_TRUE;
+    for (const char* ext : ext_selected) {
+        if (strcmp(ext, "VK_KHR_synchronization2") == 0) {
+            sync2.pNext = const_cast<void*>(info.pNext);
+            info.pNext = &sync2;
+        } else if (strcmp(ext, "VK_KHR_timeline_semaphore") == 0) {
+            timeline.pNext = const_cast<void*>(info.pNext);
+            info.pNext = &timeline;
+        }
+    }
 
     if (vkCreateDevice(physical_device, &info, alloc, &device) != VK_SUCCESS) return -1;
     return k_success;
 }
 
+static constexpr const char* s_default_device_ext[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+                                                       "VK_KHR_draw_indirect_count",
+                                                       "VK_KHR_external_memory",
+                                                       "VK_KHR_external_memory_fd",
+                                                       "VK_KHR_external_memory_win32",
+                                                       "VK_KHR_external_semaphore",
+                                                       "VK_KHR_external_semaphore_fd",
+                                                       "VK_KHR_external_semaphore_win32",
+                                                       "VK_KHR_synchronization2",
+                                                       "VK_KHR_timeline_semaphore",
+                                                       "VK_EXT_external_memory_host",
+                                                       "VK_EXT_memory_budget"};
+static constexpr uint32_t s_default_device_ext_count = sizeof(s_default_device_ext) / sizeof(char*);
+
 result VkMutableDeviceCreateInfo::create_default(VkMutableDeviceCreateInfo& dev, VkInstance instance,
                                                  VkPhysicalDevice physical)
 {
@@ -107,14 +167,22 @@ result VkMutableDeviceCreateInfo::create_default(VkMutableDeviceCreateInfo& dev,
     if (vkEnumerateDeviceExtensionProperties(physical, nullptr, &count, dev.ext_props.data()) != VK_SUCCESS)
         return -3;
 
-    // By default we want to append the VkSwapchain extension for displaying
-    for (const auto& exts : dev.ext_props) {
-        if (strcmp(exts.extensionName, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0) {
-            dev.ext_selected.push_back(exts.extensionName);
-            break;
+    // By default we want to append the VkSwapchain extension for displaying, plus any of the optional extensions
+    // the rest of the code can make use of when the device has them
+    for (size_t i = 0; i < s_default_device_ext_count; i++) {
+        for (const auto& exts : dev.ext_props) {
+            if (strcmp(exts.extensionName, s_default_device_ext[i]) == 0) {
+                dev.ext_selected.push_back(exts.extensionName);
+                break;
+            }
         }
     }
 
+    // Only turn on the features that indirect drawing benefits from, everything else stays off
+    vkGetPhysicalDeviceFeatures(physical, &dev.supported_features);
+    dev.enabled_features.multiDrawIndirect = dev.supported_features.multiDrawIndirect;
+    dev.enabled_features.drawIndirectFirstInstance = dev.supported_features.drawIndirectFirstInstance;
+
     // Get the queue properties
     vkGetPhysicalDeviceQueueFamilyProperties(physical, &count, nullptr);
     dev.queue_props.resize(count);
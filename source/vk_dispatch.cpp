@@ -0,0 +1,137 @@
+#include "atelier/atelier_vk_dispatch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <vector>
+using namespace Atelier;
+
+// Extension entry points which are allowed to come back null
+static bool is_extension_entry(const char* name)
+{
+    size_t length = strlen(name);
+    return length > 3 && (strcmp(name + length - 3, "KHR") == 0 || strcmp(name + length - 3, "EXT") == 0);
+}
+
+result VkInstanceDispatch::load(VkInstance instance)
+{
+    uint32_t missing = 0;
+#define ATELIER_VK_LOAD(name)                                                                                     \
+    name = (PFN_##name)vkGetInstanceProcAddr(instance, #name);                                                    \
+    if (name == nullptr && !is_extension_entry(#name)) {                                                          \
+        Log::error("Instance entry point %s is missing", #name);                                                  \
+        missing++;                                                                                                \
+    }
+    ATELIER_VK_INSTANCE_FUNCTIONS(ATELIER_VK_LOAD)
+#undef ATELIER_VK_LOAD
+    return missing == 0 ? k_success : -1;
+}
+
+#ifdef ATELIER_VK_INSTRUMENT
+uint64_t Atelier::vk_dispatch_now_ns()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+}
+
+void VkCallStats::record(uint64_t ns)
+{
+    uint32_t bucket = 0;
+    for (uint64_t edge = 64; bucket + 1 < k_buckets && ns >= edge; edge <<= 1) bucket++;
+    m_calls.fetch_add(1, std::memory_order_relaxed);
+    m_total_ns.fetch_add(ns, std::memory_order_relaxed);
+    m_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void VkCallStats::end_frame()
+{
+    // Calls landing on another thread while this runs go into the next frame rather than being lost
+    m_frame.m_calls = m_calls.exchange(0, std::memory_order_relaxed);
+    m_frame.m_total_ns = m_total_ns.exchange(0, std::memory_order_relaxed);
+    m_run.m_calls += m_frame.m_calls;
+    m_run.m_total_ns += m_frame.m_total_ns;
+    for (uint32_t b = 0; b < k_buckets; b++) {
+        m_frame.m_histogram[b] = m_histogram[b].exchange(0, std::memory_order_relaxed);
+        m_run.m_histogram[b] += m_frame.m_histogram[b];
+    }
+}
+
+uint64_t VkCallStats::Snapshot::percentile_ns(double fraction) const
+{
+    uint64_t calls = 0;
+    for (uint32_t b = 0; b < k_buckets; b++) calls += m_histogram[b];
+    if (calls == 0) return 0;
+    uint64_t wanted = uint64_t(double(calls) * fraction);
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < k_buckets; b++) {
+        seen += m_histogram[b];
+        if (seen > wanted) return uint64_t(64) << b;
+    }
+    return uint64_t(64) << (k_buckets - 1);
+}
+#endif
+
+result VkDeviceDispatch::load(PFN_vkGetDeviceProcAddr get_device_proc_addr, VkDevice device)
+{
+    uint32_t missing = 0;
+#ifdef ATELIER_VK_INSTRUMENT
+    static const char* const names[] = {
+#define ATELIER_VK_NAME(name) #name,
+      ATELIER_VK_DEVICE_FUNCTIONS(ATELIER_VK_NAME)
+#undef ATELIER_VK_NAME
+    };
+    m_stats_count = uint32_t(sizeof(names) / sizeof(names[0]));
+    m_stats.reset(new VkCallStats[m_stats_count]);
+    m_frames = 0;
+    uint32_t index = 0;
+    for (uint32_t i = 0; i < m_stats_count; i++) m_stats[i].m_name = names[i];
+#define ATELIER_VK_LOAD(name)                                                                                     \
+    name.m_fn = (PFN_##name)get_device_proc_addr(device, #name);                                                  \
+    name.m_stats = &m_stats[index++];                                                                             \
+    if (name.m_fn == nullptr && !is_extension_entry(#name)) {                                                     \
+        Log::error("Device entry point %s is missing", #name);                                                    \
+        missing++;                                                                                                \
+    }
+#else
+#define ATELIER_VK_LOAD(name)                                                                                     \
+    name = (PFN_##name)get_device_proc_addr(device, #name);                                                       \
+    if (name == nullptr && !is_extension_entry(#name)) {                                                          \
+        Log::error("Device entry point %s is missing", #name);                                                    \
+        missing++;                                                                                                \
+    }
+#endif
+    ATELIER_VK_DEVICE_FUNCTIONS(ATELIER_VK_LOAD)
+#undef ATELIER_VK_LOAD
+    return missing == 0 ? k_success : -1;
+}
+
+void VkDeviceDispatch::end_frame()
+{
+#ifdef ATELIER_VK_INSTRUMENT
+    for (uint32_t i = 0; i < m_stats_count; i++) m_stats[i].end_frame();
+    m_frames++;
+#endif
+}
+
+void VkDeviceDispatch::log_stats(uint32_t top) const
+{
+#ifdef ATELIER_VK_INSTRUMENT
+    if (m_frames == 0) return;
+    std::vector<const VkCallStats*> order;
+    for (uint32_t i = 0; i < m_stats_count; i++) {
+        if (m_stats[i].m_run.m_calls > 0) order.push_back(&m_stats[i]);
+    }
+    std::sort(order.begin(), order.end(), [](const VkCallStats* a, const VkCallStats* b) {
+        return a->m_run.m_total_ns > b->m_run.m_total_ns;
+    });
+    Log::info("Vulkan calls over %llu frames, by time spent in the driver", (unsigned long long)m_frames);
+    for (uint32_t i = 0; i < order.size() && i < top; i++) {
+        const VkCallStats::Snapshot& run = order[i]->m_run;
+        Log::info("  %-36s %9.1f calls/frame %9.3f us/frame  p50 < %llu ns  p99 < %llu ns", order[i]->m_name,
+                  double(run.m_calls) / double(m_frames), double(run.m_total_ns) / double(m_frames) / 1e3,
+                  (unsigned long long)run.percentile_ns(0.5), (unsigned long long)run.percentile_ns(0.99));
+    }
+#else
+    (void)top;
+#endif
+}
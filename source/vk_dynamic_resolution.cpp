@@ -0,0 +1,260 @@
+#include "atelier/atelier_vk_dynamic_resolution.h"
+#include "atelier/atelier_vk_memory.h"
+
+#include <algorithm>
+#include <cmath>
+using namespace Atelier;
+
+bool ResolutionController::update(uint64_t gpu_ns)
+{
+    if (m_target_ns == 0) {
+        if (m_scale == m_max_scale) return false;
+        m_scale = m_max_scale;
+        m_changes++;
+        return true;
+    }
+    if (gpu_ns == 0) return false;
+    if (m_settle > 0) {
+        m_settle--;
+        return false;
+    }
+    m_gpu.add(double(gpu_ns));
+    if (++m_samples < m_min_samples) return false;
+
+    // Pixels go with the square of the scale, so the time does too. Going up aims at the bottom of the band
+    // rather than the target itself, otherwise the next noisy frame would bring it straight back down
+    double predicted = m_gpu.predict();
+    double target = double(m_target_ns);
+    double wanted = m_scale;
+    if (predicted > target) {
+        wanted = m_scale * std::sqrt(target / predicted);
+    } else if (predicted < target * m_raise_below) {
+        wanted = m_scale * std::sqrt(target * m_raise_below / predicted);
+    } else {
+        return false;
+    }
+    wanted = std::clamp(wanted, double(m_scale - m_max_drop), double(m_scale + m_max_raise));
+    float next = std::floor(float(wanted) / m_granularity) * m_granularity;
+    next = std::clamp(next, m_min_scale, m_max_scale);
+    if (std::fabs(next - m_scale) < m_granularity * 0.5f) return false;
+
+    m_scale = next;
+    m_gpu = FramePredictor();
+    m_samples = 0;
+    m_settle = m_settle_frames;
+    m_changes++;
+    return true;
+}
+
+VkExtent2D ResolutionController::render_extent(VkExtent2D output) const
+{
+    VkExtent2D extent;
+    extent.width = std::max(1u, uint32_t(float(output.width) * m_scale + 0.5f));
+    extent.height = std::max(1u, uint32_t(float(output.height) * m_scale + 0.5f));
+    return extent;
+}
+
+result VkDynamicResolution::init(VkCompletedDevice& device, VkFormat format, VkExtent2D max_extent)
+{
+    if (max_extent.width == 0 || max_extent.height == 0) return -1;
+    m_parent = &device;
+    m_format = format;
+    m_max_extent = max_extent;
+    VkDevice dev = device.m_handle;
+
+    VkFormatProperties props = {};
+    vkGetPhysicalDeviceFormatProperties(device.m_physical->m_handle, format, &props);
+    const VkFormatFeatureFlags needed =
+      VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+    if ((props.optimalTilingFeatures & needed) != needed) {
+        Log::warn("Format %d can't be blitted, dynamic resolution is unavailable", int(format));
+        return -2;
+    }
+    bool linear = (props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) != 0;
+    m_filter = linear ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+    VkImageCreateInfo image_info = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = format;
+    image_info.extent = {max_extent.width, max_extent.height, 1};
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateImage(dev, &image_info, nullptr, &m_image) != VK_SUCCESS) {
+        Log::error("Failed to create a %ux%u dynamic resolution target", max_extent.width, max_extent.height);
+        shutdown();
+        return -3;
+    }
+
+    VkMemoryRequirements reqs = {};
+    vkGetImageMemoryRequirements(dev, m_image, &reqs);
+    int32_t type = device.m_physical->find_memory_type(reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (type < 0) type = device.m_physical->find_memory_type(reqs.memoryTypeBits, 0);
+    VkMemoryAllocateInfo alloc_info = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    alloc_info.allocationSize = reqs.size;
+    alloc_info.memoryTypeIndex = uint32_t(type);
+    if (type < 0 || vkAllocateMemory(dev, &alloc_info, nullptr, &m_memory) != VK_SUCCESS ||
+        vkBindImageMemory(dev, m_image, m_memory, 0) != VK_SUCCESS) {
+        Log::error("Failed to allocate %llu bytes for the dynamic resolution target",
+                   (unsigned long long)reqs.size);
+        shutdown();
+        return -4;
+    }
+    m_memory_type = alloc_info.memoryTypeIndex;
+    m_bytes = reqs.size;
+    VkMemoryTelemetry::on_allocate(device, m_memory_type, m_bytes);
+
+    VkImageViewCreateInfo view_info = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+    view_info.image = m_image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = format;
+    view_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    if (vkCreateImageView(dev, &view_info, nullptr, &m_view) != VK_SUCCESS) {
+        Log::error("Failed to create the dynamic resolution target view");
+        shutdown();
+        return -5;
+    }
+
+    // The old contents are never needed, and the pass hands the target straight to the blit
+    VkAttachmentDescription attachment = {};
+    attachment.format = format;
+    attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    VkAttachmentReference ref = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &ref;
+
+    // The first waits for the last frame's blit to finish reading before the target is overwritten, the second
+    // makes the writes visible to this frame's blit
+    VkSubpassDependency deps[2] = {};
+    deps[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    deps[0].dstSubpass = 0;
+    deps[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    deps[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    deps[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    deps[1].srcSubpass = 0;
+    deps[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    deps[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    deps[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    deps[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    deps[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    VkRenderPassCreateInfo pass_info = {VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+    pass_info.attachmentCount = 1;
+    pass_info.pAttachments = &attachment;
+    pass_info.subpassCount = 1;
+    pass_info.pSubpasses = &subpass;
+    pass_info.dependencyCount = 2;
+    pass_info.pDependencies = deps;
+    if (vkCreateRenderPass(dev, &pass_info, nullptr, &m_render_pass) != VK_SUCCESS) {
+        Log::error("Failed to create the dynamic resolution render pass");
+        shutdown();
+        return -6;
+    }
+
+    VkFramebufferCreateInfo fb = {VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+    fb.renderPass = m_render_pass;
+    fb.attachmentCount = 1;
+    fb.pAttachments = &m_view;
+    fb.width = max_extent.width;
+    fb.height = max_extent.height;
+    fb.layers = 1;
+    if (vkCreateFramebuffer(dev, &fb, nullptr, &m_framebuffer) != VK_SUCCESS) {
+        Log::error("Failed to create the dynamic resolution framebuffer");
+        shutdown();
+        return -7;
+    }
+    return k_success;
+}
+
+void VkDynamicResolution::shutdown()
+{
+    if (m_parent == nullptr) return;
+    VkDevice dev = m_parent->m_handle;
+    vkDestroyFramebuffer(dev, m_framebuffer, nullptr);
+    vkDestroyRenderPass(dev, m_render_pass, nullptr);
+    vkDestroyImageView(dev, m_view, nullptr);
+    vkDestroyImage(dev, m_image, nullptr);
+    if (m_memory != VK_NULL_HANDLE) {
+        vkFreeMemory(dev, m_memory, nullptr);
+        VkMemoryTelemetry::on_free(*m_parent, m_memory_type, m_bytes);
+    }
+    ResolutionController controller = m_controller;
+    *this = VkDynamicResolution();
+    m_controller = controller;
+}
+
+VkExtent2D VkDynamicResolution::render_extent(VkExtent2D output) const
+{
+    VkExtent2D extent = m_controller.render_extent(output);
+    extent.width = std::min(extent.width, m_max_extent.width);
+    extent.height = std::min(extent.height, m_max_extent.height);
+    return extent;
+}
+
+void VkDynamicResolution::begin(VkCommandBuffer cmd, VkExtent2D output, const VkClearValue& clear) const
+{
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    VkExtent2D extent = render_extent(output);
+    VkRenderPassBeginInfo begin = {VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+    begin.renderPass = m_render_pass;
+    begin.framebuffer = m_framebuffer;
+    begin.renderArea.offset = {0, 0};
+    begin.renderArea.extent = extent;
+    begin.clearValueCount = 1;
+    begin.pClearValues = &clear;
+    api.vkCmdBeginRenderPass(cmd, &begin, VK_SUBPASS_CONTENTS_INLINE);
+
+    VkViewport viewport = {0.0f, 0.0f, float(extent.width), float(extent.height), 0.0f, 1.0f};
+    VkRect2D scissor = {{0, 0}, extent};
+    api.vkCmdSetViewport(cmd, 0, 1, &viewport);
+    api.vkCmdSetScissor(cmd, 0, 1, &scissor);
+}
+
+void VkDynamicResolution::end(VkCommandBuffer cmd) const { m_parent->m_dispatch.vkCmdEndRenderPass(cmd); }
+
+void VkDynamicResolution::upscale(VkCommandBuffer cmd, VkImage output, VkExtent2D extent,
+                                  VkImageLayout final_layout) const
+{
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    VkExtent2D source = render_extent(extent);
+
+    // The acquire semaphore is waited on at colour output, starting the transition there chains onto it
+    VkImageMemoryBarrier barrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = output;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    api.vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkImageBlit blit = {};
+    blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    blit.srcOffsets[1] = {int32_t(source.width), int32_t(source.height), 1};
+    blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    blit.dstOffsets[1] = {int32_t(extent.width), int32_t(extent.height), 1};
+    api.vkCmdBlitImage(cmd, m_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, output,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, m_filter);
+
+    // Whatever comes next, an overlay pass or the present, waits on the blit
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = final_layout;
+    api.vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0,
+                             nullptr, 0, nullptr, 1, &barrier);
+}
@@ -0,0 +1,238 @@
+#include "atelier/atelier_vk_gpu_cull.h"
+
+#include <cmath>
+using namespace Atelier;
+
+static constexpr uint32_t s_group_size = 64;  // local_size_x in shaders/cull.comp
+
+result VkGpuCuller::init(VkCompletedDevice& device, VkShaderRegistry& shaders, uint32_t max_objects,
+                         const char* cull_spirv_path)
+{
+    if (max_objects == 0) return -1;
+    m_parent = &device;
+    m_shaders = &shaders;
+    m_max_objects = max_objects;
+    VkDevice dev = device.m_handle;
+
+    // Inputs are host visible so the scene can be edited in place, the outputs want to be device local
+    VkDeviceSize draws_size = VkDeviceSize(max_objects) * sizeof(VkDrawIndexedIndirectCommand);
+    VkMemoryPropertyFlags host = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    if (m_bounds.init(device, VkDeviceSize(max_objects) * sizeof(ObjectBounds), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                      host, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != k_success ||
+        m_draws.init(device, draws_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != k_success ||
+        m_visible.init(device, draws_size,
+                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != k_success ||
+        m_count.init(device, sizeof(uint32_t),
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                       VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != k_success) {
+        Log::error("Failed to create the GPU culling buffers");
+        shutdown();
+        return -2;
+    }
+
+    VkDescriptorSetLayoutBinding bindings[4] = {};
+    for (uint32_t i = 0; i < 4; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo set_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    set_info.pBindings = bindings;
+    set_info.bindingCount = 4;
+    if (vkCreateDescriptorSetLayout(dev, &set_info, nullptr, &m_set_layout) != VK_SUCCESS) {
+        Log::error("Failed to create the culling descriptor set layout");
+        shutdown();
+        return -3;
+    }
+
+    VkDescriptorPoolSize pool_size = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4};
+    VkDescriptorPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    pool_info.maxSets = 1;
+    pool_info.pPoolSizes = &pool_size;
+    pool_info.poolSizeCount = 1;
+    if (vkCreateDescriptorPool(dev, &pool_info, nullptr, &m_pool) != VK_SUCCESS) {
+        Log::error("Failed to create the culling descriptor pool");
+        shutdown();
+        return -4;
+    }
+    VkDescriptorSetAllocateInfo alloc = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    alloc.descriptorPool = m_pool;
+    alloc.descriptorSetCount = 1;
+    alloc.pSetLayouts = &m_set_layout;
+    if (vkAllocateDescriptorSets(dev, &alloc, &m_set) != VK_SUCCESS) {
+        Log::error("Failed to allocate the culling descriptor set");
+        shutdown();
+        return -4;
+    }
+
+    VkDescriptorBufferInfo buffer_infos[4] = {{m_bounds.m_handle, 0, VK_WHOLE_SIZE},
+                                              {m_draws.m_handle, 0, VK_WHOLE_SIZE},
+                                              {m_visible.m_handle, 0, VK_WHOLE_SIZE},
+                                              {m_count.m_handle, 0, VK_WHOLE_SIZE}};
+    VkWriteDescriptorSet writes[4] = {};
+    for (uint32_t i = 0; i < 4; i++) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = m_set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &buffer_infos[i];
+    }
+    vkUpdateDescriptorSets(dev, 4, writes, 0, nullptr);
+
+    VkPushConstantRange push = {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants)};
+    VkPipelineLayoutCreateInfo layout_info = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    layout_info.pSetLayouts = &m_set_layout;
+    layout_info.setLayoutCount = 1;
+    layout_info.pPushConstantRanges = &push;
+    layout_info.pushConstantRangeCount = 1;
+    if (vkCreatePipelineLayout(dev, &layout_info, nullptr, &m_layout) != VK_SUCCESS) {
+        Log::error("Failed to create the culling pipeline layout");
+        shutdown();
+        return -5;
+    }
+
+    VkShaderModule module = VK_NULL_HANDLE;
+    if (shaders.acquire_file(cull_spirv_path, module, &m_shader_hash) != k_success) {
+        Log::error("Failed to load the culling shader");
+        shutdown();
+        return -6;
+    }
+    VkComputePipelineCreateInfo pipeline_info = {VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+    pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = module;
+    pipeline_info.stage.pName = "main";
+    pipeline_info.layout = m_layout;
+    if (vkCreateComputePipelines(dev, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &m_pipeline) != VK_SUCCESS) {
+        Log::error("Failed to create the culling pipeline");
+        shutdown();
+        return -7;
+    }
+
+    // Without the count extension every slot is drawn, the shader zeroes the culled ones in place instead
+    m_draw_indirect_count =
+      device.has_extension("VK_KHR_draw_indirect_count") && device.m_dispatch.vkCmdDrawIndexedIndirectCountKHR;
+    if (!m_draw_indirect_count) {
+        Log::warn("VK_KHR_draw_indirect_count is unavailable, culled draws will be zeroed rather than compacted");
+    }
+    m_first_instance = device.m_enabled_features.drawIndirectFirstInstance == VK_TRUE;
+    return k_success;
+}
+
+void VkGpuCuller::shutdown()
+{
+    if (m_parent == nullptr) return;
+    VkDevice dev = m_parent->m_handle;
+    vkDestroyPipeline(dev, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(dev, m_layout, nullptr);
+    vkDestroyDescriptorPool(dev, m_pool, nullptr);
+    vkDestroyDescriptorSetLayout(dev, m_set_layout, nullptr);
+    if (m_shader_hash != 0) m_shaders->release(m_shader_hash);
+    m_pipeline = VK_NULL_HANDLE;
+    m_layout = VK_NULL_HANDLE;
+    m_pool = VK_NULL_HANDLE;
+    m_set = VK_NULL_HANDLE;
+    m_set_layout = VK_NULL_HANDLE;
+    m_shader_hash = 0;
+
+    m_bounds.shutdown();
+    m_draws.shutdown();
+    m_visible.shutdown();
+    m_count.shutdown();
+    m_parent = nullptr;
+}
+
+result VkGpuCuller::set_object(uint32_t index, const ObjectBounds& bounds,
+                               const VkDrawIndexedIndirectCommand& draw)
+{
+    if (index >= m_max_objects) return -1;
+    if (draw.firstInstance != 0 && !m_first_instance) {
+        Log::error("Object %u has a first instance, but drawIndirectFirstInstance isn't supported", index);
+        return -2;
+    }
+    static_cast<ObjectBounds*>(m_bounds.m_mapped)[index] = bounds;
+    static_cast<VkDrawIndexedIndirectCommand*>(m_draws.m_mapped)[index] = draw;
+    return k_success;
+}
+
+void VkGpuCuller::record_cull(VkCommandBuffer cmd, const float planes[6][4])
+{
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    // The previous frame's draw might still be reading the outputs, so wait on it before clearing the count
+    VkMemoryBarrier reuse = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    reuse.srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    reuse.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    api.vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &reuse,
+                             0, nullptr, 0, nullptr);
+    api.vkCmdFillBuffer(cmd, m_count.m_handle, 0, sizeof(uint32_t), 0);
+
+    VkMemoryBarrier cleared = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    cleared.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    cleared.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    api.vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                             &cleared, 0, nullptr, 0, nullptr);
+
+    PushConstants push = {};
+    memcpy(push.planes, planes, sizeof(push.planes));
+    push.object_count = m_object_count;
+    push.compact = m_draw_indirect_count ? 1 : 0;
+
+    api.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    api.vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_layout, 0, 1, &m_set, 0, nullptr);
+    api.vkCmdPushConstants(cmd, m_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+    api.vkCmdDispatch(cmd, (m_object_count + s_group_size - 1) / s_group_size, 1, 1);
+
+    VkMemoryBarrier culled = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    culled.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    culled.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    api.vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1,
+                             &culled, 0, nullptr, 0, nullptr);
+}
+
+void VkGpuCuller::record_draw(VkCommandBuffer cmd)
+{
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    if (m_draw_indirect_count) {
+        api.vkCmdDrawIndexedIndirectCountKHR(cmd, m_visible.m_handle, 0, m_count.m_handle, 0, m_object_count,
+                                             stride);
+        return;
+    }
+
+    // Multi draw lets a single call walk every slot, without it we're stuck with one call per object
+    if (m_parent->m_enabled_features.multiDrawIndirect) {
+        api.vkCmdDrawIndexedIndirect(cmd, m_visible.m_handle, 0, m_object_count, stride);
+        return;
+    }
+    for (uint32_t i = 0; i < m_object_count; i++) {
+        api.vkCmdDrawIndexedIndirect(cmd, m_visible.m_handle, VkDeviceSize(i) * stride, 1, stride);
+    }
+}
+
+void VkGpuCuller::extract_frustum(const float m[16], float planes[6][4])
+{
+    // Gribb and Hartmann, rows of the matrix are m[col * 4 + row] for column major storage
+    auto row = [&](int r, int c) { return m[c * 4 + r]; };
+    for (int c = 0; c < 4; c++) {
+        planes[0][c] = row(3, c) + row(0, c);  // Left
+        planes[1][c] = row(3, c) - row(0, c);  // Right
+        planes[2][c] = row(3, c) + row(1, c);  // Bottom
+        planes[3][c] = row(3, c) - row(1, c);  // Top
+        planes[4][c] = row(2, c);              // Near, depth range is 0..1
+        planes[5][c] = row(3, c) - row(2, c);  // Far
+    }
+
+    // Normalize so that the plane distance can be compared against a sphere radius
+    for (int p = 0; p < 6; p++) {
+        float* pl = planes[p];
+        float len = std::sqrt(pl[0] * pl[0] + pl[1] * pl[1] + pl[2] * pl[2]);
+        if (len <= 0.0f) continue;
+        for (int c = 0; c < 4; c++) pl[c] /= len;
+    }
+}
@@ -1,4 +1,5 @@
-#include "atelier/atelier.h"
+#include "atelier/atelier_vk_completed.h"
+#include "atelier/atelier_vk_mutable.h"
 using namespace Atelier;
 
 result VkCompletedInstance::init_from_mutable_instance(const VkMutableInstanceCreateInfo& info)
@@ -17,6 +18,10 @@ result VkCompletedInstance::init_from_mutable_instance(const VkMutableInstanceCr
 
     // Yay we can store the vulkan devices
     m_handle = instance;
+    if (m_dispatch.load(instance) != k_success) {
+        Log::error("Failed to load the instance entry points");
+        return -6;
+    }
     if (messenger != VK_NULL_HANDLE) m_messenger = messenger;
 
     // Copy any enabled layers and extensions
@@ -49,11 +54,20 @@ result VkCompletedInstance::init_from_mutable_instance(const VkMutableInstanceCr
     for (VkPhysicalDevice dev : devs) {
         auto& p_dev = m_physical_devices.emplace_back();
         p_dev.init_from_instance(instance, dev);
+        p_dev.m_parent = this;
     }
 
     return k_success;
 }
 
+bool VkCompletedInstance::has_extension(const char* name) const
+{
+    for (const auto& ext : m_enabled_extensions) {
+        if (ext == name) return true;
+    }
+    return false;
+}
+
 void Atelier::VkCompletedInstance::shutdown(VkCompletedState& vk)
 {
     // Shutdown all of the logical devices which make use of this instance, and then also do the same for the
@@ -68,6 +82,9 @@ void Atelier::VkCompletedInstance::shutdown(VkCompletedState& vk)
     for (auto& surf : vk.m_surfaces) {
         if (surf.m_parent == this) surf.shutdown(vk);
     }
+    for (auto& surf : vk.m_headless_surfaces) {
+        if (surf.m_parent == this) surf.shutdown(vk);
+    }
 
     // If we have a debug messenger, we need to destroy them
     PFN_vkDestroyDebugUtilsMessengerEXT destroy_msg =
@@ -117,8 +134,13 @@ result VkMutableInstanceCreateInfo::create_instance(VkInstance& instance, VkAllo
 
 static constexpr char s_validation_layer_name[] = "VK_LAYER_KHRONOS_validation";
 static constexpr char s_debug_utils_ext_name[] = "VK_EXT_debug_utils";
-static constexpr const char* s_surface_ext[] = {"VK_KHR_surface", "VK_KHR_win32_surface"};
+static constexpr const char* s_surface_ext[] = {"VK_KHR_surface", "VK_KHR_win32_surface",
+                                                "VK_EXT_headless_surface"};
 static constexpr uint32_t s_surface_count = sizeof(s_surface_ext) / sizeof(char*);
+static constexpr const char* s_sharing_ext[] = {"VK_KHR_get_physical_device_properties2",
+                                                "VK_KHR_external_memory_capabilities",
+                                                "VK_KHR_external_semaphore_capabilities"};
+static constexpr uint32_t s_sharing_count = sizeof(s_sharing_ext) / sizeof(char*);
 
 // Default callback for handling debug messages
 static VkBool32 s_callback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -164,6 +186,17 @@ result VkMutableInstanceCreateInfo::create_default(VkMutableInstanceCreateInfo&
         }
     }
 
+    // Sharing memory and semaphores between devices needs the device ID and external handle queries, which are
+    // only extensions on a 1.0 instance
+    for (size_t i = 0; i < s_sharing_count; i++) {
+        for (const auto& ext : inst.ext_props) {
+            if (strcmp(s_sharing_ext[i], ext.extensionName) == 0) {
+                inst.ext_selected.push_back(s_sharing_ext[i]);
+                break;
+            }
+        }
+    }
+
     // Now lets see if we can add debug validation layers
 #ifndef NDEBUG
     for (const auto& layer : inst.layer_props) {
@@ -0,0 +1,38 @@
+#include "atelier/atelier_scene.h"
+using namespace Atelier;
+
+result VkInstanceBuffers::init(VkCompletedDevice& device, uint32_t capacity, uint32_t frames)
+{
+    if (capacity == 0 || frames == 0 || frames > k_max_frames) {
+        Log::error("Instance buffers need a capacity and between 1 and %u frames", k_max_frames);
+        return -1;
+    }
+
+    // Read by vertex fetch as per instance data or by shaders as a storage buffer, whichever the pass prefers
+    const VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        if (m_buffers[frame].init(device, VkDeviceSize(capacity) * sizeof(Mat4), usage,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != k_success) {
+            Log::error("Failed to create the instance buffer for frame %u", frame);
+            shutdown();
+            return -2;
+        }
+        m_targets[frame] = {};
+        m_targets[frame].m_data = static_cast<Mat4*>(m_buffers[frame].m_mapped);
+        m_targets[frame].m_capacity = capacity;
+        m_frames = frame + 1;
+    }
+    m_capacity = capacity;
+    return k_success;
+}
+
+void VkInstanceBuffers::shutdown()
+{
+    for (uint32_t frame = 0; frame < k_max_frames; frame++) {
+        m_buffers[frame].shutdown();
+        m_targets[frame] = {};
+    }
+    m_frames = 0;
+    m_capacity = 0;
+}
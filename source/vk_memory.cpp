@@ -0,0 +1,137 @@
+#include "atelier/atelier_vk_memory.h"
+
+#include <algorithm>
+using namespace Atelier;
+
+result VkMemoryTelemetry::init(VkCompletedDevice& device)
+{
+    if (device.m_handle == VK_NULL_HANDLE) return -1;
+    if (device.m_memory != nullptr) {
+        Log::error("The device already has memory telemetry attached");
+        return -2;
+    }
+    m_parent = &device;
+    const auto& props = device.m_physical->m_memory_properties;
+    m_heaps.assign(props.memoryHeapCount, Heap());
+    for (uint32_t i = 0; i < props.memoryHeapCount; i++) {
+        m_heaps[i].m_size = props.memoryHeaps[i].size;
+        m_heaps[i].m_device_local = (props.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        m_tracked[i] = 0;
+        m_allocation_count[i] = 0;
+    }
+    VkCompletedInstance* inst = device.m_parent;
+    m_has_budget = device.has_extension("VK_EXT_memory_budget") && inst != nullptr &&
+                   inst->has_extension("VK_KHR_get_physical_device_properties2");
+
+    // The budget comes through the properties2 chain, which a 1.0 instance only has through the extension
+    if (m_has_budget) {
+        m_get_props2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(
+          inst->m_handle, "vkGetPhysicalDeviceMemoryProperties2KHR");
+        m_has_budget = m_get_props2 != nullptr;
+    }
+    if (!m_has_budget) Log::info("VK_EXT_memory_budget unavailable, memory usage is what the library allocated");
+    device.m_memory = this;
+    poll();
+    return k_success;
+}
+
+void VkMemoryTelemetry::shutdown()
+{
+    if (m_parent != nullptr && m_parent->m_memory == this) m_parent->m_memory = nullptr;
+    m_parent = nullptr;
+    m_get_props2 = nullptr;
+    m_heaps.clear();
+    m_subscribers.clear();
+}
+
+void VkMemoryTelemetry::poll()
+{
+    if (m_parent == nullptr) return;
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT};
+    if (m_has_budget) {
+        VkPhysicalDeviceMemoryProperties2 props2 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2};
+        props2.pNext = &budget;
+        m_get_props2(m_parent->m_physical->m_handle, &props2);
+    }
+
+    for (uint32_t i = 0; i < m_heaps.size(); i++) {
+        Heap& heap = m_heaps[i];
+        heap.m_tracked = m_tracked[i].load(std::memory_order_relaxed);
+        heap.m_allocations = m_allocation_count[i].load(std::memory_order_relaxed);
+        if (m_has_budget) {
+            heap.m_usage = budget.heapUsage[i];
+            heap.m_budget = budget.heapBudget[i];
+        } else {
+            heap.m_usage = heap.m_tracked;
+            heap.m_budget = VkDeviceSize(double(heap.m_size) * m_fallback_fraction);
+        }
+        heap.m_high_water = std::max(heap.m_high_water, heap.m_usage);
+        heap.m_tracked_high_water = std::max(heap.m_tracked_high_water, heap.m_tracked);
+
+        double used = double(heap.m_usage);
+        double moderate = double(heap.m_budget) * m_moderate;
+        heap.m_pressure = Pressure::k_none;
+        if (used >= double(heap.m_budget) * m_critical) {
+            heap.m_pressure = Pressure::k_critical;
+        } else if (used >= moderate) {
+            heap.m_pressure = Pressure::k_moderate;
+        }
+        if (heap.m_pressure == Pressure::k_none) continue;
+
+        // Subscribers are told every frame the heap stays over, so they can shed a little at a time
+        VkDeviceSize excess = VkDeviceSize(used - moderate);
+        for (size_t s = 0; s < m_subscribers.size(); s++) {
+            m_subscribers[s].m_callback(i, heap.m_pressure, excess);
+            m_pressure_events++;
+        }
+    }
+    m_polls++;
+}
+
+uint32_t VkMemoryTelemetry::subscribe(Callback callback)
+{
+    Subscriber& subscriber = m_subscribers.emplace_back();
+    subscriber.m_id = m_next_id++;
+    subscriber.m_callback = std::move(callback);
+    return subscriber.m_id;
+}
+
+void VkMemoryTelemetry::unsubscribe(uint32_t id)
+{
+    auto it = std::find_if(m_subscribers.begin(), m_subscribers.end(),
+                           [id](const Subscriber& s) { return s.m_id == id; });
+    if (it != m_subscribers.end()) m_subscribers.erase(it);
+}
+
+void VkMemoryTelemetry::reset_high_water()
+{
+    for (auto& heap : m_heaps) {
+        heap.m_high_water = heap.m_usage;
+        heap.m_tracked_high_water = heap.m_tracked;
+    }
+}
+
+void VkMemoryTelemetry::track_allocate(uint32_t memory_type, VkDeviceSize bytes)
+{
+    uint32_t heap = m_parent->m_physical->m_memory_properties.memoryTypes[memory_type].heapIndex;
+    m_tracked[heap].fetch_add(bytes, std::memory_order_relaxed);
+    m_allocation_count[heap].fetch_add(1, std::memory_order_relaxed);
+}
+
+void VkMemoryTelemetry::track_free(uint32_t memory_type, VkDeviceSize bytes)
+{
+    uint32_t heap = m_parent->m_physical->m_memory_properties.memoryTypes[memory_type].heapIndex;
+    m_tracked[heap].fetch_sub(bytes, std::memory_order_relaxed);
+    m_allocation_count[heap].fetch_sub(1, std::memory_order_relaxed);
+}
+
+void VkMemoryTelemetry::on_allocate(const VkCompletedDevice& device, uint32_t memory_type, VkDeviceSize bytes)
+{
+    if (device.m_memory != nullptr) device.m_memory->track_allocate(memory_type, bytes);
+}
+
+void VkMemoryTelemetry::on_free(const VkCompletedDevice& device, uint32_t memory_type, VkDeviceSize bytes)
+{
+    if (device.m_memory != nullptr) device.m_memory->track_free(memory_type, bytes);
+}
@@ -0,0 +1,841 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "atelier/atelier_vk_memory.h"
+#include "atelier/atelier_vk_multi_gpu.h"
+#include "atelier/atelier_vk_submit.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include "vulkan/vulkan_win32.h"
+#else
+#include <unistd.h>
+#endif
+using namespace Atelier;
+
+#ifdef _WIN32
+static constexpr const char* s_memory_ext = "VK_KHR_external_memory_win32";
+static constexpr const char* s_semaphore_ext = "VK_KHR_external_semaphore_win32";
+static constexpr VkExternalMemoryHandleTypeFlagBits s_memory_handle =
+  VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_WIN32_BIT;
+static constexpr VkExternalSemaphoreHandleTypeFlagBits s_semaphore_handle =
+  VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_WIN32_BIT;
+#else
+static constexpr const char* s_memory_ext = "VK_KHR_external_memory_fd";
+static constexpr const char* s_semaphore_ext = "VK_KHR_external_semaphore_fd";
+static constexpr VkExternalMemoryHandleTypeFlagBits s_memory_handle = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+static constexpr VkExternalSemaphoreHandleTypeFlagBits s_semaphore_handle =
+  VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT;
+#endif
+
+static constexpr VkBufferUsageFlags s_producer_usage =
+  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+static constexpr VkBufferUsageFlags s_consumer_usage =
+  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+const char* Atelier::share_mode_name(VkShareMode mode)
+{
+    switch (mode) {
+        case VkShareMode::k_same_device:
+            return "same device";
+        case VkShareMode::k_opaque:
+            return "external memory";
+        case VkShareMode::k_host_memory:
+            return "imported host memory";
+        case VkShareMode::k_host_copy:
+            return "host copy";
+    }
+    return "unknown";
+}
+
+static void* host_alloc(size_t alignment, size_t size)
+{
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    void* out = nullptr;
+    return posix_memalign(&out, alignment, size) == 0 ? out : nullptr;
+#endif
+}
+
+static void host_free(void* ptr)
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+VkDeviceCapabilities VkDeviceCapabilities::query(VkCompletedDevice& device, bool primary)
+{
+    VkDeviceCapabilities caps;
+    const VkCompletedPhysicalDevice& physical = *device.m_physical;
+    caps.m_device = &device;
+    caps.m_type = physical.m_device_properties.deviceType;
+    for (uint32_t i = 0; i < physical.m_memory_properties.memoryHeapCount; i++) {
+        const auto& heap = physical.m_memory_properties.memoryHeaps[i];
+        if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) caps.m_device_local_bytes += heap.size;
+    }
+
+    // Walk the families in order so the choice doesn't depend on the map's ordering
+    uint32_t family_count = 0;
+    for (const auto& queue : device.m_queues) family_count = std::max(family_count, queue.first + 1);
+    const VkQueueFlags universal = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+    int32_t best = -1, best_rank = 0;
+    for (uint32_t i = 0; i < family_count; i++) {
+        auto found = device.m_queues.find(i);
+        if (found == device.m_queues.end() || found->second.m_handle.empty()) continue;
+        VkQueueFlags flags = found->second.props.queueFlags;
+        int32_t rank = 0;
+        if ((flags & universal) == universal) rank = primary ? 2 : 3;
+        else if (flags & VK_QUEUE_COMPUTE_BIT) rank = primary ? 3 : 2;
+        else if (flags & VK_QUEUE_TRANSFER_BIT) rank = 1;
+        if (rank > best_rank) {
+            best = i;
+            best_rank = rank;
+        }
+    }
+    if (best >= 0) {
+        caps.m_family = best;
+        caps.m_family_flags = device.m_queues[best].props.queueFlags;
+        caps.m_async_family = (caps.m_family_flags & VK_QUEUE_GRAPHICS_BIT) == 0;
+    }
+
+    // IDs and the host import alignment come from the properties2 chain, which a 1.0 instance only has through
+    // extensions
+    VkCompletedInstance* inst = device.m_parent;
+    bool ids_available = inst != nullptr && inst->has_extension("VK_KHR_get_physical_device_properties2") &&
+                         inst->has_extension("VK_KHR_external_memory_capabilities");
+    if (!ids_available) return caps;
+
+    auto get_props2 = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(
+      inst->m_handle, "vkGetPhysicalDeviceProperties2KHR");
+    VkPhysicalDeviceIDProperties ids = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES};
+    VkPhysicalDeviceExternalMemoryHostPropertiesEXT host = {
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT};
+    bool host_ext = device.has_extension("VK_EXT_external_memory_host");
+    if (host_ext) ids.pNext = &host;
+    VkPhysicalDeviceProperties2 props = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+    props.pNext = &ids;
+    if (get_props2 == nullptr) return caps;
+    get_props2(physical.m_handle, &props);
+    caps.m_has_ids = true;
+    memcpy(caps.m_device_uuid, ids.deviceUUID, VK_UUID_SIZE);
+    memcpy(caps.m_driver_uuid, ids.driverUUID, VK_UUID_SIZE);
+    if (host_ext && host.minImportedHostPointerAlignment > 0) {
+        caps.m_host_import = true;
+        caps.m_host_import_alignment = host.minImportedHostPointerAlignment;
+    }
+
+    // Exporting has to work for the exact buffer usage we share, not just be an enabled extension
+    auto get_buffer_props = (PFN_vkGetPhysicalDeviceExternalBufferPropertiesKHR)vkGetInstanceProcAddr(
+      inst->m_handle, "vkGetPhysicalDeviceExternalBufferPropertiesKHR");
+    if (get_buffer_props != nullptr && device.has_extension(s_memory_ext)) {
+        VkPhysicalDeviceExternalBufferInfo info = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_BUFFER_INFO};
+        info.usage = s_producer_usage | s_consumer_usage;
+        info.handleType = s_memory_handle;
+        VkExternalBufferProperties out = {VK_STRUCTURE_TYPE_EXTERNAL_BUFFER_PROPERTIES};
+        get_buffer_props(physical.m_handle, &info, &out);
+        const VkExternalMemoryFeatureFlags both =
+          VK_EXTERNAL_MEMORY_FEATURE_EXPORTABLE_BIT | VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT;
+        caps.m_opaque_memory = (out.externalMemoryProperties.externalMemoryFeatures & both) == both;
+    }
+
+    auto get_semaphore_props = (PFN_vkGetPhysicalDeviceExternalSemaphorePropertiesKHR)vkGetInstanceProcAddr(
+      inst->m_handle, "vkGetPhysicalDeviceExternalSemaphorePropertiesKHR");
+    if (get_semaphore_props != nullptr && inst->has_extension("VK_KHR_external_semaphore_capabilities") &&
+        device.has_extension(s_semaphore_ext)) {
+        VkPhysicalDeviceExternalSemaphoreInfo info = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_SEMAPHORE_INFO};
+        info.handleType = s_semaphore_handle;
+        VkExternalSemaphoreProperties out = {VK_STRUCTURE_TYPE_EXTERNAL_SEMAPHORE_PROPERTIES};
+        get_semaphore_props(physical.m_handle, &info, &out);
+        const VkExternalSemaphoreFeatureFlags both =
+          VK_EXTERNAL_SEMAPHORE_FEATURE_EXPORTABLE_BIT | VK_EXTERNAL_SEMAPHORE_FEATURE_IMPORTABLE_BIT;
+        caps.m_opaque_semaphore = (out.externalSemaphoreFeatures & both) == both;
+    }
+    return caps;
+}
+
+// Opaque handles only work between devices on the same driver and physical device, which the UUIDs tell us
+static VkShareMode choose_share_mode(const VkDeviceCapabilities& producer, const VkDeviceCapabilities& consumer)
+{
+    if (producer.m_device == consumer.m_device) return VkShareMode::k_same_device;
+    bool same_ids = producer.m_has_ids && consumer.m_has_ids &&
+                    memcmp(producer.m_device_uuid, consumer.m_device_uuid, VK_UUID_SIZE) == 0 &&
+                    memcmp(producer.m_driver_uuid, consumer.m_driver_uuid, VK_UUID_SIZE) == 0;
+    if (same_ids && producer.m_opaque_memory && consumer.m_opaque_memory) return VkShareMode::k_opaque;
+    if (producer.m_host_import && consumer.m_host_import) return VkShareMode::k_host_memory;
+    return VkShareMode::k_host_copy;
+}
+
+result VkMultiGpuScheduler::init(VkCompletedState& vk, VkCompletedDevice& primary)
+{
+    m_primary = &primary;
+    m_primary_caps = VkDeviceCapabilities::query(primary, true);
+    m_workers.reserve(vk.m_devices.size());
+    for (auto& device : vk.m_devices) {
+        if (device.m_handle == VK_NULL_HANDLE || device.m_physical == nullptr) continue;
+        Worker worker;
+        worker.m_caps = &device == &primary ? m_primary_caps : VkDeviceCapabilities::query(device, false);
+        if (worker.m_caps.m_family_flags == 0) continue;
+        worker.m_share = choose_share_mode(worker.m_caps, m_primary_caps);
+        const std::vector<VkQueue>& queues = device.m_queues[worker.m_caps.m_family].m_handle;
+        worker.m_queue = queues[0];
+        if (&device == &primary && m_submitter != nullptr && worker.m_queue == m_submitter->m_queue) {
+            if (queues.size() > 1) {
+                worker.m_queue = queues[1];
+            } else {
+                worker.m_submitter = m_submitter;
+            }
+        }
+
+        VkCommandPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+        pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        pool_info.queueFamilyIndex = worker.m_caps.m_family;
+        if (vkCreateCommandPool(device.m_handle, &pool_info, nullptr, &worker.m_pool) != VK_SUCCESS) {
+            Log::warn("Failed to create a command pool for %s, it won't take work",
+                      device.m_physical->m_device_properties.deviceName);
+            continue;
+        }
+        Log::info("Offscreen worker %u on %s, family %u, results by %s", uint32_t(m_workers.size()),
+                  device.m_physical->m_device_properties.deviceName, worker.m_caps.m_family,
+                  share_mode_name(worker.m_share));
+        m_workers.push_back(worker);
+    }
+
+    if (m_workers.empty()) {
+        Log::error("No device can take offscreen work");
+        return -1;
+    }
+    return k_success;
+}
+
+// Allocates through the device's memory telemetry, so result slots count against their heap like anything else
+static VkResult allocate_tracked(VkCompletedDevice& device, const VkMemoryAllocateInfo& alloc, VkDeviceMemory& out,
+                                 VkMultiGpuScheduler::Allocation& tracked)
+{
+    VkResult res = vkAllocateMemory(device.m_handle, &alloc, nullptr, &out);
+    if (res != VK_SUCCESS) return res;
+    tracked.m_type = alloc.memoryTypeIndex;
+    tracked.m_bytes = alloc.allocationSize;
+    VkMemoryTelemetry::on_allocate(device, tracked.m_type, tracked.m_bytes);
+    return res;
+}
+
+static void free_tracked(VkCompletedDevice& device, VkDeviceMemory memory,
+                         VkMultiGpuScheduler::Allocation& tracked)
+{
+    vkFreeMemory(device.m_handle, memory, nullptr);
+    if (tracked.m_bytes != 0) VkMemoryTelemetry::on_free(device, tracked.m_type, tracked.m_bytes);
+    tracked = VkMultiGpuScheduler::Allocation();
+}
+
+static void destroy_slot(VkMultiGpuScheduler& s, VkMultiGpuScheduler::Job& job)
+{
+    const auto& worker = s.m_workers[job.m_worker];
+    VkDevice producer = worker.m_caps.m_device->m_handle;
+    VkDevice consumer = s.m_primary->m_handle;
+    if (job.m_consumer_buffer != job.m_producer_buffer) {
+        vkDestroyBuffer(consumer, job.m_consumer_buffer, nullptr);
+        free_tracked(*s.m_primary, job.m_consumer_memory, job.m_consumer_allocation);
+    }
+    vkDestroyBuffer(producer, job.m_producer_buffer, nullptr);
+    free_tracked(*worker.m_caps.m_device, job.m_producer_memory, job.m_producer_allocation);
+    if (job.m_host != nullptr) host_free(job.m_host);
+    vkDestroySemaphore(producer, job.m_producer_semaphore, nullptr);
+    vkDestroySemaphore(consumer, job.m_consumer_semaphore, nullptr);
+    vkDestroyFence(producer, job.m_fence, nullptr);
+    if (job.m_cmd != VK_NULL_HANDLE) vkFreeCommandBuffers(producer, worker.m_pool, 1, &job.m_cmd);
+
+    uint32_t worker_index = job.m_worker;
+    job = VkMultiGpuScheduler::Job();
+    job.m_worker = worker_index;
+}
+
+// Blocks until the job's fence signals. A job pushed to a submitter is only waited on once its call has been made
+// and went through, a failed call never signals the fence
+static VkResult wait_job(VkMultiGpuScheduler& s, VkMultiGpuScheduler::Job& job)
+{
+    const auto& worker = s.m_workers[job.m_worker];
+    if (worker.m_submitter != nullptr) {
+        worker.m_submitter->wait_submitted(job.m_ticket);
+        if (worker.m_submitter->error() != k_success) return VK_ERROR_DEVICE_LOST;
+    }
+    const VkCompletedDevice& device = *worker.m_caps.m_device;
+    return device.m_dispatch.vkWaitForFences(device.m_handle, 1, &job.m_fence, VK_TRUE, (uint64_t)-1);
+}
+
+void VkMultiGpuScheduler::shutdown()
+{
+    for (auto& job : m_jobs) {
+        if (job.m_state == State::k_running) wait_job(*this, job);
+        destroy_slot(*this, job);
+    }
+    for (auto& worker : m_workers) {
+        vkDestroyCommandPool(worker.m_caps.m_device->m_handle, worker.m_pool, nullptr);
+    }
+    m_jobs.clear();
+    m_workers.clear();
+    m_primary = nullptr;
+}
+
+float VkMultiGpuScheduler::score(uint32_t worker_index, const Requirements& req) const
+{
+    const Worker& worker = m_workers[worker_index];
+    const VkDeviceCapabilities& caps = worker.m_caps;
+    if ((caps.m_family_flags & req.m_queue_flags) != req.m_queue_flags) return -1.0f;
+    if (caps.m_device_local_bytes < req.m_min_device_memory) return -1.0f;
+    if (worker.m_share == VkShareMode::k_same_device && !req.m_allow_primary) return -1.0f;
+    if (caps.m_type == VK_PHYSICAL_DEVICE_TYPE_CPU && !req.m_allow_cpu) return -1.0f;
+
+    float out = 1.0f;
+    switch (caps.m_type) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+            out = 4.0f;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+            out = 2.0f;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:
+            out = 0.5f;
+            break;
+        default:
+            break;
+    }
+    out += std::min(float(caps.m_device_local_bytes >> 30), 16.0f) * 0.125f;
+
+    // The cheaper the trip back to the primary, the better. The primary itself is busy rendering, an async family
+    // takes some of the sting out of that
+    switch (worker.m_share) {
+        case VkShareMode::k_same_device:
+            out *= caps.m_async_family ? 0.75f : 0.5f;
+            break;
+        case VkShareMode::k_opaque:
+            out += 1.0f;
+            break;
+        case VkShareMode::k_host_memory:
+            out += 0.5f;
+            break;
+        case VkShareMode::k_host_copy:
+            break;
+    }
+    return out;
+}
+
+std::vector<uint32_t> VkMultiGpuScheduler::rank(const Requirements& req) const
+{
+    std::vector<std::pair<float, uint32_t>> scored;
+    for (uint32_t i = 0; i < m_workers.size(); i++) {
+        float s = score(i, req);
+        if (s >= 0.0f) scored.push_back({s, i});
+    }
+    std::stable_sort(scored.begin(), scored.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    std::vector<uint32_t> out;
+    out.reserve(scored.size());
+    for (const auto& s : scored) out.push_back(s.second);
+    return out;
+}
+
+VkMultiGpuScheduler::Handle VkMultiGpuScheduler::submit(const Requirements& req, VkDeviceSize result_size,
+                                                        const RecordFunc& record)
+{
+    // A worker with twice the score takes twice the work before it looks as busy as the other
+    int32_t best = -1;
+    float best_score = 0.0f;
+    for (uint32_t i = 0; i < m_workers.size(); i++) {
+        float s = score(i, req);
+        if (s < 0.0f) continue;
+        s /= float(1 + m_workers[i].m_pending);
+        if (best < 0 || s > best_score) {
+            best = i;
+            best_score = s;
+        }
+    }
+    if (best < 0) {
+        Log::warn("No device meets the requirements of the offscreen work");
+        return k_invalid;
+    }
+    return submit_to(best, result_size, record, req.m_gpu_wait);
+}
+
+static result create_buffer(VkCompletedDevice& device, VkDeviceSize size, VkBufferUsageFlags usage,
+                            const void* buffer_next, VkBuffer& out)
+{
+    VkBufferCreateInfo info = {VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    info.pNext = buffer_next;
+    info.size = size;
+    info.usage = usage;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    // Work on an async family lands in a buffer the graphics family reads, so let every family at it
+    std::vector<uint32_t> families;
+    if (buffer_next == nullptr && device.m_queues.size() > 1) {
+        for (const auto& queue : device.m_queues) families.push_back(queue.first);
+        info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        info.pQueueFamilyIndices = families.data();
+        info.queueFamilyIndexCount = families.size();
+    }
+    return vkCreateBuffer(device.m_handle, &info, nullptr, &out) == VK_SUCCESS ? k_success : -1;
+}
+
+// Allocates and binds memory for the buffer from the types allowed, preferring the extra flags
+static result bind_memory(VkCompletedDevice& device, VkBuffer buffer, uint32_t type_bits,
+                          VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, const void* alloc_next,
+                          VkDeviceMemory& out, VkMultiGpuScheduler::Allocation& tracked,
+                          VkMemoryPropertyFlags* out_flags = nullptr)
+{
+    VkMemoryRequirements reqs = {};
+    vkGetBufferMemoryRequirements(device.m_handle, buffer, &reqs);
+    type_bits &= reqs.memoryTypeBits;
+    int32_t type = device.m_physical->find_memory_type(type_bits, required | preferred);
+    if (type < 0) type = device.m_physical->find_memory_type(type_bits, required);
+    if (type < 0) return -1;
+
+    VkMemoryAllocateInfo alloc = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    alloc.pNext = alloc_next;
+    alloc.allocationSize = reqs.size;
+    alloc.memoryTypeIndex = type;
+    if (allocate_tracked(device, alloc, out, tracked) != VK_SUCCESS) return -2;
+    vkBindBufferMemory(device.m_handle, buffer, out, 0);
+    if (out_flags != nullptr) *out_flags = device.m_physical->m_memory_properties.memoryTypes[type].propertyFlags;
+    return k_success;
+}
+
+static result map_buffer(VkDevice device, VkDeviceMemory memory, VkMemoryPropertyFlags flags, void*& out,
+                         bool& coherent)
+{
+    coherent = (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+    if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0) return k_success;
+    return vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &out) == VK_SUCCESS ? k_success : -1;
+}
+
+// Wraps the pinned host allocation in a buffer on the device
+static result import_host(VkCompletedDevice& device, void* host, VkDeviceSize size, VkBufferUsageFlags usage,
+                          VkBuffer& buffer, VkDeviceMemory& memory, VkMultiGpuScheduler::Allocation& tracked)
+{
+    const auto handle = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+    VkExternalMemoryBufferCreateInfo external = {VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO};
+    external.handleTypes = handle;
+    if (create_buffer(device, size, usage, &external, buffer) != k_success) return -1;
+
+    auto get_host_props = (PFN_vkGetMemoryHostPointerPropertiesEXT)vkGetDeviceProcAddr(
+      device.m_handle, "vkGetMemoryHostPointerPropertiesEXT");
+    VkMemoryHostPointerPropertiesEXT props = {VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT};
+    if (get_host_props == nullptr || get_host_props(device.m_handle, handle, host, &props) != VK_SUCCESS) {
+        return -2;
+    }
+
+    VkImportMemoryHostPointerInfoEXT import = {VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT};
+    import.handleType = handle;
+    import.pHostPointer = host;
+    if (bind_memory(device, buffer, props.memoryTypeBits, 0, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &import,
+                    memory, tracked) != k_success) {
+        return -3;
+    }
+    return k_success;
+}
+
+// Exports the producer's memory and imports it on the consumer with the same size and type, which opaque handles
+// require. On success the consumer owns the memory import and we own nothing extra
+static result share_memory(VkCompletedDevice& producer, VkDeviceMemory memory, VkCompletedDevice& consumer,
+                           const VkMultiGpuScheduler::Allocation& producer_alloc, VkBuffer consumer_buffer,
+                           VkDeviceMemory& out, VkMultiGpuScheduler::Allocation& tracked)
+{
+    VkMemoryAllocateInfo alloc = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    alloc.allocationSize = producer_alloc.m_bytes;
+    alloc.memoryTypeIndex = producer_alloc.m_type;
+#ifdef _WIN32
+    auto get_handle =
+      (PFN_vkGetMemoryWin32HandleKHR)vkGetDeviceProcAddr(producer.m_handle, "vkGetMemoryWin32HandleKHR");
+    VkMemoryGetWin32HandleInfoKHR get = {VK_STRUCTURE_TYPE_MEMORY_GET_WIN32_HANDLE_INFO_KHR};
+    get.memory = memory;
+    get.handleType = s_memory_handle;
+    HANDLE handle = nullptr;
+    if (get_handle == nullptr || get_handle(producer.m_handle, &get, &handle) != VK_SUCCESS) return -1;
+
+    // Win32 imports don't take ownership of the handle
+    VkImportMemoryWin32HandleInfoKHR import = {VK_STRUCTURE_TYPE_IMPORT_MEMORY_WIN32_HANDLE_INFO_KHR};
+    import.handleType = s_memory_handle;
+    import.handle = handle;
+    alloc.pNext = &import;
+    VkResult res = allocate_tracked(consumer, alloc, out, tracked);
+    CloseHandle(handle);
+#else
+    auto get_fd = (PFN_vkGetMemoryFdKHR)vkGetDeviceProcAddr(producer.m_handle, "vkGetMemoryFdKHR");
+    VkMemoryGetFdInfoKHR get = {VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR};
+    get.memory = memory;
+    get.handleType = s_memory_handle;
+    int fd = -1;
+    if (get_fd == nullptr || get_fd(producer.m_handle, &get, &fd) != VK_SUCCESS) return -1;
+
+    // A successful import owns the fd, a failed one leaves it with us
+    VkImportMemoryFdInfoKHR import = {VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR};
+    import.handleType = s_memory_handle;
+    import.fd = fd;
+    alloc.pNext = &import;
+    VkResult res = allocate_tracked(consumer, alloc, out, tracked);
+    if (res != VK_SUCCESS) close(fd);
+#endif
+    if (res != VK_SUCCESS) return -2;
+    vkBindBufferMemory(consumer.m_handle, consumer_buffer, out, 0);
+    return k_success;
+}
+
+// The consumer's semaphore takes a permanent reference to the producer's payload
+static result share_semaphore(VkCompletedDevice& producer, VkCompletedDevice& consumer, VkSemaphore& out_producer,
+                              VkSemaphore& out_consumer)
+{
+    VkExportSemaphoreCreateInfo export_info = {VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO};
+    export_info.handleTypes = s_semaphore_handle;
+    VkSemaphoreCreateInfo info = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    info.pNext = &export_info;
+    if (vkCreateSemaphore(producer.m_handle, &info, nullptr, &out_producer) != VK_SUCCESS) return -1;
+    info.pNext = nullptr;
+    if (vkCreateSemaphore(consumer.m_handle, &info, nullptr, &out_consumer) != VK_SUCCESS) return -2;
+#ifdef _WIN32
+    auto get_handle =
+      (PFN_vkGetSemaphoreWin32HandleKHR)vkGetDeviceProcAddr(producer.m_handle, "vkGetSemaphoreWin32HandleKHR");
+    auto import_handle = (PFN_vkImportSemaphoreWin32HandleKHR)vkGetDeviceProcAddr(
+      consumer.m_handle, "vkImportSemaphoreWin32HandleKHR");
+    VkSemaphoreGetWin32HandleInfoKHR get = {VK_STRUCTURE_TYPE_SEMAPHORE_GET_WIN32_HANDLE_INFO_KHR};
+    get.semaphore = out_producer;
+    get.handleType = s_semaphore_handle;
+    HANDLE handle = nullptr;
+    if (get_handle == nullptr || import_handle == nullptr ||
+        get_handle(producer.m_handle, &get, &handle) != VK_SUCCESS) {
+        return -3;
+    }
+    VkImportSemaphoreWin32HandleInfoKHR import = {VK_STRUCTURE_TYPE_IMPORT_SEMAPHORE_WIN32_HANDLE_INFO_KHR};
+    import.semaphore = out_consumer;
+    import.handleType = s_semaphore_handle;
+    import.handle = handle;
+    VkResult res = import_handle(consumer.m_handle, &import);
+    CloseHandle(handle);
+#else
+    auto get_fd = (PFN_vkGetSemaphoreFdKHR)vkGetDeviceProcAddr(producer.m_handle, "vkGetSemaphoreFdKHR");
+    auto import_fd = (PFN_vkImportSemaphoreFdKHR)vkGetDeviceProcAddr(consumer.m_handle, "vkImportSemaphoreFdKHR");
+    VkSemaphoreGetFdInfoKHR get = {VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR};
+    get.semaphore = out_producer;
+    get.handleType = s_semaphore_handle;
+    int fd = -1;
+    if (get_fd == nullptr || import_fd == nullptr || get_fd(producer.m_handle, &get, &fd) != VK_SUCCESS) return -3;
+    VkImportSemaphoreFdInfoKHR import = {VK_STRUCTURE_TYPE_IMPORT_SEMAPHORE_FD_INFO_KHR};
+    import.semaphore = out_consumer;
+    import.handleType = s_semaphore_handle;
+    import.fd = fd;
+    VkResult res = import_fd(consumer.m_handle, &import);
+    if (res != VK_SUCCESS) close(fd);
+#endif
+    return res == VK_SUCCESS ? k_success : -4;
+}
+
+// Builds the buffers, memory and sync for one slot in the worker's share mode. On failure the caller destroys
+// whatever was made
+static result create_slot(VkMultiGpuScheduler& s, VkMultiGpuScheduler::Job& job, VkDeviceSize size)
+{
+    auto& worker = s.m_workers[job.m_worker];
+    VkCompletedDevice& producer = *worker.m_caps.m_device;
+    VkCompletedDevice& consumer = *s.m_primary;
+    job.m_capacity = size;
+
+    VkCommandBufferAllocateInfo cmd_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    cmd_info.commandPool = worker.m_pool;
+    cmd_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmd_info.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(producer.m_handle, &cmd_info, &job.m_cmd) != VK_SUCCESS) return -1;
+    VkFenceCreateInfo fence_info = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    if (vkCreateFence(producer.m_handle, &fence_info, nullptr, &job.m_fence) != VK_SUCCESS) return -2;
+
+    VkMemoryPropertyFlags flags = 0;
+    switch (worker.m_share) {
+        case VkShareMode::k_same_device: {
+            if (create_buffer(producer, size, s_producer_usage, nullptr, job.m_producer_buffer) != k_success ||
+                bind_memory(producer, job.m_producer_buffer, ~0u, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, nullptr,
+                            job.m_producer_memory, job.m_producer_allocation, &flags) != k_success ||
+                map_buffer(producer.m_handle, job.m_producer_memory, flags, job.m_producer_mapped,
+                           job.m_producer_coherent) != k_success) {
+                return -3;
+            }
+            job.m_consumer_buffer = job.m_producer_buffer;
+            job.m_consumer_memory = job.m_producer_memory;
+            job.m_consumer_mapped = job.m_producer_mapped;
+            break;
+        }
+        case VkShareMode::k_host_copy: {
+            // Cached on the readback side, and whatever is host visible on the upload side
+            if (create_buffer(producer, size, s_producer_usage, nullptr, job.m_producer_buffer) != k_success ||
+                bind_memory(producer, job.m_producer_buffer, ~0u, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                            VK_MEMORY_PROPERTY_HOST_CACHED_BIT, nullptr, job.m_producer_memory,
+                            job.m_producer_allocation, &flags) != k_success ||
+                map_buffer(producer.m_handle, job.m_producer_memory, flags, job.m_producer_mapped,
+                           job.m_producer_coherent) != k_success) {
+                return -4;
+            }
+            if (create_buffer(consumer, size, s_consumer_usage, nullptr, job.m_consumer_buffer) != k_success ||
+                bind_memory(consumer, job.m_consumer_buffer, ~0u, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, nullptr, job.m_consumer_memory,
+                            job.m_consumer_allocation, &flags) != k_success ||
+                map_buffer(consumer.m_handle, job.m_consumer_memory, flags, job.m_consumer_mapped,
+                           job.m_consumer_coherent) != k_success) {
+                return -5;
+            }
+            break;
+        }
+        case VkShareMode::k_host_memory: {
+            VkDeviceSize align =
+              std::max(worker.m_caps.m_host_import_alignment, s.m_primary_caps.m_host_import_alignment);
+            job.m_capacity = (size + align - 1) / align * align;
+            job.m_host = host_alloc(align, job.m_capacity);
+            if (job.m_host == nullptr) return -6;
+            if (import_host(producer, job.m_host, job.m_capacity, s_producer_usage, job.m_producer_buffer,
+                            job.m_producer_memory, job.m_producer_allocation) != k_success ||
+                import_host(consumer, job.m_host, job.m_capacity, s_consumer_usage, job.m_consumer_buffer,
+                            job.m_consumer_memory, job.m_consumer_allocation) != k_success) {
+                return -7;
+            }
+            break;
+        }
+        case VkShareMode::k_opaque: {
+            VkExternalMemoryBufferCreateInfo external = {VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO};
+            external.handleTypes = s_memory_handle;
+            VkExportMemoryAllocateInfo export_info = {VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO};
+            export_info.handleTypes = s_memory_handle;
+            if (create_buffer(producer, size, s_producer_usage | s_consumer_usage, &external,
+                              job.m_producer_buffer) != k_success ||
+                bind_memory(producer, job.m_producer_buffer, ~0u, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                            &export_info, job.m_producer_memory, job.m_producer_allocation) != k_success ||
+                create_buffer(consumer, size, s_producer_usage | s_consumer_usage, &external,
+                              job.m_consumer_buffer) != k_success ||
+                share_memory(producer, job.m_producer_memory, consumer, job.m_producer_allocation,
+                             job.m_consumer_buffer, job.m_consumer_memory,
+                             job.m_consumer_allocation) != k_success) {
+                return -8;
+            }
+
+            // Without semaphores the consumer falls back to waiting for the fence through poll
+            if (worker.m_caps.m_opaque_semaphore && s.m_primary_caps.m_opaque_semaphore &&
+                share_semaphore(producer, consumer, job.m_producer_semaphore, job.m_consumer_semaphore) !=
+                  k_success) {
+                Log::warn("Failed to share a semaphore, the result can only be waited on from the host");
+                vkDestroySemaphore(producer.m_handle, job.m_producer_semaphore, nullptr);
+                vkDestroySemaphore(consumer.m_handle, job.m_consumer_semaphore, nullptr);
+                job.m_producer_semaphore = job.m_consumer_semaphore = VK_NULL_HANDLE;
+            }
+            break;
+        }
+    }
+    return k_success;
+}
+
+VkMultiGpuScheduler::Handle VkMultiGpuScheduler::submit_to(uint32_t worker_index, VkDeviceSize result_size,
+                                                           const RecordFunc& record, bool gpu_wait)
+{
+    if (worker_index >= m_workers.size() || result_size == 0) return k_invalid;
+    Worker& worker = m_workers[worker_index];
+    VkDevice device = worker.m_caps.m_device->m_handle;
+    const VkDeviceDispatch& api = worker.m_caps.m_device->m_dispatch;
+
+    // Reuse a free slot of the worker which is big enough, or grow one which isn't, before making a new one
+    Handle handle = k_invalid;
+    for (Handle i = 0; i < m_jobs.size(); i++) {
+        const Job& job = m_jobs[i];
+        if (job.m_state != State::k_free || job.m_worker != worker_index) continue;
+        if (job.m_capacity >= result_size) {
+            handle = i;
+            break;
+        }
+        if (handle == k_invalid) handle = i;
+    }
+    if (handle == k_invalid) {
+        handle = m_jobs.size();
+        m_jobs.emplace_back().m_worker = worker_index;
+    }
+    Job& job = m_jobs[handle];
+    if (job.m_capacity < result_size) {
+        destroy_slot(*this, job);
+        if (create_slot(*this, job, result_size) != k_success) {
+            Log::error("Failed to create a %llu byte result slot for offscreen work",
+                       (unsigned long long)result_size);
+            destroy_slot(*this, job);
+            return k_invalid;
+        }
+    }
+    job.m_size = result_size;
+
+    VkCommandBufferBeginInfo begin = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    api.vkResetCommandBuffer(job.m_cmd, 0);
+    api.vkBeginCommandBuffer(job.m_cmd, &begin);
+    record(job.m_cmd, job.m_producer_buffer);
+
+    // Whatever wrote the result has to be visible to where it goes next. For opaque memory that's a release to
+    // the external family, for host paths it's the host
+    const VkAccessFlags writes = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    if (worker.m_share == VkShareMode::k_opaque) {
+        VkBufferMemoryBarrier release = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+        release.srcAccessMask = writes;
+        release.srcQueueFamilyIndex = worker.m_caps.m_family;
+        release.dstQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
+        release.buffer = job.m_producer_buffer;
+        release.size = VK_WHOLE_SIZE;
+        api.vkCmdPipelineBarrier(job.m_cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                 VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &release, 0, nullptr);
+    } else if (worker.m_share != VkShareMode::k_same_device) {
+        VkMemoryBarrier to_host = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        to_host.srcAccessMask = writes;
+        to_host.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        api.vkCmdPipelineBarrier(job.m_cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1,
+                                 &to_host, 0, nullptr, 0, nullptr);
+    }
+    api.vkEndCommandBuffer(job.m_cmd);
+
+    VkSubmitInfo submit = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submit.pCommandBuffers = &job.m_cmd;
+    submit.commandBufferCount = 1;
+    job.m_signalled = gpu_wait && job.m_producer_semaphore != VK_NULL_HANDLE;
+    if (job.m_signalled) {
+        submit.pSignalSemaphores = &job.m_producer_semaphore;
+        submit.signalSemaphoreCount = 1;
+    }
+    if (worker.m_submitter != nullptr) {
+        if (worker.m_submitter->error() != k_success) {
+            Log::error("Failed to submit offscreen work, the submission thread has failed");
+            job.m_signalled = false;
+            return k_invalid;
+        }
+        VkSubmitQueue::Submit pushed;
+        pushed.add_cmd(job.m_cmd);
+        if (job.m_signalled) pushed.add_signal(job.m_producer_semaphore);
+        pushed.m_fence = job.m_fence;
+        api.vkResetFences(device, 1, &job.m_fence);
+        job.m_ticket = worker.m_submitter->push(pushed);
+    } else {
+        api.vkResetFences(device, 1, &job.m_fence);
+        if (api.vkQueueSubmit(worker.m_queue, 1, &submit, job.m_fence) != VK_SUCCESS) {
+            Log::error("Failed to submit offscreen work");
+            job.m_signalled = false;
+            return k_invalid;
+        }
+    }
+    job.m_state = State::k_running;
+    worker.m_pending++;
+    return handle;
+}
+
+// The producer is done, host copies happen now so the result is ready to use on the consumer
+static void complete_job(VkMultiGpuScheduler& s, VkMultiGpuScheduler::Job& job)
+{
+    auto& worker = s.m_workers[job.m_worker];
+    const VkDeviceDispatch& api = worker.m_caps.m_device->m_dispatch;
+    if (worker.m_share == VkShareMode::k_host_copy) {
+        VkMappedMemoryRange range = {VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE};
+        range.size = VK_WHOLE_SIZE;
+        if (!job.m_producer_coherent) {
+            range.memory = job.m_producer_memory;
+            api.vkInvalidateMappedMemoryRanges(worker.m_caps.m_device->m_handle, 1, &range);
+        }
+        memcpy(job.m_consumer_mapped, job.m_producer_mapped, job.m_size);
+        if (!job.m_consumer_coherent) {
+            range.memory = job.m_consumer_memory;
+            s.m_primary->m_dispatch.vkFlushMappedMemoryRanges(s.m_primary->m_handle, 1, &range);
+        }
+    } else if (worker.m_share == VkShareMode::k_same_device && job.m_producer_mapped && !job.m_producer_coherent) {
+        VkMappedMemoryRange range = {VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE};
+        range.memory = job.m_producer_memory;
+        range.size = VK_WHOLE_SIZE;
+        api.vkInvalidateMappedMemoryRanges(worker.m_caps.m_device->m_handle, 1, &range);
+    }
+    job.m_state = VkMultiGpuScheduler::State::k_ready;
+    worker.m_pending--;
+    worker.m_completed++;
+}
+
+void VkMultiGpuScheduler::poll()
+{
+    for (auto& job : m_jobs) {
+        if (job.m_state != State::k_running) continue;
+        const VkCompletedDevice& device = *m_workers[job.m_worker].m_caps.m_device;
+        if (device.m_dispatch.vkGetFenceStatus(device.m_handle, job.m_fence) == VK_SUCCESS) {
+            complete_job(*this, job);
+        }
+    }
+}
+
+result VkMultiGpuScheduler::wait(Handle handle)
+{
+    if (handle >= m_jobs.size() || m_jobs[handle].m_state == State::k_free) return -1;
+    Job& job = m_jobs[handle];
+    if (job.m_state == State::k_ready) return k_success;
+    if (wait_job(*this, job) != VK_SUCCESS) return -2;
+    complete_job(*this, job);
+    return k_success;
+}
+
+const void* VkMultiGpuScheduler::result_data(Handle handle) const
+{
+    const Job& job = m_jobs[handle];
+    if (job.m_state != State::k_ready) return nullptr;
+    switch (m_workers[job.m_worker].m_share) {
+        case VkShareMode::k_same_device:
+        case VkShareMode::k_host_copy:
+            return job.m_consumer_mapped;
+        case VkShareMode::k_host_memory:
+            return job.m_host;
+        case VkShareMode::k_opaque:
+            break;
+    }
+    return nullptr;
+}
+
+VkSemaphore VkMultiGpuScheduler::take_wait_semaphore(Handle handle)
+{
+    Job& job = m_jobs[handle];
+    if (!job.m_signalled) return VK_NULL_HANDLE;
+    job.m_signalled = false;
+    return job.m_consumer_semaphore;
+}
+
+void VkMultiGpuScheduler::record_acquire(Handle handle, VkCommandBuffer cmd, uint32_t cmd_family,
+                                         VkPipelineStageFlags dst_stage, VkAccessFlags dst_access) const
+{
+    const Job& job = m_jobs[handle];
+    VkShareMode share = m_workers[job.m_worker].m_share;
+    const VkDeviceDispatch& api = m_primary->m_dispatch;
+    if (share == VkShareMode::k_opaque) {
+        VkBufferMemoryBarrier acquire = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+        acquire.dstAccessMask = dst_access;
+        acquire.srcQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
+        acquire.dstQueueFamilyIndex = cmd_family;
+        acquire.buffer = job.m_consumer_buffer;
+        acquire.size = VK_WHOLE_SIZE;
+        api.vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dst_stage, 0, 0, nullptr, 1, &acquire, 0,
+                                 nullptr);
+        return;
+    }
+
+    VkMemoryBarrier barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    bool same = share == VkShareMode::k_same_device;
+    barrier.srcAccessMask = same ? VK_ACCESS_MEMORY_WRITE_BIT : VK_ACCESS_HOST_WRITE_BIT;
+    barrier.dstAccessMask = dst_access;
+    VkPipelineStageFlags src_stage = same ? VK_PIPELINE_STAGE_ALL_COMMANDS_BIT : VK_PIPELINE_STAGE_HOST_BIT;
+    api.vkCmdPipelineBarrier(cmd, src_stage, dst_stage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void VkMultiGpuScheduler::release(Handle handle)
+{
+    Job& job = m_jobs[handle];
+    if (job.m_state != State::k_ready) {
+        Log::warn("Released offscreen work which hasn't finished, waiting for it first");
+        wait(handle);
+    }
+
+    // A binary semaphore nobody waited on is still signalled, signalling it again on reuse is invalid
+    if (job.m_signalled) {
+        Log::warn("Offscreen work's semaphore was never waited on, dropping its slot");
+        destroy_slot(*this, job);
+        return;
+    }
+    job.m_state = State::k_free;
+}
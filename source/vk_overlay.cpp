@@ -0,0 +1,559 @@
+#include "atelier/atelier_vk_overlay.h"
+
+#include <algorithm>
+#ifdef ATELIER_IMGUI
+#include "imgui.h"
+#endif
+using namespace Atelier;
+
+result VkGpuScopes::init(VkCompletedDevice& device, uint32_t graphics_family, uint32_t frames_in_flight)
+{
+    if (frames_in_flight == 0 || frames_in_flight > k_max_frames_in_flight) return -1;
+    m_parent = &device;
+    m_frames_in_flight = frames_in_flight;
+    m_frame = 0;
+
+    auto family = device.m_queues.find(graphics_family);
+    float period = device.m_physical->m_device_properties.limits.timestampPeriod;
+    if (family == device.m_queues.end() || family->second.props.timestampValidBits == 0 || period <= 0.0f) {
+        Log::warn("The graphics family can't write timestamps, GPU scopes won't be measured");
+        return k_success;
+    }
+
+    VkQueryPoolCreateInfo query_info = {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    query_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    query_info.queryCount = 2 * k_max_scopes * frames_in_flight;
+    if (vkCreateQueryPool(device.m_handle, &query_info, nullptr, &m_pool) != VK_SUCCESS) {
+        Log::warn("Failed to create the GPU scope query pool, GPU scopes won't be measured");
+        return k_success;
+    }
+    m_period = period;
+    for (auto& names : m_names) names.reserve(k_max_scopes);
+    m_results.reserve(k_max_scopes);
+    return k_success;
+}
+
+void VkGpuScopes::shutdown()
+{
+    if (m_parent == nullptr) return;
+    vkDestroyQueryPool(m_parent->m_handle, m_pool, nullptr);
+    m_pool = VK_NULL_HANDLE;
+    for (auto& names : m_names) names.clear();
+    m_results.clear();
+    m_parent = nullptr;
+}
+
+void VkGpuScopes::begin_frame(VkCommandBuffer cmd, uint32_t frame_index)
+{
+    if (m_pool == VK_NULL_HANDLE) return;
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    m_frame = frame_index % m_frames_in_flight;
+    uint32_t first = 2 * k_max_scopes * m_frame;
+    auto& names = m_names[m_frame];
+
+    // The fence has passed so nothing here waits, a scope the driver somehow hasn't finished is just left out
+    if (!names.empty()) {
+        uint64_t stamps[2 * k_max_scopes] = {};
+        uint32_t count = static_cast<uint32_t>(names.size());
+        VkResult res = api.vkGetQueryPoolResults(m_parent->m_handle, m_pool, first, 2 * count, sizeof(stamps),
+                                                 stamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (res == VK_SUCCESS) {
+            m_results.clear();
+            for (uint32_t i = 0; i < count; i++) {
+                uint64_t ticks = stamps[2 * i + 1] >= stamps[2 * i] ? stamps[2 * i + 1] - stamps[2 * i] : 0;
+                m_results.push_back({names[i], double(ticks) * m_period / 1e6});
+            }
+        }
+    }
+    names.clear();
+    api.vkCmdResetQueryPool(cmd, m_pool, first, 2 * k_max_scopes);
+}
+
+uint32_t VkGpuScopes::begin(VkCommandBuffer cmd, const char* name)
+{
+    if (m_pool == VK_NULL_HANDLE) return k_max_scopes;
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    auto& names = m_names[m_frame];
+    if (names.size() >= k_max_scopes) return k_max_scopes;
+    uint32_t scope = static_cast<uint32_t>(names.size());
+    names.push_back(name);
+    api.vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_pool, 2 * (k_max_scopes * m_frame + scope));
+    return scope;
+}
+
+void VkGpuScopes::end(VkCommandBuffer cmd, uint32_t scope)
+{
+    if (m_pool == VK_NULL_HANDLE || scope >= k_max_scopes) return;
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    uint32_t query = 2 * (k_max_scopes * m_frame + scope) + 1;
+    api.vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_pool, query);
+}
+
+void PerfHud::add_frame(double cpu_ms, double gpu_ms)
+{
+    m_cpu_ms[m_cursor] = float(cpu_ms);
+    m_gpu_ms[m_cursor] = float(gpu_ms);
+    m_cursor = (m_cursor + 1) % k_history;
+}
+
+void PerfHud::sample_memory(const VkMemoryTelemetry& memory)
+{
+    m_has_budget = memory.m_has_budget;
+    m_heaps.resize(memory.m_heaps.size());
+    for (size_t i = 0; i < memory.m_heaps.size(); i++) {
+        const VkMemoryTelemetry::Heap& heap = memory.m_heaps[i];
+        m_heaps[i].m_size = heap.m_size;
+        m_heaps[i].m_usage = heap.m_usage;
+        m_heaps[i].m_budget = heap.m_budget;
+        m_heaps[i].m_high_water = heap.m_high_water;
+        m_heaps[i].m_device_local = heap.m_device_local;
+        m_heaps[i].m_pressure = heap.m_pressure != VkMemoryTelemetry::Pressure::k_none;
+    }
+}
+
+#ifdef ATELIER_IMGUI
+
+void PerfHud::draw() const
+{
+    ImGui::SetNextWindowPos(ImVec2(8.0f, 8.0f), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowBgAlpha(0.75f);
+    if (!ImGui::Begin("Performance", nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
+        ImGui::End();
+        return;
+    }
+
+    // The graphs start at the oldest sample so time runs left to right
+    uint32_t newest = (m_cursor + k_history - 1) % k_history;
+    ImGui::Text("Frame %.2f ms (%.0f fps), stddev %.2f ms, p99 %.2f ms", m_cpu_ms[newest],
+                m_cpu_ms[newest] > 0.0f ? 1000.0f / m_cpu_ms[newest] : 0.0f, m_stddev_ms, m_p99_ms);
+    ImGui::Text("%llu frames, %llu missed, rendering at %.0f%%", (unsigned long long)m_frames,
+                (unsigned long long)m_missed, m_render_scale * 100.0f);
+    ImGui::PlotLines("Frame ms", m_cpu_ms, int(k_history), int(m_cursor), nullptr, 0.0f, 50.0f, ImVec2(0, 60));
+    ImGui::PlotLines("GPU ms", m_gpu_ms, int(k_history), int(m_cursor), nullptr, 0.0f, 50.0f, ImVec2(0, 60));
+
+    if (ImGui::CollapsingHeader("GPU scopes", ImGuiTreeNodeFlags_DefaultOpen)) {
+        if (m_scopes.empty()) ImGui::TextUnformatted("No timestamps on this queue");
+        for (const auto& scope : m_scopes) ImGui::Text("%-24s %8.3f ms", scope.m_name, scope.m_ms);
+    }
+
+    if (ImGui::CollapsingHeader("Queue", ImGuiTreeNodeFlags_DefaultOpen)) {
+        ImGui::Text("%u submits, %u presents per frame", m_queue.m_submits, m_queue.m_presents);
+        ImGui::Text("%llu frames pending on the GPU", (unsigned long long)m_queue.m_frames_pending);
+        ImGui::Text("Overlay %u draws, %u vertices, %u lists dropped", m_queue.m_overlay_draws,
+                    m_queue.m_overlay_vertices, m_queue.m_overlay_dropped);
+    }
+
+    if (ImGui::CollapsingHeader("Memory", ImGuiTreeNodeFlags_DefaultOpen)) {
+        if (!m_has_budget) ImGui::TextUnformatted("VK_EXT_memory_budget unavailable, showing tracked allocations");
+        for (size_t i = 0; i < m_heaps.size(); i++) {
+            const Heap& heap = m_heaps[i];
+            double used_mb = double(heap.m_usage) / (1024.0 * 1024.0);
+            double budget_mb = double(heap.m_budget) / (1024.0 * 1024.0);
+            char label[64];
+            snprintf(label, sizeof(label), "%.0f / %.0f MB", used_mb, budget_mb);
+            ImGui::Text("Heap %zu%s", i, heap.m_device_local ? " (device)" : "");
+            ImGui::SameLine(120.0f);
+            float fraction = heap.m_budget > 0 ? float(double(heap.m_usage) / double(heap.m_budget)) : 0.0f;
+            ImGui::ProgressBar(fraction, ImVec2(200.0f, 0.0f), label);
+            ImGui::SameLine();
+            ImGui::Text("peak %.0f MB%s", double(heap.m_high_water) / (1024.0 * 1024.0),
+                        heap.m_pressure ? ", under pressure" : "");
+        }
+    }
+    ImGui::End();
+}
+
+result VkOverlay::init(VkCompletedDevice& device, VkShaderRegistry& shaders, uint32_t graphics_family,
+                       VkQueue queue, VkRenderPass render_pass, uint32_t frames_in_flight, uint32_t max_vertices,
+                       uint32_t max_indices, const char* vertex_spirv_path, const char* fragment_spirv_path)
+{
+    if (frames_in_flight == 0 || max_vertices == 0 || max_indices == 0 || render_pass == VK_NULL_HANDLE) return -1;
+    m_parent = &device;
+    m_shaders = &shaders;
+    VkDevice dev = device.m_handle;
+    const VkDeviceDispatch& api = device.m_dispatch;
+
+    if (ImGui::GetCurrentContext() == nullptr) {
+        ImGui::CreateContext();
+        ImGui::GetIO().IniFilename = nullptr;
+        m_owns_context = true;
+    }
+
+    // One region per frame in flight, indices after vertices with the alignment both of them need
+    m_frames_in_flight = frames_in_flight;
+    m_max_vertices = max_vertices;
+    m_max_indices = max_indices;
+    m_index_offset = (VkDeviceSize(max_vertices) * sizeof(ImDrawVert) + 255) & ~VkDeviceSize(255);
+    m_region_size = (m_index_offset + VkDeviceSize(max_indices) * sizeof(ImDrawIdx) + 255) & ~VkDeviceSize(255);
+    if (m_ring.init(device, m_region_size * frames_in_flight,
+                    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != k_success) {
+        Log::error("Failed to create the overlay vertex ring");
+        shutdown();
+        return -2;
+    }
+
+    // The font atlas goes through a staging buffer into a device local image
+    unsigned char* pixels = nullptr;
+    int width = 0, height = 0;
+    ImGui::GetIO().Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+    VkDeviceSize font_bytes = VkDeviceSize(width) * height * 4;
+    VkCompletedBuffer staging;
+    if (staging.init(device, font_bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != k_success) {
+        Log::error("Failed to create the font staging buffer");
+        shutdown();
+        return -3;
+    }
+    memcpy(staging.m_mapped, pixels, font_bytes);
+
+    VkImageCreateInfo image_info = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+    image_info.extent = {uint32_t(width), uint32_t(height), 1};
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(dev, &image_info, nullptr, &m_font_image) != VK_SUCCESS) {
+        Log::error("Failed to create the font image");
+        staging.shutdown();
+        shutdown();
+        return -4;
+    }
+    VkMemoryRequirements reqs;
+    vkGetImageMemoryRequirements(dev, m_font_image, &reqs);
+    int32_t type = device.m_physical->find_memory_type(reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (type < 0) type = device.m_physical->find_memory_type(reqs.memoryTypeBits, 0);
+    VkMemoryAllocateInfo alloc_info = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    alloc_info.allocationSize = reqs.size;
+    alloc_info.memoryTypeIndex = uint32_t(type);
+    if (type < 0 || vkAllocateMemory(dev, &alloc_info, nullptr, &m_font_memory) != VK_SUCCESS ||
+        vkBindImageMemory(dev, m_font_image, m_font_memory, 0) != VK_SUCCESS) {
+        Log::error("Failed to allocate the font image");
+        staging.shutdown();
+        shutdown();
+        return -5;
+    }
+    m_font_memory_type = uint32_t(type);
+    m_font_bytes = reqs.size;
+    VkMemoryTelemetry::on_allocate(device, m_font_memory_type, m_font_bytes);
+
+    // A one off command buffer for the copy, waited on here since it only happens at startup
+    VkCommandPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    pool_info.queueFamilyIndex = graphics_family;
+    VkCommandPool pool = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    VkCommandBuffer cmd = VK_NULL_HANDLE;
+    VkFenceCreateInfo fence_info = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    bool uploaded = vkCreateCommandPool(dev, &pool_info, nullptr, &pool) == VK_SUCCESS &&
+                    vkCreateFence(dev, &fence_info, nullptr, &fence) == VK_SUCCESS;
+    if (uploaded) {
+        VkCommandBufferAllocateInfo cmd_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        cmd_info.commandPool = pool;
+        cmd_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        cmd_info.commandBufferCount = 1;
+        uploaded = vkAllocateCommandBuffers(dev, &cmd_info, &cmd) == VK_SUCCESS;
+    }
+    if (uploaded) {
+        VkCommandBufferBeginInfo begin = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+        begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        api.vkBeginCommandBuffer(cmd, &begin);
+
+        VkImageMemoryBarrier barrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = m_font_image;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        api.vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                                 nullptr, 0, nullptr, 1, &barrier);
+
+        VkBufferImageCopy copy = {};
+        copy.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        copy.imageExtent = image_info.extent;
+        api.vkCmdCopyBufferToImage(cmd, staging.m_handle, m_font_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                                   &copy);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        api.vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0,
+                                 nullptr, 0, nullptr, 1, &barrier);
+        api.vkEndCommandBuffer(cmd);
+
+        VkSubmitInfo submit = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        submit.commandBufferCount = 1;
+        submit.pCommandBuffers = &cmd;
+        uploaded = api.vkQueueSubmit(queue, 1, &submit, fence) == VK_SUCCESS &&
+                   api.vkWaitForFences(dev, 1, &fence, VK_TRUE, UINT64_MAX) == VK_SUCCESS;
+    }
+    vkDestroyFence(dev, fence, nullptr);
+    vkDestroyCommandPool(dev, pool, nullptr);
+    staging.shutdown();
+    if (!uploaded) {
+        Log::error("Failed to upload the font atlas");
+        shutdown();
+        return -6;
+    }
+
+    VkImageViewCreateInfo view_info = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+    view_info.image = m_font_image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+    view_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    VkSamplerCreateInfo sampler_info = {VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    sampler_info.magFilter = VK_FILTER_LINEAR;
+    sampler_info.minFilter = VK_FILTER_LINEAR;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.maxLod = 1.0f;
+    if (vkCreateImageView(dev, &view_info, nullptr, &m_font_view) != VK_SUCCESS ||
+        vkCreateSampler(dev, &sampler_info, nullptr, &m_sampler) != VK_SUCCESS) {
+        Log::error("Failed to create the font view and sampler");
+        shutdown();
+        return -7;
+    }
+
+    // Same texture layout as the quad batcher so the fragment shader can be shared
+    VkDescriptorSetLayoutBinding binding = {};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    VkDescriptorSetLayoutCreateInfo set_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    set_info.pBindings = &binding;
+    set_info.bindingCount = 1;
+    VkDescriptorPoolSize pool_size = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1};
+    VkDescriptorPoolCreateInfo descriptor_pool_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    descriptor_pool_info.maxSets = 1;
+    descriptor_pool_info.pPoolSizes = &pool_size;
+    descriptor_pool_info.poolSizeCount = 1;
+    if (vkCreateDescriptorSetLayout(dev, &set_info, nullptr, &m_set_layout) != VK_SUCCESS ||
+        vkCreateDescriptorPool(dev, &descriptor_pool_info, nullptr, &m_descriptor_pool) != VK_SUCCESS) {
+        Log::error("Failed to create the overlay descriptors");
+        shutdown();
+        return -8;
+    }
+    VkDescriptorSetAllocateInfo set_alloc = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    set_alloc.descriptorPool = m_descriptor_pool;
+    set_alloc.descriptorSetCount = 1;
+    set_alloc.pSetLayouts = &m_set_layout;
+    if (vkAllocateDescriptorSets(dev, &set_alloc, &m_font_set) != VK_SUCCESS) {
+        Log::error("Failed to allocate the font descriptor set");
+        shutdown();
+        return -9;
+    }
+    VkDescriptorImageInfo font_info = {m_sampler, m_font_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    VkWriteDescriptorSet write = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.dstSet = m_font_set;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &font_info;
+    vkUpdateDescriptorSets(dev, 1, &write, 0, nullptr);
+    ImGui::GetIO().Fonts->SetTexID((ImTextureID)(uint64_t)m_font_set);
+
+    VkPushConstantRange push = {VK_SHADER_STAGE_VERTEX_BIT, 0, 4 * sizeof(float)};
+    VkPipelineLayoutCreateInfo layout_info = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    layout_info.pSetLayouts = &m_set_layout;
+    layout_info.setLayoutCount = 1;
+    layout_info.pPushConstantRanges = &push;
+    layout_info.pushConstantRangeCount = 1;
+    if (vkCreatePipelineLayout(dev, &layout_info, nullptr, &m_layout) != VK_SUCCESS) {
+        Log::error("Failed to create the overlay pipeline layout");
+        shutdown();
+        return -10;
+    }
+
+    VkShaderModule vertex = VK_NULL_HANDLE, fragment = VK_NULL_HANDLE;
+    if (shaders.acquire_file(vertex_spirv_path, vertex, &m_vertex_hash) != k_success ||
+        shaders.acquire_file(fragment_spirv_path, fragment, &m_fragment_hash) != k_success) {
+        Log::error("Failed to load the overlay shaders");
+        shutdown();
+        return -11;
+    }
+
+    VkMutableGraphicsPipelineCreateInfo pipeline_info;
+    VkMutableGraphicsPipelineCreateInfo::create_default(pipeline_info, m_layout, render_pass);
+    pipeline_info.stages.push_back({VK_SHADER_STAGE_VERTEX_BIT, vertex, m_vertex_hash});
+    pipeline_info.stages.push_back({VK_SHADER_STAGE_FRAGMENT_BIT, fragment, m_fragment_hash});
+    pipeline_info.vertex_bindings.push_back({0, sizeof(ImDrawVert), VK_VERTEX_INPUT_RATE_VERTEX});
+    pipeline_info.vertex_attributes.push_back({0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(ImDrawVert, pos)});
+    pipeline_info.vertex_attributes.push_back({1, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(ImDrawVert, uv)});
+    pipeline_info.vertex_attributes.push_back({2, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(ImDrawVert, col)});
+    for (auto& blend : pipeline_info.blend_attachments) {
+        blend.blendEnable = VK_TRUE;
+        blend.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        blend.colorBlendOp = VK_BLEND_OP_ADD;
+        blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        blend.alphaBlendOp = VK_BLEND_OP_ADD;
+    }
+    if (pipeline_info.create_pipeline(m_pipeline, dev) != k_success) {
+        Log::error("Failed to create the overlay pipeline");
+        shutdown();
+        return -12;
+    }
+    return k_success;
+}
+
+void VkOverlay::shutdown()
+{
+    if (m_parent == nullptr) return;
+    VkDevice dev = m_parent->m_handle;
+    vkDestroyPipeline(dev, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(dev, m_layout, nullptr);
+    vkDestroyDescriptorPool(dev, m_descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(dev, m_set_layout, nullptr);
+    vkDestroySampler(dev, m_sampler, nullptr);
+    vkDestroyImageView(dev, m_font_view, nullptr);
+    vkDestroyImage(dev, m_font_image, nullptr);
+    vkFreeMemory(dev, m_font_memory, nullptr);
+    if (m_font_bytes != 0) VkMemoryTelemetry::on_free(*m_parent, m_font_memory_type, m_font_bytes);
+    if (m_vertex_hash != 0) m_shaders->release(m_vertex_hash);
+    if (m_fragment_hash != 0) m_shaders->release(m_fragment_hash);
+    m_ring.shutdown();
+    m_pipeline = VK_NULL_HANDLE;
+    m_layout = VK_NULL_HANDLE;
+    m_descriptor_pool = VK_NULL_HANDLE;
+    m_font_set = VK_NULL_HANDLE;
+    m_set_layout = VK_NULL_HANDLE;
+    m_sampler = VK_NULL_HANDLE;
+    m_font_view = VK_NULL_HANDLE;
+    m_font_image = VK_NULL_HANDLE;
+    m_font_memory = VK_NULL_HANDLE;
+    m_font_bytes = 0;
+    m_vertex_hash = 0;
+    m_fragment_hash = 0;
+    if (m_owns_context) ImGui::DestroyContext();
+    m_owns_context = false;
+    m_parent = nullptr;
+}
+
+void VkOverlay::new_frame(VkExtent2D extent, float delta_seconds)
+{
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = ImVec2(float(extent.width), float(extent.height));
+    io.DeltaTime = delta_seconds > 0.0f ? delta_seconds : 1.0f / 60.0f;
+    ImGui::NewFrame();
+}
+
+void VkOverlay::setup_render_state(VkCommandBuffer cmd, const ImDrawData* data, VkDeviceSize region)
+{
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    api.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+    VkDeviceSize index_offset = region + m_index_offset;
+    api.vkCmdBindVertexBuffers(cmd, 0, 1, &m_ring.m_handle, &region);
+    api.vkCmdBindIndexBuffer(cmd, m_ring.m_handle, index_offset,
+                             sizeof(ImDrawIdx) == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+
+    float width = data->DisplaySize.x * data->FramebufferScale.x;
+    float height = data->DisplaySize.y * data->FramebufferScale.y;
+    VkViewport viewport = {0.0f, 0.0f, width, height, 0.0f, 1.0f};
+    api.vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+    // ImGui works in display coordinates starting at DisplayPos, the vertex shader maps them to clip space
+    float scale_x = 2.0f / data->DisplaySize.x;
+    float scale_y = 2.0f / data->DisplaySize.y;
+    float transform[4] = {scale_x, scale_y, -1.0f - data->DisplayPos.x * scale_x,
+                          -1.0f - data->DisplayPos.y * scale_y};
+    api.vkCmdPushConstants(cmd, m_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(transform), transform);
+}
+
+void VkOverlay::record(VkCommandBuffer cmd, uint32_t frame_index, const ImDrawData* data)
+{
+    m_last_draws = 0;
+    m_last_vertices = 0;
+    m_last_dropped = 0;
+    if (data == nullptr || data->CmdListsCount == 0) return;
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    float fb_width = data->DisplaySize.x * data->FramebufferScale.x;
+    float fb_height = data->DisplaySize.y * data->FramebufferScale.y;
+    if (fb_width <= 0.0f || fb_height <= 0.0f) return;
+
+    // Whole draw lists are copied in order until the region is full, the ring is likely write combined so the
+    // copies only ever move forwards
+    VkDeviceSize region = VkDeviceSize(frame_index % m_frames_in_flight) * m_region_size;
+    auto* vertices = reinterpret_cast<ImDrawVert*>(static_cast<uint8_t*>(m_ring.m_mapped) + region);
+    auto* indices = reinterpret_cast<ImDrawIdx*>(static_cast<uint8_t*>(m_ring.m_mapped) + region + m_index_offset);
+    uint32_t vertex_count = 0, index_count = 0;
+    int list_count = 0;
+    for (; list_count < data->CmdListsCount; list_count++) {
+        const ImDrawList* list = data->CmdLists[list_count];
+        uint32_t list_vertices = uint32_t(list->VtxBuffer.Size);
+        uint32_t list_indices = uint32_t(list->IdxBuffer.Size);
+        if (vertex_count + list_vertices > m_max_vertices || index_count + list_indices > m_max_indices) break;
+        memcpy(vertices + vertex_count, list->VtxBuffer.Data, list_vertices * sizeof(ImDrawVert));
+        memcpy(indices + index_count, list->IdxBuffer.Data, list_indices * sizeof(ImDrawIdx));
+        vertex_count += list_vertices;
+        index_count += list_indices;
+    }
+    m_last_dropped = uint32_t(data->CmdListsCount - list_count);
+
+    // Only the start and end of a run of dropping frames are logged, the HUD shows the count every frame
+    bool dropping = m_last_dropped != 0;
+    if (dropping && !m_dropping) {
+        Log::warn("Overlay started dropping draw lists over the ring capacity, %u this frame", m_last_dropped);
+    } else if (!dropping && m_dropping) {
+        Log::info("Overlay draw lists fit the ring again");
+    }
+    m_dropping = dropping;
+    m_ring.flush(region, m_index_offset + VkDeviceSize(index_count) * sizeof(ImDrawIdx));
+    m_last_vertices = vertex_count;
+    if (vertex_count == 0) return;
+
+    setup_render_state(cmd, data, region);
+    ImVec2 clip_offset = data->DisplayPos;
+    ImVec2 clip_scale = data->FramebufferScale;
+    VkDescriptorSet bound_texture = VK_NULL_HANDLE;
+    uint32_t vertex_base = 0, index_base = 0;
+    for (int l = 0; l < list_count; l++) {
+        const ImDrawList* list = data->CmdLists[l];
+        for (int c = 0; c < list->CmdBuffer.Size; c++) {
+            const ImDrawCmd& draw = list->CmdBuffer[c];
+            if (draw.UserCallback != nullptr) {
+                if (draw.UserCallback == ImDrawCallback_ResetRenderState) {
+                    setup_render_state(cmd, data, region);
+                    bound_texture = VK_NULL_HANDLE;
+                } else {
+                    draw.UserCallback(list, &draw);
+                }
+                continue;
+            }
+
+            // Clip rectangles are in display space, the scissor wants framebuffer pixels inside the target
+            float x0 = std::max((draw.ClipRect.x - clip_offset.x) * clip_scale.x, 0.0f);
+            float y0 = std::max((draw.ClipRect.y - clip_offset.y) * clip_scale.y, 0.0f);
+            float x1 = std::min((draw.ClipRect.z - clip_offset.x) * clip_scale.x, fb_width);
+            float y1 = std::min((draw.ClipRect.w - clip_offset.y) * clip_scale.y, fb_height);
+            if (x1 <= x0 || y1 <= y0) continue;
+            VkRect2D scissor = {{int32_t(x0), int32_t(y0)}, {uint32_t(x1 - x0), uint32_t(y1 - y0)}};
+            api.vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+            auto texture = (VkDescriptorSet)(uint64_t)draw.GetTexID();
+            if (texture == VK_NULL_HANDLE) texture = m_font_set;
+            if (texture != bound_texture) {
+                api.vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_layout, 0, 1, &texture, 0,
+                                            nullptr);
+                bound_texture = texture;
+            }
+            api.vkCmdDrawIndexed(cmd, draw.ElemCount, 1, index_base + draw.IdxOffset,
+                                 int32_t(vertex_base + draw.VtxOffset), 0);
+            m_last_draws++;
+        }
+        vertex_base += uint32_t(list->VtxBuffer.Size);
+        index_base += uint32_t(list->IdxBuffer.Size);
+    }
+}
+
+#endif
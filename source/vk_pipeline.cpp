@@ -0,0 +1,248 @@
+#include "atelier/atelier_vk_mutable.h"
+using namespace Atelier;
+
+result VkMutableGraphicsPipelineCreateInfo::create_default(VkMutableGraphicsPipelineCreateInfo& info,
+                                                           VkPipelineLayout layout, VkRenderPass render_pass)
+{
+    if (layout == VK_NULL_HANDLE || render_pass == VK_NULL_HANDLE) return -1;
+    info = VkMutableGraphicsPipelineCreateInfo();
+    info.layout = layout;
+    info.render_pass = render_pass;
+
+    info.input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    info.input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    info.rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    info.rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+    info.rasterization.cullMode = VK_CULL_MODE_NONE;
+    info.rasterization.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    info.rasterization.lineWidth = 1.0f;
+
+    info.multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    info.multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    info.depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    info.depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+    auto& blend = info.blend_attachments.emplace_back();
+    blend = {};
+    blend.colorWriteMask =
+      VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    // Viewport and scissor are always dynamic so that a resize doesn't have to rebuild every pipeline
+    info.dynamic_states.push_back(VK_DYNAMIC_STATE_VIEWPORT);
+    info.dynamic_states.push_back(VK_DYNAMIC_STATE_SCISSOR);
+    return k_success;
+}
+
+uint64_t VkMutableGraphicsPipelineCreateInfo::hash() const
+{
+    // We hash field by field rather than the raw structs, they have pNext pointers and padding in them
+    uint64_t h = hash_mix(stages.size());
+    for (const auto& s : stages) {
+        h = hash_combine(h, s.stage);
+        h = hash_combine(h, s.shader_hash != 0 ? s.shader_hash : (uint64_t)s.module);
+        h = hash_bytes(s.entry.data(), s.entry.size(), h);
+        for (const auto& c : s.constants) {
+            h = hash_combine(h, (uint64_t(c.constantID) << 32) | c.offset);
+            h = hash_combine(h, c.size);
+        }
+        h = hash_bytes(s.constant_data.data(), s.constant_data.size(), h);
+    }
+    for (const auto& b : vertex_bindings) {
+        h = hash_combine(h, (uint64_t(b.binding) << 32) | b.stride);
+        h = hash_combine(h, b.inputRate);
+    }
+    for (const auto& a : vertex_attributes) {
+        h = hash_combine(h, (uint64_t(a.location) << 32) | a.binding);
+        h = hash_combine(h, (uint64_t(a.format) << 32) | a.offset);
+    }
+
+    h = hash_combine(h, (uint64_t(input_assembly.topology) << 1) | input_assembly.primitiveRestartEnable);
+
+    const auto& r = rasterization;
+    h = hash_combine(h, (uint64_t(r.polygonMode) << 32) | r.cullMode);
+    h = hash_combine(h, (uint64_t(r.frontFace) << 3) | (r.depthClampEnable << 2) |
+                          (r.rasterizerDiscardEnable << 1) | r.depthBiasEnable);
+    float raster_floats[] = {r.depthBiasConstantFactor, r.depthBiasClamp, r.depthBiasSlopeFactor, r.lineWidth};
+    h = hash_bytes(raster_floats, sizeof(raster_floats), h);
+
+    const auto& m = multisample;
+    h = hash_combine(h, (uint64_t(m.rasterizationSamples) << 3) | (m.sampleShadingEnable << 2) |
+                          (m.alphaToCoverageEnable << 1) | m.alphaToOneEnable);
+    h = hash_bytes(&m.minSampleShading, sizeof(float), h);
+
+    const auto& d = depth_stencil;
+    h = hash_combine(h, (uint64_t(d.depthCompareOp) << 4) | (d.depthTestEnable << 3) | (d.depthWriteEnable << 2) |
+                          (d.depthBoundsTestEnable << 1) | d.stencilTestEnable);
+    for (const VkStencilOpState* st : {&d.front, &d.back}) {
+        h = hash_combine(h, (uint64_t(st->failOp) << 48) | (uint64_t(st->passOp) << 32) |
+                              (uint64_t(st->depthFailOp) << 16) | st->compareOp);
+        h = hash_combine(h, (uint64_t(st->compareMask) << 32) | st->writeMask);
+        h = hash_combine(h, st->reference);
+    }
+    float bounds[] = {d.minDepthBounds, d.maxDepthBounds};
+    h = hash_bytes(bounds, sizeof(bounds), h);
+
+    for (const auto& b : blend_attachments) {
+        h = hash_combine(h, (uint64_t(b.blendEnable) << 32) | b.colorWriteMask);
+        h = hash_combine(h, (uint64_t(b.srcColorBlendFactor) << 32) | b.dstColorBlendFactor);
+        h = hash_combine(h, (uint64_t(b.srcAlphaBlendFactor) << 32) | b.dstAlphaBlendFactor);
+        h = hash_combine(h, (uint64_t(b.colorBlendOp) << 32) | b.alphaBlendOp);
+    }
+    for (VkDynamicState ds : dynamic_states) h = hash_combine(h, ds);
+
+    h = hash_combine(h, (uint64_t)layout);
+    h = hash_combine(h, (uint64_t)render_pass);
+    return hash_combine(h, subpass);
+}
+
+// Field by field for the same reasons as the hash, and over exactly the fields the hash reads
+static bool same_stencil(const VkStencilOpState& a, const VkStencilOpState& b)
+{
+    return a.failOp == b.failOp && a.passOp == b.passOp && a.depthFailOp == b.depthFailOp &&
+           a.compareOp == b.compareOp && a.compareMask == b.compareMask && a.writeMask == b.writeMask &&
+           a.reference == b.reference;
+}
+
+bool VkMutableGraphicsPipelineCreateInfo::same_state(const VkMutableGraphicsPipelineCreateInfo& other) const
+{
+    if (stages.size() != other.stages.size() || vertex_bindings.size() != other.vertex_bindings.size() ||
+        vertex_attributes.size() != other.vertex_attributes.size() ||
+        blend_attachments.size() != other.blend_attachments.size() || dynamic_states != other.dynamic_states ||
+        layout != other.layout || render_pass != other.render_pass || subpass != other.subpass) {
+        return false;
+    }
+    for (size_t i = 0; i < stages.size(); i++) {
+        const Stage& a = stages[i];
+        const Stage& b = other.stages[i];
+        uint64_t a_shader = a.shader_hash != 0 ? a.shader_hash : (uint64_t)a.module;
+        uint64_t b_shader = b.shader_hash != 0 ? b.shader_hash : (uint64_t)b.module;
+        if (a.stage != b.stage || a_shader != b_shader || a.entry != b.entry ||
+            a.constants.size() != b.constants.size() || a.constant_data != b.constant_data) {
+            return false;
+        }
+        for (size_t c = 0; c < a.constants.size(); c++) {
+            if (a.constants[c].constantID != b.constants[c].constantID ||
+                a.constants[c].offset != b.constants[c].offset || a.constants[c].size != b.constants[c].size) {
+                return false;
+            }
+        }
+    }
+    for (size_t i = 0; i < vertex_bindings.size(); i++) {
+        const auto& a = vertex_bindings[i];
+        const auto& b = other.vertex_bindings[i];
+        if (a.binding != b.binding || a.stride != b.stride || a.inputRate != b.inputRate) return false;
+    }
+    for (size_t i = 0; i < vertex_attributes.size(); i++) {
+        const auto& a = vertex_attributes[i];
+        const auto& b = other.vertex_attributes[i];
+        if (a.location != b.location || a.binding != b.binding || a.format != b.format || a.offset != b.offset) {
+            return false;
+        }
+    }
+
+    const auto& ia = input_assembly;
+    const auto& ib = other.input_assembly;
+    if (ia.topology != ib.topology || ia.primitiveRestartEnable != ib.primitiveRestartEnable) return false;
+
+    const auto& ra = rasterization;
+    const auto& rb = other.rasterization;
+    if (ra.polygonMode != rb.polygonMode || ra.cullMode != rb.cullMode || ra.frontFace != rb.frontFace ||
+        ra.depthClampEnable != rb.depthClampEnable || ra.rasterizerDiscardEnable != rb.rasterizerDiscardEnable ||
+        ra.depthBiasEnable != rb.depthBiasEnable || ra.depthBiasConstantFactor != rb.depthBiasConstantFactor ||
+        ra.depthBiasClamp != rb.depthBiasClamp || ra.depthBiasSlopeFactor != rb.depthBiasSlopeFactor ||
+        ra.lineWidth != rb.lineWidth) {
+        return false;
+    }
+
+    const auto& ma = multisample;
+    const auto& mb = other.multisample;
+    if (ma.rasterizationSamples != mb.rasterizationSamples || ma.sampleShadingEnable != mb.sampleShadingEnable ||
+        ma.alphaToCoverageEnable != mb.alphaToCoverageEnable || ma.alphaToOneEnable != mb.alphaToOneEnable ||
+        ma.minSampleShading != mb.minSampleShading) {
+        return false;
+    }
+
+    const auto& da = depth_stencil;
+    const auto& db = other.depth_stencil;
+    if (da.depthCompareOp != db.depthCompareOp || da.depthTestEnable != db.depthTestEnable ||
+        da.depthWriteEnable != db.depthWriteEnable || da.depthBoundsTestEnable != db.depthBoundsTestEnable ||
+        da.stencilTestEnable != db.stencilTestEnable || !same_stencil(da.front, db.front) ||
+        !same_stencil(da.back, db.back) || da.minDepthBounds != db.minDepthBounds ||
+        da.maxDepthBounds != db.maxDepthBounds) {
+        return false;
+    }
+
+    for (size_t i = 0; i < blend_attachments.size(); i++) {
+        const auto& a = blend_attachments[i];
+        const auto& b = other.blend_attachments[i];
+        if (a.blendEnable != b.blendEnable || a.colorWriteMask != b.colorWriteMask ||
+            a.srcColorBlendFactor != b.srcColorBlendFactor || a.dstColorBlendFactor != b.dstColorBlendFactor ||
+            a.srcAlphaBlendFactor != b.srcAlphaBlendFactor || a.dstAlphaBlendFactor != b.dstAlphaBlendFactor ||
+            a.colorBlendOp != b.colorBlendOp || a.alphaBlendOp != b.alphaBlendOp) {
+            return false;
+        }
+    }
+    return true;
+}
+
+result VkMutableGraphicsPipelineCreateInfo::create_pipeline(VkPipeline& pipeline, VkDevice device,
+                                                            VkPipelineCache cache,
+                                                            const VkAllocationCallbacks* alloc) const
+{
+    if (device == VK_NULL_HANDLE || stages.empty()) return -1;
+
+    std::vector<VkPipelineShaderStageCreateInfo> stage_infos(stages.size());
+    std::vector<VkSpecializationInfo> specializations(stages.size());
+    for (size_t i = 0; i < stages.size(); i++) {
+        stage_infos[i] = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+        stage_infos[i].stage = stages[i].stage;
+        stage_infos[i].module = stages[i].module;
+        stage_infos[i].pName = stages[i].entry.c_str();
+        if (stages[i].constants.empty()) continue;
+        specializations[i].mapEntryCount = stages[i].constants.size();
+        specializations[i].pMapEntries = stages[i].constants.data();
+        specializations[i].dataSize = stages[i].constant_data.size();
+        specializations[i].pData = stages[i].constant_data.data();
+        stage_infos[i].pSpecializationInfo = &specializations[i];
+    }
+
+    VkPipelineVertexInputStateCreateInfo vertex_input = {};
+    vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertex_input.pVertexBindingDescriptions = vertex_bindings.data();
+    vertex_input.vertexBindingDescriptionCount = vertex_bindings.size();
+    vertex_input.pVertexAttributeDescriptions = vertex_attributes.data();
+    vertex_input.vertexAttributeDescriptionCount = vertex_attributes.size();
+
+    // Viewport contents are ignored since they're dynamic, but the counts still have to be valid
+    VkPipelineViewportStateCreateInfo viewport = {VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
+    viewport.viewportCount = 1;
+    viewport.scissorCount = 1;
+
+    VkPipelineColorBlendStateCreateInfo blend = {VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
+    blend.pAttachments = blend_attachments.data();
+    blend.attachmentCount = blend_attachments.size();
+
+    VkPipelineDynamicStateCreateInfo dynamic = {VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+    dynamic.pDynamicStates = dynamic_states.data();
+    dynamic.dynamicStateCount = dynamic_states.size();
+
+    VkGraphicsPipelineCreateInfo info = {VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+    info.pStages = stage_infos.data();
+    info.stageCount = stage_infos.size();
+    info.pVertexInputState = &vertex_input;
+    info.pInputAssemblyState = &input_assembly;
+    info.pViewportState = &viewport;
+    info.pRasterizationState = &rasterization;
+    info.pMultisampleState = &multisample;
+    info.pDepthStencilState = &depth_stencil;
+    info.pColorBlendState = &blend;
+    info.pDynamicState = &dynamic;
+    info.layout = layout;
+    info.renderPass = render_pass;
+    info.subpass = subpass;
+
+    if (vkCreateGraphicsPipelines(device, cache, 1, &info, alloc, &pipeline) != VK_SUCCESS) return -2;
+    return k_success;
+}
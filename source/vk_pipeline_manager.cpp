@@ -0,0 +1,137 @@
+#include "atelier/atelier_io.h"
+#include "atelier/atelier_vk_pipeline.h"
+
+#include <cstdio>
+#include <vector>
+using namespace Atelier;
+
+// The header every driver has to put at the front of its pipeline cache data
+struct PipelineCacheHeader {
+    uint32_t header_size;
+    uint32_t header_version;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint8_t uuid[VK_UUID_SIZE];
+};
+
+// Only feed old cache data back to the driver when it came from the same driver and device, some drivers don't
+// check this themselves very carefully
+static bool cache_matches_device(const MappedFile& file, const VkPhysicalDeviceProperties& props)
+{
+    if (file.m_size < sizeof(PipelineCacheHeader)) return false;
+    PipelineCacheHeader header;
+    memcpy(&header, file.m_data, sizeof(header));
+    return header.header_size >= sizeof(PipelineCacheHeader) && header.vendor_id == props.vendorID &&
+           header.device_id == props.deviceID && memcmp(header.uuid, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+result VkPipelineManager::init(VkCompletedDevice& device, JobSystem& jobs, const char* cache_path)
+{
+    if (device.m_handle == VK_NULL_HANDLE) return -1;
+    m_parent = &device;
+    m_jobs = &jobs;
+    m_cache_path = cache_path != nullptr ? cache_path : "";
+
+    VkPipelineCacheCreateInfo info = {VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+    MappedFile previous;
+    if (!m_cache_path.empty() && previous.open(m_cache_path.c_str()) == k_success) {
+        if (cache_matches_device(previous, device.m_physical->m_device_properties)) {
+            info.pInitialData = previous.m_data;
+            info.initialDataSize = previous.m_size;
+        } else {
+            Log::warn("Pipeline cache %s is from a different device or driver, ignoring it", m_cache_path.c_str());
+        }
+    }
+
+    if (vkCreatePipelineCache(device.m_handle, &info, nullptr, &m_cache) != VK_SUCCESS) {
+        Log::error("Failed to create the pipeline cache");
+        return -2;
+    }
+    return k_success;
+}
+
+void VkPipelineManager::shutdown()
+{
+    if (m_parent == nullptr) return;
+
+    // The compile jobs reference the slots and the cache, so they all have to land before we tear down
+    m_jobs->wait_idle();
+    save_cache();
+
+    VkDevice device = m_parent->m_handle;
+    for (auto& slot : m_slots) {
+        VkPipeline pipeline = slot.m_handle.exchange(VK_NULL_HANDLE);
+        if (pipeline != VK_NULL_HANDLE) vkDestroyPipeline(device, pipeline, nullptr);
+    }
+    m_slots.clear();
+    m_lookup.clear();
+
+    vkDestroyPipelineCache(device, m_cache, nullptr);
+    m_cache = VK_NULL_HANDLE;
+    m_parent = nullptr;
+    m_jobs = nullptr;
+}
+
+VkPipelineManager::Handle VkPipelineManager::request(const VkMutableGraphicsPipelineCreateInfo& info)
+{
+    Handle handle;
+    if (m_parent == nullptr) return handle;
+
+    // Duplicate requests, from this thread or any other, just get the slot of the first request. The hash only
+    // narrows it down, the state itself has to match too
+    uint64_t hash = info.hash();
+    Slot* slot = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        auto [first, last] = m_lookup.equal_range(hash);
+        for (auto it = first; it != last; ++it) {
+            if (it->second->m_info.same_state(info)) {
+                handle.m_slot = it->second;
+                return handle;
+            }
+        }
+        slot = &m_slots.emplace_back();
+        slot->m_hash = hash;
+        slot->m_info = info;
+        m_lookup.emplace(hash, slot);
+    }
+    handle.m_slot = slot;
+
+    // The job compiles from the slot's own copy of the info, the caller is free to reuse theirs
+    m_in_flight.fetch_add(1);
+    VkDevice device = m_parent->m_handle;
+    VkPipelineCache cache = m_cache;
+    m_jobs->push([this, slot, device, cache]() {
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        if (slot->m_info.create_pipeline(pipeline, device, cache) == k_success) {
+            slot->m_handle.store(pipeline, std::memory_order_release);
+            slot->m_state.store(State::k_ready, std::memory_order_release);
+        } else {
+            Log::error("Failed to compile pipeline %016llx", (unsigned long long)slot->m_hash);
+            slot->m_state.store(State::k_failed, std::memory_order_release);
+        }
+        m_in_flight.fetch_sub(1);
+    });
+
+    return handle;
+}
+
+result VkPipelineManager::save_cache()
+{
+    if (m_cache == VK_NULL_HANDLE || m_cache_path.empty()) return k_success;
+
+    VkDevice device = m_parent->m_handle;
+    size_t size = 0;
+    if (vkGetPipelineCacheData(device, m_cache, &size, nullptr) != VK_SUCCESS) return -1;
+    std::vector<uint8_t> data(size);
+    if (vkGetPipelineCacheData(device, m_cache, &size, data.data()) != VK_SUCCESS) return -2;
+
+    FILE* file = fopen(m_cache_path.c_str(), "wb");
+    if (file == nullptr) {
+        Log::warn("Failed to open %s to write the pipeline cache", m_cache_path.c_str());
+        return -3;
+    }
+    bool ok = fwrite(data.data(), 1, size, file) == size;
+    fclose(file);
+    return ok ? k_success : -4;
+}
@@ -0,0 +1,304 @@
+#include "atelier/atelier_vk_present.h"
+#include "atelier/atelier_vk_submit.h"
+using namespace Atelier;
+
+result VkMultiPresenter::init(VkCompletedDevice& device, uint32_t graphics_family, VkQueue graphics_queue,
+                              VkQueue present_queue, uint32_t frames_in_flight)
+{
+    if (frames_in_flight == 0 || frames_in_flight > k_max_frames_in_flight) return -1;
+    m_parent = &device;
+    m_graphics_queue = graphics_queue;
+    m_present_queue = present_queue;
+    m_frames_in_flight = frames_in_flight;
+
+    // Fences start signaled so the first wait on each frame falls straight through
+    VkCommandPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    pool_info.queueFamilyIndex = graphics_family;
+    VkFenceCreateInfo fence_info = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    VkSemaphoreCreateInfo semaphore_info = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    for (uint32_t i = 0; i < frames_in_flight; i++) {
+        Frame& frame = m_frames[i];
+        if (vkCreateCommandPool(device.m_handle, &pool_info, nullptr, &frame.m_pool) != VK_SUCCESS ||
+            vkCreateFence(device.m_handle, &fence_info, nullptr, &frame.m_fence) != VK_SUCCESS ||
+            vkCreateSemaphore(device.m_handle, &semaphore_info, nullptr, &frame.m_rendered) != VK_SUCCESS) {
+            Log::error("Failed to create the presenter's frame resources");
+            shutdown();
+            return -2;
+        }
+    }
+
+    // Frame timing is optional, a family without timestamp bits just never reports a GPU time
+    auto family = device.m_queues.find(graphics_family);
+    float period = device.m_physical->m_device_properties.limits.timestampPeriod;
+    if (family != device.m_queues.end() && family->second.props.timestampValidBits > 0 && period > 0.0f) {
+        VkQueryPoolCreateInfo query_info = {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+        query_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        query_info.queryCount = 2 * frames_in_flight;
+        if (vkCreateQueryPool(device.m_handle, &query_info, nullptr, &m_timestamps) == VK_SUCCESS) {
+            m_timestamp_period = period;
+        }
+    }
+
+    // Static buffers go ahead of the targets' own, so the start timestamp gets a buffer of its own in front
+    VkCommandBufferAllocateInfo buffer_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    buffer_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    buffer_info.commandBufferCount = 1;
+    for (uint32_t i = 0; i < frames_in_flight && m_timestamps != VK_NULL_HANDLE; i++) {
+        buffer_info.commandPool = m_frames[i].m_pool;
+        if (vkAllocateCommandBuffers(device.m_handle, &buffer_info, &m_frames[i].m_prologue) != VK_SUCCESS) {
+            Log::error("Failed to allocate the presenter's timing command buffers");
+            shutdown();
+            return -3;
+        }
+    }
+    return k_success;
+}
+
+void VkMultiPresenter::shutdown()
+{
+    if (m_parent == nullptr) return;
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    VkDevice dev = m_parent->m_handle;
+    api.vkDeviceWaitIdle(dev);
+    while (!m_targets.empty()) remove_target(uint32_t(m_targets.size() - 1));
+
+    for (auto& frame : m_frames) {
+        if (frame.m_rendered != VK_NULL_HANDLE) vkDestroySemaphore(dev, frame.m_rendered, nullptr);
+        if (frame.m_fence != VK_NULL_HANDLE) vkDestroyFence(dev, frame.m_fence, nullptr);
+        if (frame.m_pool != VK_NULL_HANDLE) vkDestroyCommandPool(dev, frame.m_pool, nullptr);
+        frame = Frame();
+    }
+    if (m_timestamps != VK_NULL_HANDLE) vkDestroyQueryPool(dev, m_timestamps, nullptr);
+    m_timestamps = VK_NULL_HANDLE;
+    m_parent = nullptr;
+}
+
+int32_t VkMultiPresenter::add_target(VkCompletedSwapchain& swap)
+{
+    if (m_parent == nullptr || swap.m_handle == VK_NULL_HANDLE) return -1;
+    VkDevice dev = m_parent->m_handle;
+
+    Target target;
+    target.m_swap = &swap;
+    VkSemaphoreCreateInfo semaphore_info = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    VkCommandBufferAllocateInfo buffer_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    buffer_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    buffer_info.commandBufferCount = 1;
+    for (uint32_t i = 0; i < m_frames_in_flight; i++) {
+        buffer_info.commandPool = m_frames[i].m_pool;
+        if (vkCreateSemaphore(dev, &semaphore_info, nullptr, &target.m_acquired[i]) != VK_SUCCESS ||
+            vkAllocateCommandBuffers(dev, &buffer_info, &target.m_cmd[i]) != VK_SUCCESS) {
+            Log::error("Failed to create the resources for a present target");
+            m_targets.push_back(target);
+            remove_target(uint32_t(m_targets.size() - 1));
+            return -2;
+        }
+    }
+
+    m_targets.push_back(target);
+    return int32_t(m_targets.size() - 1);
+}
+
+void VkMultiPresenter::remove_target(uint32_t index)
+{
+    if (index >= m_targets.size()) return;
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    VkDevice dev = m_parent->m_handle;
+    api.vkDeviceWaitIdle(dev);
+
+    Target& target = m_targets[index];
+    for (uint32_t i = 0; i < m_frames_in_flight; i++) {
+        if (target.m_acquired[i] != VK_NULL_HANDLE) vkDestroySemaphore(dev, target.m_acquired[i], nullptr);
+        if (target.m_cmd[i] != VK_NULL_HANDLE) vkFreeCommandBuffers(dev, m_frames[i].m_pool, 1, &target.m_cmd[i]);
+    }
+    m_targets.erase(m_targets.begin() + index);
+}
+
+result VkMultiPresenter::begin_frame()
+{
+    if (m_parent == nullptr) return -1;
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    VkDevice dev = m_parent->m_handle;
+    Frame& frame = m_frames[m_frame];
+
+    // A failed submit leaves its fence unsignalled for good, so make sure the frame's call was made and went
+    // through before waiting on it
+    if (frame.m_pushed && m_submitter != nullptr) {
+        m_submitter->wait_submitted(frame.m_ticket);
+        frame.m_pushed = false;
+        if (m_submitter->error() != k_success) {
+            Log::error("The submission thread failed, frame fences will never signal");
+            return -3;
+        }
+    }
+
+    // The fence is only reset right before a submit, so a frame where nothing was acquired can't deadlock this
+    if (api.vkWaitForFences(dev, 1, &frame.m_fence, VK_TRUE, (uint64_t)-1) != VK_SUCCESS) {
+        Log::error("Failed waiting for a frame in flight");
+        return -2;
+    }
+    if (frame.m_serial > m_completed_serial) m_completed_serial = frame.m_serial;
+    api.vkResetCommandPool(dev, frame.m_pool, 0);
+    m_serial++;
+
+    // The fence covers the timestamps too, so the results are there without waiting
+    if (frame.m_timed) {
+        uint64_t stamps[2] = {};
+        if (api.vkGetQueryPoolResults(dev, m_timestamps, 2 * m_frame, 2, sizeof(stamps), stamps, sizeof(uint64_t),
+                                      VK_QUERY_RESULT_64_BIT) == VK_SUCCESS &&
+            stamps[1] >= stamps[0]) {
+            m_gpu_time_ns = uint64_t(double(stamps[1] - stamps[0]) * m_timestamp_period);
+            m_gpu_samples++;
+        }
+        frame.m_timed = false;
+    }
+
+    VkCommandBufferBeginInfo begin = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (frame.m_prologue != VK_NULL_HANDLE) {
+        api.vkBeginCommandBuffer(frame.m_prologue, &begin);
+        // The prologue shares a submit with the first target's wait for its image, and that wait holds back colour
+        // output. Stamping at that stage starts the clock once the image is ours, leaving out the vsync wait and
+        // whatever of the previous frame was still running
+        api.vkCmdResetQueryPool(frame.m_prologue, m_timestamps, 2 * m_frame, 2);
+        api.vkCmdWriteTimestamp(frame.m_prologue, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, m_timestamps,
+                                2 * m_frame);
+        api.vkEndCommandBuffer(frame.m_prologue);
+    }
+    for (auto& target : m_targets) {
+        VkResult res = api.vkAcquireNextImageKHR(dev, target.m_swap->m_handle, (uint64_t)-1,
+                                                 target.m_acquired[m_frame], VK_NULL_HANDLE,
+                                                 &target.m_image_index);
+
+        // Suboptimal still hands over an image and signals the semaphore, so it's drawn like any other
+        target.m_active = res == VK_SUCCESS || res == VK_SUBOPTIMAL_KHR;
+        target.m_static.clear();
+        if (!target.m_active) continue;
+        api.vkBeginCommandBuffer(target.m_cmd[m_frame], &begin);
+    }
+    return k_success;
+}
+
+result VkMultiPresenter::push_frame(const Frame& frame)
+{
+    // A wait only holds back the submit it's on, so every target's buffers go in the same descriptor as the wait
+    // for its image. Targets are packed into descriptors in order, and the signal and fence go on the last
+    VkSubmitQueue::Submit submit;
+    uint32_t start = 0;
+    for (size_t i = 0; i < m_submit_waits.size(); i++) {
+        uint32_t end = m_submit_ends[i];
+        if (end - start > VkSubmitQueue::Submit::k_max_cmds) return -1;
+        bool fits = submit.m_cmd_count + (end - start) <= VkSubmitQueue::Submit::k_max_cmds &&
+                    submit.m_wait_count < VkSubmitQueue::Submit::k_max_waits;
+        if (!fits) {
+            m_submit_ticket = m_submitter->push(submit);
+            submit = VkSubmitQueue::Submit();
+        }
+        submit.add_wait(m_submit_waits[i], VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+        for (uint32_t c = start; c < end; c++) submit.add_cmd(m_submit_cmds[c]);
+        start = end;
+    }
+    submit.add_signal(frame.m_rendered);
+    submit.m_fence = frame.m_fence;
+    m_submit_ticket = m_submitter->push(submit);
+    return k_success;
+}
+
+result VkMultiPresenter::end_frame()
+{
+    if (m_parent == nullptr) return -1;
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    Frame& frame = m_frames[m_frame];
+
+    m_submit_cmds.clear();
+    m_submit_waits.clear();
+    m_submit_ends.clear();
+    m_submit_stages.clear();
+    m_present_swaps.clear();
+    m_present_indices.clear();
+    VkCommandBuffer last = VK_NULL_HANDLE;
+    for (auto& target : m_targets) {
+        if (target.m_active) last = target.m_cmd[m_frame];
+    }
+    if (last != VK_NULL_HANDLE && m_timestamps != VK_NULL_HANDLE) {
+        api.vkCmdWriteTimestamp(last, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestamps, 2 * m_frame + 1);
+        m_submit_cmds.push_back(frame.m_prologue);
+        frame.m_timed = true;
+    }
+    for (auto& target : m_targets) {
+        if (!target.m_active) continue;
+        api.vkEndCommandBuffer(target.m_cmd[m_frame]);
+        m_submit_cmds.insert(m_submit_cmds.end(), target.m_static.begin(), target.m_static.end());
+        m_submit_cmds.push_back(target.m_cmd[m_frame]);
+        m_submit_waits.push_back(target.m_acquired[m_frame]);
+        m_submit_ends.push_back(uint32_t(m_submit_cmds.size()));
+        m_submit_stages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        m_present_swaps.push_back(target.m_swap->m_handle);
+        m_present_indices.push_back(target.m_image_index);
+    }
+    uint32_t frame_index = m_frame;
+    m_frame = (m_frame + 1) % m_frames_in_flight;
+    if (m_submit_cmds.empty()) return k_success;
+
+    // Checked before the fence is reset, a frame that's never pushed has to leave it signalled
+    if (m_submitter != nullptr && m_submitter->error() != k_success) {
+        Log::error("Not pushing frame %u, the submission thread has already failed", frame_index);
+        return -2;
+    }
+    api.vkResetFences(m_parent->m_handle, 1, &frame.m_fence);
+    if (m_submitter != nullptr) {
+        if (push_frame(frame) != k_success) {
+            Log::error("Failed to push frame %u, a window has more command buffers than a submit holds",
+                       frame_index);
+            return -2;
+        }
+        frame.m_ticket = m_submit_ticket;
+        frame.m_pushed = true;
+    } else {
+        VkSubmitInfo submit = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        submit.pCommandBuffers = m_submit_cmds.data();
+        submit.commandBufferCount = uint32_t(m_submit_cmds.size());
+        submit.pWaitSemaphores = m_submit_waits.data();
+        submit.pWaitDstStageMask = m_submit_stages.data();
+        submit.waitSemaphoreCount = uint32_t(m_submit_waits.size());
+        submit.pSignalSemaphores = &frame.m_rendered;
+        submit.signalSemaphoreCount = 1;
+        if (api.vkQueueSubmit(m_graphics_queue, 1, &submit, frame.m_fence) != VK_SUCCESS) {
+            Log::error("Failed to submit frame %u", frame_index);
+            return -2;
+        }
+    }
+    frame.m_serial = m_serial;
+
+    // One present for every swapchain, each one's own result comes back through pResults
+    m_present_results.assign(m_present_swaps.size(), VK_SUCCESS);
+    VkPresentInfoKHR present = {VK_STRUCTURE_TYPE_PRESENT_INFO_KHR};
+    present.pSwapchains = m_present_swaps.data();
+    present.pImageIndices = m_present_indices.data();
+    present.swapchainCount = uint32_t(m_present_swaps.size());
+    present.pResults = m_present_results.data();
+    present.pWaitSemaphores = &frame.m_rendered;
+    present.waitSemaphoreCount = 1;
+    VkResult res = VK_SUCCESS;
+    if (m_submitter != nullptr && m_present_queue == m_submitter->m_queue) {
+        m_submitter->with_queue([&](VkQueue queue) { res = api.vkQueuePresentKHR(queue, &present); });
+    } else {
+        // The present waits on a binary semaphore, so its signal has to be on the queue first
+        if (m_submitter != nullptr) m_submitter->wait_submitted(m_submit_ticket);
+        res = api.vkQueuePresentKHR(m_present_queue, &present);
+    }
+
+    uint32_t presented = 0;
+    for (auto& target : m_targets) {
+        if (target.m_active) target.m_last_present = m_present_results[presented++];
+    }
+
+    // Out of date and lost surfaces are per window problems, the caller sees them on the target
+    if (res < 0 && res != VK_ERROR_OUT_OF_DATE_KHR && res != VK_ERROR_SURFACE_LOST_KHR) {
+        Log::error("Failed to present frame %u", frame_index);
+        return -3;
+    }
+    return k_success;
+}
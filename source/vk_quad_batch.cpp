@@ -0,0 +1,171 @@
+#include "atelier/atelier_vk_quad_batch.h"
+
+#include <algorithm>
+using namespace Atelier;
+
+static uint64_t batch_key(VkPipeline pipeline, VkDescriptorSet texture)
+{
+    return hash_combine((uint64_t)pipeline, (uint64_t)texture);
+}
+
+result VkQuadBatcher::init(VkCompletedDevice& device, uint32_t frames_in_flight, uint32_t max_quads_per_frame)
+{
+    if (frames_in_flight == 0 || max_quads_per_frame == 0) return -1;
+
+    // Host visible and coherent is required, device local on top is preferred so resizable BAR can be used
+    VkDeviceSize size = VkDeviceSize(frames_in_flight) * max_quads_per_frame * sizeof(QuadInstance);
+    if (m_ring.init(device, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != k_success) {
+        Log::error("Failed to create the quad instance ring");
+        return -2;
+    }
+
+    m_parent = &device;
+    m_frames_in_flight = frames_in_flight;
+    m_max_quads = max_quads_per_frame;
+    return k_success;
+}
+
+void VkQuadBatcher::shutdown()
+{
+    m_ring.shutdown();
+    m_batches.clear();
+    m_order.clear();
+    m_lookup.clear();
+    m_parent = nullptr;
+}
+
+void VkQuadBatcher::fill_pipeline_info(VkMutableGraphicsPipelineCreateInfo& info)
+{
+    info.vertex_bindings.clear();
+    info.vertex_attributes.clear();
+
+    VkVertexInputBindingDescription binding = {};
+    binding.binding = 0;
+    binding.stride = sizeof(QuadInstance);
+    binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    info.vertex_bindings.push_back(binding);
+
+    info.vertex_attributes.push_back({0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(QuadInstance, x)});
+    info.vertex_attributes.push_back({1, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(QuadInstance, u0)});
+    info.vertex_attributes.push_back({2, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(QuadInstance, color)});
+    info.vertex_attributes.push_back({3, 0, VK_FORMAT_R32_SFLOAT, offsetof(QuadInstance, rotation)});
+
+    info.input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    for (auto& blend : info.blend_attachments) {
+        blend.blendEnable = VK_TRUE;
+        blend.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        blend.colorBlendOp = VK_BLEND_OP_ADD;
+        blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        blend.alphaBlendOp = VK_BLEND_OP_ADD;
+    }
+}
+
+void VkQuadBatcher::begin_frame(uint32_t frame_index)
+{
+    m_frame = frame_index % m_frames_in_flight;
+    bool trimmed = false;
+    for (size_t i = 0; i < m_batches.size();) {
+        Batch& batch = m_batches[i];
+        batch.m_idle_frames = batch.m_quads.empty() ? batch.m_idle_frames + 1 : 0;
+        batch.m_quads.clear();
+        if (batch.m_idle_frames <= k_max_idle_frames) {
+            i++;
+            continue;
+        }
+        std::swap(batch, m_batches.back());
+        m_batches.pop_back();
+        trimmed = true;
+    }
+    if (trimmed) {
+        m_lookup.clear();
+        for (uint32_t i = 0; i < m_batches.size(); i++) {
+            m_lookup.emplace(batch_key(m_batches[i].m_pipeline, m_batches[i].m_texture), i);
+        }
+        m_last_batch = 0;
+    }
+    m_quad_count = 0;
+    m_dropped = 0;
+}
+
+void VkQuadBatcher::select_batch(VkPipeline pipeline, VkDescriptorSet texture)
+{
+    uint64_t key = batch_key(pipeline, texture);
+    auto [first, last] = m_lookup.equal_range(key);
+    for (auto it = first; it != last; ++it) {
+        const Batch& batch = m_batches[it->second];
+        if (batch.m_pipeline == pipeline && batch.m_texture == texture) {
+            m_last_batch = it->second;
+            return;
+        }
+    }
+
+    m_last_batch = static_cast<uint32_t>(m_batches.size());
+    m_lookup.emplace(key, m_last_batch);
+    auto& batch = m_batches.emplace_back();
+    batch.m_pipeline = pipeline;
+    batch.m_texture = texture;
+}
+
+void VkQuadBatcher::record(VkCommandBuffer cmd, VkPipelineLayout layout, uint32_t texture_set, VkExtent2D target)
+{
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    if (m_dropped != 0) Log::warn("Quad batcher dropped %u quads over the per frame limit", m_dropped);
+
+    // Sorting only touches the small list of batches, never the quads themselves
+    m_order.clear();
+    for (uint32_t i = 0; i < m_batches.size(); i++) {
+        if (!m_batches[i].m_quads.empty()) m_order.push_back(i);
+    }
+    std::sort(m_order.begin(), m_order.end(), [this](uint32_t a, uint32_t b) {
+        const Batch& x = m_batches[a];
+        const Batch& y = m_batches[b];
+        if (x.m_pipeline != y.m_pipeline) return (uint64_t)x.m_pipeline < (uint64_t)y.m_pipeline;
+        return (uint64_t)x.m_texture < (uint64_t)y.m_texture;
+    });
+
+    m_last_draws = 0;
+    m_last_quads = m_quad_count;
+    if (m_order.empty()) return;
+
+    // Bind the region of the ring which belongs to this frame, each batch then picks its slice via firstInstance
+    VkDeviceSize region = VkDeviceSize(m_frame) * m_max_quads * sizeof(QuadInstance);
+    auto* dst = reinterpret_cast<QuadInstance*>(static_cast<uint8_t*>(m_ring.m_mapped) + region);
+    api.vkCmdBindVertexBuffers(cmd, 0, 1, &m_ring.m_handle, &region);
+
+    float transform[4] = {2.0f / float(target.width), 2.0f / float(target.height), -1.0f, -1.0f};
+    api.vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(transform), transform);
+
+    VkViewport viewport = {0.0f, 0.0f, float(target.width), float(target.height), 0.0f, 1.0f};
+    VkRect2D scissor = {{0, 0}, target};
+    api.vkCmdSetViewport(cmd, 0, 1, &viewport);
+    api.vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+    VkPipeline bound_pipeline = VK_NULL_HANDLE;
+    VkDescriptorSet bound_texture = VK_NULL_HANDLE;
+    uint32_t first = 0;
+    for (uint32_t i : m_order) {
+        const Batch& batch = m_batches[i];
+        uint32_t count = static_cast<uint32_t>(batch.m_quads.size());
+
+        // The ring is likely write combined, so the copies go out strictly in order and nothing is read back
+        memcpy(dst + first, batch.m_quads.data(), count * sizeof(QuadInstance));
+
+        if (batch.m_pipeline != bound_pipeline) {
+            api.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.m_pipeline);
+            bound_pipeline = batch.m_pipeline;
+        }
+        if (batch.m_texture != bound_texture && batch.m_texture != VK_NULL_HANDLE) {
+            api.vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, texture_set, 1,
+                                        &batch.m_texture, 0, nullptr);
+            bound_texture = batch.m_texture;
+        }
+        api.vkCmdDraw(cmd, 6, count, 0, first);
+        first += count;
+        m_last_draws++;
+    }
+    m_ring.flush(region, VkDeviceSize(first) * sizeof(QuadInstance));
+}
@@ -0,0 +1,327 @@
+#include "atelier/atelier_vk_reactor.h"
+#include "atelier/atelier_vk_submit.h"
+
+#include <algorithm>
+#include <cstring>
+using namespace Atelier;
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool FenceAwait::await_ready()
+{
+    m_result = m_device->m_dispatch.vkGetFenceStatus(m_device->m_handle, m_fence);
+    return m_result != VK_NOT_READY;
+}
+
+void FenceAwait::await_suspend(std::coroutine_handle<> handle)
+{
+    m_reactor->m_fences.push_back({this, handle});
+}
+
+bool TimelineAwait::await_ready()
+{
+    const VkDeviceDispatch& api = m_device->m_dispatch;
+    if (!api.vkGetSemaphoreCounterValueKHR) {
+        Log::error("Timeline semaphores aren't enabled on this device");
+        m_result = VK_ERROR_FEATURE_NOT_PRESENT;
+        return true;
+    }
+    uint64_t counter = 0;
+    m_result = api.vkGetSemaphoreCounterValueKHR(m_device->m_handle, m_semaphore, &counter);
+    if (m_result == VK_SUCCESS && counter < m_value) m_result = VK_NOT_READY;
+    return m_result != VK_NOT_READY;
+}
+
+void TimelineAwait::await_suspend(std::coroutine_handle<> handle)
+{
+    m_reactor->m_timelines.push_back({this, handle});
+}
+
+void FrameAwait::await_suspend(std::coroutine_handle<> handle)
+{
+    m_reactor->m_next_frame.push_back(handle);
+}
+
+void JobAwait<void>::await_suspend(std::coroutine_handle<> handle)
+{
+    m_reactor->m_jobs_in_flight.fetch_add(1, std::memory_order_relaxed);
+    m_jobs->push([this, handle]() {
+        m_fn();
+        m_reactor->finish_job(handle);
+    });
+}
+
+void Reactor::spawn(Task<void> task)
+{
+    if (!task.valid()) return;
+    std::coroutine_handle<> handle = task.m_handle;
+    m_tasks.push_back(std::move(task));
+    handle.resume();
+}
+
+void Reactor::poll()
+{
+    m_polls++;
+    m_resuming.swap(m_next_frame);
+
+    // Waits are swapped out of the list as they finish, anything the resumed tasks wait on next lands at the end
+    // and is looked at from the next poll
+    for (size_t i = 0; i < m_fences.size();) {
+        FenceAwait& await = *m_fences[i].m_await;
+        VkResult status = await.m_device->m_dispatch.vkGetFenceStatus(await.m_device->m_handle, await.m_fence);
+        if (status == VK_NOT_READY) {
+            i++;
+            continue;
+        }
+        await.m_result = status;
+        m_resuming.push_back(m_fences[i].m_handle);
+        m_fences[i] = m_fences.back();
+        m_fences.pop_back();
+    }
+
+    m_counters.clear();
+    for (size_t i = 0; i < m_timelines.size();) {
+        TimelineAwait& await = *m_timelines[i].m_await;
+        auto known = std::find_if(m_counters.begin(), m_counters.end(),
+                                  [&](const auto& counter) { return counter.first == await.m_semaphore; });
+        VkResult status = VK_SUCCESS;
+        if (known == m_counters.end()) {
+            uint64_t value = 0;
+            status = await.m_device->m_dispatch.vkGetSemaphoreCounterValueKHR(await.m_device->m_handle,
+                                                                              await.m_semaphore, &value);
+            if (status == VK_SUCCESS) known = m_counters.insert(m_counters.end(), {await.m_semaphore, value});
+        }
+        if (status == VK_SUCCESS && known->second < await.m_value) {
+            i++;
+            continue;
+        }
+        await.m_result = status;
+        m_resuming.push_back(m_timelines[i].m_handle);
+        m_timelines[i] = m_timelines.back();
+        m_timelines.pop_back();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_resuming.insert(m_resuming.end(), m_ready.begin(), m_ready.end());
+        m_ready.clear();
+    }
+
+    for (std::coroutine_handle<> handle : m_resuming) handle.resume();
+    m_resumed += m_resuming.size();
+    m_resuming.clear();
+
+    auto finished = [](const Task<void>& task) { return task.done(); };
+    m_tasks.erase(std::remove_if(m_tasks.begin(), m_tasks.end(), finished), m_tasks.end());
+}
+
+void Reactor::shutdown()
+{
+    // A running job still points into its task's frame
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_jobs_done.wait(lock, [this]() { return m_jobs_in_flight.load(std::memory_order_acquire) == 0; });
+    }
+    m_fences.clear();
+    m_timelines.clear();
+    m_next_frame.clear();
+    m_ready.clear();
+    m_tasks.clear();
+}
+
+void Reactor::schedule(std::coroutine_handle<> handle)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_ready.push_back(handle);
+}
+
+void Reactor::finish_job(std::coroutine_handle<> handle)
+{
+    // Notified under the lock, once it's released shutdown may return and the reactor go away
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_ready.push_back(handle);
+    if (m_jobs_in_flight.fetch_sub(1, std::memory_order_release) == 1) m_jobs_done.notify_all();
+}
+
+void Reactor::fail_fence(VkFence fence, VkResult error)
+{
+    for (size_t i = 0; i < m_fences.size();) {
+        if (m_fences[i].m_await->m_fence != fence) {
+            i++;
+            continue;
+        }
+        m_fences[i].m_await->m_result = error;
+        m_next_frame.push_back(m_fences[i].m_handle);
+        m_fences[i] = m_fences.back();
+        m_fences.pop_back();
+    }
+}
+
+JobAwait<FileRead> Reactor::read_file(JobSystem& jobs, const char* path)
+{
+    return run(jobs, [path = std::string(path)]() {
+        FileRead read;
+        read.m_result = read.m_file.open(path.c_str());
+        if (read.m_result != k_success) {
+            Log::error("Failed to open %s", path.c_str());
+            return read;
+        }
+
+        // The mapping is lazy, so fault every page in here rather than on the render thread
+        volatile uint8_t sink = 0;
+        for (size_t i = 0; i < read.m_file.m_size; i += 4096) sink = sink + read.m_file.m_data[i];
+        return read;
+    });
+}
+
+result VkAsyncUploader::init(VkCompletedDevice& device, Reactor& reactor, uint32_t family, VkQueue queue)
+{
+    if (queue == VK_NULL_HANDLE) return -1;
+    m_parent = &device;
+    m_reactor = &reactor;
+    m_queue = queue;
+
+    VkCommandPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex = family;
+    if (vkCreateCommandPool(device.m_handle, &pool_info, nullptr, &m_pool) != VK_SUCCESS) {
+        Log::error("Failed to create the async upload command pool");
+        shutdown();
+        return -2;
+    }
+    return k_success;
+}
+
+void VkAsyncUploader::shutdown()
+{
+    if (m_parent == nullptr) return;
+    VkDevice dev = m_parent->m_handle;
+    for (auto& batch : m_batches) {
+        batch.m_staging.shutdown();
+        if (batch.m_fence != VK_NULL_HANDLE) vkDestroyFence(dev, batch.m_fence, nullptr);
+    }
+    m_batches.clear();
+    m_open = nullptr;
+    if (m_pool != VK_NULL_HANDLE) vkDestroyCommandPool(dev, m_pool, nullptr);
+    m_pool = VK_NULL_HANDLE;
+    m_parent = nullptr;
+}
+
+Task<result> VkAsyncUploader::upload(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size)
+{
+    Batch* batch = open_batch(size);
+    if (batch == nullptr) co_return -1;
+
+    memcpy(static_cast<uint8_t*>(batch->m_staging.m_mapped) + batch->m_used, data, size_t(size));
+    VkBufferCopy region = {batch->m_used, offset, size};
+    m_parent->m_dispatch.vkCmdCopyBuffer(batch->m_cmd, batch->m_staging.m_handle, buffer, 1, &region);
+    batch->m_used += align_up(size, 16);
+    batch->m_waiters++;
+    m_uploads++;
+    m_uploaded_bytes += size;
+
+    result res = co_await m_reactor->fence(*m_parent, batch->m_fence);
+    batch->m_waiters--;
+    co_return res;
+}
+
+result VkAsyncUploader::flush()
+{
+    if (m_open == nullptr) return k_success;
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    Batch* batch = m_open;
+    m_open = nullptr;
+    batch->m_recording = false;
+    batch->m_submitted = true;
+
+    // Tasks only carry on once the fence has signalled, so anything they submit next already follows the copy
+    api.vkEndCommandBuffer(batch->m_cmd);
+    m_submits++;
+    if (m_submitter != nullptr) {
+        // Once a call on the submission thread has failed its fences never signal, so every batch still waited
+        // on resumes its tasks with the error rather than leaving them parked on the reactor
+        if (m_submitter->error() != k_success) {
+            Log::error("Failed to submit %u async uploads, the submission thread has failed", batch->m_waiters);
+            for (auto& b : m_batches) {
+                if (b.m_submitted && b.m_waiters != 0 &&
+                    api.vkGetFenceStatus(m_parent->m_handle, b.m_fence) != VK_SUCCESS) {
+                    m_reactor->fail_fence(b.m_fence, m_submitter->m_last_error.load());
+                    b.m_submitted = false;
+                }
+            }
+            m_reactor->fail_fence(batch->m_fence, m_submitter->m_last_error.load());
+            batch->m_submitted = false;
+            return -1;
+        }
+        VkSubmitQueue::Submit submit;
+        submit.add_cmd(batch->m_cmd);
+        submit.m_fence = batch->m_fence;
+        m_submitter->push(submit);
+        return k_success;
+    }
+    VkSubmitInfo submit = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submit.commandBufferCount = 1;
+    submit.pCommandBuffers = &batch->m_cmd;
+    VkResult res = api.vkQueueSubmit(m_queue, 1, &submit, batch->m_fence);
+    if (res != VK_SUCCESS) {
+        // The fence will never signal, so the uploads' tasks are resumed with the error instead. The batch can be
+        // reused once they have been, its fence was never submitted
+        Log::error("Failed to submit %u async uploads", batch->m_waiters);
+        batch->m_submitted = false;
+        m_reactor->fail_fence(batch->m_fence, res);
+        return -1;
+    }
+    return k_success;
+}
+
+VkAsyncUploader::Batch* VkAsyncUploader::open_batch(VkDeviceSize size)
+{
+    if (m_open != nullptr && m_open->m_used + size <= m_open->m_staging.m_size) return m_open;
+    flush();
+
+    // The fence is reset as the batch is reopened rather than when it's submitted, a task checking it before then
+    // must not see the signal left over from the last use
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    VkDevice dev = m_parent->m_handle;
+    VkDeviceSize needed = std::max(m_batch_bytes, align_up(size, 16));
+    Batch* batch = nullptr;
+    for (auto& b : m_batches) {
+        if (b.m_recording || b.m_waiters != 0 || b.m_staging.m_size < needed) continue;
+        if (b.m_submitted && api.vkGetFenceStatus(dev, b.m_fence) != VK_SUCCESS) continue;
+        batch = &b;
+        break;
+    }
+    if (batch == nullptr) {
+        batch = &m_batches.emplace_back();
+        VkCommandBufferAllocateInfo cmd_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        cmd_info.commandPool = m_pool;
+        cmd_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        cmd_info.commandBufferCount = 1;
+        VkFenceCreateInfo fence_info = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+        if (vkAllocateCommandBuffers(dev, &cmd_info, &batch->m_cmd) != VK_SUCCESS ||
+            vkCreateFence(dev, &fence_info, nullptr, &batch->m_fence) != VK_SUCCESS ||
+            batch->m_staging.init(*m_parent, needed, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) !=
+              k_success) {
+            Log::error("Failed to create an async upload batch of %llu bytes", (unsigned long long)needed);
+            batch->m_staging.shutdown();
+            if (batch->m_fence != VK_NULL_HANDLE) vkDestroyFence(dev, batch->m_fence, nullptr);
+            m_batches.pop_back();
+            return nullptr;
+        }
+    } else if (batch->m_submitted) {
+        api.vkResetFences(dev, 1, &batch->m_fence);
+    }
+
+    VkCommandBufferBeginInfo begin = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    api.vkBeginCommandBuffer(batch->m_cmd, &begin);
+    batch->m_used = 0;
+    batch->m_recording = true;
+    batch->m_submitted = false;
+    m_open = batch;
+    return batch;
+}
@@ -0,0 +1,200 @@
+#include "atelier/atelier_vk_recorder.h"
+
+#include <algorithm>
+#include <cstring>
+using namespace Atelier;
+
+void VkStateRecorder::begin(const VkDeviceDispatch& api, VkCommandBuffer cmd)
+{
+    m_api = &api;
+    m_cmd = cmd;
+    invalidate();
+}
+
+void VkStateRecorder::invalidate()
+{
+    m_pipeline = VK_NULL_HANDLE;
+    m_layout = VK_NULL_HANDLE;
+    memset(m_sets, 0, sizeof(m_sets));
+    memset(m_vertex_buffers, 0, sizeof(m_vertex_buffers));
+    m_index_buffer = VK_NULL_HANDLE;
+    m_has_viewport = false;
+    m_has_scissor = false;
+    memset(m_push_known, 0, sizeof(m_push_known));
+}
+
+void VkStateRecorder::bind_pipeline(VkPipeline pipeline)
+{
+    if (pipeline == m_pipeline) {
+        m_counters.m_filtered++;
+        return;
+    }
+    m_api->vkCmdBindPipeline(m_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    m_pipeline = pipeline;
+    m_counters.m_emitted++;
+}
+
+void VkStateRecorder::bind_descriptor_sets(VkPipelineLayout layout, uint32_t first, uint32_t count,
+                                           const VkDescriptorSet* sets, uint32_t dynamic_count,
+                                           const uint32_t* dynamic_offsets)
+{
+    // Whether sets bound under another layout survive depends on how compatible the two are, which we can't see
+    // from here, so a new layout starts from nothing
+    if (layout != m_layout) {
+        memset(m_sets, 0, sizeof(m_sets));
+        memset(m_push_known, 0, sizeof(m_push_known));
+        m_layout = layout;
+    }
+
+    uint32_t begin = 0, end = count;
+    if (dynamic_count == 0 && first + count <= k_max_sets) {
+        while (begin < end && m_sets[first + begin] == sets[begin]) begin++;
+        while (end > begin && m_sets[first + end - 1] == sets[end - 1]) end--;
+        if (begin == end) {
+            m_counters.m_filtered++;
+            return;
+        }
+    }
+    m_api->vkCmdBindDescriptorSets(m_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, first + begin, end - begin,
+                                   sets + begin, dynamic_count, dynamic_offsets);
+    for (uint32_t i = begin; i < end && first + i < k_max_sets; i++) {
+        m_sets[first + i] = dynamic_count == 0 ? sets[i] : VK_NULL_HANDLE;
+    }
+    m_counters.m_emitted++;
+}
+
+void VkStateRecorder::bind_vertex_buffers(uint32_t first, uint32_t count, const VkBuffer* buffers,
+                                          const VkDeviceSize* offsets)
+{
+    uint32_t begin = 0, end = count;
+    if (first + count <= k_max_vertex_bindings) {
+        auto same = [&](uint32_t i) {
+            return m_vertex_buffers[first + i] == buffers[i] && m_vertex_offsets[first + i] == offsets[i];
+        };
+        while (begin < end && same(begin)) begin++;
+        while (end > begin && same(end - 1)) end--;
+        if (begin == end) {
+            m_counters.m_filtered++;
+            return;
+        }
+    }
+    m_api->vkCmdBindVertexBuffers(m_cmd, first + begin, end - begin, buffers + begin, offsets + begin);
+    for (uint32_t i = begin; i < end && first + i < k_max_vertex_bindings; i++) {
+        m_vertex_buffers[first + i] = buffers[i];
+        m_vertex_offsets[first + i] = offsets[i];
+    }
+    m_counters.m_emitted++;
+}
+
+void VkStateRecorder::bind_index_buffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType type)
+{
+    if (buffer == m_index_buffer && offset == m_index_offset && type == m_index_type) {
+        m_counters.m_filtered++;
+        return;
+    }
+    m_api->vkCmdBindIndexBuffer(m_cmd, buffer, offset, type);
+    m_index_buffer = buffer;
+    m_index_offset = offset;
+    m_index_type = type;
+    m_counters.m_emitted++;
+}
+
+void VkStateRecorder::set_viewport(const VkViewport& viewport)
+{
+    if (m_has_viewport && memcmp(&viewport, &m_viewport, sizeof(VkViewport)) == 0) {
+        m_counters.m_filtered++;
+        return;
+    }
+    m_api->vkCmdSetViewport(m_cmd, 0, 1, &viewport);
+    m_viewport = viewport;
+    m_has_viewport = true;
+    m_counters.m_emitted++;
+}
+
+void VkStateRecorder::set_scissor(const VkRect2D& scissor)
+{
+    if (m_has_scissor && memcmp(&scissor, &m_scissor, sizeof(VkRect2D)) == 0) {
+        m_counters.m_filtered++;
+        return;
+    }
+    m_api->vkCmdSetScissor(m_cmd, 0, 1, &scissor);
+    m_scissor = scissor;
+    m_has_scissor = true;
+    m_counters.m_emitted++;
+}
+
+void VkStateRecorder::push_constants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset,
+                                     uint32_t size, const void* data)
+{
+    // Bytes are shadowed whatever stage they went to, a push only matches when every byte is already there
+    if (layout != m_layout) {
+        memset(m_sets, 0, sizeof(m_sets));
+        memset(m_push_known, 0, sizeof(m_push_known));
+        m_layout = layout;
+    }
+    bool shadowed = offset + size <= k_max_push_bytes;
+    if (shadowed && memcmp(m_push + offset, data, size) == 0 &&
+        std::all_of(m_push_known + offset, m_push_known + offset + size, [](uint8_t known) { return known; })) {
+        m_counters.m_filtered++;
+        return;
+    }
+    m_api->vkCmdPushConstants(m_cmd, layout, stages, offset, size, data);
+    if (shadowed) {
+        memcpy(m_push + offset, data, size);
+        memset(m_push_known + offset, 1, size);
+    }
+    m_counters.m_emitted++;
+}
+
+void VkStateRecorder::draw(uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex,
+                           uint32_t first_instance)
+{
+    m_api->vkCmdDraw(m_cmd, vertex_count, instance_count, first_vertex, first_instance);
+    m_counters.m_draws++;
+}
+
+void VkStateRecorder::draw_indexed(uint32_t index_count, uint32_t instance_count, uint32_t first_index,
+                                   int32_t vertex_offset, uint32_t first_instance)
+{
+    m_api->vkCmdDrawIndexed(m_cmd, index_count, instance_count, first_index, vertex_offset, first_instance);
+    m_counters.m_draws++;
+}
+
+uint64_t VkDrawList::sort_key(uint32_t pipeline, uint32_t material, float depth)
+{
+    const uint32_t depth_max = (1u << 24) - 1;
+    float clamped = std::min(std::max(depth, 0.0f), 1.0f);
+    uint64_t quantized = uint64_t(clamped * float(depth_max) + 0.5f);
+    return (uint64_t(pipeline & 0xffffu) << 48) | (uint64_t(material & 0xffffffu) << 24) |
+           std::min<uint64_t>(quantized, depth_max);
+}
+
+void VkDrawList::flush(VkStateRecorder& recorder)
+{
+    m_order.resize(m_draws.size());
+    for (uint32_t i = 0; i < m_draws.size(); i++) m_order[i] = {m_draws[i].m_key, i};
+    if (m_sort) {
+        std::sort(m_order.begin(), m_order.end(), [](const Order& a, const Order& b) {
+            return a.m_key != b.m_key ? a.m_key < b.m_key : a.m_index < b.m_index;
+        });
+    }
+
+    for (const Order& order : m_order) {
+        const Draw& draw = m_draws[order.m_index];
+        recorder.bind_pipeline(draw.m_pipeline);
+        if (draw.m_material != VK_NULL_HANDLE) {
+            recorder.bind_descriptor_set(draw.m_layout, m_material_set, draw.m_material);
+        }
+        if (draw.m_vertex_buffer != VK_NULL_HANDLE) {
+            recorder.bind_vertex_buffers(0, 1, &draw.m_vertex_buffer, &draw.m_vertex_offset);
+        }
+        if (draw.m_index_buffer != VK_NULL_HANDLE) {
+            recorder.bind_index_buffer(draw.m_index_buffer, draw.m_index_offset, draw.m_index_type);
+            recorder.draw_indexed(draw.m_count, draw.m_instance_count, draw.m_first, draw.m_base_vertex,
+                                  draw.m_first_instance);
+        } else {
+            recorder.draw(draw.m_count, draw.m_instance_count, draw.m_first, draw.m_first_instance);
+        }
+    }
+    m_draws.clear();
+}
@@ -0,0 +1,171 @@
+#include "atelier/atelier_vk_shader.h"
+using namespace Atelier;
+
+result VkShaderRegistry::init(VkCompletedDevice& device)
+{
+    if (device.m_handle == VK_NULL_HANDLE) return -1;
+    m_parent = &device;
+    return k_success;
+}
+
+void VkShaderRegistry::shutdown()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (m_parent != nullptr && m_parent->m_handle != VK_NULL_HANDLE) {
+        for (auto& module : m_modules) {
+            vkDestroyShaderModule(m_parent->m_handle, module.second.m_handle, nullptr);
+        }
+    }
+    m_modules.clear();
+    m_archives.clear();
+    m_parent = nullptr;
+}
+
+result VkShaderRegistry::mount_archive(const char* path)
+{
+    auto archive = std::make_unique<ShaderArchive>();
+    if (archive->open(path) != k_success) {
+        Log::error("Failed to mount shader archive %s", path);
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_archives.push_back(std::move(archive));
+    return k_success;
+}
+
+VkShaderRegistry::Lookup VkShaderRegistry::try_ref_locked(uint64_t hash, const uint32_t* code, size_t size,
+  VkShaderModule& out)
+{
+    auto it = m_modules.find(hash);
+    if (it == m_modules.end()) return Lookup::miss;
+    const auto& stored = it->second.m_code;
+    if (code != nullptr &&
+        (stored.size() * sizeof(uint32_t) != size || memcmp(stored.data(), code, size) != 0)) {
+        Log::error("Shader hash %016llx collides with a different live module", (unsigned long long)hash);
+        return Lookup::collision;
+    }
+    it->second.m_refs++;
+    out = it->second.m_handle;
+    return Lookup::hit;
+}
+
+result VkShaderRegistry::create_and_insert(uint64_t hash, const uint32_t* code, size_t size, VkShaderModule& out)
+{
+    // Module creation can be slow, so we don't hold the lock while the driver is parsing
+    VkShaderModuleCreateInfo info = {VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+    info.pCode = code;
+    info.codeSize = size;
+    VkShaderModule module = VK_NULL_HANDLE;
+    if (vkCreateShaderModule(m_parent->m_handle, &info, nullptr, &module) != VK_SUCCESS) {
+        Log::error("Failed to create shader module %016llx", (unsigned long long)hash);
+        return -1;
+    }
+
+    // Another thread might have beaten us to the same content, in that case use theirs and toss ours
+    std::lock_guard<std::mutex> guard(m_lock);
+    Lookup found = try_ref_locked(hash, code, size, out);
+    if (found != Lookup::miss) {
+        vkDestroyShaderModule(m_parent->m_handle, module, nullptr);
+        return found == Lookup::hit ? k_success : -2;
+    }
+    auto& entry = m_modules[hash];
+    entry.m_handle = module;
+    entry.m_refs = 1;
+    entry.m_code.assign(code, code + size / sizeof(uint32_t));
+    out = module;
+    return k_success;
+}
+
+result VkShaderRegistry::acquire(const uint32_t* code, size_t size, VkShaderModule& out, uint64_t* out_hash)
+{
+    if (m_parent == nullptr) return -1;
+    if (code == nullptr || size == 0 || (size % sizeof(uint32_t)) != 0) {
+        Log::error("SPIR-V must be a non empty array of words");
+        return -2;
+    }
+
+    uint64_t hash = hash_bytes(code, size);
+    if (out_hash != nullptr) *out_hash = hash;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        Lookup found = try_ref_locked(hash, code, size, out);
+        if (found == Lookup::hit) return k_success;
+        if (found == Lookup::collision) return -3;
+    }
+    return create_and_insert(hash, code, size, out) == k_success ? k_success : -3;
+}
+
+result VkShaderRegistry::acquire_file(const char* path, VkShaderModule& out, uint64_t* out_hash)
+{
+    // The mapping only needs to live until the driver has consumed the words
+    MappedFile file;
+    if (file.open(path) != k_success) return -1;
+    if (acquire(reinterpret_cast<const uint32_t*>(file.m_data), file.m_size, out, out_hash) != k_success) {
+        Log::error("Failed to acquire shader from file %s", path);
+        return -2;
+    }
+    return k_success;
+}
+
+result VkShaderRegistry::acquire_named(const char* name, VkShaderModule& out, uint64_t* out_hash)
+{
+    // Archives are only appended to, but take the lock so that mounting from another thread is safe
+    const ShaderArchive* archive = nullptr;
+    const ShaderArchive::Entry* entry = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        for (const auto& a : m_archives) {
+            entry = a->find(name);
+            if (entry != nullptr) {
+                archive = a.get();
+                break;
+            }
+        }
+        if (entry == nullptr) {
+            Log::error("Shader %s isn't in any mounted archive", name);
+            return -1;
+        }
+
+        // The archive already knows the hash, so a live module is found without hashing the blob again
+        if (out_hash != nullptr) *out_hash = entry->hash;
+        Lookup found = try_ref_locked(entry->hash, archive->code(*entry), entry->size, out);
+        if (found == Lookup::hit) return k_success;
+        if (found == Lookup::collision) return -2;
+    }
+    return create_and_insert(entry->hash, archive->code(*entry), entry->size, out) == k_success ? k_success : -2;
+}
+
+result VkShaderRegistry::acquire_hash(uint64_t hash, VkShaderModule& out)
+{
+    const ShaderArchive* archive = nullptr;
+    const ShaderArchive::Entry* entry = nullptr;
+    {
+        // Asking by hash means the caller has no words to compare, a live module is trusted as is
+        std::lock_guard<std::mutex> guard(m_lock);
+        if (try_ref_locked(hash, nullptr, 0, out) == Lookup::hit) return k_success;
+        for (const auto& a : m_archives) {
+            entry = a->find(hash);
+            if (entry != nullptr) {
+                archive = a.get();
+                break;
+            }
+        }
+    }
+    if (entry == nullptr) {
+        Log::error("Shader %016llx isn't loaded or in any mounted archive", (unsigned long long)hash);
+        return -1;
+    }
+    return create_and_insert(hash, archive->code(*entry), entry->size, out) == k_success ? k_success : -2;
+}
+
+void VkShaderRegistry::release(uint64_t hash)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    auto it = m_modules.find(hash);
+    if (it == m_modules.end()) return;
+    if (--it->second.m_refs > 0) return;
+
+    vkDestroyShaderModule(m_parent->m_handle, it->second.m_handle, nullptr);
+    m_modules.erase(it);
+}
@@ -0,0 +1,259 @@
+#include "atelier/atelier_vk_submit.h"
+using namespace Atelier;
+
+static_assert((VkSubmitQueue::k_capacity & (VkSubmitQueue::k_capacity - 1)) == 0,
+              "The ring's capacity must be a power of two");
+
+bool VkSubmitQueue::Submit::add_cmd(VkCommandBuffer cmd)
+{
+    if (m_cmd_count == k_max_cmds) return false;
+    m_cmds[m_cmd_count++] = cmd;
+    return true;
+}
+
+bool VkSubmitQueue::Submit::add_wait(VkSemaphore semaphore, VkPipelineStageFlags2 stages, uint64_t value)
+{
+    if (m_wait_count == k_max_waits) return false;
+    m_waits[m_wait_count] = semaphore;
+    m_wait_stages[m_wait_count] = stages;
+    m_wait_values[m_wait_count] = value;
+    m_wait_count++;
+    return true;
+}
+
+bool VkSubmitQueue::Submit::add_signal(VkSemaphore semaphore, uint64_t value)
+{
+    if (m_signal_count == k_max_signals) return false;
+    m_signals[m_signal_count] = semaphore;
+    m_signal_values[m_signal_count] = value;
+    m_signal_count++;
+    return true;
+}
+
+result VkSubmitQueue::init(VkCompletedDevice& device, VkQueue queue)
+{
+    if (device.m_handle == VK_NULL_HANDLE || queue == VK_NULL_HANDLE) return -1;
+    m_parent = &device;
+    m_queue = queue;
+
+    // Submit2 needs the feature enabled at device creation, which the default device does with the extension
+    m_submit2 = device.has_extension("VK_KHR_synchronization2") && device.m_dispatch.vkQueueSubmit2KHR;
+    if (!m_submit2) Log::info("synchronization2 unavailable, batching through vkQueueSubmit");
+
+    for (uint32_t i = 0; i < k_capacity; i++) m_cells[i].m_sequence.store(i, std::memory_order_relaxed);
+    m_head.store(0);
+    m_tail = 0;
+    m_submitted.store(0);
+    m_last_error.store(VK_SUCCESS);
+
+    // Reserved up front since the submit infos point into these
+    m_infos.reserve(k_max_batch);
+    m_semaphores.reserve(k_max_batch * (Submit::k_max_waits + Submit::k_max_signals));
+    m_buffers.reserve(k_max_batch * Submit::k_max_cmds);
+    m_legacy_infos.reserve(k_max_batch);
+    m_legacy_timelines.reserve(k_max_batch);
+    m_legacy_stages.reserve(k_max_batch * Submit::k_max_waits);
+
+    m_stopping.store(false);
+    m_thread = std::thread(&VkSubmitQueue::thread_main, this);
+    return k_success;
+}
+
+void VkSubmitQueue::shutdown()
+{
+    if (m_parent == nullptr) return;
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stopping.store(true);
+    }
+    m_wake.notify_one();
+    if (m_thread.joinable()) m_thread.join();
+    with_queue([&api](VkQueue queue) { api.vkQueueWaitIdle(queue); });
+    m_parent = nullptr;
+    m_queue = VK_NULL_HANDLE;
+}
+
+uint64_t VkSubmitQueue::push(const Submit& submit)
+{
+    // Bounded MPMC ring, used with a single consumer. A cell is free for ticket t when its sequence is t, and
+    // ready for the consumer once the producer moves it to t + 1
+    uint64_t ticket = m_head.load(std::memory_order_relaxed);
+    Cell* cell = nullptr;
+    for (;;) {
+        cell = &m_cells[ticket & (k_capacity - 1)];
+        uint64_t sequence = cell->m_sequence.load(std::memory_order_acquire);
+        int64_t diff = int64_t(sequence) - int64_t(ticket);
+        if (diff == 0) {
+            if (m_head.compare_exchange_weak(ticket, ticket + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            std::this_thread::yield();  // Full, the submission thread is a whole ring behind
+            ticket = m_head.load(std::memory_order_relaxed);
+        } else {
+            ticket = m_head.load(std::memory_order_relaxed);
+        }
+    }
+    cell->m_submit = submit;
+    cell->m_sequence.store(ticket + 1, std::memory_order_release);
+
+    // Pairs with the fence in thread_main, one of the two always sees the other
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_wake.notify_one();
+    }
+    return ticket;
+}
+
+void VkSubmitQueue::wait_submitted(uint64_t ticket)
+{
+    if (m_submitted.load(std::memory_order_acquire) > ticket) return;
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_progress.wait(lock, [this, ticket]() { return m_submitted.load(std::memory_order_acquire) > ticket; });
+}
+
+void VkSubmitQueue::with_queue(const std::function<void(VkQueue queue)>& fn)
+{
+    uint64_t head = m_head.load(std::memory_order_acquire);
+    if (head > 0 && m_thread.joinable()) wait_submitted(head - 1);
+    std::lock_guard<std::mutex> lock(m_queue_lock);
+    fn(m_queue);
+}
+
+void VkSubmitQueue::thread_main()
+{
+    for (;;) {
+        // Everything that's ready goes out together, up to the batch size
+        uint32_t ready = 0;
+        while (ready < k_max_batch) {
+            const Cell& cell = m_cells[(m_tail + ready) & (k_capacity - 1)];
+            if (cell.m_sequence.load(std::memory_order_acquire) != m_tail + ready + 1) break;
+            ready++;
+        }
+        if (ready > 0) {
+            submit_batch(ready);
+            for (uint32_t i = 0; i < ready; i++) {
+                m_cells[(m_tail + i) & (k_capacity - 1)].m_sequence.store(m_tail + i + k_capacity,
+                                                                           std::memory_order_release);
+            }
+            m_tail += ready;
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+                m_submitted.store(m_tail, std::memory_order_release);
+            }
+            m_progress.notify_all();
+            continue;
+        }
+
+        m_sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_wake.wait(lock, [this]() {
+            const Cell& cell = m_cells[m_tail & (k_capacity - 1)];
+            return m_stopping.load() || cell.m_sequence.load(std::memory_order_acquire) == m_tail + 1;
+        });
+        m_sleeping.store(false, std::memory_order_relaxed);
+        if (m_stopping.load() && m_cells[m_tail & (k_capacity - 1)].m_sequence.load() != m_tail + 1) return;
+    }
+}
+
+// Stages from synchronization2 that have no legacy bit fall back to waiting on everything
+static VkPipelineStageFlags legacy_stages(VkPipelineStageFlags2 stages)
+{
+    if (stages >> 32) return VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    return VkPipelineStageFlags(stages);
+}
+
+void VkSubmitQueue::submit_batch(uint32_t count)
+{
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    auto at = [this](uint32_t i) -> const Submit& { return m_cells[(m_tail + i) & (k_capacity - 1)].m_submit; };
+    std::lock_guard<std::mutex> lock(m_queue_lock);
+    uint32_t first = 0;
+    while (first < count) {
+        // A fence belongs to the whole call, so the call ends at the first descriptor carrying one
+        uint32_t last = first;
+        while (last + 1 < count && at(last).m_fence == VK_NULL_HANDLE) last++;
+        VkFence fence = at(last).m_fence;
+
+        VkResult res = VK_SUCCESS;
+        if (m_submit2) {
+            m_infos.clear();
+            m_semaphores.clear();
+            m_buffers.clear();
+            for (uint32_t i = first; i <= last; i++) {
+                const Submit& s = at(i);
+                VkSubmitInfo2 info = {VK_STRUCTURE_TYPE_SUBMIT_INFO_2};
+                info.pWaitSemaphoreInfos = m_semaphores.data() + m_semaphores.size();
+                info.waitSemaphoreInfoCount = s.m_wait_count;
+                for (uint32_t w = 0; w < s.m_wait_count; w++) {
+                    VkSemaphoreSubmitInfo wait = {VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO};
+                    wait.semaphore = s.m_waits[w];
+                    wait.value = s.m_wait_values[w];
+                    wait.stageMask = s.m_wait_stages[w];
+                    m_semaphores.push_back(wait);
+                }
+                info.pSignalSemaphoreInfos = m_semaphores.data() + m_semaphores.size();
+                info.signalSemaphoreInfoCount = s.m_signal_count;
+                for (uint32_t g = 0; g < s.m_signal_count; g++) {
+                    VkSemaphoreSubmitInfo signal = {VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO};
+                    signal.semaphore = s.m_signals[g];
+                    signal.value = s.m_signal_values[g];
+                    signal.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+                    m_semaphores.push_back(signal);
+                }
+                info.pCommandBufferInfos = m_buffers.data() + m_buffers.size();
+                info.commandBufferInfoCount = s.m_cmd_count;
+                for (uint32_t c = 0; c < s.m_cmd_count; c++) {
+                    VkCommandBufferSubmitInfo buffer = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO};
+                    buffer.commandBuffer = s.m_cmds[c];
+                    m_buffers.push_back(buffer);
+                }
+                m_infos.push_back(info);
+            }
+            res = api.vkQueueSubmit2KHR(m_queue, uint32_t(m_infos.size()), m_infos.data(), fence);
+        } else {
+            m_legacy_infos.clear();
+            m_legacy_timelines.clear();
+            m_legacy_stages.clear();
+            for (uint32_t i = first; i <= last; i++) {
+                const Submit& s = at(i);
+                VkSubmitInfo info = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+                info.pWaitSemaphores = s.m_waits;
+                info.pWaitDstStageMask = m_legacy_stages.data() + m_legacy_stages.size();
+                info.waitSemaphoreCount = s.m_wait_count;
+                for (uint32_t w = 0; w < s.m_wait_count; w++) {
+                    m_legacy_stages.push_back(legacy_stages(s.m_wait_stages[w]));
+                }
+                info.pCommandBuffers = s.m_cmds;
+                info.commandBufferCount = s.m_cmd_count;
+                info.pSignalSemaphores = s.m_signals;
+                info.signalSemaphoreCount = s.m_signal_count;
+
+                // Timeline values only need chaining when something in the descriptor uses them
+                bool timeline = false;
+                for (uint32_t w = 0; w < s.m_wait_count; w++) timeline = timeline || s.m_wait_values[w] != 0;
+                for (uint32_t g = 0; g < s.m_signal_count; g++) timeline = timeline || s.m_signal_values[g] != 0;
+                if (timeline) {
+                    VkTimelineSemaphoreSubmitInfo values = {VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+                    values.pWaitSemaphoreValues = s.m_wait_values;
+                    values.waitSemaphoreValueCount = s.m_wait_count;
+                    values.pSignalSemaphoreValues = s.m_signal_values;
+                    values.signalSemaphoreValueCount = s.m_signal_count;
+                    m_legacy_timelines.push_back(values);
+                    info.pNext = &m_legacy_timelines.back();
+                }
+                m_legacy_infos.push_back(info);
+            }
+            res = api.vkQueueSubmit(m_queue, uint32_t(m_legacy_infos.size()), m_legacy_infos.data(), fence);
+        }
+        if (res != VK_SUCCESS) {
+            Log::error("Failed to submit a batch of %u descriptors", last - first + 1);
+            VkResult none = VK_SUCCESS;
+            m_last_error.compare_exchange_strong(none, res, std::memory_order_release);
+        }
+        m_submits.fetch_add(last - first + 1, std::memory_order_relaxed);
+        m_calls.fetch_add(1, std::memory_order_relaxed);
+        first = last + 1;
+    }
+}
@@ -1,9 +1,25 @@
-
 #include <string>
-#include "atelier/atelier.h"
+#include "atelier/atelier_vk_completed.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
 #include "vulkan/vulkan_win32.h"
+#endif
 using namespace Atelier;
 
+// Swapchains have to go before the surface they were made from
+static void destroy_surface(VkCompletedState& vk, VkCompletedSurface& surf)
+{
+    for (auto& dev : vk.m_devices) {
+        for (auto& swap : dev.m_swaps)
+            if (swap.m_info.m_parent_surface == &surf) swap.shutdown(vk);
+    }
+
+    if (surf.m_handle != VK_NULL_HANDLE) vkDestroySurfaceKHR(surf.m_parent->m_handle, surf.m_handle, nullptr);
+    surf.m_handle = VK_NULL_HANDLE;
+}
+
+#ifdef _WIN32
 result VkCompletedWin32Surface::init_from_win32_handles(VkCompletedInstance& inst, void* win32_instance_handle,
                                                         void* win32_window_handle)
 {
@@ -24,16 +40,38 @@ result VkCompletedWin32Surface::init_from_win32_handles(VkCompletedInstance& ins
 
     return k_success;
 }
+#else
+result VkCompletedWin32Surface::init_from_win32_handles(VkCompletedInstance&, void*, void*)
+{
+    Log::error("Win32 surfaces are only available on Windows");
+    return -1;
+}
+#endif
 
 void VkCompletedWin32Surface::shutdown(VkCompletedState& vk)
 {
-    // Shutdown any derived surfaces
-    for (auto& dev : vk.m_devices) {
-        for (auto& swap : dev.m_swaps)
-            if (swap.m_info.m_parent_surface == this) swap.shutdown(vk);
+    // TODO inform the parent win32 object that the surface is being detached
+    destroy_surface(vk, *this);
+}
+
+result VkCompletedHeadlessSurface::init_headless(VkCompletedInstance& inst)
+{
+    auto create_headless =
+      (PFN_vkCreateHeadlessSurfaceEXT)vkGetInstanceProcAddr(inst.m_handle, "vkCreateHeadlessSurfaceEXT");
+    if (create_headless == nullptr) {
+        Log::error("Instance wasn't created with VK_EXT_headless_surface");
+        return -1;
     }
 
-    // TODO inform the parent win32 object that the surface is being detached
-    vkDestroySurfaceKHR(m_parent->m_handle, m_handle, nullptr);
-    m_handle = VK_NULL_HANDLE;
+    VkHeadlessSurfaceCreateInfoEXT surface_info = {VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT};
+    if (create_headless(inst.m_handle, &surface_info, nullptr, &m_handle) != VK_SUCCESS) {
+        Log::error("Failed to create a headless surface");
+        return -2;
+    }
+
+    m_parent = &inst;
+    m_type = VkCompletedSurface::Type::k_headless;
+    return k_success;
 }
+
+void VkCompletedHeadlessSurface::shutdown(VkCompletedState& vk) { destroy_surface(vk, *this); }
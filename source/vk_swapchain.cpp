@@ -1,12 +1,22 @@
 #include "atelier/atelier_vk_completed.h"
 #include "atelier/atelier_vk_mutable.h"
+
+#include <algorithm>
+#include <limits>
 using namespace Atelier;
 
 result VkCompletedSwapchain::CreateInfo::create_default_from_win32(VkCompletedDevice& device,
                                                                    VkCompletedWin32Surface& surf)
+{
+    return create_default(device, surf);
+}
+
+result VkCompletedSwapchain::CreateInfo::create_default(VkCompletedDevice& device, VkCompletedSurface& surf,
+                                                        VkExtent2D fallback_extent)
 {
     uint32_t count = 0;
     VkPhysicalDevice physical = device.m_physical->m_handle;
+    const VkInstanceDispatch& api = device.m_physical->m_parent->m_dispatch;
     memset(&m_info, 0, sizeof(VkSwapchainCreateInfoKHR));
     m_parent_device = &device;
     m_parent_surface = &surf;
@@ -20,13 +30,13 @@ result VkCompletedSwapchain::CreateInfo::create_default_from_win32(VkCompletedDe
     m_info.imageArrayLayers = 1;
 
     // Get the supported present modes
-    if (vkGetPhysicalDeviceSurfacePresentModesKHR(physical, surf.m_handle, &count, nullptr) != VK_SUCCESS) {
+    if (api.vkGetPhysicalDeviceSurfacePresentModesKHR(physical, surf.m_handle, &count, nullptr) != VK_SUCCESS) {
         Log::error("failed to get device surface present modes");
         return -1;
     }
     m_supported_present_modes.resize(count);
-    if (vkGetPhysicalDeviceSurfacePresentModesKHR(physical, surf.m_handle, &count,
-                                                  m_supported_present_modes.data()) != VK_SUCCESS) {
+    if (api.vkGetPhysicalDeviceSurfacePresentModesKHR(physical, surf.m_handle, &count,
+                                                      m_supported_present_modes.data()) != VK_SUCCESS) {
         Log::error("failed to get device surface present modes after counting");
         return -2;
     }
@@ -37,13 +47,13 @@ result VkCompletedSwapchain::CreateInfo::create_default_from_win32(VkCompletedDe
     if (fifo == m_supported_present_modes.end()) m_info.presentMode = m_supported_present_modes[0];
 
     // Next get the supported formats
-    if (vkGetPhysicalDeviceSurfaceFormatsKHR(physical, surf.m_handle, &count, nullptr) != VK_SUCCESS) {
+    if (api.vkGetPhysicalDeviceSurfaceFormatsKHR(physical, surf.m_handle, &count, nullptr) != VK_SUCCESS) {
         Log::error("Failed to get device surface formats");
         return -3;
     }
     m_supported_formats.resize(count);
-    if (vkGetPhysicalDeviceSurfaceFormatsKHR(physical, surf.m_handle, &count, m_supported_formats.data()) !=
-        VK_SUCCESS) {
+    if (api.vkGetPhysicalDeviceSurfaceFormatsKHR(physical, surf.m_handle, &count,
+                                                 m_supported_formats.data()) != VK_SUCCESS) {
         Log::error("Failed to get device surface formats after counting");
         return -4;
     }
@@ -58,7 +68,8 @@ result VkCompletedSwapchain::CreateInfo::create_default_from_win32(VkCompletedDe
     // Now we're going to go through all the devices created queues and check if it has support
     for (const auto& queue : device.m_queues) {
         VkBool32 support = VK_TRUE;
-        if (vkGetPhysicalDeviceSurfaceSupportKHR(physical, queue.first, surf.m_handle, &support) != VK_SUCCESS) {
+        if (api.vkGetPhysicalDeviceSurfaceSupportKHR(physical, queue.first, surf.m_handle, &support) !=
+            VK_SUCCESS) {
             Log::error("Failed to get device surface support");
             return -5;
         }
@@ -86,26 +97,32 @@ result VkCompletedSwapchain::CreateInfo::create_default_from_win32(VkCompletedDe
     // End queues stuff
 
     // Get the Surface capabilities
-    if (vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical, surf.m_handle, &m_surface_caps) != VK_SUCCESS) {
+    if (api.vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical, surf.m_handle, &m_surface_caps) != VK_SUCCESS) {
         Log::error("Failed to get surface capabilities");
         return -7;
     }
 
     // Frames in flight should aim for 3, but maybe we need to bound between the supported range
     m_info.minImageCount = 3;
-    if (m_info.minImageCount > m_surface_caps.maxImageCount) m_info.minImageCount = m_surface_caps.maxImageCount;
+    // A max of zero means there is no upper limit
+    uint32_t max_images = m_surface_caps.maxImageCount;
+    if (max_images != 0 && m_info.minImageCount > max_images) m_info.minImageCount = max_images;
     if (m_info.minImageCount < m_surface_caps.minImageCount) m_info.minImageCount = m_surface_caps.minImageCount;
 
-    // TODO: We should probably look into handling when the current extent isn't defined
+    // An undefined current extent means the swapchain decides the size, so take the fallback within the limits
     if (m_surface_caps.currentExtent.width != std::numeric_limits<uint32_t>::max() &&
         m_surface_caps.currentExtent.height != std::numeric_limits<uint32_t>::max()) {
         m_info.imageExtent = m_surface_caps.currentExtent;
     } else {
-        Log::warn("Couldn't determine swapchain extent from capabilities");
+        m_info.imageExtent.width = std::clamp(fallback_extent.width, m_surface_caps.minImageExtent.width,
+                                              m_surface_caps.maxImageExtent.width);
+        m_info.imageExtent.height = std::clamp(fallback_extent.height, m_surface_caps.minImageExtent.height,
+                                               m_surface_caps.maxImageExtent.height);
     }
 
-    // Image flags, in general we only need the device local bit
-    m_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    // Image flags, in general we only need the device local bit. Transfer source lets frames be read back
+    m_info.imageUsage =
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
     m_info.imageUsage &= m_surface_caps.supportedUsageFlags;
 
     return k_success;
@@ -0,0 +1,699 @@
+#include "atelier/atelier_vk_texture_stream.h"
+#include "atelier/atelier_vk_memory.h"
+#include "atelier/atelier_vk_submit.h"
+
+#include <cmath>
+using namespace Atelier;
+
+static_assert(sizeof(Ktx2File::Header) == 80, "Ktx2File::Header must match the KTX2 file layout");
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+result Ktx2File::open(const char* path)
+{
+    close();
+    if (m_file.open(path) != k_success) return -1;
+    if (m_file.m_size < sizeof(Header)) {
+        Log::error("KTX2 file is too small for a header: %s", path);
+        close();
+        return -2;
+    }
+
+    Header header;
+    memcpy(&header, m_file.m_data, sizeof(Header));
+    if (memcmp(header.identifier, k_identifier, sizeof(k_identifier)) != 0) {
+        Log::error("Not a KTX2 file: %s", path);
+        close();
+        return -3;
+    }
+    if (header.supercompression_scheme != 0 || header.pixel_height == 0 || header.pixel_depth > 1 ||
+        header.layer_count > 1 || header.face_count != 1 || header.vk_format == VK_FORMAT_UNDEFINED) {
+        Log::error("Only 2D KTX2 textures without supercompression can be streamed: %s", path);
+        close();
+        return -4;
+    }
+
+    // A level count of zero asks the loader to generate mips, which we don't, so it's just the base level
+    uint32_t max_levels = 1;
+    while ((std::max(header.pixel_width, header.pixel_height) >> max_levels) != 0) max_levels++;
+    m_levels = std::max(1u, header.level_count);
+    if (m_levels > max_levels || sizeof(Header) + sizeof(Level) * m_levels > m_file.m_size) {
+        Log::error("KTX2 level index is invalid: %s", path);
+        close();
+        return -5;
+    }
+    m_level_index = reinterpret_cast<const Level*>(m_file.m_data + sizeof(Header));
+    for (uint32_t i = 0; i < m_levels; i++) {
+        const Level& level = m_level_index[i];
+        if (level.offset > m_file.m_size || level.length > m_file.m_size - level.offset) {
+            Log::error("KTX2 level %u is outside of the file: %s", i, path);
+            close();
+            return -6;
+        }
+    }
+
+    m_format = VkFormat(header.vk_format);
+    m_width = header.pixel_width;
+    m_height = header.pixel_height;
+    return k_success;
+}
+
+void Ktx2File::close()
+{
+    m_file.close();
+    m_format = VK_FORMAT_UNDEFINED;
+    m_width = 0;
+    m_height = 0;
+    m_levels = 0;
+    m_level_index = nullptr;
+}
+
+result Ktx2File::write(const char* path, VkFormat format, uint32_t width, uint32_t height,
+                       const std::vector<std::vector<uint8_t>>& levels)
+{
+    if (levels.empty() || width == 0 || height == 0) return -1;
+
+    // No data format descriptor is written, which is enough for this reader but not for other tools. Level data
+    // is stored smallest first as the format asks, each level aligned for the copy into staging
+    Header header = {};
+    memcpy(header.identifier, k_identifier, sizeof(k_identifier));
+    header.vk_format = uint32_t(format);
+    header.type_size = 1;
+    header.pixel_width = width;
+    header.pixel_height = height;
+    header.face_count = 1;
+    header.level_count = uint32_t(levels.size());
+
+    std::vector<Level> index(levels.size());
+    const VkDeviceSize alignment = VkTextureStreamer::k_copy_alignment;
+    uint64_t offset = align_up(sizeof(Header) + sizeof(Level) * levels.size(), alignment);
+    for (size_t i = levels.size(); i-- > 0;) {
+        index[i].offset = offset;
+        index[i].length = levels[i].size();
+        index[i].uncompressed_length = levels[i].size();
+        offset = align_up(offset + levels[i].size(), alignment);
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        Log::error("Failed to open %s for writing", path);
+        return -2;
+    }
+    bool ok = fwrite(&header, sizeof(Header), 1, file) == 1 &&
+              fwrite(index.data(), sizeof(Level), index.size(), file) == index.size();
+    static const uint8_t s_padding[16] = {};
+    uint64_t written = sizeof(Header) + sizeof(Level) * levels.size();
+    for (size_t i = levels.size(); ok && i-- > 0;) {
+        ok = fwrite(s_padding, 1, index[i].offset - written, file) == index[i].offset - written &&
+             fwrite(levels[i].data(), 1, levels[i].size(), file) == levels[i].size();
+        written = index[i].offset + levels[i].size();
+    }
+    fclose(file);
+    if (!ok) {
+        Log::error("Failed to write %s", path);
+        return -3;
+    }
+    return k_success;
+}
+
+result VkTextureStreamer::init(VkCompletedDevice& device, uint32_t transfer_family, VkQueue transfer_queue,
+                               uint32_t graphics_family, uint32_t frames_in_flight, VkDeviceSize staging_bytes)
+{
+    // The tail of a texture can take up to twice the tail size, and has to fit in the ring in one piece
+    if (frames_in_flight == 0 || transfer_queue == VK_NULL_HANDLE || staging_bytes < 4 * m_tail_bytes) return -1;
+    m_parent = &device;
+    m_transfer_queue = transfer_queue;
+    m_frames_in_flight = frames_in_flight;
+    m_families = {transfer_family};
+    if (graphics_family != transfer_family) m_families.push_back(graphics_family);
+
+    VkCommandPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex = transfer_family;
+    if (vkCreateCommandPool(device.m_handle, &pool_info, nullptr, &m_pool) != VK_SUCCESS) {
+        Log::error("Failed to create the texture upload command pool");
+        shutdown();
+        return -2;
+    }
+    if (m_staging.init(device, staging_bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != k_success) {
+        Log::error("Failed to create the texture staging ring");
+        shutdown();
+        return -3;
+    }
+
+    // Textures are counted against the heap behind the first device local memory type
+    const auto& props = device.m_physical->m_memory_properties;
+    for (uint32_t i = 0; i < props.memoryTypeCount; i++) {
+        if (props.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
+            m_heap = props.memoryTypes[i].heapIndex;
+            break;
+        }
+    }
+    refresh_budget();
+
+    // Pressure sheds the least recently used detail straight away, and a critical heap holds back new detail
+    // until the next frame
+    if (device.m_memory != nullptr) {
+        m_subscription = device.m_memory->subscribe(
+          [this](uint32_t heap, VkMemoryTelemetry::Pressure pressure, VkDeviceSize excess) {
+              // Retired images are still counted by the heap until they're destroyed, so the excess they make up
+              // has been dealt with already and evicting for it again would shed detail twice
+              if (heap != m_heap) return;
+              excess = excess > m_retired_bytes ? excess - m_retired_bytes : 0;
+              VkDeviceSize target = m_resident_bytes > excess ? m_resident_bytes - excess : 0;
+              while (m_resident_bytes > target && evict_one()) {
+              }
+              if (pressure == VkMemoryTelemetry::Pressure::k_critical) m_held_frame = m_frame;
+          });
+    }
+
+    m_stopping = false;
+    m_io_thread = std::thread(&VkTextureStreamer::io_main, this);
+    return k_success;
+}
+
+void VkTextureStreamer::shutdown()
+{
+    if (m_parent == nullptr) return;
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    if (m_subscription != 0 && m_parent->m_memory != nullptr) m_parent->m_memory->unsubscribe(m_subscription);
+    m_subscription = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stopping = true;
+    }
+    m_io_wake.notify_all();
+    if (m_io_thread.joinable()) m_io_thread.join();
+    if (m_submitter != nullptr) {
+        m_submitter->with_queue([&api](VkQueue queue) { api.vkQueueWaitIdle(queue); });
+    } else {
+        api.vkQueueWaitIdle(m_transfer_queue);
+    }
+
+    // Uploads which never made it into a texture still own their images
+    VkDevice dev = m_parent->m_handle;
+    for (auto* queue : {&m_tail_requests, &m_detail_requests}) {
+        for (auto& upload : *queue) destroy_residency(upload.m_target);
+        queue->clear();
+    }
+    for (auto& upload : m_ready) destroy_residency(upload.m_target);
+    m_ready.clear();
+    for (auto& batch : m_batches) {
+        for (auto& upload : batch.m_uploads) destroy_residency(upload.m_target);
+        vkDestroyFence(dev, batch.m_fence, nullptr);
+    }
+    m_batches.clear();
+    for (auto& retired : m_retired) destroy_residency(retired.m_residency);
+    m_retired.clear();
+    m_retired_bytes = 0;
+    for (auto& texture : m_textures) {
+        destroy_residency(texture.m_tail);
+        destroy_residency(texture.m_detail);
+    }
+    m_textures.clear();
+
+    m_staging.shutdown();
+    vkDestroyCommandPool(dev, m_pool, nullptr);
+    m_pool = VK_NULL_HANDLE;
+    m_staging_write = 0;
+    m_staging_read = 0;
+    m_staging_failed = 0;
+    m_resident_bytes = 0;
+    m_pending_bytes = 0;
+    m_parent = nullptr;
+}
+
+uint32_t VkTextureStreamer::select_transfer_family(const VkCompletedDevice& device, uint32_t graphics_family)
+{
+    // Dedicated transfer families usually map onto the copy engines, which run beside graphics work
+    for (const auto& [family, queue] : device.m_queues) {
+        VkQueueFlags flags = queue.props.queueFlags;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) &&
+            !queue.m_handle.empty()) {
+            return family;
+        }
+    }
+    return graphics_family;
+}
+
+VkTextureStreamer::Handle VkTextureStreamer::load(const char* path)
+{
+    Texture& texture = m_textures.emplace_back();
+    if (texture.m_file.open(path) != k_success) {
+        m_textures.pop_back();
+        return k_invalid;
+    }
+
+    // The tail is every level small enough to not be worth streaming, always at least the smallest one
+    const Ktx2File& file = texture.m_file;
+    uint32_t tail = file.m_levels - 1;
+    while (tail > 0 && file.level_size(tail - 1) <= m_tail_bytes) tail--;
+    texture.m_tail_mip = tail;
+    texture.m_wanted_mip = tail;
+
+    // The tail goes through the ring in one piece, one that can never fit would stall the I/O thread for good
+    Upload upload;
+    upload.m_staging_size = upload_size(file, tail);
+    if (upload.m_staging_size > m_staging.m_size) {
+        Log::error("The mip tail of %s needs %llu bytes of staging, more than the whole ring", path,
+                   (unsigned long long)upload.m_staging_size);
+        m_textures.pop_back();
+        return k_invalid;
+    }
+    upload.m_texture = Handle(m_textures.size() - 1);
+    upload.m_file = &file;
+    upload.m_tail = true;
+    if (create_residency(texture, tail, upload.m_target) != k_success) {
+        m_textures.pop_back();
+        return k_invalid;
+    }
+    texture.m_loading = true;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_tail_requests.push_back(upload);
+    }
+    m_io_wake.notify_one();
+    return upload.m_texture;
+}
+
+void VkTextureStreamer::request(Handle handle, float screen_pixels)
+{
+    // The mip whose size is closest to covering the screen size without going under it
+    Texture& texture = m_textures[handle];
+    float ratio = float(std::max(texture.m_file.m_width, texture.m_file.m_height)) / std::max(screen_pixels, 1.0f);
+    uint32_t mip = ratio > 1.0f ? uint32_t(std::floor(std::log2(ratio))) : 0;
+    mip = std::min(mip, texture.m_tail_mip);
+
+    // Draws asking for different sizes in the same frame get the most detailed of them
+    if (texture.m_last_used == m_frame) mip = std::min(mip, texture.m_wanted_mip);
+    texture.m_wanted_mip = mip;
+    texture.m_last_used = m_frame;
+}
+
+void VkTextureStreamer::update()
+{
+    complete_batches();
+
+    // Anything retired frames_in_flight frames ago can no longer be in use by the graphics queue
+    for (size_t i = 0; i < m_retired.size();) {
+        if (m_retired[i].m_frame > m_frame) {
+            i++;
+            continue;
+        }
+        m_retired_bytes -= m_retired[i].m_residency.m_bytes;
+        destroy_residency(m_retired[i].m_residency);
+        m_retired[i] = m_retired.back();
+        m_retired.pop_back();
+    }
+    submit_ready();
+
+    refresh_budget();
+    while (m_resident_bytes > m_budget && evict_one()) {
+    }
+
+    // Textures drawn this frame which want more detail than they have, the most recently used and furthest from
+    // what they want go first
+    m_candidates.clear();
+    for (Handle h = 0; h < m_textures.size(); h++) {
+        const Texture& t = m_textures[h];
+        if (t.m_tail_ready && !t.m_loading && t.m_last_used == m_frame && t.m_wanted_mip < resident_mip(h)) {
+            m_candidates.push_back(h);
+        }
+    }
+    std::sort(m_candidates.begin(), m_candidates.end(), [this](Handle a, Handle b) {
+        return resident_mip(a) - m_textures[a].m_wanted_mip > resident_mip(b) - m_textures[b].m_wanted_mip;
+    });
+
+    bool queued = false;
+    if (m_held_frame == m_frame) m_candidates.clear();
+    for (Handle h : m_candidates) {
+        Texture& t = m_textures[h];
+
+        // Settle for less detail than wanted when the budget or the staging ring can't take it all
+        uint32_t top = t.m_wanted_mip;
+        for (; top < resident_mip(h); top++) {
+            VkDeviceSize bytes = upload_size(t.m_file, top);
+            if (m_pending_bytes + bytes > m_staging.m_size) continue;
+            while (m_resident_bytes + bytes > m_budget && evict_one()) {
+            }
+            if (m_resident_bytes + bytes <= m_budget) break;
+        }
+        if (top >= resident_mip(h)) continue;
+
+        Upload upload;
+        upload.m_texture = h;
+        upload.m_file = &t.m_file;
+        upload.m_staging_size = upload_size(t.m_file, top);
+        if (create_residency(t, top, upload.m_target) != k_success) continue;
+        t.m_loading = true;
+        m_pending_bytes += upload.m_staging_size;
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_detail_requests.push_back(upload);
+        queued = true;
+    }
+    if (queued) m_io_wake.notify_one();
+    m_frame++;
+}
+
+void VkTextureStreamer::flush()
+{
+    for (;;) {
+        submit_ready();
+        complete_batches();
+        bool idle = true;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            idle = m_tail_requests.empty() && m_detail_requests.empty() && m_ready.empty();
+        }
+        for (const auto& batch : m_batches) idle = idle && !batch.m_busy;
+        if (idle) return;
+        std::this_thread::yield();
+    }
+}
+
+VkDeviceSize VkTextureStreamer::upload_size(const Ktx2File& file, uint32_t top_mip)
+{
+    VkDeviceSize bytes = 0;
+    for (uint32_t level = top_mip; level < file.m_levels; level++) {
+        bytes += align_up(file.level_size(level), k_copy_alignment);
+    }
+    return bytes;
+}
+
+result VkTextureStreamer::create_residency(const Texture& texture, uint32_t top_mip, Residency& out)
+{
+    VkDevice dev = m_parent->m_handle;
+    const Ktx2File& file = texture.m_file;
+    VkImageCreateInfo image_info = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = file.m_format;
+    image_info.extent = file.level_extent(top_mip);
+    image_info.mipLevels = file.m_levels - top_mip;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image_info.sharingMode = m_families.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    image_info.queueFamilyIndexCount = m_families.size() > 1 ? uint32_t(m_families.size()) : 0;
+    image_info.pQueueFamilyIndices = m_families.data();
+    if (vkCreateImage(dev, &image_info, nullptr, &out.m_image) != VK_SUCCESS) {
+        Log::error("Failed to create a %ux%u streamed texture image", image_info.extent.width,
+                   image_info.extent.height);
+        return -1;
+    }
+
+    VkMemoryRequirements reqs = {};
+    vkGetImageMemoryRequirements(dev, out.m_image, &reqs);
+    const auto& physical = *m_parent->m_physical;
+    int32_t type = physical.find_memory_type(reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (type < 0) type = physical.find_memory_type(reqs.memoryTypeBits, 0);
+    VkMemoryAllocateInfo alloc_info = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    alloc_info.allocationSize = reqs.size;
+    alloc_info.memoryTypeIndex = uint32_t(type);
+    if (type < 0 || vkAllocateMemory(dev, &alloc_info, nullptr, &out.m_memory) != VK_SUCCESS ||
+        vkBindImageMemory(dev, out.m_image, out.m_memory, 0) != VK_SUCCESS) {
+        Log::error("Failed to allocate %llu bytes for a streamed texture", (unsigned long long)reqs.size);
+        destroy_residency(out);
+        return -2;
+    }
+
+    VkImageViewCreateInfo view_info = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+    view_info.image = out.m_image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = file.m_format;
+    view_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, image_info.mipLevels, 0, 1};
+    if (vkCreateImageView(dev, &view_info, nullptr, &out.m_view) != VK_SUCCESS) {
+        Log::error("Failed to create a streamed texture view");
+        destroy_residency(out);
+        return -3;
+    }
+    out.m_bytes = reqs.size;
+    out.m_memory_type = alloc_info.memoryTypeIndex;
+    out.m_top_mip = top_mip;
+    m_resident_bytes += reqs.size;
+    VkMemoryTelemetry::on_allocate(*m_parent, out.m_memory_type, out.m_bytes);
+    return k_success;
+}
+
+void VkTextureStreamer::destroy_residency(Residency& residency)
+{
+    VkDevice dev = m_parent->m_handle;
+    vkDestroyImageView(dev, residency.m_view, nullptr);
+    vkDestroyImage(dev, residency.m_image, nullptr);
+    if (residency.m_memory != VK_NULL_HANDLE) {
+        vkFreeMemory(dev, residency.m_memory, nullptr);
+        VkMemoryTelemetry::on_free(*m_parent, residency.m_memory_type, residency.m_bytes);
+    }
+    residency = Residency();
+}
+
+void VkTextureStreamer::refresh_budget()
+{
+    const auto& props = m_parent->m_physical->m_memory_properties;
+    VkDeviceSize budget = VkDeviceSize(double(props.memoryHeaps[m_heap].size) * m_budget_fraction);
+
+    // With telemetry attached the heap's current budget caps it too, everyone else's usage comes out of that
+    // before ours
+    const VkMemoryTelemetry* memory = m_parent->m_memory;
+    if (memory != nullptr && m_heap < memory->m_heaps.size()) {
+        const VkMemoryTelemetry::Heap& heap = memory->m_heaps[m_heap];
+        VkDeviceSize others = heap.m_usage > m_resident_bytes ? heap.m_usage - m_resident_bytes : 0;
+        budget = std::min(budget, heap.m_budget > others ? heap.m_budget - others : 0);
+    }
+    if (m_budget_limit != 0) budget = std::min(budget, m_budget_limit);
+    m_budget = budget;
+}
+
+bool VkTextureStreamer::evict_one()
+{
+    Handle oldest = k_invalid;
+    for (Handle h = 0; h < m_textures.size(); h++) {
+        const Texture& t = m_textures[h];
+        // Textures drawn this frame only give up detail finer than they asked for
+        bool needed = t.m_last_used == m_frame && t.m_wanted_mip <= t.m_detail.m_top_mip;
+        if (!t.m_detail_ready || t.m_loading || needed) continue;
+        if (oldest == k_invalid || t.m_last_used < m_textures[oldest].m_last_used) oldest = h;
+    }
+    if (oldest == k_invalid) return false;
+
+    // The bytes stop counting straight away, the image itself goes once the GPU is done with it
+    Texture& t = m_textures[oldest];
+    m_resident_bytes -= t.m_detail.m_bytes;
+    m_retired_bytes += t.m_detail.m_bytes;
+    m_retired.push_back({t.m_detail, m_frame + m_frames_in_flight});
+    t.m_detail = Residency();
+    t.m_detail_ready = false;
+    m_evictions++;
+    return true;
+}
+
+void VkTextureStreamer::submit_ready()
+{
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_ready_swap.swap(m_ready);
+    }
+    if (m_ready_swap.empty()) return;
+
+    Batch* batch = nullptr;
+    for (auto& b : m_batches) {
+        if (!b.m_busy) {
+            batch = &b;
+            break;
+        }
+    }
+    VkDevice dev = m_parent->m_handle;
+    if (batch == nullptr) {
+        Batch created;
+        VkCommandBufferAllocateInfo cmd_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        cmd_info.commandPool = m_pool;
+        cmd_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        cmd_info.commandBufferCount = 1;
+        VkFenceCreateInfo fence_info = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+        if (vkAllocateCommandBuffers(dev, &cmd_info, &created.m_cmd) != VK_SUCCESS ||
+            vkCreateFence(dev, &fence_info, nullptr, &created.m_fence) != VK_SUCCESS) {
+            Log::error("Failed to create a texture upload batch");
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_ready.insert(m_ready.begin(), m_ready_swap.begin(), m_ready_swap.end());
+            m_ready_swap.clear();
+            return;
+        }
+        batch = &m_batches.emplace_back(created);
+    }
+
+    VkCommandBufferBeginInfo begin = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    api.vkBeginCommandBuffer(batch->m_cmd, &begin);
+
+    m_barriers.clear();
+    for (const auto& upload : m_ready_swap) {
+        VkImageMemoryBarrier barrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = upload.m_target.m_image;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1};
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        m_barriers.push_back(barrier);
+    }
+    api.vkCmdPipelineBarrier(batch->m_cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                             nullptr, 0, nullptr, uint32_t(m_barriers.size()), m_barriers.data());
+
+    for (const auto& upload : m_ready_swap) {
+        const Ktx2File& file = *upload.m_file;
+        VkDeviceSize offset = upload.m_staging_offset;
+        m_regions.clear();
+        for (uint32_t level = upload.m_target.m_top_mip; level < file.m_levels; level++) {
+            VkBufferImageCopy region = {};
+            region.bufferOffset = offset;
+            region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - upload.m_target.m_top_mip, 0, 1};
+            region.imageExtent = file.level_extent(level);
+            m_regions.push_back(region);
+            offset += align_up(file.level_size(level), k_copy_alignment);
+        }
+        api.vkCmdCopyBufferToImage(batch->m_cmd, m_staging.m_handle, upload.m_target.m_image,
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, uint32_t(m_regions.size()),
+                                   m_regions.data());
+    }
+
+    // The fence orders the uploads before any draw that sees the new view, so the barrier only has to change the
+    // layout and make the writes available
+    for (auto& barrier : m_barriers) {
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+    }
+    api.vkCmdPipelineBarrier(batch->m_cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                             0, nullptr, 0, nullptr, uint32_t(m_barriers.size()), m_barriers.data());
+    api.vkEndCommandBuffer(batch->m_cmd);
+
+    api.vkResetFences(dev, 1, &batch->m_fence);
+    if (m_submitter != nullptr) {
+        VkSubmitQueue::Submit submit;
+        submit.add_cmd(batch->m_cmd);
+        submit.m_fence = batch->m_fence;
+        m_submitter->push(submit);
+    } else {
+        VkSubmitInfo submit = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        submit.commandBufferCount = 1;
+        submit.pCommandBuffers = &batch->m_cmd;
+        if (api.vkQueueSubmit(m_transfer_queue, 1, &submit, batch->m_fence) != VK_SUCCESS) {
+            Log::error("Failed to submit %zu texture uploads", m_ready_swap.size());
+            fail_uploads(m_ready_swap);
+            return;
+        }
+    }
+    batch->m_uploads.swap(m_ready_swap);
+    m_ready_swap.clear();
+    batch->m_busy = true;
+}
+
+void VkTextureStreamer::complete_batches()
+{
+    const VkDeviceDispatch& api = m_parent->m_dispatch;
+    uint64_t staging_read = 0;
+    for (auto& batch : m_batches) {
+        if (!batch.m_busy || api.vkGetFenceStatus(m_parent->m_handle, batch.m_fence) != VK_SUCCESS) continue;
+        for (auto& upload : batch.m_uploads) {
+            Texture& t = m_textures[upload.m_texture];
+            if (upload.m_tail) {
+                t.m_tail = upload.m_target;
+                t.m_tail_ready = true;
+            } else {
+                if (t.m_detail.m_image != VK_NULL_HANDLE) {
+                    m_resident_bytes -= t.m_detail.m_bytes;
+                    m_retired_bytes += t.m_detail.m_bytes;
+                    m_retired.push_back({t.m_detail, m_frame + m_frames_in_flight});
+                }
+                t.m_detail = upload.m_target;
+                t.m_detail_ready = true;
+                m_pending_bytes -= upload.m_staging_size;
+            }
+            t.m_loading = false;
+            m_uploaded_bytes += upload.m_staging_size;
+            staging_read = std::max(staging_read, upload.m_staging_end);
+        }
+        batch.m_uploads.clear();
+        batch.m_busy = false;
+    }
+
+    // Staging of failed submits is only free once every batch recorded before them has finished with theirs
+    bool busy = false;
+    for (const auto& batch : m_batches) busy = busy || batch.m_busy;
+    if (!busy) staging_read = std::max(staging_read, m_staging_failed);
+    if (staging_read == 0) return;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_staging_read = std::max(m_staging_read, staging_read);
+    }
+    m_io_wake.notify_one();
+}
+
+void VkTextureStreamer::fail_uploads(std::vector<Upload>& uploads)
+{
+    // Nothing reached the queue, so the images can go straight away. A texture whose tail failed never becomes
+    // ready, one whose detail failed keeps what it had and may ask again
+    for (auto& upload : uploads) {
+        Texture& t = m_textures[upload.m_texture];
+        m_resident_bytes -= upload.m_target.m_bytes;
+        destroy_residency(upload.m_target);
+        if (!upload.m_tail) m_pending_bytes -= upload.m_staging_size;
+        t.m_loading = false;
+        m_staging_failed = std::max(m_staging_failed, upload.m_staging_end);
+    }
+    uploads.clear();
+    complete_batches();
+}
+
+void VkTextureStreamer::io_main()
+{
+    const uint64_t ring = m_staging.m_size;
+    for (;;) {
+        Upload upload;
+        std::deque<Upload>* queue = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_io_wake.wait(lock, [this]() {
+                return m_stopping || !m_tail_requests.empty() || !m_detail_requests.empty();
+            });
+            if (m_stopping) return;
+            queue = !m_tail_requests.empty() ? &m_tail_requests : &m_detail_requests;
+            upload = queue->front();
+
+            // Uploads never straddle the end of the ring, and wait for finished batches when it's full
+            for (;;) {
+                uint64_t position = m_staging_write;
+                if (position % ring + upload.m_staging_size > ring) position += ring - position % ring;
+                if (position + upload.m_staging_size - m_staging_read <= ring) {
+                    upload.m_staging_offset = position % ring;
+                    upload.m_staging_end = position + upload.m_staging_size;
+                    m_staging_write = upload.m_staging_end;
+                    break;
+                }
+                m_io_wake.wait(lock);
+                if (m_stopping) return;
+            }
+        }
+
+        // Touching the mapping is what pulls the file in from disk, so the page faults land on this thread
+        const Ktx2File& file = *upload.m_file;
+        uint8_t* dst = static_cast<uint8_t*>(m_staging.m_mapped) + upload.m_staging_offset;
+        for (uint32_t level = upload.m_target.m_top_mip; level < file.m_levels; level++) {
+            memcpy(dst, file.level_data(level), file.level_size(level));
+            dst += align_up(file.level_size(level), k_copy_alignment);
+        }
+
+        // Only this thread pops, so the upload is still at the front and never looks idle to flush() mid copy
+        std::lock_guard<std::mutex> lock(m_lock);
+        queue->pop_front();
+        m_ready.push_back(upload);
+    }
+}
@@ -3,9 +3,90 @@
 static ATOM main_wc_atom = 0;
 static ATOM sub_wc_atom = 0;
 
+static Atelier::InputEvent input_event(Atelier::InputEventType type, uint32_t code = 0, int32_t x = 0,
+                                       int32_t y = 0, uint32_t down = 0)
+{
+    Atelier::InputEvent event;
+    event.m_time_ns = Atelier::pacer_now_ns();
+    event.m_type = type;
+    event.m_code = code;
+    event.m_x = x;
+    event.m_y = y;
+    event.m_down = down;
+    return event;
+}
+
+// Applies the event to the window the message was for, and hands it to the recorder when there is one
+static void deliver_input(HWND window_handle, const Atelier::InputEvent& event)
+{
+    auto* window = reinterpret_cast<Atelier::Window*>(GetWindowLongPtrW(window_handle, GWLP_USERDATA));
+    if (window == nullptr) return;
+    window->input.apply(event);
+    if (window->recorder != nullptr) window->recorder->record(event);
+}
+
+void Atelier::Window::begin_input_frame()
+{
+    InputEvent frame = input_event(InputEventType::k_frame);
+    frame.m_frame = input_frame++;
+    input.apply(frame);
+    if (recorder != nullptr) recorder->record(frame);
+}
+
 static LRESULT main_class_proc_func(HWND window_handle, UINT msg_id, WPARAM w_param, LPARAM l_param)
 {
+    using Type = Atelier::InputEventType;
+    int32_t x = int16_t(LOWORD(l_param));
+    int32_t y = int16_t(HIWORD(l_param));
     switch (msg_id) {
+        // The window is handed to CreateWindowExW, keep it with the handle so messages can find their way back
+        case WM_NCCREATE: {
+            auto* create = reinterpret_cast<CREATESTRUCTW*>(l_param);
+            SetWindowLongPtrW(window_handle, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(create->lpCreateParams));
+            break;
+        }
+
+        // Everything the frame loop reads about the window goes through the input, so it can be recorded
+        case WM_SIZE:
+            deliver_input(window_handle, input_event(Type::k_resize, 0, LOWORD(l_param), HIWORD(l_param)));
+            break;
+        case WM_MOUSEMOVE:
+            deliver_input(window_handle, input_event(Type::k_mouse_move, 0, x, y));
+            break;
+        case WM_LBUTTONDOWN:
+        case WM_LBUTTONUP:
+            deliver_input(window_handle, input_event(Type::k_mouse_button, 0, x, y, msg_id == WM_LBUTTONDOWN));
+            break;
+        case WM_RBUTTONDOWN:
+        case WM_RBUTTONUP:
+            deliver_input(window_handle, input_event(Type::k_mouse_button, 1, x, y, msg_id == WM_RBUTTONDOWN));
+            break;
+        case WM_MBUTTONDOWN:
+        case WM_MBUTTONUP:
+            deliver_input(window_handle, input_event(Type::k_mouse_button, 2, x, y, msg_id == WM_MBUTTONDOWN));
+            break;
+        case WM_MOUSEWHEEL:
+            deliver_input(window_handle, input_event(Type::k_wheel, 0, 0, GET_WHEEL_DELTA_WPARAM(w_param)));
+            break;
+        case WM_KEYDOWN:
+        case WM_SYSKEYDOWN:
+        case WM_KEYUP:
+        case WM_SYSKEYUP: {
+            bool down = msg_id == WM_KEYDOWN || msg_id == WM_SYSKEYDOWN;
+            deliver_input(window_handle, input_event(Type::k_key, uint32_t(w_param & 0xff), 0, 0, down));
+            break;
+        }
+        case WM_CHAR:
+            deliver_input(window_handle, input_event(Type::k_char, uint32_t(w_param)));
+            break;
+        case WM_SETFOCUS:
+        case WM_KILLFOCUS:
+            deliver_input(window_handle, input_event(Type::k_focus, 0, 0, 0, msg_id == WM_SETFOCUS));
+            break;
+        case WM_CLOSE:
+            deliver_input(window_handle, input_event(Type::k_close));
+            break;
+
         // This is our MAIN window, and so when the user closes it, we should tell all other objects that it's time
         // to exit
         case WM_DESTROY:
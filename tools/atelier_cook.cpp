@@ -0,0 +1,97 @@
+/**
+ * @brief Cooks glTF scenes into the mapped mesh format the runtime loads, and packs compiled shaders into an
+ * archive.
+ *
+ *   atelier_cook input.gltf|input.glb output.amesh [--no-optimize] [--threads n]
+ *   atelier_cook --shaders output.ashaders input.spv...
+ *
+ * Every primitive becomes one cooked mesh, named after its glTF mesh with the primitive index appended when the
+ * mesh has more than one. Shaders are packed under their file names
+ */
+#include "atelier/atelier_jobs.h"
+#include "atelier/atelier_mesh.h"
+#include "atelier/atelier_vk_shader.h"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+using namespace Atelier;
+
+static int cook_shaders(int argc, char** argv)
+{
+    if (argc < 4) {
+        Log::error("Usage: atelier_cook --shaders output.ashaders input.spv...");
+        return 2;
+    }
+    std::vector<std::string> inputs(argv + 3, argv + argc);
+    if (ShaderArchive::pack_files(argv[2], inputs) != k_success) {
+        Log::error("Failed to pack shaders into %s", argv[2]);
+        return 1;
+    }
+    Log::info("Packed %zu shaders into %s", inputs.size(), argv[2]);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    Log::init();
+    if (argc > 1 && std::string(argv[1]) == "--shaders") {
+        int code = cook_shaders(argc, argv);
+        Log::shutdown();
+        return code;
+    }
+
+    const char* input = nullptr;
+    const char* output = nullptr;
+    bool optimize = true;
+    uint32_t threads = 0;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--no-optimize") {
+            optimize = false;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = uint32_t(atoi(argv[++i]));
+        } else if (input == nullptr) {
+            input = argv[i];
+        } else if (output == nullptr) {
+            output = argv[i];
+        } else {
+            Log::error("Unknown argument %s", arg.c_str());
+            return 2;
+        }
+    }
+    if (input == nullptr || output == nullptr) {
+        Log::error("Usage: atelier_cook input.gltf output.amesh [--no-optimize] [--threads n]");
+        return 2;
+    }
+
+    JobSystem jobs;
+    jobs.init(threads);
+    GltfImporter importer;
+    importer.m_jobs = &jobs;
+    importer.m_optimize = optimize;
+    if (importer.import(input) != k_success) {
+        Log::error("Failed to import %s", input);
+        jobs.shutdown();
+        return 1;
+    }
+    jobs.shutdown();
+
+    size_t vertices = 0;
+    size_t indices = 0;
+    double acmr = 0.0;
+    for (const auto& mesh : importer.m_meshes) {
+        vertices += mesh.m_vertices.size();
+        indices += mesh.m_indices.size();
+        double mesh_acmr = average_cache_miss_ratio(mesh.m_indices.data(), mesh.m_indices.size());
+        acmr += mesh_acmr * double(mesh.m_indices.size());
+    }
+    Log::info("Imported %zu meshes, %zu vertices and %zu triangles in %.2f ms parsing and %.2f ms decoding",
+              importer.m_meshes.size(), vertices, indices / 3, importer.m_parse_ms, importer.m_decode_ms);
+    if (indices > 0) Log::info("Average cache miss ratio %.3f", acmr / double(indices));
+
+    if (CookedMeshFile::write(output, importer.m_meshes) != k_success) return 1;
+    Log::info("Wrote %s", output);
+    Log::shutdown();
+    return 0;
+}
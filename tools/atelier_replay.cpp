@@ -0,0 +1,291 @@
+/**
+ * @brief Plays an input recording through the frame loop with no window behind it, so a performance run can be
+ * repeated exactly and two builds compared frame for frame.
+ *
+ *   atelier_replay input.ainp [--fast] [--out frames.csv]
+ *   atelier_replay --compare baseline.csv frames.csv [--threshold 0.15]
+ *
+ * Recordings come from running the application with --record-input=path. A paced replay starts every frame when it
+ * started in the recording, --fast runs them back to back. Either way every frame sees the same events, resizes
+ * included, and its CPU and GPU time go into one row of the CSV. GPU times arrive a couple of frames late, the
+ * frames still in flight at the end are left without one
+ */
+#include "atelier/atelier_frame_loop.h"
+#include "atelier/atelier_frame_pacer.h"
+#include "atelier/atelier_input.h"
+#include "atelier/atelier_vk_completed.h"
+#include "atelier/atelier_vk_present.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <string>
+#include <vector>
+using namespace Atelier;
+
+struct FrameRow {
+    uint32_t frame = 0;
+    double time_ms = 0.0;  // Start of the frame in the recording
+    double cpu_ms = 0.0;
+    double gpu_ms = -1.0;  // Negative when it never came back
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+static result write_rows(const char* path, const std::vector<FrameRow>& rows)
+{
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        Log::error("Failed to open %s for writing", path);
+        return -1;
+    }
+    fprintf(file, "frame,time_ms,cpu_ms,gpu_ms,width,height\n");
+    for (const FrameRow& row : rows) {
+        fprintf(file, "%u,%.3f,%.4f,%.4f,%u,%u\n", row.frame, row.time_ms, row.cpu_ms, row.gpu_ms, row.width,
+                row.height);
+    }
+    fclose(file);
+    return k_success;
+}
+
+static result read_rows(const char* path, std::vector<FrameRow>& rows)
+{
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        Log::error("Failed to open %s", path);
+        return -1;
+    }
+    char line[256];
+    if (fgets(line, sizeof(line), file) == nullptr) {
+        fclose(file);
+        return -2;
+    }
+    FrameRow row;
+    while (fscanf(file, "%u,%lf,%lf,%lf,%u,%u", &row.frame, &row.time_ms, &row.cpu_ms, &row.gpu_ms, &row.width,
+                  &row.height) == 6) {
+        rows.push_back(row);
+    }
+    fclose(file);
+    return k_success;
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    return values[size_t(p * double(values.size() - 1) + 0.5)];
+}
+
+// Lines the two runs up by frame and reports how the second one's times moved, fails past the threshold
+static int compare_runs(const char* baseline_path, const char* path, double threshold)
+{
+    std::vector<FrameRow> baseline, rows;
+    if (read_rows(baseline_path, baseline) != k_success || read_rows(path, rows) != k_success) return 2;
+    size_t count = std::min(baseline.size(), rows.size());
+    if (baseline.size() != rows.size()) {
+        Log::warn("The runs have %zu and %zu frames, comparing the first %zu", baseline.size(), rows.size(),
+                  count);
+    }
+
+    std::vector<double> cpu_ratios, gpu_ratios;
+    size_t mismatched = 0, worst = 0;
+    for (size_t i = 0; i < count; i++) {
+        const FrameRow& a = baseline[i];
+        const FrameRow& b = rows[i];
+        if (a.frame != b.frame || a.width != b.width || a.height != b.height) mismatched++;
+        if (a.cpu_ms > 0.0) cpu_ratios.push_back(b.cpu_ms / a.cpu_ms);
+        if (a.gpu_ms > 0.0 && b.gpu_ms >= 0.0) gpu_ratios.push_back(b.gpu_ms / a.gpu_ms);
+        if (b.cpu_ms - a.cpu_ms > rows[worst].cpu_ms - baseline[worst].cpu_ms) worst = i;
+    }
+    if (mismatched > 0) {
+        Log::warn("%zu frames differ in number or size, the recordings aren't the same", mismatched);
+    }
+
+    double cpu_median = percentile(cpu_ratios, 0.5), gpu_median = percentile(gpu_ratios, 0.5);
+    Log::info("CPU time %+.1f%% median, %+.1f%% p95 over %zu frames", (cpu_median - 1.0) * 100.0,
+              (percentile(cpu_ratios, 0.95) - 1.0) * 100.0, cpu_ratios.size());
+    if (!gpu_ratios.empty()) {
+        Log::info("GPU time %+.1f%% median, %+.1f%% p95 over %zu frames", (gpu_median - 1.0) * 100.0,
+                  (percentile(gpu_ratios, 0.95) - 1.0) * 100.0, gpu_ratios.size());
+    }
+    if (count > 0) {
+        Log::info("Largest CPU regression at frame %u, %.3f ms to %.3f ms", rows[worst].frame,
+                  baseline[worst].cpu_ms, rows[worst].cpu_ms);
+    }
+    bool regressed = cpu_median > 1.0 + threshold || (!gpu_ratios.empty() && gpu_median > 1.0 + threshold);
+    return regressed ? 1 : 0;
+}
+
+/**
+ * @brief The headless stand in for the main window, a swapchain on a headless surface which is rebuilt at the new
+ * size whenever the recording resizes the window
+ */
+struct ReplayWindow {
+    VkCompletedState* m_vk = nullptr;
+    VkCompletedDevice* m_device = nullptr;
+    VkCompletedHeadlessSurface* m_surface = nullptr;
+    VkCompletedSwapchain* m_swap = nullptr;
+    FrameLoop* m_loop = nullptr;  // Set once the loop is running, it's handed each rebuilt swapchain
+    VkExtent2D m_requested = {};  // The recording's size, the swapchain can be clamped to something else
+    VkExtent2D m_extent = {};
+    bool m_attached = false;
+
+    // A zero size is a minimized window, which has nothing to draw into until it's restored
+    result resize(uint32_t width, uint32_t height)
+    {
+        if (m_loop != nullptr) m_loop->detach(0);
+        if (m_attached) m_swap->shutdown(*m_vk);
+        m_attached = false;
+        m_requested = {width, height};
+        m_extent = m_requested;
+        if (width == 0 || height == 0) return k_success;
+
+        auto swap_info = VkCompletedSwapchain::CreateInfo();
+        if (swap_info.create_default(*m_device, *m_surface, m_extent) != k_success ||
+            m_swap->init_from_create_info(swap_info) != k_success) {
+            Log::error("Failed to create a %ux%u headless swapchain", width, height);
+            return -1;
+        }
+        m_extent = m_swap->m_info.m_info.imageExtent;
+        m_attached = true;
+        if (m_loop != nullptr && m_loop->attach(0, *m_swap) != k_success) return -2;
+        return k_success;
+    }
+
+    // The loop must have let go of the swapchain already
+    void shutdown()
+    {
+        if (m_attached) m_swap->shutdown(*m_vk);
+        m_attached = false;
+    }
+};
+
+int main(int argc, char** argv)
+{
+    Log::init();
+    const char* input_path = nullptr;
+    const char* out_path = "atelier_replay.csv";
+    const char* compare[2] = {};
+    double threshold = 0.15;
+    bool fast = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--fast") {
+            fast = true;
+        } else if (arg == "--out" && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (arg == "--compare" && i + 2 < argc) {
+            compare[0] = argv[++i];
+            compare[1] = argv[++i];
+        } else if (arg == "--threshold" && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        } else if (input_path == nullptr) {
+            input_path = argv[i];
+        } else {
+            Log::error("Unknown argument %s", arg.c_str());
+            return 2;
+        }
+    }
+    if (compare[0] != nullptr) return compare_runs(compare[0], compare[1], threshold);
+    if (input_path == nullptr) {
+        Log::error("Usage: atelier_replay input.ainp [--fast] [--out frames.csv]");
+        return 2;
+    }
+
+    InputReplay replay;
+    if (replay.open(input_path) != k_success) return 1;
+    replay.m_paced = !fast;
+
+    // The first device with a graphics queue, which presents to the headless surface as well
+    VkCompletedState vk;
+    if (vk.pre_surface_default_init() != k_success || vk.m_devices.empty()) {
+        Log::error("No usable Vulkan device");
+        return 1;
+    }
+    VkCompletedDevice& device = vk.m_devices[0];
+    uint32_t family = UINT32_MAX;
+    for (auto& queue : device.m_queues) {
+        if ((queue.second.props.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0) {
+            family = queue.first;
+            break;
+        }
+    }
+    auto& surface = vk.m_headless_surfaces.emplace_back();
+    if (family == UINT32_MAX || surface.init_headless(*device.m_parent) != k_success) {
+        Log::error("Replays need a graphics queue and VK_EXT_headless_surface");
+        vk.shutdown();
+        return 1;
+    }
+    VkQueue queue = device.m_queues[family].m_handle[0];
+    ReplayWindow window;
+    window.m_vk = &vk;
+    window.m_device = &device;
+    window.m_surface = &surface;
+    window.m_swap = &device.m_swaps.emplace_back();
+
+    // The swapchain starts at the recording's first size, one which starts minimized gets a stand in until it's
+    // restored. The recording paces the frames, so the loop itself runs uncapped
+    VkExtent2D start_extent = {1280, 720};
+    const InputEvent* first = replay.m_header->event_count > 0 ? &replay.m_events[0] : nullptr;
+    if (first != nullptr && first->m_type == InputEventType::k_resize && first->m_x > 0 && first->m_y > 0) {
+        start_extent = {uint32_t(first->m_x), uint32_t(first->m_y)};
+    }
+    auto config = FrameLoop::Config();
+    config.m_target_fps = 0.0;
+    FrameLoop loop;
+    if (window.resize(start_extent.width, start_extent.height) != k_success ||
+        loop.init(device, family, queue, queue, {window.m_swap}, config) != k_success) {
+        Log::error("Failed to start the frame loop");
+        loop.shutdown();
+        window.shutdown();
+        vk.shutdown();
+        return 1;
+    }
+    window.m_loop = &loop;
+    replay.m_pacer = &loop.m_pacer;
+
+    // Rows are found again by the serial of the submit they were recorded into, for when their GPU time lands
+    const VkMultiPresenter& presenter = loop.m_presenter;
+    InputState input;
+    std::vector<FrameRow> rows;
+    std::deque<std::pair<uint64_t, size_t>> in_flight;
+    uint64_t start = pacer_now_ns();
+    Log::info("Replaying %u frames %s", replay.frame_count(), fast ? "as fast as possible" : "at recorded pace");
+    while (replay.next_frame(input) && !input.m_close) {
+        uint64_t frame_start = loop.wait_for_frame();
+        if (input.m_width != window.m_requested.width || input.m_height != window.m_requested.height) {
+            if (window.resize(input.m_width, input.m_height) != k_success) break;
+        }
+
+        FrameRow& row = rows.emplace_back();
+        row.frame = input.m_frame;
+        row.time_ms = double(input.m_time_ns) / 1e6;
+        row.width = window.m_extent.width;
+        row.height = window.m_extent.height;
+        if (!window.m_attached) continue;
+
+        // The application's own frame, with the recording's input driving its HUD
+        if (loop.frame(input) != k_success) break;
+        row.cpu_ms = double(pacer_now_ns() - frame_start) / 1e6;
+        uint64_t completed = presenter.completed_serial();
+        while (!in_flight.empty() && in_flight.front().first <= completed) {
+            if (in_flight.front().first == completed && presenter.gpu_time_ns() > 0) {
+                rows[in_flight.front().second].gpu_ms = double(presenter.gpu_time_ns()) / 1e6;
+            }
+            in_flight.pop_front();
+        }
+        in_flight.push_back({presenter.serial(), rows.size() - 1});
+    }
+    double seconds = double(pacer_now_ns() - start) / 1e9;
+    Log::info("Replayed %zu frames in %.2f s", rows.size(), seconds);
+
+    loop.shutdown();
+    window.shutdown();
+    vk.shutdown();
+    replay.close();
+    if (write_rows(out_path, rows) != k_success) return 1;
+    Log::info("Wrote %s", out_path);
+    Log::shutdown();
+    return 0;
+}